@@ -241,6 +241,9 @@ struct SuggestContext {
   // The common thread pool to use.
   ::util::threading::ThreadPool* pool = nullptr;
 
+  // The priority and deadline of the work added to the pool for this context.
+  ::util::threading::ThreadPoolTaskOptions pool_options;
+
   // This is the response that has already been computed after merging and
   // sorting the results of the primary algorithms. Some secondary algorithms
   // may choose to use these responses while computing suggestions.
@@ -9,6 +9,7 @@
 
 #include "base/common.h"
 #include "meta/suggest/common/suggest_datatypes.h"
+#include "util/async/task.h"
 #include "util/factory/factory.h"
 #include "util/factory/factory_extra.h"
 
@@ -41,6 +42,23 @@ class SuggestAlgo : public Factory<SuggestAlgo, string, string> {
                              shared_ptr<SuggestResponse> response,
                              shared_ptr<SuggestAlgoContext> context) const = 0;
 
+  // Asynchronous version of GetCompletions(): returns a task for the number of
+  // completions, set once the response is filled in. The counter of the
+  // context, if any, is notified as well.
+  // By default GetCompletions() runs on the pool of the context, with the
+  // pool options of the context, or right away if it has no pool. If the
+  // deadline passes before it starts, it does not run and the task is never
+  // set. Algos that wait on other work (other algos, RPCs) override this so
+  // that no thread is blocked while they wait.
+  virtual ::util::async::Task<int> GetCompletionsAsync(
+      const SuggestRequest& request, shared_ptr<SuggestResponse> response,
+      shared_ptr<SuggestAlgoContext> context) const {
+    return ::util::async::Async(context->pool,
+        [this, request, response, context]() {
+      return GetCompletions(request, response, context);
+    }, context->pool_options);
+  }
+
   // Utility function when there is no context specified.
   int GetCompletions(const SuggestRequest& request,
                              shared_ptr<SuggestResponse> response) const {
@@ -6,6 +6,7 @@
 
 #include <algorithm>
 #include <functional>
+#include <mutex>
 
 #include "util/time/simple_timer.h"
 
@@ -39,6 +40,38 @@ bool SuggestAlgoGroup::Initialize() {
   return true;
 }
 
+struct SuggestAlgoGroup::AsyncCall {
+  AsyncCall(const SuggestRequest& request, shared_ptr<SuggestResponse> response,
+            shared_ptr<SuggestAlgoContext> context,
+            const SuggestAlgoGroupParams& params)
+      : request(request), response(response), context(context),
+        algo_responses(params.algo_params.size()),
+        finished(params.algo_params.size(), false),
+        required_algos(params.num_required_algos_),
+        optional_algos(params.num_optional_algos_) {
+    timer.Start();
+  }
+
+  const SuggestRequest request;
+  const shared_ptr<SuggestResponse> response;
+  const shared_ptr<SuggestAlgoContext> context;
+  vector<shared_ptr<SuggestResponse>> algo_responses;
+
+  // Whether each algo has finished. The response of an algo that has not
+  // finished may still be written to, so only finished ones are merged.
+  std::mutex finished_mutex;
+  vector<bool> finished;
+
+  // The required and optional algos that have not finished.
+  ::util::threading::Counter required_algos;
+  ::util::threading::Counter optional_algos;
+
+  // The merged suggestions. Only used by the merge steps, one at a time.
+  unordered_map<SuggestionId, Completion> combined_suggestions;
+
+  ::util::time::SimpleTimer timer;
+};
+
 // The interface function for different suggest Algos. The response is filled
 // with relevant results from the algorithm. If a counter is specified the
 // algorithm calls Notify() once valid results have been filled into the
@@ -46,80 +79,108 @@ bool SuggestAlgoGroup::Initialize() {
 int SuggestAlgoGroup::GetCompletions(const SuggestRequest& request,
                                      shared_ptr<SuggestResponse> response,
                                      shared_ptr<SuggestAlgoContext> context) const {
-  ::util::threading::ScopedCNotify n(context->counter.get());
-  ::util::time::ScopedMilliSecondsTimer timer(
-      params().id + ": [" + request.normalized_query + "] (ms):", 3);
+  return GetCompletionsAsync(request, response, context).Get();
+}
 
+::util::async::Task<int> SuggestAlgoGroup::GetCompletionsAsync(
+    const SuggestRequest& request, shared_ptr<SuggestResponse> response,
+    shared_ptr<SuggestAlgoContext> context) const {
   VLOG(3) << params().id << ": [" << request.normalized_query << "]";
 
-  // Prepare the contexts for the different algorithms.
-  shared_ptr<SuggestAlgoContext> required_algos_context(
-      new SuggestAlgoContext(*context));
-
-  shared_ptr<SuggestAlgoContext> optional_algos_context(
-      new SuggestAlgoContext(*context));
-
-  required_algos_context->counter.reset(
-      new ::util::threading::Counter(params().num_required_algos_));
-  optional_algos_context->counter.reset(
-      new ::util::threading::Counter(params().num_optional_algos_));
+  shared_ptr<AsyncCall> call(new AsyncCall(request, response, context,
+                                           params()));
+
+  // The algos report back through their tasks, not through a counter.
+  shared_ptr<SuggestAlgoContext> algo_context(new SuggestAlgoContext(*context));
+  algo_context->counter.reset();
+
+  // The optional algos are only useful until we stop waiting for them.
+  shared_ptr<SuggestAlgoContext> optional_context = algo_context;
+  if (params().low_priority_optional_algos) {
+    typedef ::util::threading::ThreadPoolTaskOptions tOptions;
+    tOptions options = tOptions::WithTimeout(
+        params().timeout_required_algos_ms + params().timeout_optional_algos_ms,
+        ::util::threading::ThreadPoolPriority::kLow);
+    options.deadline = min(options.deadline, context->pool_options.deadline);
+    optional_context.reset(new SuggestAlgoContext(*algo_context));
+    optional_context->pool_options = options;
+  }
 
-  vector<shared_ptr<SuggestResponse>> algo_responses(suggest_algos_.size());
   for (int i = 0; i < suggest_algos_.size(); ++i) {
-    // Prepare the request and the response.
-    shared_ptr<SuggestResponse>& algo_response = algo_responses[i];
+    shared_ptr<SuggestResponse>& algo_response = call->algo_responses[i];
     algo_response = shared_ptr<SuggestResponse>(new SuggestResponse);
 
-    shared_ptr<SuggestAlgoContext>& algo_context = params().algo_params[i].required ?
-        required_algos_context : optional_algos_context;
-
-    const shared_proxy& algo = suggest_algos_[i];
-    auto func = [=]() mutable {
-          algo->GetCompletions(request, algo_response, algo_context);
-        };
-
-    if (context->pool != nullptr) context->pool->Add(func);
-    else func();
+    bool required = params().algo_params[i].required;
+    suggest_algos_[i]->GetCompletionsAsync(request, algo_response,
+        required ? algo_context : optional_context).OnReady(
+        [call, i, required](int) {
+      {
+        lock_guard<std::mutex> l(call->finished_mutex);
+        call->finished[i] = true;
+      }
+      if (required) call->required_algos.Notify();
+      else call->optional_algos.Notify();
+    });
   }
 
-  // Wait for all the required algorithms to finish.
-  required_algos_context->counter->WaitWithTimeout(
-      params().timeout_required_algos_ms);
-
-  unordered_map<SuggestionId, Completion> combined_suggestions;
-  // Add all the results from finished *required* algos.
-  for (int i = 0; i < suggest_algos_.size(); ++i) {
-    const SuggestAlgoGroupParams::AlgoParams& algo_param = params().algo_params[i];
-    if (!algo_param.required) continue;
-    MergeSuggestionsFromAlgo(request, algo_param, algo_responses[i],
-                             &combined_suggestions);
-  }
+  // Wait for all the required algorithms to finish, then, if the total
+  // suggestions are less than the required number, allow more time for
+  // optional algorithms to finish. The merges run on the pool of the context,
+  // not on the timer thread that fires the timeouts.
+  ::util::threading::ThreadPool* pool = context->pool;
+  return ::util::async::WhenZero(&call->required_algos,
+                                 params().timeout_required_algos_ms).Then(
+      [this, call](bool) {
+    MergeFinishedAlgos(true, call.get());
+    if (call->combined_suggestions.size() >= call->request.num_suggestions)
+      return ::util::async::MakeReadyTask(true);
+    return ::util::async::WhenZero(&call->optional_algos,
+                                   params().timeout_optional_algos_ms);
+  }, pool).Then([this, call](bool) {
+    MergeFinishedAlgos(false, call.get());
+    return FinishCall(call.get());
+  }, pool);
+}
 
-  // If the total suggestions are less than the required number, allow more time for optional
-  // algorithms to finish.
-  if (combined_suggestions.size() < request.num_suggestions) {
-    optional_algos_context->counter->WaitWithTimeout(
-        params().timeout_optional_algos_ms);
+void SuggestAlgoGroup::MergeFinishedAlgos(bool required,
+                                          AsyncCall* call) const {
+  vector<bool> finished;
+  {
+    lock_guard<std::mutex> l(call->finished_mutex);
+    finished = call->finished;
   }
-
-  // Add all the results from finished *optional* algos.
   for (int i = 0; i < suggest_algos_.size(); ++i) {
     const SuggestAlgoGroupParams::AlgoParams& algo_param = params().algo_params[i];
-
-    if (algo_param.required) continue;
-
-    MergeSuggestionsFromAlgo(request, algo_param, algo_responses[i],
-                             &combined_suggestions);
+    if (algo_param.required != required) continue;
+    if (!finished[i]) {
+      VLOG(3) << algo_param.id << " timed out for query ["
+              << call->request.normalized_query << "]";
+      continue;
+    }
+    MergeSuggestionsFromAlgo(call->request, algo_param,
+                             call->algo_responses[i],
+                             &call->combined_suggestions);
   }
+}
+
+int SuggestAlgoGroup::FinishCall(AsyncCall* call) const {
+  ::util::threading::ScopedCNotify n(call->context->counter.get());
+  SuggestResponse* response = call->response.get();
 
   // Fill in the suggestions.
   response->completions.reserve(response->completions.size() +
-                                combined_suggestions.size());
-  for (const auto& p : combined_suggestions)
+                                call->combined_suggestions.size());
+  for (const auto& p : call->combined_suggestions)
     response->completions.push_back(p.second);
 
-  VLOG(3) << params().id << " found " << combined_suggestions.size()
-          << " suggestions for query : [" << request.normalized_query << "]";
+  VLOG(3) << params().id << " found " << call->combined_suggestions.size()
+          << " suggestions for query : [" << call->request.normalized_query
+          << "]";
+
+  call->timer.Stop();
+  VLOG(3) << " Time: " << params().id << ": ["
+          << call->request.normalized_query << "] (ms):"
+          << ": " << call->timer.GetDuration();
 
   response->success = true;
   return response->completions.size();
@@ -31,10 +31,20 @@ class SuggestAlgoGroup : public SuggestAlgo {
   // with relevant results from the algorithm. If a counter is specified the
   // algorithm calls Notify() once valid results have been filled into the
   // response.
+  // Waits for GetCompletionsAsync().
   virtual int GetCompletions(const SuggestRequest& request,
                              shared_ptr<SuggestResponse> response,
                              shared_ptr<SuggestAlgoContext> context) const;
 
+  // Starts the algos of the group and merges their results once the required
+  // algos are done (or timed out), and the optional ones if needed. No thread
+  // waits in the meantime: the merges run on the pool of the context, or
+  // inline on the thread completing the last algo or firing the timeout if it
+  // has no pool.
+  virtual ::util::async::Task<int> GetCompletionsAsync(
+      const SuggestRequest& request, shared_ptr<SuggestResponse> response,
+      shared_ptr<SuggestAlgoContext> context) const;
+
  protected:
   // The parameters struct to configure the algo.
   struct SuggestAlgoGroupParams {
@@ -79,8 +89,16 @@ class SuggestAlgoGroup : public SuggestAlgo {
     // 70msec, we wait for another 10msec for optional algos.
     int timeout_optional_algos_ms = 30;
 
+    // Whether to run the optional algos at low priority on the pool, with a
+    // deadline at the longest we may wait for them. Optional algos that have
+    // not started by then are dropped instead of delaying other requests.
+    // Off by default, as a busy pool then drops optional algos that used to
+    // run.
+    bool low_priority_optional_algos = false;
+
     SERIALIZE(DEFAULT_CUSTOM / id*1 / algo_params*2 /
-              timeout_required_algos_ms*3 / timeout_optional_algos_ms*4);
+              timeout_required_algos_ms*3 / timeout_optional_algos_ms*4 /
+              low_priority_optional_algos*5);
 
     // The number of required algos. This is not serialized and computed in
     // Initialize().
@@ -91,6 +109,16 @@ class SuggestAlgoGroup : public SuggestAlgo {
     int num_optional_algos_ = 0;
   };
 
+  // The state of a GetCompletionsAsync() call, shared with its algos.
+  struct AsyncCall;
+
+  // Merges the suggestions from the required or optional algos that have
+  // finished.
+  void MergeFinishedAlgos(bool required, AsyncCall* call) const;
+
+  // Fills in the response once the algos have been merged.
+  int FinishCall(AsyncCall* call) const;
+
   // Merges the suggestions from an algo
   void MergeSuggestionsFromAlgo(const SuggestRequest& request,
       const SuggestAlgoGroupParams::AlgoParams& algo_param,
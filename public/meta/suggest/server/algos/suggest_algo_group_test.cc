@@ -3,6 +3,9 @@
 
 #include "meta/suggest/server/algos/suggest_algo_group.h"
 
+#include <chrono>
+#include <thread>
+
 #include "meta/suggest/server/algos/suggest_algo_mock.h"
 #include "meta/suggest/server/test_util/suggest_server_test_util.h"
 #include "test/cc/test_main.h"
@@ -34,7 +37,8 @@ class SuggestAlgoGroupTest : public ::testing::Test {
               "\"op\": \"+\","
               "\"required\": false"
             "}"
-          "]"
+          "],"
+          "\"low_priority_optional_algos\": true"
         "}";
 
     // Register suggest algo primary group.
@@ -119,6 +123,83 @@ TEST_F(SuggestAlgoGroupTest, Sanity) {
   EXPECT_EQ(5, algo_group_->GetCompletions(request_, response_, context_));
 }
 
+TEST_F(SuggestAlgoGroupTest, Async) {
+  UseThreadPool();
+  SetUpDefaults();
+
+  SuggestResponse mock_response_1 = MakeMockSuggestResponse("mock1", 100, 3);
+  SuggestResponse mock_response_2 = MakeMockSuggestResponse("mock2", 200, 2);
+
+  EXPECT_CALL(*mock_algo1_, GetCompletions(_, _, _))
+      .WillOnce(SetMockResponseNotifyCounter(mock_response_1));
+
+  EXPECT_CALL(*mock_algo2_, GetCompletions(_, _, _))
+      .WillOnce(SetMockResponseNotifyCounter(mock_response_2));
+
+  context_->counter.reset(new ::util::threading::Counter(1));
+  ::util::async::Task<int> task =
+      algo_group_->GetCompletionsAsync(request_, response_, context_);
+  EXPECT_EQ(5, task.Get());
+  EXPECT_EQ(5, response_->completions.size());
+  EXPECT_TRUE(context_->counter->WaitWithTimeout(1000));
+}
+
+TEST_F(SuggestAlgoGroupTest, RequiredAlgoTimesOut) {
+  UseThreadPool();
+  SetUpDefaults();
+
+  SuggestResponse mock_response_1 = MakeMockSuggestResponse("mock1", 100, 3);
+  SuggestResponse mock_response_2 = MakeMockSuggestResponse("mock2", 200, 2);
+
+  // The required algo only finishes after the group has given up on it.
+  ::util::threading::Notification release, released;
+  EXPECT_CALL(*mock_algo1_, GetCompletions(_, _, _))
+      .WillOnce(::testing::Invoke([&](const SuggestRequest&,
+                                      shared_ptr<SuggestResponse> response,
+                                      shared_ptr<SuggestAlgoContext>) {
+        release.Wait();
+        *response = mock_response_1;
+        released.Notify();
+        return 3;
+      }));
+
+  EXPECT_CALL(*mock_algo2_, GetCompletions(_, _, _))
+      .WillOnce(SetMockResponseNotifyCounter(mock_response_2));
+
+  // Only the optional algo is merged.
+  EXPECT_EQ(2, algo_group_->GetCompletions(request_, response_, context_));
+  release.Notify();
+  released.Wait();
+}
+
+TEST_F(SuggestAlgoGroupTest, OptionalAlgoDroppedAfterDeadline) {
+  pool_.reset(new ::util::threading::ThreadPool(1));
+  UseThreadPool();
+  SetUpDefaults();
+
+  SuggestResponse mock_response_1 = MakeMockSuggestResponse("mock1", 100, 3);
+  EXPECT_CALL(*mock_algo1_, GetCompletions(_, _, _))
+      .WillOnce(SetMockResponseNotifyCounter(mock_response_1));
+  EXPECT_CALL(*mock_algo2_, GetCompletions(_, _, _)).Times(0);
+
+  // Keep the only worker busy past the time the group waits for the algos.
+  ::util::threading::Notification release;
+  pool_->Add([&release]() { release.Wait(); });
+  ::util::async::Task<int> task =
+      algo_group_->GetCompletionsAsync(request_, response_, context_);
+  thread releaser([&release]() {
+    this_thread::sleep_for(chrono::milliseconds(300));
+    release.Notify();
+  });
+
+  // The merges run on the pool after the required algo, which is merged. The
+  // optional one is dropped.
+  EXPECT_EQ(3, task.Get());
+  releaser.join();
+  pool_->Wait();
+  EXPECT_EQ(1, pool_->num_dropped());
+}
+
 }  // namespace test
 }  // namespace algo
 }  // namespace suggest
@@ -106,6 +106,7 @@ void SuggestionManager::InitThreadPool() {
       gFlag_suggestion_manager_threadpool_size));
 
   ASSERT_NOTNULL(thread_pool_) << "Could not initialize suggest thread pool";
+  thread_pool_->set_name("suggestion_manager");
 }
 
 INIT_ADD("suggestion_manager", [](){ SuggestionManager::Instance(); });
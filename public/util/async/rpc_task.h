@@ -0,0 +1,50 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Task wrappers for RPC calls: the reply is handled by a continuation instead
+// of a thread blocked in RPCClient::Call().
+//
+//   CallRPC<tOutput>(RPCChannel::Get(host, port), request).Then(
+//       [](const RPCChannel::tResult<tOutput>& result) { ... }, pool);
+
+#ifndef _PUBLIC_UTIL_ASYNC_RPC_TASK_H_
+#define _PUBLIC_UTIL_ASYNC_RPC_TASK_H_
+
+#include <memory>
+
+#include "base/common.h"
+#include "util/async/task.h"
+#include "util/network/rpc_channel.h"
+
+namespace util {
+namespace async {
+
+// Sends 'request' on 'channel' and returns a task for the result, set when
+// the reply arrives, the call times out (-1: netclient_default_timeout) or
+// the connection fails. Calls still in flight when the channel is destroyed
+// fail.
+template<class tOutput>
+Task<network::RPCChannel::tResult<tOutput>> CallRPC(
+    const shared_ptr<network::RPCChannel>& channel,
+    const tServerRequestMessage& request, int timeout_ms = -1) {
+  typedef network::RPCChannel::tResult<tOutput> tResult;
+  Promise<tResult> p;
+  channel->CallAsync<tOutput>(request, timeout_ms,
+      function<void(tResult*)>([p](tResult* result) {
+    p.SetValue(std::move(*result));
+  }));
+  return p.task();
+}
+
+// Same for a call to host:port.
+template<class tOutput>
+Task<network::RPCChannel::tResult<tOutput>> CallRPC(
+    const string& host, int port,
+    const tServerRequestMessage& request, int timeout_ms = -1) {
+  return CallRPC<tOutput>(network::RPCChannel::Get(host, port), request,
+                          timeout_ms);
+}
+
+}  // namespace async
+}  // namespace util
+
+#endif  // _PUBLIC_UTIL_ASYNC_RPC_TASK_H_
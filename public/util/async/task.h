@@ -0,0 +1,321 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Continuation-based asynchronous tasks. Code that waits on other work (an RPC,
+// algorithms running on a pool, a Counter) chains what comes next onto a task
+// instead of blocking a thread until the work is done:
+//
+//   Promise<int> p;
+//   Task<int> t = p.task();
+//   Task<string> s = t.Then([](int x) { return to_string(x); }, pool);
+//   ...
+//   p.SetValue(10);  // Runs the continuation on 'pool'.
+//
+// A continuation that returns a Task<U> yields a Task<U>, not a
+// Task<Task<U>>, so asynchronous steps chain without nesting:
+//
+//   CallRPC<tReply>(channel, request).Then([counter](const tResult& r) {
+//     return WhenZero(counter, 10);
+//   }).Then([](bool done) { ... });
+//
+// Continuations run on the given ThreadPool or, without one, inline on the
+// thread that completes the task (or the caller, if it is already complete).
+// Inline continuations must be short: they may run on the Timer thread.
+//
+// T must be default constructible and copyable. A promise dropped without a
+// value leaves its task pending forever, so producers that may fail should
+// set a value describing the error.
+
+#ifndef _PUBLIC_UTIL_ASYNC_TASK_H_
+#define _PUBLIC_UTIL_ASYNC_TASK_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "base/common.h"
+#include "util/thread/counters.h"
+#include "util/thread/small_task.h"
+#include "util/thread/thread_pool.h"
+#include "util/thread/timer.h"
+
+namespace util {
+namespace async {
+
+using ::util::threading::SmallTask;
+using ::util::threading::ThreadPool;
+using ::util::threading::ThreadPoolTaskOptions;
+
+template<class T> class Task;
+template<class T> class Promise;
+
+namespace internal {
+
+// Runs f on 'pool', or inline if it is null.
+inline void RunOn(ThreadPool* pool, SmallTask f,
+                  const ThreadPoolTaskOptions& options = ThreadPoolTaskOptions()) {
+  if (pool != nullptr) pool->Add(std::move(f), options);
+  else f();
+}
+
+// The value of a task and the continuations waiting for it.
+template<class T>
+class TaskState {
+ public:
+  template<class V>
+  bool SetValue(V&& value) {
+    vector<SmallTask> continuations;
+    {
+      lock_guard<mutex> l(mutex_);
+      if (ready_) return false;
+      value_ = std::forward<V>(value);
+      ready_ = true;
+      cond_.notify_all();
+      continuations.swap(continuations_);
+    }
+    for (SmallTask& f : continuations) f();
+    return true;
+  }
+
+  // Calls f once the value is set, right away if it is.
+  void OnReady(SmallTask f) {
+    {
+      lock_guard<mutex> l(mutex_);
+      if (!ready_) {
+        continuations_.push_back(std::move(f));
+        return;
+      }
+    }
+    f();
+  }
+
+  bool ready() {
+    lock_guard<mutex> l(mutex_);
+    return ready_;
+  }
+
+  void Wait() {
+    unique_lock<mutex> l(mutex_);
+    cond_.wait(l, [this]() { return ready_; });
+  }
+
+  bool WaitWithTimeout(int msec) {
+    unique_lock<mutex> l(mutex_);
+    return cond_.wait_for(l, chrono::milliseconds(msec),
+                          [this]() { return ready_; });
+  }
+
+  // Only valid once ready: the value is never written again.
+  const T& value() const { return value_; }
+
+ private:
+  mutex mutex_;
+  condition_variable cond_;
+  bool ready_ = false;
+  T value_;
+  vector<SmallTask> continuations_;
+};
+
+// The type of the task returned by Then(): continuations returning a Task<U>
+// yield a Task<U>.
+template<class U>
+struct ThenTask { typedef Task<U> type; typedef U value_type; };
+template<class U>
+struct ThenTask<Task<U>> { typedef Task<U> type; typedef U value_type; };
+
+// Sets the result of a continuation on p.
+template<class U, class F, class T>
+void Resolve(Promise<U>* p, F* f, const T& value, false_type /* task */) {
+  p->SetValue((*f)(value));
+}
+
+template<class U, class F, class T>
+void Resolve(Promise<U>* p, F* f, const T& value, true_type /* task */) {
+  Promise<U> promise = *p;
+  (*f)(value).OnReady([promise](const U& result) mutable {
+    promise.SetValue(result);
+  });
+}
+
+template<class U>
+struct IsTask : false_type {};
+template<class U>
+struct IsTask<Task<U>> : true_type {};
+
+}  // namespace internal
+
+// The read side of an asynchronous value. Copies share the value.
+template<class T>
+class Task {
+ public:
+  typedef T value_type;
+
+  // An invalid task, to be assigned.
+  Task() {}
+
+  bool valid() const { return state_ != nullptr; }
+  bool ready() const { return state_->ready(); }
+
+  // Waits for the value. Blocks the thread: only for callers that cannot
+  // continue asynchronously, e.g. synchronous APIs implemented on tasks.
+  const T& Get() const {
+    state_->Wait();
+    return state_->value();
+  }
+
+  // Waits up to 'msec' milliseconds for the value. Returns true if it is set.
+  bool WaitWithTimeout(int msec) const {
+    return state_->WaitWithTimeout(msec);
+  }
+
+  // Calls f(value) once the value is set, on 'pool' or inline if it is null.
+  template<class F>
+  void OnReady(F f, ThreadPool* pool = nullptr) const {
+    shared_ptr<internal::TaskState<T>> state = state_;
+    state_->OnReady([state, f, pool]() mutable {
+      internal::RunOn(pool, [state, f]() mutable { f(state->value()); });
+    });
+  }
+
+  // Returns a task for f(value), called on 'pool' or inline if it is null.
+  // If f returns a Task<U>, the result is a Task<U> for its value.
+  template<class F>
+  auto Then(F f, ThreadPool* pool = nullptr) const
+      -> typename internal::ThenTask<
+          typename decay<decltype(f(declval<const T&>()))>::type>::type {
+    typedef typename decay<decltype(f(declval<const T&>()))>::type tResult;
+    typedef typename internal::ThenTask<tResult>::value_type U;
+    Promise<U> p;
+    OnReady([p, f](const T& value) mutable {
+      internal::Resolve(&p, &f, value, internal::IsTask<tResult>());
+    }, pool);
+    return p.task();
+  }
+
+ private:
+  explicit Task(shared_ptr<internal::TaskState<T>> state)
+      : state_(std::move(state)) {}
+
+  shared_ptr<internal::TaskState<T>> state_;
+
+  friend class Promise<T>;
+};
+
+// The write side of an asynchronous value. Copies share the value; the first
+// SetValue() wins.
+template<class T>
+class Promise {
+ public:
+  Promise() : state_(new internal::TaskState<T>) {}
+
+  Task<T> task() const { return Task<T>(state_); }
+
+  // Sets the value and runs the continuations waiting for it. Returns false if
+  // the value was already set, in which case 'value' is dropped.
+  template<class V>
+  bool SetValue(V&& value) const {
+    return state_->SetValue(std::forward<V>(value));
+  }
+
+ private:
+  shared_ptr<internal::TaskState<T>> state_;
+};
+
+// Returns a task that is already complete.
+template<class T>
+Task<typename decay<T>::type> MakeReadyTask(T&& value) {
+  Promise<typename decay<T>::type> p;
+  p.SetValue(std::forward<T>(value));
+  return p.task();
+}
+
+// Returns a task for f(), called on 'pool' or inline if it is null.
+template<class F>
+auto Async(ThreadPool* pool, F f)
+    -> Task<typename decay<decltype(f())>::type> {
+  Promise<typename decay<decltype(f())>::type> p;
+  internal::RunOn(pool, [p, f]() mutable { p.SetValue(f()); });
+  return p.task();
+}
+
+// Same, with the priority and deadline of f on the pool. If f is dropped
+// because its deadline passed, the task is never set: bound the wait with
+// WithTimeout() or WhenZero() as needed.
+template<class F>
+auto Async(ThreadPool* pool, F f, const ThreadPoolTaskOptions& options)
+    -> Task<typename decay<decltype(f())>::type> {
+  Promise<typename decay<decltype(f())>::type> p;
+  internal::RunOn(pool, [p, f]() mutable { p.SetValue(f()); }, options);
+  return p.task();
+}
+
+// Returns a task for the values of 'tasks', in order, set once they are all
+// complete.
+template<class T>
+Task<vector<T>> WhenAll(const vector<Task<T>>& tasks) {
+  if (tasks.empty()) return MakeReadyTask(vector<T>());
+  struct tAll {
+    vector<Task<T>> tasks;
+    atomic<int> remaining;
+    Promise<vector<T>> promise;
+  };
+  shared_ptr<tAll> all(new tAll);
+  all->tasks = tasks;
+  all->remaining = tasks.size();
+  for (const Task<T>& task : tasks) {
+    task.OnReady([all](const T&) {
+      if (--all->remaining > 0) return;
+      vector<T> values;
+      values.reserve(all->tasks.size());
+      for (const Task<T>& t : all->tasks) values.push_back(t.Get());
+      all->promise.SetValue(std::move(values));
+    });
+  }
+  return all->promise.task();
+}
+
+// Returns a task for 'value', set in 'msec' milliseconds by the Timer.
+template<class T>
+Task<typename decay<T>::type> Delay(int msec, T&& value) {
+  typedef typename decay<T>::type tValue;
+  Promise<tValue> p;
+  tValue v = std::forward<T>(value);
+  ::util::threading::Timer::Instance().RunAfter(msec, [p, v]() {
+    p.SetValue(v);
+  });
+  return p.task();
+}
+
+// Returns a task for the value of 'task', or 'on_timeout' if it is not
+// complete within 'msec' milliseconds. A negative timeout waits forever.
+template<class T>
+Task<T> WithTimeout(const Task<T>& task, int msec, T on_timeout) {
+  if (msec < 0) return task;
+  Promise<T> p;
+  ::util::threading::Timer& timer = ::util::threading::Timer::Instance();
+  ::util::threading::Timer::tTimerId id = timer.RunAfter(msec,
+      [p, on_timeout]() { p.SetValue(on_timeout); });
+  task.OnReady([p, id, &timer](const T& value) {
+    if (p.SetValue(value)) timer.Cancel(id);
+  });
+  return p.task();
+}
+
+// Returns a task for whether 'counter' became 0 within 'msec' milliseconds;
+// the asynchronous Counter::WaitWithTimeout(). A negative timeout waits
+// forever. The counter must outlive the wait.
+inline Task<bool> WhenZero(::util::threading::Counter* counter,
+                           int msec = -1) {
+  Promise<bool> p;
+  counter->OnZero([p]() { p.SetValue(true); });
+  return WithTimeout(p.task(), msec, false);
+}
+
+}  // namespace async
+}  // namespace util
+
+#endif  // _PUBLIC_UTIL_ASYNC_TASK_H_
@@ -0,0 +1,127 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/async/task.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "test/cc/test_main.h"
+
+namespace util {
+namespace async {
+namespace test {
+
+using ::util::threading::Counter;
+
+TEST(Task, SetValueRunsContinuations) {
+  Promise<int> p;
+  Task<int> t = p.task();
+  EXPECT_TRUE(t.valid());
+  EXPECT_FALSE(t.ready());
+
+  int seen = 0;
+  t.OnReady([&seen](int x) { seen = x; });
+  EXPECT_EQ(0, seen);
+  EXPECT_TRUE(p.SetValue(7));
+  EXPECT_EQ(7, seen);
+  EXPECT_TRUE(t.ready());
+  EXPECT_EQ(7, t.Get());
+
+  // The first value wins.
+  EXPECT_FALSE(p.SetValue(8));
+  EXPECT_EQ(7, t.Get());
+
+  // Continuations added once ready run right away.
+  t.OnReady([&seen](int x) { seen = x + 1; });
+  EXPECT_EQ(8, seen);
+}
+
+TEST(Task, Then) {
+  Promise<int> p;
+  Task<string> s = p.task().Then([](int x) { return to_string(x); })
+                           .Then([](const string& x) { return x + "!"; });
+  p.SetValue(42);
+  EXPECT_EQ("42!", s.Get());
+}
+
+TEST(Task, ThenFlattensTasks) {
+  Promise<int> p1, p2;
+  Task<int> t = p1.task().Then([p2](int x) {
+    return p2.task().Then([x](int y) { return x + y; });
+  });
+  p1.SetValue(1);
+  EXPECT_FALSE(t.ready());
+  p2.SetValue(2);
+  EXPECT_EQ(3, t.Get());
+}
+
+TEST(Task, ThenOnPool) {
+  ThreadPool pool(2);
+  Promise<int> p;
+  thread::id caller = this_thread::get_id();
+  Task<bool> on_pool = p.task().Then([caller](int) {
+    return this_thread::get_id() != caller;
+  }, &pool);
+  p.SetValue(0);
+  EXPECT_TRUE(on_pool.Get());
+}
+
+TEST(Task, Async) {
+  ThreadPool pool(2);
+  EXPECT_EQ(5, Async(&pool, []() { return 5; }).Get());
+  EXPECT_EQ(6, Async(nullptr, []() { return 6; }).Get());
+}
+
+TEST(Task, WhenAll) {
+  vector<Promise<int>> promises(3);
+  vector<Task<int>> tasks;
+  for (const Promise<int>& p : promises) tasks.push_back(p.task());
+  Task<vector<int>> all = WhenAll(tasks);
+  promises[2].SetValue(3);
+  promises[0].SetValue(1);
+  EXPECT_FALSE(all.ready());
+  promises[1].SetValue(2);
+  EXPECT_EQ(vector<int>({1, 2, 3}), all.Get());
+
+  EXPECT_TRUE(WhenAll(vector<Task<int>>()).ready());
+}
+
+TEST(Task, Delay) {
+  Task<int> t = Delay(20, 3);
+  EXPECT_FALSE(t.WaitWithTimeout(1));
+  EXPECT_EQ(3, t.Get());
+}
+
+TEST(Task, WithTimeout) {
+  Promise<int> p;
+  Task<int> t = WithTimeout(p.task(), 20, -1);
+  EXPECT_EQ(-1, t.Get());
+  // A value set later does not change the result.
+  p.SetValue(1);
+  EXPECT_EQ(-1, t.Get());
+
+  Promise<int> q;
+  t = WithTimeout(q.task(), 1000, -1);
+  q.SetValue(1);
+  EXPECT_EQ(1, t.Get());
+}
+
+TEST(Task, WhenZero) {
+  Counter c(2);
+  Task<bool> t = WhenZero(&c, 1000);
+  c.Notify();
+  EXPECT_FALSE(t.ready());
+  thread([&c]() { c.Notify(); }).join();
+  EXPECT_TRUE(t.Get());
+
+  Counter never(1);
+  EXPECT_FALSE(WhenZero(&never, 20).Get());
+
+  Counter zero(0);
+  EXPECT_TRUE(WhenZero(&zero).ready());
+}
+
+}  // namespace test
+}  // namespace async
+}  // namespace util
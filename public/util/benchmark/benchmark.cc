@@ -0,0 +1,224 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/benchmark/benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+FLAG_string(bench_filter, "",
+            "Only run the benchmarks whose name contains this string.");
+
+FLAG_int(bench_min_ms, 200,
+         "The number of iterations is picked so that a run takes this long.");
+
+FLAG_int(bench_warmup_runs, 1,
+         "The runs of each benchmark done before the measured ones.");
+
+FLAG_int(bench_repetitions, 10, "The measured runs of each benchmark.");
+
+FLAG_string(bench_json, "",
+            "If set, the results are also written to this file as JSON.");
+
+namespace util {
+namespace benchmark {
+
+namespace {
+
+using ::util::time::CycleClock;
+
+// The largest number of iterations of a run.
+const int64_t kMaxIterations = 1000000000;
+
+// The two-sided 95% quantiles of Student's t distribution, by degrees of
+// freedom from 1 to 30. Beyond, the normal quantile is close enough.
+const double kStudentT95[] = {
+  12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+  2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+  2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+};
+
+double Median(vector<double>* values) {
+  size_t n = values->size();
+  sort(values->begin(), values->end());
+  return n % 2 ? (*values)[n / 2]
+               : ((*values)[n / 2 - 1] + (*values)[n / 2]) / 2;
+}
+
+// All the results of a binary, as written to --bench_json.
+struct tReport {
+  double cycles_per_usec = 0;
+  vector<tResult> benchmarks;
+
+  SERIALIZE(DEFAULT_CUSTOM / cycles_per_usec*1 / benchmarks*2);
+};
+
+}  // namespace
+
+void State::Start() {
+  running_ = true;
+  start_ = chrono::steady_clock::now();
+  start_cycles_ = CycleClock::Now();
+}
+
+void State::Stop() {
+  if (!running_) return;
+  elapsed_cycles_ += CycleClock::Now() - start_cycles_;
+  elapsed_ns_ += chrono::duration<double, nano>(
+      chrono::steady_clock::now() - start_).count();
+  running_ = false;
+}
+
+void State::PauseTiming() { Stop(); }
+
+void State::ResumeTiming() { Start(); }
+
+void State::ResetTiming() {
+  elapsed_ns_ = 0;
+  elapsed_cycles_ = 0;
+  Start();
+}
+
+tSummary Summarize(vector<double> values) {
+  tSummary summary;
+  if (values.empty()) return summary;
+  size_t n = values.size();
+  for (double v : values) summary.mean += v;
+  summary.mean /= n;
+  for (double v : values)
+    summary.stddev += (v - summary.mean) * (v - summary.mean);
+  summary.stddev = n > 1 ? sqrt(summary.stddev / (n - 1)) : 0;
+  double t = n - 1 <= sizeof(kStudentT95) / sizeof(kStudentT95[0])
+                 ? (n > 1 ? kStudentT95[n - 2] : 0)
+                 : 1.96;
+  double half_width = t * summary.stddev / sqrt(n);
+  summary.ci_low = summary.mean - half_width;
+  summary.ci_high = summary.mean + half_width;
+
+  summary.median = Median(&values);
+  for (double& v : values) v = fabs(v - summary.median);
+  summary.mad = Median(&values);
+  return summary;
+}
+
+string tResult::ToString() const {
+  stringstream ss;
+  ss << left << setw(40) << name << right << fixed << setprecision(1)
+     << setw(14) << ns_per_iteration.median << setw(10)
+     << ns_per_iteration.mad << setw(22)
+     << ("[" + to_string(llround(ns_per_iteration.ci_low)) + ", " +
+         to_string(llround(ns_per_iteration.ci_high)) + "]")
+     << setw(14) << cycles_per_iteration.median << setw(14) << iterations;
+  if (items_per_second > 0)
+    ss << setw(14) << setprecision(0) << items_per_second;
+  return ss.str();
+}
+
+Benchmark* Benchmark::Range(int64_t begin, int64_t end, int multiplier) {
+  ASSERT(begin > 0 && multiplier > 1) << name_;
+  for (int64_t arg = begin; arg < end; arg *= multiplier) args_.push_back(arg);
+  args_.push_back(end);
+  return this;
+}
+
+vector<string> Benchmark::Names() const {
+  if (args_.empty()) return {name_};
+  vector<string> names;
+  for (int64_t arg : args_) names.push_back(name_ + "/" + to_string(arg));
+  return names;
+}
+
+State Benchmark::RunOnce(int64_t iterations, int64_t arg) const {
+  State state(iterations, arg);
+  state.Start();
+  function_(state);
+  state.Stop();
+  return state;
+}
+
+tResult Benchmark::Run(int index) const {
+  const int64_t arg = args_.empty() ? 0 : args_[index];
+  tResult result;
+  result.name = Names()[index];
+
+  // Grow the iterations until a run takes --bench_min_ms.
+  const double min_ns = gFlag_bench_min_ms * 1e6;
+  int64_t iterations = 1;
+  while (true) {
+    double ns = RunOnce(iterations, arg).elapsed_ns();
+    if (ns >= min_ns || iterations >= kMaxIterations) break;
+    // Aim 20% past the target, growing by at most 10x at a time.
+    double next = ns > 0 ? iterations * min_ns * 1.2 / ns : iterations * 10;
+    iterations = min<int64_t>(kMaxIterations,
+        max<int64_t>(iterations + 1, min<double>(next, iterations * 10)));
+  }
+  result.iterations = iterations;
+
+  for (int i = 0; i < gFlag_bench_warmup_runs; ++i) RunOnce(iterations, arg);
+
+  vector<double> ns, cycles;
+  double items_per_second = 0;
+  for (int i = 0; i < gFlag_bench_repetitions; ++i) {
+    State state = RunOnce(iterations, arg);
+    ns.push_back(state.elapsed_ns() / iterations);
+    cycles.push_back(double(state.elapsed_cycles()) / iterations);
+    if (state.items_processed() > 0 && state.elapsed_ns() > 0)
+      items_per_second += state.items_processed() * 1e9 / state.elapsed_ns();
+  }
+  result.repetitions = ns.size();
+  result.ns_per_iteration = Summarize(ns);
+  result.cycles_per_iteration = Summarize(cycles);
+  if (!ns.empty()) result.items_per_second = items_per_second / ns.size();
+  return result;
+}
+
+vector<unique_ptr<Benchmark>>& Benchmark::Registry() {
+  static vector<unique_ptr<Benchmark>> benchmarks;
+  return benchmarks;
+}
+
+const vector<unique_ptr<Benchmark>>& Benchmark::All() { return Registry(); }
+
+Benchmark* Benchmark::Register(const string& name, const tFunction& function) {
+  Registry().emplace_back(new Benchmark(name, function));
+  return Registry().back().get();
+}
+
+int RunBenchmarks() {
+  tReport report;
+  report.cycles_per_usec = CycleClock::CyclesPerUsec();
+  cout << "Median of " << gFlag_bench_repetitions << " runs of at least "
+       << gFlag_bench_min_ms << "ms, " << fixed << setprecision(0)
+       << report.cycles_per_usec << " cycles/us" << endl;
+  cout << left << setw(40) << "benchmark" << right << setw(14) << "ns/iter"
+       << setw(10) << "mad" << setw(22) << "95% ci" << setw(14)
+       << "cycles/iter" << setw(14) << "iterations" << setw(14) << "items/s"
+       << endl;
+
+  for (const auto& benchmark : Benchmark::All()) {
+    vector<string> names = benchmark->Names();
+    for (int i = 0; i < names.size(); ++i) {
+      if (names[i].find(gFlag_bench_filter) == string::npos) continue;
+      report.benchmarks.push_back(benchmark->Run(i));
+      cout << report.benchmarks.back().ToString() << endl;
+    }
+  }
+
+  if (!gFlag_bench_json.empty()) {
+    ofstream out(gFlag_bench_json);
+    serial::Serializer::ToJSON(out, report, serial::JSONSerializationParams(
+        2, 0, serial::kSerializeAllFields));
+    out << endl;
+    if (!out) {
+      LOG(ERROR) << "Could not write the results to " << gFlag_bench_json;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+}  // namespace benchmark
+}  // namespace util
@@ -0,0 +1,185 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Microbenchmark framework.
+//
+// A benchmark is a function that runs the code to measure state.iterations()
+// times:
+//
+//   void BM_Find(util::benchmark::State& state) {
+//     SharedLRUCache<int, int> cache(state.arg());
+//     ... fill the cache, outside of the loop ...
+//     state.ResetTiming();
+//     for (int64_t i = 0; i < state.iterations(); ++i)
+//       util::benchmark::DoNotOptimize(cache.find(i % state.arg()));
+//     state.SetItemsProcessed(state.iterations());
+//   }
+//   BENCHMARK(BM_Find)->Arg(1000)->Arg(1000000);
+//
+// Include util/benchmark/benchmark_main.h instead of this file to get a
+// binary that runs the registered benchmarks. For each benchmark and argument, the runner:
+// - picks the number of iterations so that one run takes --bench_min_ms,
+// - runs it for --bench_warmup_runs runs that are not counted,
+// - runs it --bench_repetitions times and summarizes the time and cycles per
+//   iteration: median, median absolute deviation and a 95% confidence
+//   interval of the mean.
+// With --bench_json=file the results are also written as JSON, to track
+// regressions across versions. --bench_filter selects the benchmarks whose
+// name contains it.
+
+#ifndef _PUBLIC_UTIL_BENCHMARK_BENCHMARK_H_
+#define _PUBLIC_UTIL_BENCHMARK_BENCHMARK_H_
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/common.h"
+#include "util/serial/serializer.h"
+#include "util/time/cycle_clock.h"
+
+extern string gFlag_bench_filter;
+extern int gFlag_bench_min_ms;
+extern int gFlag_bench_warmup_runs;
+extern int gFlag_bench_repetitions;
+extern string gFlag_bench_json;
+
+namespace util {
+namespace benchmark {
+
+// Keeps the compiler from optimizing away the computation of 'value'.
+template<class T>
+inline void DoNotOptimize(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// The state of one run of a benchmark.
+class State {
+ public:
+  State(int64_t iterations, int64_t arg) : iterations_(iterations), arg_(arg) {}
+
+  int64_t iterations() const { return iterations_; }
+  // The argument of the benchmark, 0 if it has none.
+  int64_t arg() const { return arg_; }
+
+  // Excludes the time between PauseTiming() and ResumeTiming() from the run,
+  // e.g. to rebuild the input. Both take about 100ns, so only call them
+  // around work that is much longer than that.
+  void PauseTiming();
+  void ResumeTiming();
+  // Restarts the timing, after a setup done at the beginning of the run.
+  void ResetTiming();
+
+  // The items processed by the run, if it is more meaningful than an
+  // iteration. Reported as items per second.
+  void SetItemsProcessed(int64_t items) { items_processed_ = items; }
+  int64_t items_processed() const { return items_processed_; }
+
+  // Called by the runner.
+  void Start();
+  void Stop();
+  double elapsed_ns() const { return elapsed_ns_; }
+  int64_t elapsed_cycles() const { return elapsed_cycles_; }
+
+ private:
+  const int64_t iterations_;
+  const int64_t arg_;
+  int64_t items_processed_ = 0;
+  bool running_ = false;
+  chrono::steady_clock::time_point start_;
+  int64_t start_cycles_ = 0;
+  double elapsed_ns_ = 0;
+  int64_t elapsed_cycles_ = 0;
+};
+
+// Summary of the measurements of several runs.
+struct tSummary {
+  double median = 0;
+  // The median absolute deviation from the median.
+  double mad = 0;
+  double mean = 0;
+  double stddev = 0;
+  // The 95% confidence interval of the mean (Student's t).
+  double ci_low = 0;
+  double ci_high = 0;
+
+  SERIALIZE(DEFAULT_CUSTOM / median*1 / mad*2 / mean*3 / stddev*4 /
+            ci_low*5 / ci_high*6);
+};
+
+tSummary Summarize(vector<double> values);
+
+// The result of a benchmark for one argument.
+struct tResult {
+  string name;
+  int64_t iterations = 0;
+  int repetitions = 0;
+  tSummary ns_per_iteration;
+  tSummary cycles_per_iteration;
+  // 0 if the benchmark does not set the items processed.
+  double items_per_second = 0;
+
+  SERIALIZE(DEFAULT_CUSTOM / name*1 / iterations*2 / repetitions*3 /
+            ns_per_iteration*4 / cycles_per_iteration*5 /
+            items_per_second*6);
+
+  // One line of the table printed by the runner.
+  string ToString() const;
+};
+
+// A registered benchmark.
+class Benchmark {
+ public:
+  typedef function<void(State&)> tFunction;
+
+  Benchmark(const string& name, const tFunction& function)
+      : name_(name), function_(function) {}
+
+  // Runs the benchmark once for each argument.
+  Benchmark* Arg(int64_t arg) {
+    args_.push_back(arg);
+    return this;
+  }
+  // Arguments from 'begin' to 'end', multiplying by 'multiplier' each time.
+  Benchmark* Range(int64_t begin, int64_t end, int multiplier = 8);
+
+  // The name of the benchmark for each argument, e.g. "BM_Find/1000".
+  vector<string> Names() const;
+
+  // Runs the benchmark for the index-th argument.
+  tResult Run(int index) const;
+
+  // Registers a benchmark. The benchmarks are owned by the registry.
+  static Benchmark* Register(const string& name, const tFunction& function);
+  static const vector<unique_ptr<Benchmark>>& All();
+
+ private:
+  static vector<unique_ptr<Benchmark>>& Registry();
+
+  // Runs the function once for 'iterations' iterations.
+  State RunOnce(int64_t iterations, int64_t arg) const;
+
+  const string name_;
+  const tFunction function_;
+  vector<int64_t> args_;
+};
+
+// Runs the benchmarks selected by --bench_filter, prints the results and
+// writes them to --bench_json. Returns 0 on success.
+int RunBenchmarks();
+
+}  // namespace benchmark
+}  // namespace util
+
+#define BENCHMARK_CONCAT_(a, b) a##b
+#define BENCHMARK_CONCAT(a, b) BENCHMARK_CONCAT_(a, b)
+
+// Registers a benchmark function. Arguments are added with ->Arg() and
+// ->Range().
+#define BENCHMARK(function)                                         \
+  static ::util::benchmark::Benchmark* BENCHMARK_CONCAT(            \
+      benchmark_registration_, __LINE__) __attribute__((unused)) =  \
+      ::util::benchmark::Benchmark::Register(#function, function)
+
+#endif  // _PUBLIC_UTIL_BENCHMARK_BENCHMARK_H_
@@ -0,0 +1,8 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Main of the microbenchmark binaries: runs the registered benchmarks.
+
+#include "util/benchmark/benchmark_main.h"
+#include "util/init/main.h"
+
+int init_main() { return util::benchmark::RunBenchmarks(); }
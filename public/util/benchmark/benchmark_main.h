@@ -0,0 +1,11 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Include this instead of benchmark.h in a benchmark binary to link the main
+// that runs the registered benchmarks.
+
+#ifndef _PUBLIC_UTIL_BENCHMARK_BENCHMARK_MAIN_H_
+#define _PUBLIC_UTIL_BENCHMARK_BENCHMARK_MAIN_H_
+
+#include "util/benchmark/benchmark.h"
+
+#endif  // _PUBLIC_UTIL_BENCHMARK_BENCHMARK_MAIN_H_
@@ -0,0 +1,84 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/benchmark/benchmark.h"
+
+#include <cmath>
+#include <thread>
+
+#include "test/cc/test_main.h"
+
+namespace util {
+namespace benchmark {
+namespace test {
+
+TEST(Benchmark, Summarize) {
+  tSummary summary = Summarize({3, 1, 2, 100, 4});
+  EXPECT_DOUBLE_EQ(3, summary.median);
+  EXPECT_DOUBLE_EQ(1, summary.mad);
+  EXPECT_DOUBLE_EQ(22, summary.mean);
+  EXPECT_LT(summary.ci_low, summary.mean);
+  EXPECT_GT(summary.ci_high, summary.mean);
+  EXPECT_NEAR(2.776 * summary.stddev / sqrt(5),
+              summary.ci_high - summary.mean, 1e-9);
+
+  summary = Summarize({5, 5, 5, 5});
+  EXPECT_DOUBLE_EQ(5, summary.median);
+  EXPECT_DOUBLE_EQ(0, summary.mad);
+  EXPECT_DOUBLE_EQ(5, summary.ci_low);
+  EXPECT_DOUBLE_EQ(5, summary.ci_high);
+
+  summary = Summarize({2, 4});
+  EXPECT_DOUBLE_EQ(3, summary.median);
+  EXPECT_DOUBLE_EQ(1, summary.mad);
+
+  summary = Summarize({});
+  EXPECT_DOUBLE_EQ(0, summary.median);
+}
+
+TEST(Benchmark, Names) {
+  Benchmark none("BM_None", [](State&) {});
+  EXPECT_EQ(vector<string>({"BM_None"}), none.Names());
+
+  Benchmark range("BM_Range", [](State&) {});
+  range.Range(1, 100)->Arg(7);
+  EXPECT_EQ(vector<string>({"BM_Range/1", "BM_Range/8", "BM_Range/64",
+                            "BM_Range/100", "BM_Range/7"}),
+            range.Names());
+}
+
+TEST(Benchmark, Run) {
+  gFlag_bench_min_ms = 5;
+  gFlag_bench_repetitions = 3;
+  int64_t last_arg = -1;
+  Benchmark benchmark("BM_Sleep", [&last_arg](State& state) {
+    last_arg = state.arg();
+    // The setup is not timed.
+    this_thread::sleep_for(chrono::milliseconds(10));
+    state.ResetTiming();
+    for (int64_t i = 0; i < state.iterations(); ++i) {
+      this_thread::sleep_for(chrono::microseconds(100));
+      state.PauseTiming();
+      this_thread::sleep_for(chrono::microseconds(100));
+      state.ResumeTiming();
+    }
+    state.SetItemsProcessed(2 * state.iterations());
+  });
+  benchmark.Arg(3);
+
+  tResult result = benchmark.Run(0);
+  EXPECT_EQ(3, last_arg);
+  EXPECT_EQ("BM_Sleep/3", result.name);
+  EXPECT_EQ(3, result.repetitions);
+  // Each timed run takes at least 5ms, at least 100us per iteration.
+  EXPECT_LE(result.iterations, 100);
+  EXPECT_LE(100000, result.ns_per_iteration.median);
+  EXPECT_LT(0, result.cycles_per_iteration.median);
+  EXPECT_LT(0, result.items_per_second);
+  EXPECT_GE(2e9 / result.ns_per_iteration.median * 1.5,
+            result.items_per_second);
+  EXPECT_NE(string::npos, result.ToString().find("BM_Sleep/3"));
+}
+
+}  // namespace test
+}  // namespace benchmark
+}  // namespace util
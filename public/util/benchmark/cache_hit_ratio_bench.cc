@@ -0,0 +1,134 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Hit ratios of the cache eviction policies on replayed traces, to pick the
+// policy of a cache: each access looks the key up, and inserts it on a miss,
+// as CachedHttpBase and store::SimpleCacher do. The caches hold 0.1%, 1% and
+// 10% of the distinct keys of the trace.
+//
+// --bench_trace replays a file with one access per line: the first word of
+// the line is the key, e.g. the urls of an access log. Without it, replays
+// synthetic traces:
+// - zipf: keys drawn from a Zipf distribution,
+// - zipf+scans: the same, with bursts of keys that are accessed once, as from
+//   a crawler or a batch job.
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "base/common.h"
+#include "util/cache/eviction_policy.h"
+#include "util/cache/sharded_lru_cache.h"
+#include "util/cache/shared_lru_cache.h"
+#include "util/init/main.h"
+
+FLAG_string(bench_trace, "",
+            "A file of accesses to replay, one per line. Empty: replays the "
+            "synthetic traces.");
+
+FLAG_int(bench_trace_length, 2000000,
+         "The number of accesses of the synthetic traces.");
+
+FLAG_int(bench_num_keys, 1000000,
+         "The number of keys of the Zipf distribution of the synthetic traces.");
+
+FLAG_double(bench_zipf_exponent, 0.9,
+            "The exponent of the Zipf distribution of the synthetic traces.");
+
+namespace {
+
+typedef vector<int> tTrace;
+
+template<template<class, class> class P>
+using tSharedCache = SharedLRUCache<int, int, hash<int>, equal_to<int>, P>;
+typedef ShardedLRUCache<int, int> tShardedCache;
+
+tTrace ReadTrace(const string& filename) {
+  ifstream file(filename);
+  ASSERT(file.good()) << "Could not open " << filename;
+  unordered_map<string, int> ids;
+  tTrace trace;
+  string line, key;
+  while (getline(file, line)) {
+    istringstream words(line);
+    if (!(words >> key)) continue;
+    trace.push_back(ids.insert(make_pair(key, int(ids.size()))).first->second);
+  }
+  return trace;
+}
+
+tTrace Zipf(int length, mt19937* random) {
+  vector<double> cdf(gFlag_bench_num_keys);
+  double sum = 0;
+  for (int i = 0; i < gFlag_bench_num_keys; ++i) {
+    sum += 1 / pow(i + 1, gFlag_bench_zipf_exponent);
+    cdf[i] = sum;
+  }
+  uniform_real_distribution<double> uniform(0, sum);
+  tTrace trace(length);
+  for (int& key : trace)
+    key = lower_bound(cdf.begin(), cdf.end(), uniform(*random)) - cdf.begin();
+  return trace;
+}
+
+// Every 10% of the trace, a scan of 5% of its length in new keys.
+tTrace WithScans(const tTrace& zipf) {
+  tTrace trace;
+  int next_key = gFlag_bench_num_keys;
+  int period = max<int>(1, zipf.size() / 10);
+  for (size_t i = 0; i < zipf.size(); ++i) {
+    if (i % period == 0) {
+      for (int j = 0; j < period / 2; ++j) trace.push_back(next_key++);
+    }
+    trace.push_back(zipf[i]);
+  }
+  return trace;
+}
+
+template<class tCache>
+double HitRatio(const tTrace& trace, int cache_size) {
+  tCache cache(cache_size);
+  int64_t hits = 0;
+  for (int key : trace) {
+    if (cache.find(key) != cache.end()) ++hits;
+    else cache.insert(make_pair(key, key));
+  }
+  return trace.empty() ? 0 : 100.0 * hits / trace.size();
+}
+
+void Report(const string& name, const tTrace& trace) {
+  int num_keys = unordered_set<int>(trace.begin(), trace.end()).size();
+  cout << name << ": " << trace.size() << " accesses, " << num_keys
+       << " keys, hit ratio (%)" << endl;
+  cout << setw(12) << "cache size" << setw(10) << "LRU" << setw(11)
+       << "W-TinyLFU" << setw(15) << "CLOCK/sharded" << endl;
+  for (int per_mille : {1, 10, 100}) {
+    int cache_size = max(1, num_keys * per_mille / 1000);
+    cout << setw(12) << cache_size << fixed << setprecision(2)
+         << setw(10) << HitRatio<tSharedCache<LRUPolicy>>(trace, cache_size)
+         << setw(11) << HitRatio<tSharedCache<WTinyLFUPolicy>>(trace, cache_size)
+         << setw(15) << HitRatio<tShardedCache>(trace, cache_size) << endl;
+  }
+}
+
+}  // namespace
+
+int init_main() {
+  if (!gFlag_bench_trace.empty()) {
+    Report(gFlag_bench_trace, ReadTrace(gFlag_bench_trace));
+    return 0;
+  }
+  mt19937 random(77);
+  tTrace zipf = Zipf(gFlag_bench_trace_length, &random);
+  Report("zipf", zipf);
+  Report("zipf+scans", WithScans(zipf));
+  return 0;
+}
@@ -0,0 +1,104 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Compares ThreadPool and NumaThreadPool on a memory-bound task.
+//
+// One producer thread per NUMA node, pinned to the node, fills an array of
+// --bench_mb_per_node MB (so its pages are in the memory of that node) and
+// adds functions that each sum a slice of it. With a ThreadPool the functions
+// run on any socket and mostly read remote memory on a multi-socket machine;
+// with a NumaThreadPool they run on the node of the producer.
+// On a single node machine both should be about the same.
+//
+// An iteration sums all the arrays once; the items processed are bytes.
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "base/common.h"
+#include "util/benchmark/benchmark_main.h"
+#include "util/thread/cpu_affinity.h"
+#include "util/thread/numa_thread_pool.h"
+#include "util/thread/thread_pool.h"
+
+FLAG_int(bench_num_workers, 16, "The number of workers of each pool.");
+
+FLAG_int(bench_mb_per_node, 256, "The size of the array of each node.");
+
+FLAG_int(bench_slice_kb, 256, "The size summed by each function.");
+
+namespace {
+
+using util::benchmark::State;
+using util::threading::CpuTopology;
+using util::threading::NumaThreadPool;
+using util::threading::SetCurrentThreadAffinity;
+using util::threading::ThreadPool;
+
+atomic<uint64_t> sink(0);
+
+// The arrays, filled by a thread of their node.
+vector<vector<uint64_t>> MakeArrays() {
+  const CpuTopology& topology = CpuTopology::Get();
+  vector<vector<uint64_t>> arrays(topology.num_nodes());
+  vector<thread> threads;
+  for (int i = 0; i < topology.num_nodes(); ++i) {
+    threads.push_back(thread([&topology, &arrays, i]() {
+      SetCurrentThreadAffinity(topology.nodes()[i].cpus);
+      arrays[i].resize(size_t(gFlag_bench_mb_per_node) << 17);
+      for (size_t j = 0; j < arrays[i].size(); ++j) arrays[i][j] = j;
+    }));
+  }
+  for (thread& t : threads) t.join();
+  return arrays;
+}
+
+// Shared by the benchmarks, as filling them takes longer than a run.
+const vector<vector<uint64_t>>& Arrays() {
+  static const vector<vector<uint64_t>> arrays = MakeArrays();
+  return arrays;
+}
+
+// Each producer adds the functions for the array of its node.
+void Run(ThreadPool* pool, const vector<vector<uint64_t>>& arrays) {
+  const CpuTopology& topology = CpuTopology::Get();
+  const size_t slice = size_t(gFlag_bench_slice_kb) << 7;
+  vector<thread> producers;
+  for (int i = 0; i < topology.num_nodes(); ++i) {
+    producers.push_back(thread([&topology, &arrays, pool, slice, i]() {
+      SetCurrentThreadAffinity(topology.nodes()[i].cpus);
+      const vector<uint64_t>& a = arrays[i];
+      for (size_t begin = 0; begin < a.size(); begin += slice) {
+        size_t end = min(begin + slice, a.size());
+        pool->Add([&a, begin, end]() {
+          uint64_t sum = 0;
+          for (size_t j = begin; j < end; ++j) sum += a[j];
+          sink += sum;
+        });
+      }
+    }));
+  }
+  for (thread& t : producers) t.join();
+  pool->Wait();
+}
+
+template<class tPool>
+void SumArrays(State& state) {
+  const vector<vector<uint64_t>>& arrays = Arrays();
+  tPool pool(gFlag_bench_num_workers);
+  state.ResetTiming();
+  for (int64_t i = 0; i < state.iterations(); ++i) Run(&pool, arrays);
+  int64_t bytes = 0;
+  for (const vector<uint64_t>& a : arrays) bytes += a.size() * sizeof(a[0]);
+  state.SetItemsProcessed(state.iterations() * bytes);
+}
+
+void BM_ThreadPoolSumArrays(State& state) { SumArrays<ThreadPool>(state); }
+BENCHMARK(BM_ThreadPoolSumArrays);
+
+void BM_NumaThreadPoolSumArrays(State& state) {
+  SumArrays<NumaThreadPool>(state);
+}
+BENCHMARK(BM_NumaThreadPoolSumArrays);
+
+}  // namespace
@@ -0,0 +1,110 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Compares the parallel algorithms of util/thread/parallel.h with their
+// serial equivalents on arg elements: BM_Serial* and BM_Parallel* for each of
+// For, Reduce and Sort.
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "base/common.h"
+#include "util/benchmark/benchmark_main.h"
+#include "util/thread/parallel.h"
+
+namespace {
+
+using util::benchmark::DoNotOptimize;
+using util::benchmark::State;
+using util::threading::ParallelFor;
+using util::threading::ParallelReduce;
+using util::threading::ParallelSort;
+
+vector<double> MakeInput(size_t n) {
+  vector<double> in(n);
+  mt19937 random(77);
+  for (double& x : in) x = random() % 1000000;
+  return in;
+}
+
+double Work(double x) { return sqrt(x) * log1p(x); }
+
+void BM_SerialFor(State& state) {
+  const size_t n = state.arg();
+  vector<double> in = MakeInput(n), out(n);
+  state.ResetTiming();
+  for (int64_t i = 0; i < state.iterations(); ++i) {
+    for (size_t j = 0; j < n; ++j) out[j] = Work(in[j]);
+    DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_SerialFor)->Arg(1 << 16)->Arg(1 << 23);
+
+void BM_ParallelFor(State& state) {
+  const size_t n = state.arg();
+  vector<double> in = MakeInput(n), out(n);
+  state.ResetTiming();
+  for (int64_t i = 0; i < state.iterations(); ++i) {
+    ParallelFor(0, n, [&in, &out](size_t j) { out[j] = Work(in[j]); });
+    DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_ParallelFor)->Arg(1 << 16)->Arg(1 << 23);
+
+void BM_SerialReduce(State& state) {
+  const size_t n = state.arg();
+  vector<double> in = MakeInput(n);
+  state.ResetTiming();
+  for (int64_t i = 0; i < state.iterations(); ++i) {
+    double sum = 0;
+    for (size_t j = 0; j < n; ++j) sum += sqrt(in[j]);
+    DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_SerialReduce)->Arg(1 << 16)->Arg(1 << 23);
+
+void BM_ParallelReduce(State& state) {
+  const size_t n = state.arg();
+  vector<double> in = MakeInput(n);
+  state.ResetTiming();
+  for (int64_t i = 0; i < state.iterations(); ++i) {
+    DoNotOptimize(ParallelReduce(0, n, 0.0,
+        [&in](size_t j) { return sqrt(in[j]); }, plus<double>()));
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_ParallelReduce)->Arg(1 << 16)->Arg(1 << 23);
+
+// The sorts copy the input outside of the timing.
+void BM_SerialSort(State& state) {
+  vector<double> in = MakeInput(state.arg()), v;
+  state.ResetTiming();
+  for (int64_t i = 0; i < state.iterations(); ++i) {
+    state.PauseTiming();
+    v = in;
+    state.ResumeTiming();
+    sort(v.begin(), v.end());
+  }
+  state.SetItemsProcessed(state.iterations() * state.arg());
+}
+BENCHMARK(BM_SerialSort)->Arg(1 << 16)->Arg(1 << 23);
+
+void BM_ParallelSort(State& state) {
+  vector<double> in = MakeInput(state.arg()), v;
+  state.ResetTiming();
+  for (int64_t i = 0; i < state.iterations(); ++i) {
+    state.PauseTiming();
+    v = in;
+    state.ResumeTiming();
+    ParallelSort(v.begin(), v.end());
+  }
+  state.SetItemsProcessed(state.iterations() * state.arg());
+}
+BENCHMARK(BM_ParallelSort)->Arg(1 << 16)->Arg(1 << 23);
+
+}  // namespace
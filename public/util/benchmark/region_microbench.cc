@@ -0,0 +1,70 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Microbenchmark of Region::LookupByLatLong on arg regions spread uniformly
+// over the continental US, about the density of the cities of the US for
+// arg = 30000. Each lookup is at a random point of the same area.
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <vector>
+
+#include "base/common.h"
+#include "util/benchmark/benchmark_main.h"
+#include "util/region_data/region.h"
+
+namespace {
+
+using region_data::Region;
+using region_data::tRegion;
+using util::benchmark::DoNotOptimize;
+using util::benchmark::State;
+
+const double kMinLat = 25, kMaxLat = 49, kMinLon = -124, kMaxLon = -67;
+
+// A region read from a CSV of 'n' random regions.
+class RandomRegion : public Region<tRegion> {
+ public:
+  explicit RandomRegion(int n) {
+    char file[] = "/tmp/region_microbench.XXXXXX";
+    int fd = mkstemp(file);
+    ASSERT(fd >= 0);
+    close(fd);
+    {
+      mt19937 random(n);
+      uniform_real_distribution<double> lat(kMinLat, kMaxLat);
+      uniform_real_distribution<double> lon(kMinLon, kMaxLon);
+      ofstream out(file);
+      out << "name,alternate_names,lat,lon" << endl;
+      for (int i = 0; i < n; ++i)
+        out << "region" << i << ",," << lat(random) << "," << lon(random) << endl;
+    }
+    ConfigParams params;
+    params.file = file;
+    params.build_latlong_index = true;
+    ASSERT(Initialize(params));
+    remove(file);
+  }
+};
+
+void BM_LookupByLatLong(State& state) {
+  RandomRegion region(state.arg());
+  mt19937 random(0);
+  uniform_real_distribution<double> lat(kMinLat, kMaxLat);
+  uniform_real_distribution<double> lon(kMinLon, kMaxLon);
+  vector<LatLong> points;
+  for (int i = 0; i < 1024; ++i)
+    points.push_back(LatLong::Create(lat(random), lon(random)));
+  state.ResetTiming();
+  for (int64_t i = 0; i < state.iterations(); ++i) {
+    vector<pair<const tRegion*, double>> result;
+    region.LookupByLatLong(points[i % points.size()], &result,
+                           gFlag_region_latlong_max_res);
+    DoNotOptimize(result);
+  }
+}
+BENCHMARK(BM_LookupByLatLong)->Range(1000, 300000, 10);
+
+}  // namespace
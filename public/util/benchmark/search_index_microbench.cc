@@ -0,0 +1,88 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Microbenchmarks of SearchIndex on arg documents of random words, frequent
+// words being much more common than rare ones:
+// - BM_SearchIndexSearch: Search() of a 3 term query over all the documents.
+// - BM_SearchIndexSearchAndScore: the same, then Score() of every match.
+
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "base/common.h"
+#include "util/benchmark/benchmark_main.h"
+#include "util/index/search_index.h"
+
+namespace {
+
+using meta::SearchIndex;
+using util::benchmark::DoNotOptimize;
+using util::benchmark::State;
+
+const int kVocabularySize = 5000;
+const int kWordsPerDocument = 200;
+
+string Word(int i) { return "word" + to_string(i); }
+
+// The index keeps iterators to the text of the documents: the documents live
+// as long as the index.
+class RandomIndex {
+ public:
+  explicit RandomIndex(int n) {
+    mt19937 random(n);
+    // Frequent words have small ids.
+    exponential_distribution<double> word(20.0 / kVocabularySize);
+    for (int i = 0; i < n; ++i) {
+      string document;
+      for (int j = 0; j < kWordsPerDocument; ++j) {
+        document += Word(int(word(random)) % kVocabularySize) + " ";
+      }
+      documents_.push_back(document);
+    }
+    for (int i = 0; i < n; ++i) {
+      ids_.push_back(i);
+      index_.IndexBlob(i, "description", documents_[i]);
+    }
+  }
+
+  const SearchIndex& index() const { return index_; }
+  const vector<int>& ids() const { return ids_; }
+
+ private:
+  deque<string> documents_;
+  vector<int> ids_;
+  SearchIndex index_;
+};
+
+vector<string> Query() {
+  return SearchIndex::ProcessQuery(Word(3) + " " + Word(50) + " " + Word(400));
+}
+
+void BM_SearchIndexSearch(State& state) {
+  RandomIndex random_index(state.arg());
+  vector<string> query = Query();
+  state.ResetTiming();
+  for (int64_t i = 0; i < state.iterations(); ++i)
+    DoNotOptimize(random_index.index().Search(random_index.ids(), query));
+  state.SetItemsProcessed(state.iterations() * state.arg());
+}
+BENCHMARK(BM_SearchIndexSearch)->Range(100, 10000, 10);
+
+void BM_SearchIndexSearchAndScore(State& state) {
+  RandomIndex random_index(state.arg());
+  vector<string> query = Query();
+  state.ResetTiming();
+  for (int64_t i = 0; i < state.iterations(); ++i) {
+    float score = 0;
+    for (const auto& matches :
+         random_index.index().Search(random_index.ids(), query)) {
+      score += random_index.index().Score(matches);
+    }
+    DoNotOptimize(score);
+  }
+  state.SetItemsProcessed(state.iterations() * state.arg());
+}
+BENCHMARK(BM_SearchIndexSearchAndScore)->Range(100, 10000, 10);
+
+}  // namespace
@@ -0,0 +1,99 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Microbenchmarks of the binary and JSON serializers on a message shaped like
+// a typical RPC reply: a few scalars and strings, and arg nested records.
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/common.h"
+#include "util/benchmark/benchmark_main.h"
+#include "util/serial/serializer.h"
+
+namespace {
+
+using serial::Serializer;
+using util::benchmark::DoNotOptimize;
+using util::benchmark::State;
+
+struct tRecord {
+  string id;
+  string name;
+  double lat = 0, lon = 0;
+  int score = 0;
+  vector<string> tags;
+
+  SERIALIZE(DEFAULT_CUSTOM / id*1 / name*2 / lat*3 / lon*4 / score*5 /
+            tags*6);
+};
+
+struct tMessage {
+  string query;
+  int64_t timestamp = 0;
+  bool cached = false;
+  vector<tRecord> records;
+  map<string, string> params;
+
+  SERIALIZE(DEFAULT_CUSTOM / query*1 / timestamp*2 / cached*3 / records*4 /
+            params*5);
+};
+
+tMessage MakeMessage(int num_records) {
+  tMessage message;
+  message.query = "hotels near golden gate park";
+  message.timestamp = 1420070400000000;
+  message.cached = true;
+  for (int i = 0; i < num_records; ++i) {
+    tRecord record;
+    record.id = "c/" + to_string(1000000 + i);
+    record.name = "Record number " + to_string(i) + " of the message";
+    record.lat = 37.7694 + i * 1e-4;
+    record.lon = -122.4862 - i * 1e-4;
+    record.score = i * 7;
+    record.tags = {"hotel", "pool", "wifi"};
+    message.records.push_back(record);
+  }
+  message.params = {{"lang", "en"}, {"currency", "USD"}, {"n", "10"}};
+  return message;
+}
+
+void BM_ToBinary(State& state) {
+  tMessage message = MakeMessage(state.arg());
+  state.ResetTiming();
+  for (int64_t i = 0; i < state.iterations(); ++i)
+    DoNotOptimize(Serializer::ToBinary(message));
+}
+BENCHMARK(BM_ToBinary)->Range(1, 1000, 10);
+
+void BM_FromBinary(State& state) {
+  string binary = Serializer::ToBinary(MakeMessage(state.arg()));
+  state.ResetTiming();
+  for (int64_t i = 0; i < state.iterations(); ++i) {
+    tMessage message;
+    ASSERT(Serializer::FromBinary(binary, &message));
+    DoNotOptimize(message);
+  }
+}
+BENCHMARK(BM_FromBinary)->Range(1, 1000, 10);
+
+void BM_ToJSON(State& state) {
+  tMessage message = MakeMessage(state.arg());
+  state.ResetTiming();
+  for (int64_t i = 0; i < state.iterations(); ++i)
+    DoNotOptimize(Serializer::ToJSON(message));
+}
+BENCHMARK(BM_ToJSON)->Range(1, 1000, 10);
+
+void BM_FromJSON(State& state) {
+  string json = Serializer::ToJSON(MakeMessage(state.arg()));
+  state.ResetTiming();
+  for (int64_t i = 0; i < state.iterations(); ++i) {
+    tMessage message;
+    ASSERT(Serializer::FromJSON(json, &message));
+    DoNotOptimize(message);
+  }
+}
+BENCHMARK(BM_FromJSON)->Range(1, 1000, 10);
+
+}  // namespace
@@ -0,0 +1,118 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Microbenchmarks of SharedLRUCache and ShardedLRUCache with arg entries:
+// - BM_*Hit: find() of keys in the cache.
+// - BM_*Miss: find() of keys not in the cache.
+// - BM_*Insert: insert() of new keys into a full cache, each evicting an
+//   entry.
+// - BM_*Readers: hits from arg threads on a cache of 64k entries.
+
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "base/common.h"
+#include "util/benchmark/benchmark_main.h"
+#include "util/cache/sharded_lru_cache.h"
+#include "util/cache/shared_lru_cache.h"
+
+namespace {
+
+using util::benchmark::DoNotOptimize;
+using util::benchmark::State;
+
+typedef SharedLRUCache<int, int> tSharedCache;
+typedef ShardedLRUCache<int, int> tShardedCache;
+
+// The keys to find, in random order, so that the access pattern is not
+// sequential.
+vector<int> Keys(int n) {
+  vector<int> keys(n);
+  for (int i = 0; i < n; ++i) keys[i] = i;
+  shuffle(keys.begin(), keys.end(), mt19937(n));
+  return keys;
+}
+
+template<class tCache>
+void Fill(tCache* cache, int n) {
+  for (int i = 0; i < n; ++i) cache->insert(make_pair(i, i));
+}
+
+template<class tCache>
+void Hit(State& state) {
+  tCache cache(state.arg());
+  Fill(&cache, state.arg());
+  vector<int> keys = Keys(state.arg());
+  state.ResetTiming();
+  for (int64_t i = 0; i < state.iterations(); ++i)
+    DoNotOptimize(cache.find(keys[i % keys.size()]));
+  // Do not time the destruction of the cache.
+  state.PauseTiming();
+}
+
+template<class tCache>
+void Miss(State& state) {
+  tCache cache(state.arg());
+  Fill(&cache, state.arg());
+  vector<int> keys = Keys(state.arg());
+  state.ResetTiming();
+  for (int64_t i = 0; i < state.iterations(); ++i)
+    DoNotOptimize(cache.find(-1 - keys[i % keys.size()]));
+  state.PauseTiming();
+}
+
+template<class tCache>
+void Insert(State& state) {
+  tCache cache(state.arg());
+  Fill(&cache, state.arg());
+  state.ResetTiming();
+  for (int64_t i = 0; i < state.iterations(); ++i)
+    cache.insert(make_pair(int(state.arg() + i), 0));
+  state.PauseTiming();
+}
+
+// Each of the arg threads does all the iterations.
+template<class tCache>
+void Readers(State& state) {
+  const int kSize = 1 << 16;
+  tCache cache(kSize);
+  Fill(&cache, kSize);
+  vector<int> keys = Keys(kSize);
+  state.ResetTiming();
+  vector<thread> threads;
+  for (int t = 0; t < state.arg(); ++t) {
+    threads.push_back(thread([&cache, &keys, &state, t]() {
+      for (int64_t i = 0; i < state.iterations(); ++i)
+        DoNotOptimize(cache.find(keys[(i + t * 997) % keys.size()]));
+    }));
+  }
+  for (thread& t : threads) t.join();
+  state.PauseTiming();
+  state.SetItemsProcessed(state.iterations() * state.arg());
+}
+
+void BM_SharedLRUCacheHit(State& state) { Hit<tSharedCache>(state); }
+BENCHMARK(BM_SharedLRUCacheHit)->Range(64, 1 << 20, 64);
+
+void BM_ShardedLRUCacheHit(State& state) { Hit<tShardedCache>(state); }
+BENCHMARK(BM_ShardedLRUCacheHit)->Range(64, 1 << 20, 64);
+
+void BM_SharedLRUCacheMiss(State& state) { Miss<tSharedCache>(state); }
+BENCHMARK(BM_SharedLRUCacheMiss)->Range(64, 1 << 20, 64);
+
+void BM_ShardedLRUCacheMiss(State& state) { Miss<tShardedCache>(state); }
+BENCHMARK(BM_ShardedLRUCacheMiss)->Range(64, 1 << 20, 64);
+
+void BM_SharedLRUCacheInsert(State& state) { Insert<tSharedCache>(state); }
+BENCHMARK(BM_SharedLRUCacheInsert)->Range(64, 1 << 20, 64);
+
+void BM_ShardedLRUCacheInsert(State& state) { Insert<tShardedCache>(state); }
+BENCHMARK(BM_ShardedLRUCacheInsert)->Range(64, 1 << 20, 64);
+
+void BM_SharedLRUCacheReaders(State& state) { Readers<tSharedCache>(state); }
+BENCHMARK(BM_SharedLRUCacheReaders)->Range(1, 64, 2);
+
+void BM_ShardedLRUCacheReaders(State& state) { Readers<tShardedCache>(state); }
+BENCHMARK(BM_ShardedLRUCacheReaders)->Range(1, 64, 2);
+
+}  // namespace
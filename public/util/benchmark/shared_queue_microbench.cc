@@ -0,0 +1,98 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Microbenchmarks of SharedQueue:
+// - BM_SharedQueuePushPop: push() then pop() from one thread, the cost of the
+//   queue without contention.
+// - BM_SharedQueueHandOff: a producer pushes arg items that a consumer pops,
+//   the cost of waking up the other side.
+// - BM_*Contention: arg producers and arg consumers move --bench_num_items
+//   integers through one SharedQueue or LockFreeSharedQueue with push() and
+//   consume_batch().
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "base/common.h"
+#include "util/benchmark/benchmark_main.h"
+#include "util/thread/lock_free_shared_queue.h"
+#include "util/thread/shared_queue.h"
+
+FLAG_int(bench_num_items, 1 << 20,
+         "The number of items moved through the queue in BM_*Contention.");
+
+FLAG_int(bench_batch_size, 1, "The batch size of the queues of BM_*Contention.");
+
+namespace {
+
+using util::benchmark::DoNotOptimize;
+using util::benchmark::State;
+using util::threading::LockFreeSharedQueue;
+using util::threading::SharedQueue;
+
+void BM_SharedQueuePushPop(State& state) {
+  SharedQueue<int> q;
+  for (int64_t i = 0; i < state.iterations(); ++i) {
+    q.push(i);
+    DoNotOptimize(q.pop());
+  }
+}
+BENCHMARK(BM_SharedQueuePushPop);
+
+void BM_SharedQueueHandOff(State& state) {
+  for (int64_t i = 0; i < state.iterations(); ++i) {
+    SharedQueue<int> q;
+    thread consumer([&q, &state]() {
+      for (int j = 0; j < state.arg(); ++j) DoNotOptimize(q.pop());
+    });
+    for (int j = 0; j < state.arg(); ++j) q.push(j);
+    consumer.join();
+  }
+  state.SetItemsProcessed(state.iterations() * state.arg());
+}
+BENCHMARK(BM_SharedQueueHandOff)->Range(1, 1 << 16, 16);
+
+template<class tQueue>
+void Contention(State& state) {
+  const int num_threads = state.arg();
+  const int per_producer = gFlag_bench_num_items / num_threads;
+  for (int64_t i = 0; i < state.iterations(); ++i) {
+    tQueue q(gFlag_bench_batch_size);
+    atomic<int64_t> sum(0);
+    vector<thread> consumers;
+    for (int j = 0; j < num_threads; ++j) {
+      consumers.push_back(thread([&q, &sum]() {
+        int64_t local = 0;
+        while (true) {
+          vector<int> batch = q.consume_batch();
+          if (batch.empty() && q.producers_finished()) break;
+          for (int x : batch) local += x;
+        }
+        sum += local;
+      }));
+    }
+    vector<thread> producers;
+    for (int j = 0; j < num_threads; ++j) {
+      producers.push_back(thread([&q, per_producer]() {
+        for (int k = 0; k < per_producer; ++k) q.push(1);
+      }));
+    }
+    for (thread& t : producers) t.join();
+    q.notify_producers_finished();
+    for (thread& t : consumers) t.join();
+    ASSERT_EQ(int64_t(per_producer) * num_threads, sum.load());
+  }
+  state.SetItemsProcessed(state.iterations() * per_producer * num_threads);
+}
+
+void BM_SharedQueueContention(State& state) {
+  Contention<SharedQueue<int>>(state);
+}
+BENCHMARK(BM_SharedQueueContention)->Range(1, 64, 4);
+
+void BM_LockFreeSharedQueueContention(State& state) {
+  Contention<LockFreeSharedQueue<int>>(state);
+}
+BENCHMARK(BM_LockFreeSharedQueueContention)->Range(1, 64, 4);
+
+}  // namespace
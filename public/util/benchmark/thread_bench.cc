@@ -1,31 +1,30 @@
 // Copyright 2011 Room77, Inc.
 // Author: Uygar Oztekin
 
-// Simple threading library test.
-// Requires GCC 4.6+ to compile.
+// Simple threading library benchmark.
 
-// Creates 30k threads, each thread creating a proxy and calling inc / dec
-// operators on the proxy 201 times in total per thread (modifying an
-// atomic<int> variable).
+// BM_SpawnThreads creates arg threads, each thread creating a factory proxy
+// and calling inc / dec operators on the proxy 201 times in total per thread
+// (modifying an atomic<int> variable), then joins them. BM_FactoryProxy does
+// the work of one thread without creating it.
 
-// Set ulimit -s 256 before running.
+// Set ulimit -s 256 before running with many threads.
 
-// Average of 50 runs for Intel(R) Core(TM) i3-2100 CPU @ 3.10GHz:
+// 30k threads for Intel(R) Core(TM) i3-2100 CPU @ 3.10GHz, average of 50 runs:
 // - with -O3: 465ms
 // - with -O2: 487ms
 // - no optimization: 495ms
 
-#include <iostream>
-#include <algorithm>
-#include <chrono>
-#include <thread>
-#include <memory>
-#include <deque>
 #include <atomic>
+#include <deque>
+#include <functional>
+#include <thread>
+
 #include "base/common.h"
+#include "util/benchmark/benchmark_main.h"
 #include "util/factory/factory.h"
 
-FLAG_int(num_threads, 30000, "");
+namespace {
 
 atomic<int> num(0);
 
@@ -47,7 +46,7 @@ auto register_base_7 = Base::bind("base7", [](){ return new Base; } );
 auto register_base_8 = Base::bind("base8", [](){ return new Base; } );
 auto register_base_9 = Base::bind("base9", [](){ return new Base; } );
 
-void ThreadProxy(int i) {
+void ThreadProxy() {
   auto proxy = Base::make_shared("base1");
   ++*proxy;
   for (int i = 0; i < 100; ++i) {
@@ -56,33 +55,19 @@ void ThreadProxy(int i) {
   }
 }
 
-void ThreadNoop(int i) {
+void BM_FactoryProxy(util::benchmark::State& state) {
+  for (int64_t i = 0; i < state.iterations(); ++i) ThreadProxy();
 }
+BENCHMARK(BM_FactoryProxy);
 
-void TestNewThread() {
-  typedef std::chrono::high_resolution_clock Clock;
-  Clock::time_point t0 = Clock::now();
-  deque<thread> threads;
-  for (int i = 0; i < gFlag_num_threads; ++i) {
-    try {
-      threads.push_back(thread(bind(ThreadProxy, i)));
-    } catch (...) {
-      cout << "Failed at " << i << endl;
-      return;
-    }
+void BM_SpawnThreads(util::benchmark::State& state) {
+  for (int64_t i = 0; i < state.iterations(); ++i) {
+    deque<thread> threads;
+    for (int j = 0; j < state.arg(); ++j) threads.push_back(thread(ThreadProxy));
+    for (thread& t : threads) t.join();
   }
-
-  for (int i = 0; i < gFlag_num_threads; ++i) {
-    threads[i].join();
-  }
-
-  Clock::time_point t1 = Clock::now();
-  auto diff = std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count();
-
-  cout << "Processed " << num << " threads in " << diff << " ms"<< endl;
+  state.SetItemsProcessed(state.iterations() * state.arg());
 }
+BENCHMARK(BM_SpawnThreads)->Arg(1)->Arg(100)->Arg(30000);
 
-int main() {
-  TestNewThread();
-  return 0;
-}
+}  // namespace
@@ -0,0 +1,143 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Microbenchmarks of the thread pools:
+// - BM_*AddWait: one thread adds arg empty functions and waits for them, the
+//   throughput of a pool fed by a server.
+// - BM_*RoundTrip: one function at a time, the latency from Add() to the end
+//   of the function.
+// - BM_*Producers: --bench_num_producers threads add arg functions in all
+//   concurrently.
+// - BM_*Recursive: arg functions added from the workers by splitting the range
+//   in two until it is a single one, as in a parallel divide and conquer.
+// The functions of the last two spin for --bench_work_iterations.
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "base/common.h"
+#include "util/benchmark/benchmark_main.h"
+#include "util/thread/counters.h"
+#include "util/thread/thread_pool.h"
+#include "util/thread/work_stealing_thread_pool.h"
+
+FLAG_int(bench_num_workers, 4, "The number of workers of each pool.");
+
+FLAG_int(bench_num_producers, 4,
+         "The number of threads adding functions in BM_*Producers.");
+
+FLAG_int(bench_work_iterations, 100,
+         "The number of iterations the functions of BM_*Producers and "
+         "BM_*Recursive spin for.");
+
+namespace {
+
+using util::benchmark::DoNotOptimize;
+using util::benchmark::State;
+using util::threading::Notification;
+using util::threading::ThreadPool;
+using util::threading::WorkStealingThreadPool;
+
+template<class tPool>
+void AddWait(State& state) {
+  tPool pool(gFlag_bench_num_workers);
+  state.ResetTiming();
+  for (int64_t i = 0; i < state.iterations(); ++i) {
+    for (int j = 0; j < state.arg(); ++j) pool.Add([]() {});
+    pool.Wait();
+  }
+  state.SetItemsProcessed(state.iterations() * state.arg());
+}
+
+template<class tPool>
+void RoundTrip(State& state) {
+  tPool pool(gFlag_bench_num_workers);
+  state.ResetTiming();
+  for (int64_t i = 0; i < state.iterations(); ++i) {
+    Notification done;
+    pool.Add([&done]() { done.Notify(); });
+    done.Wait();
+  }
+}
+
+void Work() {
+  uint64_t x = 0;
+  for (int i = 0; i < gFlag_bench_work_iterations; ++i) x = x * 31 + i;
+  DoNotOptimize(x);
+}
+
+template<class tPool>
+void Producers(State& state) {
+  tPool pool(gFlag_bench_num_workers);
+  const int per_producer = state.arg() / gFlag_bench_num_producers;
+  state.ResetTiming();
+  for (int64_t i = 0; i < state.iterations(); ++i) {
+    vector<thread> producers;
+    for (int p = 0; p < gFlag_bench_num_producers; ++p) {
+      producers.push_back(thread([&pool, per_producer]() {
+        for (int j = 0; j < per_producer; ++j) pool.Add(&Work);
+      }));
+    }
+    for (thread& t : producers) t.join();
+    pool.Wait();
+  }
+  state.SetItemsProcessed(state.iterations() * per_producer *
+                          gFlag_bench_num_producers);
+}
+
+// Runs 'n' functions by splitting the range in two until it is a single one.
+void Split(ThreadPool* pool, int n) {
+  if (n == 1) {
+    Work();
+    return;
+  }
+  int half = n / 2;
+  pool->Add([pool, half]() { Split(pool, half); });
+  pool->Add([pool, n, half]() { Split(pool, n - half); });
+}
+
+template<class tPool>
+void Recursive(State& state) {
+  tPool pool(gFlag_bench_num_workers);
+  const int n = state.arg();
+  state.ResetTiming();
+  for (int64_t i = 0; i < state.iterations(); ++i) {
+    pool.Add([&pool, n]() { Split(&pool, n); });
+    pool.Wait();
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+
+void BM_ThreadPoolAddWait(State& state) { AddWait<ThreadPool>(state); }
+BENCHMARK(BM_ThreadPoolAddWait)->Range(1, 4096);
+
+void BM_WorkStealingAddWait(State& state) {
+  AddWait<WorkStealingThreadPool>(state);
+}
+BENCHMARK(BM_WorkStealingAddWait)->Range(1, 4096);
+
+void BM_ThreadPoolRoundTrip(State& state) { RoundTrip<ThreadPool>(state); }
+BENCHMARK(BM_ThreadPoolRoundTrip);
+
+void BM_WorkStealingRoundTrip(State& state) {
+  RoundTrip<WorkStealingThreadPool>(state);
+}
+BENCHMARK(BM_WorkStealingRoundTrip);
+
+void BM_ThreadPoolProducers(State& state) { Producers<ThreadPool>(state); }
+BENCHMARK(BM_ThreadPoolProducers)->Arg(1 << 16);
+
+void BM_WorkStealingProducers(State& state) {
+  Producers<WorkStealingThreadPool>(state);
+}
+BENCHMARK(BM_WorkStealingProducers)->Arg(1 << 16);
+
+void BM_ThreadPoolRecursive(State& state) { Recursive<ThreadPool>(state); }
+BENCHMARK(BM_ThreadPoolRecursive)->Arg(1 << 16);
+
+void BM_WorkStealingRecursive(State& state) {
+  Recursive<WorkStealingThreadPool>(state);
+}
+BENCHMARK(BM_WorkStealingRecursive)->Arg(1 << 16);
+
+}  // namespace
@@ -0,0 +1,105 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/cache/cache_gauges.h"
+
+#include <algorithm>
+#include <mutex>
+#include <sstream>
+
+namespace {
+
+mutex& RegistryMutex() {
+  static mutex m;
+  return m;
+}
+
+// The live gauges, in order of creation.
+vector<CacheGauges*>& Registry() {
+  static vector<CacheGauges*> gauges;
+  return gauges;
+}
+
+}  // namespace
+
+bool CacheGauges::tSnapshot::GetMetric(const string& metric,
+                                       double* value) const {
+  if (metric == "entries") *value = entries;
+  else if (metric == "bytes") *value = bytes;
+  else if (metric == "max_bytes") *value = max_bytes;
+  else return false;
+  return true;
+}
+
+string CacheGauges::tSnapshot::ToString() const {
+  stringstream ss;
+  ss << (name.empty() ? "<unnamed>" : name) << ": entries=" << entries
+     << " bytes=" << bytes << " max_bytes=" << max_bytes << endl;
+  return ss.str();
+}
+
+CacheGauges::CacheGauges(const string& name) : name_(name) {
+  lock_guard<mutex> l(RegistryMutex());
+  Registry().push_back(this);
+}
+
+CacheGauges::~CacheGauges() {
+  lock_guard<mutex> l(RegistryMutex());
+  vector<CacheGauges*>& registry = Registry();
+  registry.erase(find(registry.begin(), registry.end(), this));
+}
+
+string CacheGauges::name() const {
+  lock_guard<mutex> l(RegistryMutex());
+  return name_;
+}
+
+void CacheGauges::set_name(const string& name) {
+  lock_guard<mutex> l(RegistryMutex());
+  name_ = name;
+}
+
+CacheGauges::tSnapshot CacheGauges::Snapshot() const {
+  lock_guard<mutex> l(RegistryMutex());
+  return SnapshotLocked();
+}
+
+CacheGauges::tSnapshot CacheGauges::SnapshotLocked() const {
+  tSnapshot snapshot;
+  snapshot.name = name_;
+  snapshot.entries = entries();
+  snapshot.bytes = bytes();
+  snapshot.max_bytes = max_bytes();
+  return snapshot;
+}
+
+vector<CacheGauges::tSnapshot> CacheGauges::SnapshotAll() {
+  vector<tSnapshot> snapshots;
+  {
+    lock_guard<mutex> l(RegistryMutex());
+    for (const CacheGauges* gauges : Registry())
+      snapshots.push_back(gauges->SnapshotLocked());
+  }
+  stable_sort(snapshots.begin(), snapshots.end(),
+              [](const tSnapshot& a, const tSnapshot& b) {
+    return a.name < b.name;
+  });
+  return snapshots;
+}
+
+bool CacheGauges::SnapshotByName(const string& name, tSnapshot* snapshot) {
+  for (tSnapshot& s : SnapshotAll()) {
+    if (s.name == name) {
+      *snapshot = std::move(s);
+      return true;
+    }
+  }
+  return false;
+}
+
+string CacheGauges::Report() {
+  vector<tSnapshot> snapshots = SnapshotAll();
+  stringstream ss;
+  ss << "Caches: " << snapshots.size() << endl;
+  for (const tSnapshot& snapshot : snapshots) ss << snapshot.ToString();
+  return ss.str();
+}
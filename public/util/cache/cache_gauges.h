@@ -0,0 +1,79 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Gauges of the size of a cache: its entries, the bytes they weigh and its
+// byte budget.
+//
+// SharedLRUCache, GroupCache and store::SimpleCacher each have a CacheGauges,
+// named with their set_name(). The live caches are listed with
+// CacheGauges::SnapshotAll(), and read by name through the .get_counters
+// method as counter "cache.<name>", with metrics "entries", "bytes" and
+// "max_bytes". The caches only weigh their entries once they are given a
+// weigher (see util/cache/weigher.h), otherwise "bytes" stays 0.
+
+#ifndef _PUBLIC_UTIL_CACHE_CACHE_GAUGES_H_
+#define _PUBLIC_UTIL_CACHE_CACHE_GAUGES_H_
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "base/common.h"
+
+class CacheGauges {
+ public:
+  struct tSnapshot {
+    string name;
+    int64_t entries = 0;
+    int64_t bytes = 0;
+    int64_t max_bytes = 0;
+
+    // A metric by name, for .get_counters. Returns false for an unknown name.
+    bool GetMetric(const string& metric, double* value) const;
+    string ToString() const;
+  };
+
+  explicit CacheGauges(const string& name = "");
+  ~CacheGauges();
+
+  string name() const;
+  void set_name(const string& name);
+
+  // The caches update the gauges by deltas.
+  void Add(int64_t entries, int64_t bytes) {
+    entries_.fetch_add(entries, memory_order_relaxed);
+    bytes_.fetch_add(bytes, memory_order_relaxed);
+  }
+  void Reset() {
+    entries_.store(0, memory_order_relaxed);
+    bytes_.store(0, memory_order_relaxed);
+  }
+  void set_max_bytes(int64_t max_bytes) {
+    max_bytes_.store(max_bytes, memory_order_relaxed);
+  }
+
+  int64_t entries() const { return entries_.load(memory_order_relaxed); }
+  int64_t bytes() const { return bytes_.load(memory_order_relaxed); }
+  int64_t max_bytes() const { return max_bytes_.load(memory_order_relaxed); }
+
+  tSnapshot Snapshot() const;
+
+  // The snapshots of all the live caches, by name.
+  static vector<tSnapshot> SnapshotAll();
+  // The snapshot of the first cache named 'name'. Returns false if none is.
+  static bool SnapshotByName(const string& name, tSnapshot* snapshot);
+  // A human readable report of all the live caches.
+  static string Report();
+
+ private:
+  tSnapshot SnapshotLocked() const;
+
+  string name_;
+  atomic<int64_t> entries_{0};
+  atomic<int64_t> bytes_{0};
+  atomic<int64_t> max_bytes_{0};
+
+  CacheGauges(const CacheGauges&) = delete;
+  CacheGauges& operator=(const CacheGauges&) = delete;
+};
+
+#endif  // _PUBLIC_UTIL_CACHE_CACHE_GAUGES_H_
@@ -0,0 +1,49 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/cache/cache_gauges.h"
+
+#include "base/common.h"
+#include "test/cc/test_main.h"
+
+namespace util {
+namespace test {
+
+TEST(CacheGauges, Gauges) {
+  CacheGauges gauges;
+  gauges.Add(2, 100);
+  gauges.Add(-1, -40);
+  gauges.set_max_bytes(1000);
+  EXPECT_EQ(1, gauges.entries());
+  EXPECT_EQ(60, gauges.bytes());
+  EXPECT_EQ(1000, gauges.max_bytes());
+  gauges.Reset();
+  EXPECT_EQ(0, gauges.entries());
+  EXPECT_EQ(0, gauges.bytes());
+  EXPECT_EQ(1000, gauges.max_bytes());
+}
+
+TEST(CacheGauges, ByName) {
+  CacheGauges::tSnapshot snapshot;
+  EXPECT_FALSE(CacheGauges::SnapshotByName("test_cache", &snapshot));
+  {
+    CacheGauges gauges;
+    gauges.set_name("test_cache");
+    gauges.Add(3, 300);
+    ASSERT_TRUE(CacheGauges::SnapshotByName("test_cache", &snapshot));
+    EXPECT_EQ("test_cache", snapshot.name);
+    double value = 0;
+    EXPECT_TRUE(snapshot.GetMetric("entries", &value));
+    EXPECT_EQ(3, value);
+    EXPECT_TRUE(snapshot.GetMetric("bytes", &value));
+    EXPECT_EQ(300, value);
+    EXPECT_TRUE(snapshot.GetMetric("max_bytes", &value));
+    EXPECT_EQ(0, value);
+    EXPECT_FALSE(snapshot.GetMetric("hits", &value));
+    EXPECT_NE(string::npos, CacheGauges::Report().find("test_cache: entries=3"));
+  }
+  // Unregistered when destroyed.
+  EXPECT_FALSE(CacheGauges::SnapshotByName("test_cache", &snapshot));
+}
+
+}  // namespace test
+}  // namespace util
@@ -0,0 +1,97 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Approximate access frequencies of a stream of keys, for cache admission
+// policies (see WTinyLFUPolicy in eviction_policy.h).
+//
+// A count-min sketch of depth 4 with 4 bit counters: a key increments one
+// counter per row, and its frequency is the smallest of its counters, so that
+// collisions can only overestimate it. The counters saturate at 15, and all of
+// them are halved once the sketch has counted sample_size() increments: old
+// accesses fade away, and the frequencies follow the recent popularity of the
+// keys.
+
+#ifndef _PUBLIC_UTIL_CACHE_COUNT_MIN_SKETCH_H_
+#define _PUBLIC_UTIL_CACHE_COUNT_MIN_SKETCH_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+class CountMinSketch {
+ public:
+  static const int kMaxFrequency = 15;
+
+  // Sized for a cache of 'capacity' entries: 16 counters per entry, up to 16M
+  // counters (8MB), and halved every 10 * capacity increments.
+  explicit CountMinSketch(size_t capacity) {
+    const size_t kMaxWords = 1 << 20;
+    size_t words = 1;
+    while (words < capacity && words < kMaxWords) words *= 2;
+    table_.resize(words);
+    counter_mask_ = words * kCountersPerWord - 1;
+    sample_size_ = 10 * std::max<size_t>(1, std::min(capacity, kMaxWords));
+  }
+
+  // Counts one access to the key of 'hash'.
+  void Increment(size_t hash) {
+    bool added = false;
+    for (int i = 0; i < kDepth; ++i) {
+      size_t index = Index(hash, i);
+      uint64_t& word = table_[index / kCountersPerWord];
+      int shift = (index % kCountersPerWord) * 4;
+      if (((word >> shift) & 0xF) < kMaxFrequency) {
+        word += uint64_t(1) << shift;
+        added = true;
+      }
+    }
+    if (added && ++additions_ >= sample_size_) Age();
+  }
+
+  // The estimated number of recent accesses to the key of 'hash', at most
+  // kMaxFrequency.
+  int Frequency(size_t hash) const {
+    int frequency = kMaxFrequency;
+    for (int i = 0; i < kDepth; ++i) {
+      size_t index = Index(hash, i);
+      uint64_t word = table_[index / kCountersPerWord];
+      frequency = std::min<int>(frequency,
+                                (word >> (index % kCountersPerWord) * 4) & 0xF);
+    }
+    return frequency;
+  }
+
+  void Clear() {
+    std::fill(table_.begin(), table_.end(), 0);
+    additions_ = 0;
+  }
+
+  size_t sample_size() const { return sample_size_; }
+
+ private:
+  static const int kDepth = 4;
+  static const int kCountersPerWord = 16;
+
+  // The counter of 'hash' in row i. The rows share the table, with
+  // independent hashes: the hash is mixed with a different seed for each row,
+  // since std::hash of integers is the identity.
+  size_t Index(size_t hash, int i) const {
+    static const uint64_t kSeeds[kDepth] = {
+      0xc3a5c85c97cb3127ULL, 0xb492b66fbe98f273ULL,
+      0x9ae16a3b2f90404fULL, 0xcbf29ce484222325ULL };
+    uint64_t h = (static_cast<uint64_t>(hash) + kSeeds[i]) * kSeeds[i];
+    return (h ^ (h >> 32)) & counter_mask_;
+  }
+
+  // Halves every counter.
+  void Age() {
+    for (uint64_t& word : table_) word = (word >> 1) & 0x7777777777777777ULL;
+    additions_ /= 2;
+  }
+
+  std::vector<uint64_t> table_;
+  size_t counter_mask_;
+  size_t sample_size_;
+  size_t additions_ = 0;
+};
+
+#endif  // _PUBLIC_UTIL_CACHE_COUNT_MIN_SKETCH_H_
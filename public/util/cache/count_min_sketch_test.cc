@@ -0,0 +1,48 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/cache/count_min_sketch.h"
+
+#include "base/common.h"
+#include "test/cc/test_main.h"
+
+namespace util {
+namespace test {
+
+TEST(CountMinSketch, Frequency) {
+  CountMinSketch sketch(1000);
+  EXPECT_EQ(0, sketch.Frequency(1));
+  for (int i = 0; i < 5; ++i) sketch.Increment(1);
+  sketch.Increment(2);
+  EXPECT_EQ(5, sketch.Frequency(1));
+  EXPECT_EQ(1, sketch.Frequency(2));
+  EXPECT_EQ(0, sketch.Frequency(3));
+  // Saturates.
+  for (int i = 0; i < 100; ++i) sketch.Increment(1);
+  EXPECT_EQ(CountMinSketch::kMaxFrequency + 0, sketch.Frequency(1));
+  sketch.Clear();
+  EXPECT_EQ(0, sketch.Frequency(1));
+}
+
+TEST(CountMinSketch, FewCollisions) {
+  CountMinSketch sketch(1000);
+  for (int i = 0; i < 1000; ++i) sketch.Increment(i);
+  // At full capacity, nearly all the keys have exact counts.
+  int overestimated = 0;
+  for (int i = 0; i < 1000; ++i) {
+    ASSERT_LE(1, sketch.Frequency(i));
+    overestimated += sketch.Frequency(i) > 1;
+  }
+  EXPECT_GT(20, overestimated);
+}
+
+TEST(CountMinSketch, Aging) {
+  CountMinSketch sketch(10);
+  ASSERT_EQ(100, sketch.sample_size());
+  for (int i = 0; i < 8; ++i) sketch.Increment(-1);
+  // Other keys fill the sample, which halves the counters.
+  for (int i = 0; i < 92; ++i) sketch.Increment(i);
+  EXPECT_EQ(4, sketch.Frequency(-1));
+}
+
+}  // namespace test
+}  // namespace util
@@ -0,0 +1,188 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Eviction policies of SharedLRUCache and store::SimpleCacher. A policy keeps
+// the entries of a cache in its own order and picks the entry to evict when the
+// cache is full. It is not thread safe: the cache calls it under its mutex.
+//
+// Interface, for entries of type T hashed by H (the cache passes the shared
+// pointer to its entries, and a functor hashing their key):
+//
+//   template<class T, class H> class Policy {
+//    public:
+//     typedef ... handle_t;           // Stored by the cache with each entry.
+//     explicit Policy(size_t capacity);
+//     void Access(const T& t);        // A lookup of the key of t, hit or miss.
+//     handle_t Insert(const T& t);    // t is new in the cache.
+//     void Touch(handle_t h);         // A hit on the entry of h.
+//     void Erase(handle_t h);         // The cache erased the entry of h.
+//     T Evict();                      // Removes and returns an entry. The
+//                                     // policy has at least one.
+//     void Clear();
+//     template<class F> void ForEach(F f) const;  // From the entry most likely
+//                                     // to be kept to the next victim.
+//   };
+//
+// - LRUPolicy evicts the least recently used entry.
+// - WTinyLFUPolicy (Einziger et al., "TinyLFU: A Highly Efficient Cache
+//   Admission Policy") evicts the least recently used entry of a segment, but
+//   only admits an entry into the main part of the cache if it was accessed
+//   more often than the entry it replaces. A burst of keys that are seen once
+//   (a scan, a crawler) then only churns the small window segment instead of
+//   flushing the popular entries.
+
+#ifndef _PUBLIC_UTIL_CACHE_EVICTION_POLICY_H_
+#define _PUBLIC_UTIL_CACHE_EVICTION_POLICY_H_
+
+#include <algorithm>
+#include <iterator>
+#include <list>
+
+#include "util/cache/count_min_sketch.h"
+
+template<class T, class H>
+class LRUPolicy {
+  typedef std::list<T> list_t;
+
+ public:
+  typedef typename list_t::iterator handle_t;
+
+  explicit LRUPolicy(size_t /* capacity */) {}
+
+  void Access(const T& /* t */) {}
+  handle_t Insert(const T& t) { list_.push_front(t); return list_.begin(); }
+  void Touch(handle_t h) { list_.splice(list_.begin(), list_, h); }
+  void Erase(handle_t h) { list_.erase(h); }
+  T Evict() {
+    T t = std::move(list_.back());
+    list_.pop_back();
+    return t;
+  }
+  void Clear() { list_.clear(); }
+
+  template<class F> void ForEach(F f) const {
+    for (const T& t : list_) f(t);
+  }
+
+ private:
+  // Most recently used first.
+  list_t list_;
+};
+
+// The entries are in three LRU segments:
+// - the window (1% of the capacity) takes the new entries,
+// - the probation segment takes the entries that leave the window, when the
+//   main part of the cache has room, or when they are accessed more often than
+//   the probation entry that they replace. Otherwise, they are evicted.
+// - a hit in the probation segment promotes the entry to the protected
+//   segment (80% of the main part), which demotes its least recently used
+//   entry back to probation when it is full.
+// The access frequencies come from a CountMinSketch of all the lookups.
+template<class T, class H>
+class WTinyLFUPolicy {
+  enum tSegment { kWindow, kProbation, kProtected };
+  struct tNode {
+    T data;
+    tSegment segment;
+  };
+  typedef std::list<tNode> list_t;
+
+ public:
+  typedef typename list_t::iterator handle_t;
+
+  explicit WTinyLFUPolicy(size_t capacity)
+      : window_capacity_(std::max<size_t>(1, capacity / 100)),
+        main_capacity_(capacity - std::min(capacity, window_capacity_)),
+        protected_capacity_(main_capacity_ * 8 / 10),
+        sketch_(capacity) {}
+
+  void Access(const T& t) { sketch_.Increment(H()(t)); }
+
+  handle_t Insert(const T& t) {
+    window_.push_front(tNode{t, kWindow});
+    // Until the main part is full, the entries move there without admission.
+    while (window_.size() > window_capacity_ && MainSize() < main_capacity_)
+      Move(std::prev(window_.end()), kProbation);
+    return window_.begin();
+  }
+
+  void Touch(handle_t h) {
+    if (h->segment == kProbation) {
+      Move(h, kProtected);
+      if (protected_.size() > protected_capacity_)
+        Move(std::prev(protected_.end()), kProbation);
+    } else {
+      Move(h, h->segment);
+    }
+  }
+
+  void Erase(handle_t h) { Segment(h->segment).erase(h); }
+
+  T Evict() {
+    if (window_.size() > window_capacity_ && MainSize() > 0) {
+      handle_t candidate = std::prev(window_.end());
+      handle_t victim = MainVictim();
+      if (sketch_.Frequency(H()(candidate->data)) >
+          sketch_.Frequency(H()(victim->data))) {
+        Move(candidate, kProbation);
+        return Remove(victim);
+      }
+      return Remove(candidate);
+    }
+    if (MainSize() > 0 && window_.size() <= window_capacity_)
+      return Remove(MainVictim());
+    return Remove(std::prev(window_.end()));
+  }
+
+  void Clear() {
+    window_.clear();
+    probation_.clear();
+    protected_.clear();
+    sketch_.Clear();
+  }
+
+  template<class F> void ForEach(F f) const {
+    for (const tNode& node : protected_) f(node.data);
+    for (const tNode& node : window_) f(node.data);
+    for (const tNode& node : probation_) f(node.data);
+  }
+
+ private:
+  list_t& Segment(tSegment segment) {
+    switch (segment) {
+      case kWindow: return window_;
+      case kProbation: return probation_;
+      default: return protected_;
+    }
+  }
+
+  size_t MainSize() const { return probation_.size() + protected_.size(); }
+
+  // The least recently used entry of the main part, preferably on probation.
+  handle_t MainVictim() {
+    return std::prev(probation_.empty() ? protected_.end() : probation_.end());
+  }
+
+  // Moves the entry of h to the front of 'segment'. Handles stay valid.
+  void Move(handle_t h, tSegment segment) {
+    list_t& from = Segment(h->segment);
+    Segment(segment).splice(Segment(segment).begin(), from, h);
+    h->segment = segment;
+  }
+
+  T Remove(handle_t h) {
+    T t = std::move(h->data);
+    Erase(h);
+    return t;
+  }
+
+  const size_t window_capacity_;
+  const size_t main_capacity_;
+  const size_t protected_capacity_;
+  // Most recently used first.
+  list_t window_;
+  list_t probation_;
+  list_t protected_;
+  CountMinSketch sketch_;
+};
+
+#endif  // _PUBLIC_UTIL_CACHE_EVICTION_POLICY_H_
@@ -0,0 +1,126 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/cache/eviction_policy.h"
+
+#include <string>
+#include <vector>
+
+#include "base/common.h"
+#include "test/cc/test_main.h"
+#include "util/cache/shared_lru_cache.h"
+
+namespace util {
+namespace test {
+
+template<template<class, class> class P>
+using tCache = SharedLRUCache<int, int, hash<int>, equal_to<int>, P>;
+
+// The keys of the cache, from the entry most likely to be kept.
+template<template<class, class> class P>
+vector<int> Keys(const P<int, hash<int>>& policy) {
+  vector<int> keys;
+  policy.ForEach([&keys](int k) { keys.push_back(k); });
+  return keys;
+}
+
+TEST(LRUPolicy, Order) {
+  LRUPolicy<int, hash<int>> policy(3);
+  auto h1 = policy.Insert(1);
+  policy.Insert(2);
+  policy.Insert(3);
+  EXPECT_EQ((vector<int>{3, 2, 1}), Keys(policy));
+  policy.Touch(h1);
+  EXPECT_EQ((vector<int>{1, 3, 2}), Keys(policy));
+  EXPECT_EQ(2, policy.Evict());
+  policy.Erase(h1);
+  EXPECT_EQ(vector<int>{3}, Keys(policy));
+}
+
+TEST(WTinyLFUPolicy, Segments) {
+  WTinyLFUPolicy<int, hash<int>> policy(4);
+  // A window of 1, then probation.
+  auto h1 = policy.Insert(1);
+  policy.Insert(2);
+  policy.Insert(3);
+  EXPECT_EQ((vector<int>{3, 2, 1}), Keys(policy));
+  // A hit promotes 1 to the protected segment.
+  policy.Touch(h1);
+  EXPECT_EQ((vector<int>{1, 3, 2}), Keys(policy));
+  policy.Insert(4);
+  policy.Insert(5);
+  // 4 leaves the window, but is not more frequent than 2.
+  EXPECT_EQ(4, policy.Evict());
+  EXPECT_EQ((vector<int>{1, 5, 3, 2}), Keys(policy));
+  // 5 is, and replaces it.
+  policy.Access(5);
+  policy.Insert(6);
+  EXPECT_EQ(2, policy.Evict());
+  EXPECT_EQ((vector<int>{1, 6, 5, 3}), Keys(policy));
+  policy.Clear();
+  EXPECT_TRUE(Keys(policy).empty());
+}
+
+TEST(WTinyLFUPolicy, SmallCaches) {
+  tCache<WTinyLFUPolicy> empty(0);
+  empty[1] = 1;
+  EXPECT_TRUE(empty.empty());
+  tCache<WTinyLFUPolicy> one(1);
+  one[1] = 1;
+  one[2] = 2;
+  EXPECT_EQ(1, one.size());
+  EXPECT_TRUE(one.find(2) != one.end());
+}
+
+// Looks up each key, and inserts it on a miss. Returns the number of hits.
+template<class tCache>
+int Replay(tCache* cache, const vector<int>& keys) {
+  int hits = 0;
+  for (int k : keys) {
+    if (cache->find(k) != cache->end()) ++hits;
+    else cache->insert(make_pair(k, k));
+  }
+  return hits;
+}
+
+// 100 popular keys looked up in turn, interrupted by a scan of 1000 keys.
+template<class tCache>
+int PopularKeysHits(tCache* cache) {
+  vector<int> popular;
+  for (int r = 0; r < 10; ++r)
+    for (int k = 0; k < 100; ++k) popular.push_back(k);
+  Replay(cache, popular);
+  vector<int> scan;
+  for (int k = 1000; k < 2000; ++k) scan.push_back(k);
+  EXPECT_EQ(0, Replay(cache, scan));
+  return Replay(cache, popular);
+}
+
+TEST(WTinyLFUPolicy, ScanResistance) {
+  tCache<LRUPolicy> lru(200);
+  tCache<WTinyLFUPolicy> tiny_lfu(200);
+  // The scan flushes the LRU cache; but not the popular entries of W-TinyLFU.
+  EXPECT_EQ(900, PopularKeysHits(&lru));
+  EXPECT_EQ(1000, PopularKeysHits(&tiny_lfu));
+  EXPECT_EQ(200, tiny_lfu.size());
+}
+
+TEST(WTinyLFUPolicy, Cache) {
+  tCache<WTinyLFUPolicy> cache(100, chrono::milliseconds(1));
+  for (int i = 0; i < 1000; ++i) cache[i] = i;
+  EXPECT_EQ(100, cache.size());
+  EXPECT_EQ(1, cache.erase(999));
+  EXPECT_EQ(99, cache.size());
+  tCache<WTinyLFUPolicy> copy(cache);
+  EXPECT_EQ(99, copy.size());
+  this_thread::sleep_for(chrono::milliseconds(2));
+  // Expired entries leave the policy too.
+  for (int i = 0; i < 1000; ++i) EXPECT_TRUE(cache.find(i) == cache.end());
+  EXPECT_TRUE(cache.empty());
+  cache[1] = 1;
+  EXPECT_EQ(1, cache.find(1)->second);
+  cache.clear();
+  EXPECT_TRUE(cache.empty());
+}
+
+}  // namespace test
+}  // namespace util
@@ -7,7 +7,10 @@
 
 // Cache size can be controlled via the policy object. When cache size hits the
 // maximum size, least recently used group is flushed to disk (if dirty) and
-// dropped from cache.
+// dropped from cache. The size is a number of groups, and optionally a number
+// of bytes (Policy::max_bytes): the weight of a group is the sum of the weights
+// of its entries, by default their serialized size. Groups, bytes and the byte
+// budget are exported as gauges (see cache_gauges.h), named with set_name().
 
 // Internally, the class caches groups and marks modified groups as dirty. This
 // means that it is possible to send a bunch of write requests to keys within
@@ -18,9 +21,25 @@
 // is only done upon insert() and find() operations. It may be a good idea to
 // explicitly flush() or clear() the cache periodically.
 
+// By default dirty groups are written to disk synchronously, under the lock of
+// the cache. With Policy::write_back_threads > 0 they are written back in the
+// background instead: flushing a group only takes a snapshot of it (the group
+// is copied on its next write), and a pool of writers serializes the snapshots
+// and writes them to a temporary file, syncs up to Policy::write_back_batch
+// files at once and renames them over the group files. A group that is read
+// while it is being written back is read from its snapshot, so lookups never
+// wait for the disk. flush() and clear() return once all the groups are on
+// disk.
+
 // It is possible to locally shard the groups so that mutex locked operations
 // lock only a single shard rather than the whole cache.
 
+// Lookups of a batch of keys first find the groups that are not cached, read
+// them from disk without locking the cache (in parallel with
+// Policy::read_threads > 0), then cache them and look the keys up. Prefetch()
+// starts reading groups early, e.g. as soon as the groups of a request are
+// known.
+
 #ifndef _PUBLIC_UTIL_CACHE_GROUP_CACHE_H_
 #define _PUBLIC_UTIL_CACHE_GROUP_CACHE_H_
 
@@ -29,7 +48,9 @@
 #include <sstream>
 #include <algorithm>
 #include <chrono>
+#include <condition_variable>
 #include <deque>
+#include <future>
 #include <thread>
 #include <mutex>
 #include <memory>
@@ -40,11 +61,20 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <cstdio>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "base/common.h"
+#include "util/cache/cache_gauges.h"
+#include "util/cache/weigher.h"
 #include "util/file/file.h"
 #include "util/factory/factory.h"
 #include "util/serial/serializer.h"
+#include "util/thread/thread_pool.h"
 
 class GroupCache : public Factory<GroupCache> {
  public:
@@ -100,12 +130,31 @@ class GroupCache : public Factory<GroupCache> {
   typedef list<pair<string, shared_ptr<group_t>>> list_t;
 
  public:
+  typedef function<size_t(const value_type&)> weigher_t;
+
+  // The serialized size of an entry.
+  static size_t SerializedWeight(const value_type& v) {
+    return SerializedSize::Weigh(v.key) + SerializedSize::Weigh(*v.data) +
+           SerializedSize::Weigh(v.time);
+  }
+
   struct Policy {
     Policy(int max_cache_size = 1000, int max_life = -1, int shards = 0)
         : max_cache_size(max_cache_size), max_life(max_life), num_local_shards(shards) {}
     int max_cache_size;     // Do not retain more than this many groups in cache.
     int max_life;           // Only retain items fresher than this many seconds.
     int num_local_shards = 0;
+    // Do not retain more than this many bytes of entries in cache (0: no
+    // limit). Split evenly between the local shards.
+    size_t max_bytes = 0;
+    weigher_t weigher = SerializedWeight;
+    // Write dirty groups back with this many background threads (0: write
+    // them synchronously), and sync up to this many files at once.
+    int write_back_threads = 0;
+    int write_back_batch = 16;
+    // Read the groups missing from batch lookups and Prefetch() with this many
+    // background threads (0: read them on the calling thread).
+    int read_threads = 0;
   };
 
   typedef string key_type;
@@ -133,17 +182,40 @@ class GroupCache : public Factory<GroupCache> {
 
   GroupCache(const string& base_path, const Grouper& grouper,
              Policy policy = Policy())
-      : base_path_(base_path), default_grouper_(grouper), policy_(policy) {
+      : base_path_(base_path), default_grouper_(grouper), policy_(policy),
+        gauges_(new CacheGauges) {
+    gauges_->set_max_bytes(policy_.max_bytes);
+    if (policy_.write_back_threads > 0) {
+      write_back_.reset(new WriteBack(policy_.write_back_threads,
+                                      policy_.write_back_batch));
+    }
+    if (policy_.read_threads > 0) {
+      read_pool_.reset(new util::threading::ThreadPool(policy_.read_threads));
+      read_pool_->set_name("group_cache_read");
+    }
     if (policy_.num_local_shards) {
       Policy shard_policy = policy_;
       shard_policy.num_local_shards = 0;
+      shard_policy.max_bytes = policy_.max_bytes / policy_.num_local_shards;
+      shard_policy.write_back_threads = 0;
+      shard_policy.read_threads = 0;
       shards_.resize(policy_.num_local_shards);
-      for (auto& shard : shards_)
+      for (auto& shard : shards_) {
         shard.reset(new GroupCache(base_path, grouper, shard_policy));
+        // The shards count in the gauges and share the readers and writers of
+        // the cache.
+        shard->gauges_ = gauges_;
+        shard->write_back_ = write_back_;
+        shard->read_pool_ = read_pool_;
+      }
     }
   }
 
-  virtual ~GroupCache() { flush(); }
+  virtual ~GroupCache() {
+    // Let the reads in flight cache their group.
+    if (read_pool_) read_pool_->Wait();
+    flush();
+  }
 
   // Recommended insert API.
   pair<iterator, bool> insert(const key_type& k, const data_type& d) {
@@ -166,8 +238,7 @@ class GroupCache : public Factory<GroupCache> {
     lock_t l(mutex_);
     if (cache_.find(group) == cache_.end()) ReadGroup(group);
     SetDirty(group);
-    GetOrCreateCacheEntry(group)[v.key].reset(new value_type(v));
-    auto ret = make_pair(iterator(GetOrCreateCacheEntry(group)[v.key]), true);
+    auto ret = make_pair(iterator(SetEntry(group, v)), true);
     AdjustSize();
     return ret;
   }
@@ -189,7 +260,7 @@ class GroupCache : public Factory<GroupCache> {
     if (!shards_.empty()) return GroupToShard(group).erase(k, group);
     lock_t l(mutex_);
     if (cache_.find(group) == cache_.end()) ReadGroup(group);
-    GetOrCreateCacheEntry(group).erase(k);
+    EraseEntry(group, k);
     SetDirty(group);
   }
 
@@ -210,16 +281,19 @@ class GroupCache : public Factory<GroupCache> {
     if (it == cache_.end()) return iterator();
     group_t& m = GetOrCreateCacheEntry(group);
     auto jt = m.find(k);
+    iterator ret;
     if (jt != m.end() && IsExpired(*jt->second)) {
-      m.erase(k);
-      jt = m.end();
+      EraseEntry(group, k);
       SetDirty(group);
+    } else if (jt != m.end()) {
+      ret = iterator(jt->second);
     }
-    auto ret = (jt == m.end()) ? iterator() : iterator(jt->second);
     AdjustSize();
     return ret;
   }
 
+  // With Policy::read_threads > 0, find_function must not look keys up in
+  // batches.
   typedef const function<void(const value_type&)>& find_function;
 
   // For each key that is found, call find_function with the value_type.
@@ -233,9 +307,16 @@ class GroupCache : public Factory<GroupCache> {
       string group = grouper(k);
       if (!group.empty()) group_to_keys[group].push_back(k);
     }
+    vector<string> groups;
+    for (auto& gk : group_to_keys) groups.push_back(gk.first);
+    LoadGroups(groups, true);
     for (auto& gk : group_to_keys) find(gk.second, f, gk.first);
   }
 
+  // Starts reading the groups that are not cached, and returns. Without
+  // Policy::read_threads, only advises the kernel to read their files ahead.
+  void Prefetch(const vector<string>& groups) const { LoadGroups(groups, false); }
+
   void find(const vector<key_type>& keys, find_function f, const string& group) const {
     if (!shards_.empty()) return GroupToShard(group).find(keys, f, group);
     lock_t l(mutex_);
@@ -243,15 +324,17 @@ class GroupCache : public Factory<GroupCache> {
     auto it = cache_.find(group);
     list<iterator> ret;
     if (it == cache_.end()) return;
-    group_t& m = GetOrCreateCacheEntry(group);
+    const group_t* m = &GetOrCreateCacheEntry(group);
     for (const auto& k : keys) {
-      auto jt = m.find(k);
-      if (jt != m.end() && IsExpired(*jt->second)) {
-        m.erase(k);
-        jt = m.end();
+      auto jt = m->find(k);
+      if (jt != m->end() && IsExpired(*jt->second)) {
+        // Erasing may copy the group if it is being written back.
+        EraseEntry(group, k);
         SetDirty(group);
+        m = &GetOrCreateCacheEntry(group);
+        continue;
       }
-      if (jt != m.end()) f(*jt->second);
+      if (jt != m->end()) f(*jt->second);
     }
     AdjustSize();
   }
@@ -271,23 +354,13 @@ class GroupCache : public Factory<GroupCache> {
   // Flushes the data but does not clear the cache. Returns number of groups
   // written to disk.
   int flush() {
-    if (!shards_.empty()) {
-      int num_dirty = 0;
-      for (auto& shard : shards_) num_dirty += shard->flush();
-      return num_dirty;
-    }
-    lock_t l(mutex_);
-    // Make a copy of dirty list since we cannot use dirty_ directly
-    // (FlushGroup() will erase stuff changing the container underneat).
-    auto dirty = dirty_;
-    // LOG(INFO) << "Flushing " << dirty.size() << " groups";
-    for (auto& group : dirty) FlushGroup(group);
-    ASSERT(dirty_.empty());
-    file_not_found_.clear();
-    return dirty.size();
+    int num_dirty = FlushDirty();
+    if (write_back_) write_back_->Wait();
+    return num_dirty;
   }
 
   // Flushes a dirty item with a probability prob (must be between 0 to 100).
+  // Does not wait for the groups written back in the background.
   int flush(int prob) {
     if (!shards_.empty()) {
       int num_dirty = 0;
@@ -312,17 +385,9 @@ class GroupCache : public Factory<GroupCache> {
   // Flushes the data and clears the cache. Returns number of groups written to
   // disk.
   int clear() {
-    if (!shards_.empty()) {
-      int num_dirty = 0;
-      for (auto& shard : shards_) num_dirty += shard->clear();
-      return num_dirty;
-    }
-    lock_t l(mutex_);
-    int num = flush();
-    ASSERT(dirty_.empty());
-    cache_.clear();
-    list_.clear();
-    return num;
+    int num_dirty = ClearAll();
+    if (write_back_) write_back_->Wait();
+    return num_dirty;
   }
 
   // Returns the number of cached groups.
@@ -335,6 +400,21 @@ class GroupCache : public Factory<GroupCache> {
     return cache_.size();
   }
 
+  // Returns the weight of the cached groups.
+  size_t bytes() const {
+    if (!shards_.empty()) {
+      size_t bytes = 0;
+      for (auto& shard : shards_) bytes += shard->bytes();
+      return bytes;
+    }
+    lock_t l(mutex_);
+    return bytes_;
+  }
+
+  // Names the gauges of the cache.
+  void set_name(const string& name) { gauges_->set_name(name); }
+  const CacheGauges& gauges() const { return *gauges_; }
+
   // Dumps basic stats about the cache for debugging purposes.
   void DumpStats(ostream& out = cout) const {
     if (!shards_.empty()) {
@@ -354,14 +434,229 @@ class GroupCache : public Factory<GroupCache> {
   }
 
  protected:
-  // Mutex needs to be locked before calling any of the following methods.
-  bool IsExpired(const value_type& v) const {
-    if (policy_.max_life <= 0) return false;
-    bool ret = Now() - v.time > policy_.max_life * 1000000;
+  // Writes dirty groups back to disk in the background. Shared by the shards of
+  // a cache. Groups are written in batches: each group is written to a
+  // temporary file, then the whole batch is synced, and renamed over the group
+  // files. There is at most one write in flight per file, newer snapshots of a
+  // file wait in pending_ (and replace each other).
+  class WriteBack {
+   public:
+    WriteBack(int num_threads, int batch_size)
+        : batch_size_(max(batch_size, 1)) {
+      for (int i = 0; i < num_threads; ++i) threads_.emplace_back([this]() { Run(); });
+    }
+
+    ~WriteBack() {
+      {
+        lock_guard<std::mutex> l(mutex_);
+        stop_ = true;
+      }
+      cond_.notify_all();
+      for (auto& t : threads_) t.join();
+    }
+
+    // Schedules writing a snapshot of a group to path. Entries older than
+    // max_life seconds are not written (see IsExpired()).
+    void Write(const string& path, shared_ptr<const group_t> group, int max_life) {
+      {
+        lock_guard<std::mutex> l(mutex_);
+        pending_[path] = {group, max_life};
+      }
+      cond_.notify_all();
+    }
+
+    // Returns the latest snapshot to be written to path, or null if there is
+    // none: then the file is up to date.
+    shared_ptr<const group_t> Pending(const string& path) const {
+      lock_guard<std::mutex> l(mutex_);
+      auto it = pending_.find(path);
+      if (it != pending_.end()) return it->second.group;
+      auto jt = in_flight_.find(path);
+      if (jt != in_flight_.end()) return jt->second;
+      return nullptr;
+    }
+
+    // Waits until all the scheduled snapshots are on disk.
+    void Wait() {
+      unique_lock<std::mutex> l(mutex_);
+      cond_.wait(l, [this]() { return pending_.empty() && in_flight_.empty(); });
+    }
+
+   private:
+    struct tRequest {
+      shared_ptr<const group_t> group;
+      int max_life;
+    };
+
+    struct tFile {
+      string path;
+      int fd;
+    };
+
+    // True if a pending file is not being written by another thread.
+    bool HasWork() const {
+      for (auto& p : pending_) if (in_flight_.find(p.first) == in_flight_.end()) return true;
+      return false;
+    }
+
+    void Run() {
+      for (;;) {
+        vector<pair<string, tRequest>> batch;
+        {
+          unique_lock<std::mutex> l(mutex_);
+          cond_.wait(l, [this]() { return stop_ || HasWork(); });
+          if (!HasWork()) return;
+          for (auto it = pending_.begin();
+               it != pending_.end() && batch.size() < batch_size_;) {
+            if (in_flight_.find(it->first) != in_flight_.end()) {
+              ++it;
+              continue;
+            }
+            in_flight_[it->first] = it->second.group;
+            batch.push_back(*it);
+            it = pending_.erase(it);
+          }
+        }
+        WriteBatch(batch);
+        {
+          lock_guard<std::mutex> l(mutex_);
+          for (auto& p : batch) in_flight_.erase(p.first);
+        }
+        cond_.notify_all();
+      }
+    }
+
+    void WriteBatch(const vector<pair<string, tRequest>>& batch) {
+      vector<tFile> files;
+      set<string> dirs;
+      for (auto& p : batch) {
+        const string& path = p.first;
+        string data = Serialize(*p.second.group, p.second.max_life);
+        if (data.empty()) {
+          VLOG(3) << "Deleting group file: " << path;
+          remove(path.c_str());
+          continue;
+        }
+        VLOG(3) << "Writing group file: " << path;
+        string temp_path = path + ".tmp";
+        int fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (fd < 0) {
+          // This is used only if the parent directory is not present.
+          file::CreateDirectoryIfNecessary(temp_path);
+          fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+          ASSERT(fd >= 0) << "Could not create directory for file: " << path;
+        }
+        for (size_t written = 0; written < data.size();) {
+          ssize_t n = write(fd, data.data() + written, data.size() - written);
+          if (n < 0 && errno == EINTR) continue;
+          ASSERT(n > 0) << "Could not write " << temp_path << ": " << strerror(errno);
+          written += n;
+        }
+        files.push_back({path, fd});
+        dirs.insert(path.substr(0, path.rfind('/') + 1));
+      }
+      // Sync the batch once it is written, so that the disk can coalesce the
+      // writes, and only then make the files visible.
+      for (auto& f : files) {
+        ASSERT(fdatasync(f.fd) == 0) << "Could not sync " << f.path << ": " << strerror(errno);
+        close(f.fd);
+        string temp_path = f.path + ".tmp";
+        ASSERT(rename(temp_path.c_str(), f.path.c_str()) == 0)
+            << "Could not rename " << temp_path << ": " << strerror(errno);
+      }
+      for (auto& dir : dirs) {
+        int fd = open(dir.empty() ? "." : dir.c_str(), O_RDONLY);
+        if (fd < 0) continue;
+        fsync(fd);
+        close(fd);
+      }
+    }
+
+    const size_t batch_size_;
+    mutable std::mutex mutex_;
+    condition_variable cond_;
+    unordered_map<string, tRequest> pending_;
+    unordered_map<string, shared_ptr<const group_t>> in_flight_;
+    bool stop_ = false;
+    vector<thread> threads_;
+  };
+
+  // A group read from disk, to be cached.
+  struct tLoadedGroup {
+    shared_ptr<group_t> group;  // Null if the group has no file.
+    bool dirty = false;         // Expired entries were skipped.
+  };
+
+  // A read of a group in flight.
+  struct tLoad {
+    shared_future<void> done;
+    bool stale = false;
+  };
+
+  // Reads a string in place.
+  struct tStringReader : public streambuf {
+    explicit tStringReader(string* s) { setg(&(*s)[0], &(*s)[0], &(*s)[0] + s->size()); }
+  };
+
+  static bool IsExpired(const value_type& v, int max_life) {
+    if (max_life <= 0) return false;
+    bool ret = Now() - v.time > max_life * 1000000;
     if (ret) VLOG(4) << "Expired key: " << v.key;
     return ret;
   }
 
+  // The entries of a group that are not expired, in binary format.
+  static string Serialize(const group_t& group, int max_life) {
+    stringstream buffer;
+    for (auto& p : group) {
+      if (IsExpired(*p.second, max_life)) continue;
+      p.second->Write(buffer);
+    }
+    return buffer.str();
+  }
+
+  // Flushes the dirty groups (of all the shards). Does not wait for the groups
+  // written back in the background.
+  int FlushDirty() {
+    if (!shards_.empty()) {
+      int num_dirty = 0;
+      for (auto& shard : shards_) num_dirty += shard->FlushDirty();
+      return num_dirty;
+    }
+    lock_t l(mutex_);
+    // Make a copy of dirty list since we cannot use dirty_ directly
+    // (FlushGroup() will erase stuff changing the container underneat).
+    auto dirty = dirty_;
+    // LOG(INFO) << "Flushing " << dirty.size() << " groups";
+    for (auto& group : dirty) FlushGroup(group);
+    ASSERT(dirty_.empty());
+    file_not_found_.clear();
+    return dirty.size();
+  }
+
+  // Flushes the dirty groups and clears the cache (of all the shards). Does not
+  // wait for the groups written back in the background.
+  int ClearAll() {
+    if (!shards_.empty()) {
+      int num_dirty = 0;
+      for (auto& shard : shards_) num_dirty += shard->ClearAll();
+      return num_dirty;
+    }
+    lock_t l(mutex_);
+    int num = FlushDirty();
+    ASSERT(dirty_.empty());
+    for (auto& p : loading_) p.second.stale = true;
+    gauges_->Add(-int64_t(cache_.size()), -int64_t(bytes_));
+    cache_.clear();
+    list_.clear();
+    group_bytes_.clear();
+    bytes_ = 0;
+    return num;
+  }
+
+  // Mutex needs to be locked before calling any of the following methods.
+  bool IsExpired(const value_type& v) const { return IsExpired(v, policy_.max_life); }
+
   void SetDirty(const string& group) const {
     dirty_.insert(group);
     VLOG(4) << "Set dirty: " << group;
@@ -377,7 +672,14 @@ class GroupCache : public Factory<GroupCache> {
     if (dirty_.find(group) != dirty_.end()) {
       auto it = cache_.find(group);
       ASSERT(it != cache_.end());
-      WriteGroup(group);
+      if (write_back_) {
+        // The group is copied on its next write (see MutableCacheEntry()).
+        write_back_->Write(base_path_ + "/" + group, it->second->second,
+                           policy_.max_life);
+        file_not_found_.erase(group);
+      } else {
+        WriteGroup(group);
+      }
       SetClean(group);
     }
     ASSERT(dirty_.find(group) == dirty_.end());
@@ -385,33 +687,152 @@ class GroupCache : public Factory<GroupCache> {
 
   // Attempt to read a group from disk. Return false on failure.
   bool ReadGroup(const string& group) const {
-    ifstream file;
-    // Use a custom buffer size.
-    char buffer[512 * 1024 + 1];
-    file.rdbuf()->pubsetbuf(buffer, sizeof(buffer));
-    file.open((base_path_ + "/" + group).c_str());
+    if (write_back_) {
+      // The group is being written back, its snapshot is more recent than its
+      // file.
+      shared_ptr<const group_t> snapshot = write_back_->Pending(base_path_ + "/" + group);
+      if (snapshot) {
+        VLOG(3) << "Reading group from write-back: " << group;
+        CacheGroup(group, {const_pointer_cast<group_t>(snapshot), false});
+        return true;
+      }
+    }
     if (file_not_found_.find(group) != file_not_found_.end()) return false;
-    else if (file.fail()) {
+    VLOG(3) << "Reading group: " << group;
+    tLoadedGroup loaded = LoadGroup(base_path_ + "/" + group, policy_.max_life);
+    if (!loaded.group) {
       file_not_found_.insert(group);
       return false;
     }
-    VLOG(3) << "Reading group: " << group;
+    CacheGroup(group, loaded);
+    return true;
+  }
 
+  // Caches a group read from disk.
+  void CacheGroup(const string& group, const tLoadedGroup& loaded) const {
     // This is needed for correct behavior in case everything that we attempt to
     // read is deemed expired (still want an empty and dirty entry in cache).
     GetOrCreateCacheEntry(group);
-    bool dirty = false;
+    list_.begin()->second = loaded.group;
+    if (policy_.weigher) {
+      for (auto& p : *loaded.group) AddBytes(group, policy_.weigher(*p.second));
+    }
+    if (loaded.dirty) SetDirty(group);
+  }
+
+  // Registers a read of the group if it is neither cached nor being read. Its
+  // task reads and caches the group, then marks it as done in *loads. Returns
+  // whether the group has to be read from disk.
+  bool StartLoad(const string& group, bool load, vector<shared_future<void>>* loads,
+                 vector<function<void()>>* tasks) const {
+    lock_t l(mutex_);
+    if (cache_.find(group) != cache_.end() ||
+        file_not_found_.find(group) != file_not_found_.end()) return false;
+    // Read from its snapshot by ReadGroup().
+    if (write_back_ && write_back_->Pending(base_path_ + "/" + group)) return false;
+    auto it = loading_.find(group);
+    if (it != loading_.end()) {
+      loads->push_back(it->second.done);
+      return false;
+    }
+    if (!load) return true;
+    shared_ptr<promise<void>> done(new promise<void>);
+    loading_[group].done = done->get_future().share();
+    loads->push_back(loading_[group].done);
+    string path = base_path_ + "/" + group;
+    int max_life = policy_.max_life;
+    tasks->push_back([this, group, path, max_life, done]() {
+      FinishLoad(group, LoadGroup(path, max_life));
+      done->set_value();
+    });
+    return true;
+  }
+
+  // Caches a group read by StartLoad(), unless the group was cached since.
+  void FinishLoad(const string& group, const tLoadedGroup& loaded) const {
+    lock_t l(mutex_);
+    auto it = loading_.find(group);
+    ASSERT(it != loading_.end());
+    bool stale = it->second.stale;
+    loading_.erase(it);
+    if (stale || cache_.find(group) != cache_.end()) return;
+    if (!loaded.group) {
+      file_not_found_.insert(group);
+      return;
+    }
+    CacheGroup(group, loaded);
+    AdjustSize();
+  }
+
+  // The group is dropped from the cache: a read of the group in flight may
+  // have read its file before it was last written.
+  void SetStale(const string& group) const {
+    auto it = loading_.find(group);
+    if (it != loading_.end()) it->second.stale = true;
+  }
+
+  // Reads the groups that need to be read, without locking the cache. Returns
+  // once they are cached if wait, right away otherwise.
+  void LoadGroups(const vector<string>& groups, bool wait) const {
+    bool load = wait || read_pool_;
+    vector<shared_future<void>> loads;
+    vector<function<void()>> tasks;
+    vector<string> paths;
+    for (auto& group : groups) {
+      const GroupCache& shard = shards_.empty() ? *this : GroupToShard(group);
+      if (shard.StartLoad(group, load, &loads, &tasks)) paths.push_back(base_path_ + "/" + group);
+    }
+    if (read_pool_) {
+      for (auto& task : tasks) read_pool_->Add(std::move(task));
+    } else {
+      // Let the kernel read all the files ahead while we read them one by one.
+      for (auto& path : paths) AdviseWillNeed(path);
+      for (auto& task : tasks) task();
+    }
+    if (wait) for (auto& done : loads) done.wait();
+  }
+
+  static void AdviseWillNeed(const string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    close(fd);
+  }
+
+  // Reads a group file. Expired entries are skipped. The group is null if
+  // there is no file.
+  static tLoadedGroup LoadGroup(const string& path, int max_life) {
+    tLoadedGroup loaded;
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return loaded;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    string data;
+    struct stat st;
+    if (fstat(fd, &st) == 0) data.resize(st.st_size);
+    size_t size = 0;
+    for (;;) {
+      if (size == data.size()) data.resize(size + 64 * 1024);
+      ssize_t n = read(fd, &data[size], data.size() - size);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) break;
+      size += n;
+    }
+    close(fd);
+    data.resize(size);
+
+    loaded.group.reset(new group_t);
+    tStringReader reader(&data);
+    istream is(&reader);
     for (;;) {
       value_type entry;
-      if (!entry.Read(file)) break;
-      if (IsExpired(entry)) {
-        dirty = true;
+      if (!entry.Read(is)) break;
+      if (IsExpired(entry, max_life)) {
+        loaded.dirty = true;
         continue;
       }
-      GetOrCreateCacheEntry(group)[entry.key].reset(new value_type(entry));
+      (*loaded.group)[entry.key].reset(new value_type(entry));
     }
-    if (dirty) SetDirty(group);
-    return true;
+    return loaded;
   }
 
   // Attempt to write a group to disk. Return false on failure.
@@ -433,13 +854,9 @@ class GroupCache : public Factory<GroupCache> {
       VLOG(3) << "Writing group: " << group;
       // We don't call GetOrCreateCacheEntry since we do not need to change this
       // entry's order in the list. Note: AdjustSize() relies on this behavior.
-      stringstream temp_buffer;
-      for (auto& p : *it->second->second) {
-        if (IsExpired(*p.second)) continue;
-        p.second->Write(temp_buffer);
-        written = true;
-      }
-      file << temp_buffer.str();
+      string data = Serialize(*it->second->second, policy_.max_life);
+      written = !data.empty();
+      file << data;
     }
     if (!written) {
       VLOG(3) << "Deleting group: " << group;
@@ -456,6 +873,7 @@ class GroupCache : public Factory<GroupCache> {
     if (it == cache_.end()) {
       list_.push_front(make_pair(group, shared_ptr<group_t>(new group_t)));
       cache_[group] = list_.begin();
+      gauges_->Add(1, 0);
       ASSERT_EQ(list_.size(), cache_.size());
     }
     else {
@@ -468,25 +886,69 @@ class GroupCache : public Factory<GroupCache> {
     return *list_.begin()->second;
   }
 
+  // Same as GetOrCreateCacheEntry(), for modifying the group: copies the group
+  // if it is shared with a write-back snapshot.
+  group_t& MutableCacheEntry(const string& group) const {
+    GetOrCreateCacheEntry(group);
+    shared_ptr<group_t>& entry = list_.begin()->second;
+    if (entry.use_count() > 1) entry.reset(new group_t(*entry));
+    return *entry;
+  }
+
+  // Sets the entry of v.key in the group, and accounts for its weight. Returns
+  // the new entry.
+  shared_ptr<value_type>& SetEntry(const string& group, const value_type& v) const {
+    group_t& m = MutableCacheEntry(group);
+    EraseEntry(group, v.key);
+    shared_ptr<value_type>& entry = m[v.key];
+    entry.reset(new value_type(v));
+    AddBytes(group, policy_.weigher ? policy_.weigher(v) : 0);
+    return entry;
+  }
+
+  // Erases the entry of key from the group, if any.
+  void EraseEntry(const string& group, const string& key) const {
+    group_t& m = MutableCacheEntry(group);
+    auto it = m.find(key);
+    if (it == m.end()) return;
+    if (policy_.weigher) AddBytes(group, -int64_t(policy_.weigher(*it->second)));
+    m.erase(it);
+  }
+
+  void AddBytes(const string& group, int64_t bytes) const {
+    if (bytes == 0) return;
+    group_bytes_[group] += bytes;
+    bytes_ += bytes;
+    gauges_->Add(0, bytes);
+  }
+
+  bool Oversize() const {
+    return (policy_.max_cache_size > 0 && cache_.size() > policy_.max_cache_size) ||
+           (policy_.max_bytes > 0 && bytes_ > policy_.max_bytes);
+  }
+
   // Shrink size if we exceeded maximum allowed cache size.
   void AdjustSize() const {
-    if (policy_.max_cache_size <= 0 ||
-        cache_.size() <= policy_.max_cache_size ||
-        list_.empty())
-      return;
+    if (!Oversize() || list_.empty()) return;
 
     // Launch the update in a separate thread.
     thread(
       [this](){
-        while (cache_.size() > policy_.max_cache_size) {
+        for (;;) {
           lock_t l(mutex_);
-          if (!cache_.size()) continue;
+          if (cache_.empty() || !Oversize()) break;
           string group = list_.rbegin()->first;
           FlushGroup(group);
+          SetStale(group);
           cache_.erase(group);
           ASSERT(list_.rbegin()->first == group);
           list_.pop_back();
           ASSERT(dirty_.find(group) == dirty_.end());
+          auto it = group_bytes_.find(group);
+          int64_t bytes = it == group_bytes_.end() ? 0 : it->second;
+          if (it != group_bytes_.end()) group_bytes_.erase(it);
+          bytes_ -= bytes;
+          gauges_->Add(-1, -bytes);
         }
       }
     ).detach();
@@ -504,6 +966,14 @@ class GroupCache : public Factory<GroupCache> {
   mutable unordered_set<string> file_not_found_;
   mutable list_t list_;
   mutable unordered_map<string, list_t::iterator> cache_;
+  // The weight of the entries, by cached group and in total.
+  mutable unordered_map<string, int64_t> group_bytes_;
+  mutable size_t bytes_ = 0;
+  shared_ptr<CacheGauges> gauges_;
+  shared_ptr<WriteBack> write_back_;
+  // The reads of groups in flight.
+  mutable unordered_map<string, tLoad> loading_;
+  shared_ptr<util::threading::ThreadPool> read_pool_;
   vector<unique_ptr<GroupCache>> shards_;
   default_random_engine rand_ = default_random_engine(random_device()());
 };
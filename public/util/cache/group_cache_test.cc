@@ -4,6 +4,9 @@
 #include <iostream>
 #include <cstdio>
 #include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "util/init/main.h"
 #include "util/cache/group_cache.h"
@@ -158,6 +161,139 @@ int init_main() {
 
   cache.DumpStats();
 
+  // Test the byte budget: 10 groups of 10 entries of about 1KB, in 30KB.
+  {
+    GroupCache::Policy bytes_policy;
+    bytes_policy.max_bytes = 30000;
+    GroupCache bytes_cache(tmpdir, GroupCache::Grouper([](const string& key) {
+      return "bytes" + key.substr(0, 1);
+    }), bytes_policy);
+    bytes_cache.set_name("group_cache_test");
+    for (int g = 0; g < 10; ++g) {
+      for (int i = 0; i < 10; ++i)
+        bytes_cache.insert(to_string(g) + "-" + to_string(i), string(1000, 'x'));
+    }
+    // Groups are evicted asynchronously.
+    for (int i = 0; i < 100 && bytes_cache.bytes() > bytes_policy.max_bytes; ++i)
+      this_thread::sleep_for(chrono::milliseconds(10));
+    LOG(INFO) << "Cached " << bytes_cache.size() << " groups of "
+              << bytes_cache.bytes() << " bytes";
+    ASSERT(bytes_cache.bytes() <= bytes_policy.max_bytes) << bytes_cache.bytes();
+    ASSERT(bytes_cache.size() > 0 && bytes_cache.size() < 10);
+    CacheGauges::tSnapshot snapshot;
+    ASSERT(CacheGauges::SnapshotByName("group_cache_test", &snapshot));
+    ASSERT_EQ(bytes_cache.size(), snapshot.entries);
+    ASSERT_EQ(bytes_cache.bytes(), snapshot.bytes);
+    ASSERT_EQ(bytes_policy.max_bytes, snapshot.max_bytes);
+
+    // The evicted groups were flushed.
+    for (int g = 0; g < 10; ++g) {
+      for (int i = 0; i < 10; ++i) {
+        string key = to_string(g) + "-" + to_string(i);
+        ASSERT(bytes_cache.find(key) != bytes_cache.end()) << key;
+        bytes_cache.erase(key);
+      }
+    }
+    // Deletes the files of the now empty groups.
+    bytes_cache.clear();
+    ASSERT_EQ(0, bytes_cache.bytes());
+    // Let the pending evictions finish before the cache is destroyed.
+    this_thread::sleep_for(chrono::milliseconds(100));
+  }
+
+  // Test the background write-back: 10 groups in a cache of 1 group, so that
+  // the groups are evicted while they are being written.
+  {
+    GroupCache::Grouper async_grouper([](const string& key) {
+      return "async" + key.substr(0, 1);
+    });
+    {
+      GroupCache::Policy async_policy(1);
+      async_policy.write_back_threads = 2;
+      async_policy.write_back_batch = 4;
+      GroupCache async_cache(tmpdir, async_grouper, async_policy);
+      for (int g = 0; g < 10; ++g) {
+        for (int i = 0; i < 10; ++i) {
+          string key = to_string(g) + "-" + to_string(i);
+          async_cache.insert(key, "old" + key);
+        }
+      }
+      for (int g = 0; g < 10; ++g) {
+        for (int i = 0; i < 10; ++i) {
+          string key = to_string(g) + "-" + to_string(i);
+          auto it = async_cache.find(key);
+          ASSERT(it != async_cache.end()) << key;
+          ASSERT_EQ("old" + key, *it->data);
+        }
+      }
+      // Modify the groups while they are being written.
+      for (int g = 0; g < 10; ++g) async_cache.insert(to_string(g) + "-0", "new");
+      async_cache.flush(100);
+      for (int g = 0; g < 10; ++g) async_cache.insert(to_string(g) + "-1", "new");
+      async_cache.flush();
+      // Let the pending evictions finish before the cache is destroyed.
+      this_thread::sleep_for(chrono::milliseconds(100));
+    }
+    ASSERT(system(("ls " + tmpdir + " | grep -q '\\.tmp$'").c_str()) != 0)
+        << "Temporary files left in " << tmpdir;
+
+    // Read the groups back synchronously.
+    GroupCache sync_cache(tmpdir, async_grouper);
+    for (int g = 0; g < 10; ++g) {
+      for (int i = 0; i < 10; ++i) {
+        string key = to_string(g) + "-" + to_string(i);
+        auto it = sync_cache.find(key);
+        ASSERT(it != sync_cache.end()) << key;
+        ASSERT_EQ(i < 2 ? "new" : "old" + key, *it->data);
+        sync_cache.erase(key);
+      }
+    }
+    sync_cache.clear();
+    this_thread::sleep_for(chrono::milliseconds(100));
+  }
+
+  // Test the batch lookups and Prefetch(): 20 groups of 10 keys, read with and
+  // without readers.
+  {
+    GroupCache::Grouper batch_grouper([](const string& key) {
+      return "batch" + key.substr(0, key.find('-'));
+    });
+    vector<string> keys, groups;
+    {
+      GroupCache write_cache(tmpdir, batch_grouper);
+      for (int g = 0; g < 20; ++g) {
+        groups.push_back("batch" + to_string(g));
+        for (int i = 0; i < 10; ++i) {
+          keys.push_back(to_string(g) + "-" + to_string(i));
+          write_cache.insert(keys.back(), "value" + keys.back());
+        }
+      }
+    }
+    groups.push_back("batch_missing");
+    keys.push_back("_missing-0");
+    for (int read_threads : {0, 4}) {
+      GroupCache::Policy batch_policy;
+      batch_policy.num_local_shards = 2;
+      batch_policy.read_threads = read_threads;
+      GroupCache batch_cache(tmpdir, batch_grouper, batch_policy);
+      batch_cache.Prefetch(vector<string>(groups.begin(), groups.begin() + 10));
+      int num_found = 0;
+      batch_cache.find(keys, [&num_found](const GroupCache::value_type& v) {
+        ASSERT_EQ("value" + v.key, *v.data);
+        ++num_found;
+      });
+      ASSERT_EQ(200, num_found) << read_threads;
+      ASSERT_EQ(20, batch_cache.size()) << read_threads;
+      // Prefetching cached groups is a no-op.
+      batch_cache.Prefetch(groups);
+      ASSERT(batch_cache.find("3-3") != batch_cache.end());
+    }
+    GroupCache erase_cache(tmpdir, batch_grouper);
+    for (auto& key : keys) erase_cache.erase(key);
+    erase_cache.clear();
+    this_thread::sleep_for(chrono::milliseconds(100));
+  }
+
   cout << "\nTest passed. About to exit and dump current directory structure.\n" << endl;
   cout << "Since we expired everything, directory should be empty: " << endl;
   return 0;
@@ -0,0 +1,289 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Thread safe cache with the interface of SharedLRUCache, for read mostly data
+// shared by many threads.
+//
+// SharedLRUCache takes one lock for every operation, and find() moves the hit
+// to the front of its list, so concurrent hits serialize. ShardedLRUCache
+// instead:
+// - splits the entries between independently locked shards by key hash,
+// - only takes a reader lock in find(): a hit sets the reference bit of its
+//   entry with an atomic store,
+// - evicts with the CLOCK (second chance) algorithm: a hand sweeps the entries
+//   of the shard, clearing the reference bits it meets, and evicts the first
+//   entry that was not referenced since the previous sweep. Expired entries
+//   are evicted first.
+// Eviction is thus an approximation of LRU, within a shard. The capacity is
+// split evenly between the shards, so a shard may evict while others still
+// have room.
+//
+// As with SharedLRUCache, iterators hold a ref counted copy of the data and
+// stay valid after the entry is evicted, and expired entries are erased when
+// they are looked up.
+
+#ifndef _PUBLIC_UTIL_CACHE_SHARDED_LRU_CACHE_H_
+#define _PUBLIC_UTIL_CACHE_SHARDED_LRU_CACHE_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+template<class K, class V, class H = std::hash<K>, class EQ = std::equal_to<K>>
+class ShardedLRUCache {
+  typedef std::shared_ptr<std::pair<K, V>> data_t;
+  // The hash and equality functors are created for each call, as in
+  // SharedLRUCache, so that their operator() need not be const.
+  struct key_hash {
+    size_t operator()(const K& k) const { return H()(k); }
+  };
+  struct key_eq {
+    bool operator()(const K& k1, const K& k2) const { return EQ()(k1, k2); }
+  };
+  typedef std::shared_timed_mutex mutex_t;
+  typedef std::shared_lock<mutex_t> read_lock_t;
+  typedef std::unique_lock<mutex_t> write_lock_t;
+
+ public:
+  typedef K                                 key_type;
+  typedef size_t                            size_type;
+  typedef typename data_t::element_type     value_type;
+  typedef std::chrono::steady_clock         clock_type;
+
+  static const int kDefaultNumShards = 16;
+
+  // Minimal iterator definition. We only support checking against end().
+  struct iterator {
+    iterator() {}
+    iterator(data_t data) : data_(data) {}
+    bool operator == (const iterator& it) const { return data_.get() == it.data_.get(); }
+    bool operator != (const iterator& it) const { return data_.get() != it.data_.get(); }
+    const value_type& operator*()  const        { return *data_.get(); }
+    const value_type* operator->() const        { return data_.get(); }
+   private:
+    data_t data_;
+    friend class ShardedLRUCache;
+  };
+  typedef iterator const_iterator;
+
+  // Allows use of operator [] in most contexts.
+  struct delegate {
+    delegate(data_t data, ShardedLRUCache* cache) : data_(data), cache_(cache) {}
+    operator const V&() const { return data_->second; }
+    void operator=(const V& v) const { cache_->insert(std::make_pair(data_->first, v)); }
+   private:
+    data_t data_;
+    ShardedLRUCache* cache_;
+  };
+
+  // The number of shards is rounded down to a power of 2, and to at most
+  // 'limit'.
+  explicit ShardedLRUCache(size_type limit, int num_shards = kDefaultNumShards)
+      : ShardedLRUCache(limit, clock_type::duration(), false, num_shards) {}
+  ShardedLRUCache(size_type limit, clock_type::duration lifetime,
+                  int num_shards = kDefaultNumShards)
+      : ShardedLRUCache(limit, lifetime, true, num_shards) {}
+
+  // Unlike unordered_map, insert variants return void for efficiency.
+  void insert(const value_type& v, clock_type::time_point tp) {
+    ShardOf(v.first).Insert(data_t(new value_type(v)), tp);
+  }
+  void insert(const value_type& v) {
+    insert(v, expire_ ? clock_type::now() + lifetime_ : clock_type::time_point());
+  }
+
+  size_type erase(const key_type& k) { return ShardOf(k).Erase(k); }
+  void erase(const_iterator it) { erase(it->first); }
+
+  iterator find(const key_type& k) const { return ShardOf(k).Find(k); }
+
+  iterator  end()      const    { return iterator(data_t()); }
+  void      clear()             { for (auto& shard : shards_) shard->Clear(); }
+  void      rehash(size_type n) {
+    for (auto& shard : shards_) shard->Rehash(n / shards_.size() + 1);
+  }
+  bool      empty()    const    { return size() == 0; }
+  size_type size()     const    {
+    size_type size = 0;
+    for (const auto& shard : shards_) size += shard->Size();
+    return size;
+  }
+  size_type max_size() const    { return max_size_; }
+  int       num_shards() const  { return shards_.size(); }
+
+  delegate operator[](const key_type& k) {
+    data_t data = find(k).data_;
+    if (!data.get()) data.reset(new value_type(k, V()));
+    return delegate(data, this);
+  }
+
+ private:
+  class Shard {
+   public:
+    Shard(size_type capacity, bool expire)
+        : capacity_(capacity), expire_(expire), slots_(new tSlot[capacity]) {
+      ResetFreeSlots();
+    }
+
+    iterator Find(const K& k) {
+      {
+        read_lock_t l(mutex_);
+        auto it = index_.find(k);
+        if (it == index_.end()) return iterator();
+        const tSlot& slot = slots_[it->second];
+        if (!Expired(slot, clock_type::now())) {
+          // Only write the bit when needed, to keep the line shared between
+          // the cores reading it.
+          if (!slot.referenced.load(std::memory_order_relaxed))
+            slot.referenced.store(true, std::memory_order_relaxed);
+          return iterator(slot.data);
+        }
+      }
+      // Expired: erase it, unless it was replaced in the meantime.
+      write_lock_t l(mutex_);
+      auto it = index_.find(k);
+      if (it != index_.end() && Expired(slots_[it->second], clock_type::now()))
+        EraseSlot(it);
+      return iterator();
+    }
+
+    void Insert(data_t data, clock_type::time_point tp) {
+      if (capacity_ == 0) return;
+      write_lock_t l(mutex_);
+      auto it = index_.find(data->first);
+      bool referenced = it != index_.end();
+      size_type i;
+      if (referenced) {
+        i = it->second;
+      } else {
+        if (free_.empty()) {
+          i = Evict();
+        } else {
+          i = free_.back();
+          free_.pop_back();
+        }
+        index_.insert(std::make_pair(data->first, i));
+      }
+      tSlot& slot = slots_[i];
+      slot.data = std::move(data);
+      slot.expiration = tp;
+      slot.referenced.store(referenced, std::memory_order_relaxed);
+    }
+
+    size_type Erase(const K& k) {
+      write_lock_t l(mutex_);
+      auto it = index_.find(k);
+      if (it == index_.end()) return 0;
+      EraseSlot(it);
+      return 1;
+    }
+
+    void Clear() {
+      write_lock_t l(mutex_);
+      index_.clear();
+      for (size_type i = 0; i < capacity_; ++i) slots_[i].data.reset();
+      ResetFreeSlots();
+    }
+
+    void Rehash(size_type n) {
+      write_lock_t l(mutex_);
+      index_.rehash(n);
+    }
+
+    size_type Size() const {
+      read_lock_t l(mutex_);
+      return index_.size();
+    }
+
+   private:
+    struct tSlot {
+      data_t data;
+      clock_type::time_point expiration;
+      mutable std::atomic<bool> referenced{false};
+    };
+    typedef std::unordered_map<K, size_type, key_hash, key_eq> index_t;
+
+    bool Expired(const tSlot& slot, clock_type::time_point now) const {
+      return expire_ && slot.expiration < now;
+    }
+
+    // Returns the slot of the evicted entry. Only called when all the slots
+    // are used.
+    size_type Evict() {
+      clock_type::time_point now = expire_ ? clock_type::now() : clock_type::time_point();
+      while (true) {
+        size_type i = hand_;
+        hand_ = (hand_ + 1) % capacity_;
+        tSlot& slot = slots_[i];
+        if (slot.referenced.load(std::memory_order_relaxed) && !Expired(slot, now)) {
+          slot.referenced.store(false, std::memory_order_relaxed);
+          continue;
+        }
+        index_.erase(slot.data->first);
+        return i;
+      }
+    }
+
+    void EraseSlot(typename index_t::iterator it) {
+      tSlot& slot = slots_[it->second];
+      slot.data.reset();
+      slot.referenced.store(false, std::memory_order_relaxed);
+      free_.push_back(it->second);
+      index_.erase(it);
+    }
+
+    void ResetFreeSlots() {
+      free_.clear();
+      for (size_type i = capacity_; i > 0; --i) free_.push_back(i - 1);
+      hand_ = 0;
+    }
+
+    const size_type capacity_;
+    const bool expire_;
+    std::unique_ptr<tSlot[]> slots_;
+    index_t index_;
+    // The unused slots.
+    std::vector<size_type> free_;
+    // The next slot considered for eviction.
+    size_type hand_ = 0;
+    mutable mutex_t mutex_;
+  };
+
+  ShardedLRUCache(size_type limit, clock_type::duration lifetime, bool expire,
+                  int num_shards)
+      : max_size_(limit), lifetime_(lifetime), expire_(expire) {
+    int shards = 1;
+    while (shards * 2 <= num_shards && size_type(shards) * 2 <= limit) shards *= 2;
+    shard_mask_ = shards - 1;
+    for (int i = 0; i < shards; ++i) {
+      shards_.emplace_back(
+          new Shard(limit / shards + (i < limit % shards), expire));
+    }
+  }
+
+  Shard& ShardOf(const K& k) const {
+    // The index of each shard uses the low bits of the same hash: take the
+    // shard from the high bits of a multiplicative hash.
+    uint64_t h = static_cast<uint64_t>(key_hash()(k)) * 0x9E3779B97F4A7C15ULL;
+    return *shards_[(h >> 40) & shard_mask_];
+  }
+
+  const size_type max_size_;
+  const clock_type::duration lifetime_;
+  const bool expire_;
+  size_t shard_mask_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+
+  ShardedLRUCache(const ShardedLRUCache&) = delete;
+  ShardedLRUCache& operator=(const ShardedLRUCache&) = delete;
+};
+
+template<class K, class V, class H, class EQ>
+const int ShardedLRUCache<K, V, H, EQ>::kDefaultNumShards;
+
+#endif  // _PUBLIC_UTIL_CACHE_SHARDED_LRU_CACHE_H_
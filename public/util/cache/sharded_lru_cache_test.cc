@@ -0,0 +1,131 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/cache/sharded_lru_cache.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base/common.h"
+#include "test/cc/test_main.h"
+
+namespace util {
+namespace test {
+
+TEST(ShardedLRUCache, Expiration) {
+  ShardedLRUCache<string, int> cache(2, chrono::milliseconds(1));
+  cache.insert(make_pair("1", 1));
+  EXPECT_TRUE(cache.find("1") != cache.end());
+  this_thread::sleep_for(chrono::milliseconds(2));
+  // Expired entries are erased when they are looked up.
+  EXPECT_EQ(1, cache.size());
+  EXPECT_TRUE(cache.find("1") == cache.end());
+  EXPECT_EQ(0, cache.size());
+  EXPECT_TRUE(cache.empty());
+}
+
+TEST(ShardedLRUCache, IteratorsOutliveTheCache) {
+  ShardedLRUCache<int, int>::iterator it;
+  {
+    ShardedLRUCache<int, int> cache(100);
+    cache[1] = 10;
+    it = cache.find(1);
+    ASSERT_TRUE(it != cache.end());
+  }
+  EXPECT_EQ(1, it->first);
+  EXPECT_EQ(10, it->second);
+}
+
+TEST(ShardedLRUCache, Operators) {
+  ShardedLRUCache<int, int> cache(100);
+  // This should not create anything except a temporary delegate.
+  cache[1];
+  EXPECT_TRUE(cache.empty());
+  cache[1] = 10;
+  EXPECT_EQ(1, cache.size());
+  EXPECT_EQ(10, cache[1]);
+  cache[1] = 20;
+  EXPECT_EQ(1, cache.size());
+  EXPECT_EQ(20, cache[1]);
+  EXPECT_EQ(1, cache.erase(1));
+  EXPECT_EQ(0, cache.erase(1));
+  EXPECT_TRUE(cache.find(1) == cache.end());
+}
+
+TEST(ShardedLRUCache, SecondChance) {
+  ShardedLRUCache<string, int> cache(2, 1);
+  EXPECT_EQ(1, cache.num_shards());
+  cache.insert(make_pair("1", 1));
+  cache.insert(make_pair("2", 2));
+  // 1 is referenced: the hand clears its bit and evicts 2.
+  EXPECT_TRUE(cache.find("1") != cache.end());
+  cache.insert(make_pair("3", 3));
+  EXPECT_EQ(2, cache.size());
+  EXPECT_TRUE(cache.find("2") == cache.end());
+  EXPECT_TRUE(cache.find("3") != cache.end());
+  // 1 was not referenced since the last sweep, 3 was.
+  cache["4"] = 4;
+  EXPECT_EQ(2, cache.size());
+  EXPECT_TRUE(cache.find("1") == cache.end());
+  EXPECT_TRUE(cache.find("3") != cache.end());
+  EXPECT_TRUE(cache.find("4") != cache.end());
+}
+
+TEST(ShardedLRUCache, ExpiredEntriesAreEvictedFirst) {
+  typedef ShardedLRUCache<int, int> tCache;
+  tCache cache(2, chrono::hours(1), 1);
+  cache.insert(make_pair(2, 2));
+  cache.insert(make_pair(1, 1),
+               tCache::clock_type::now() + chrono::milliseconds(10));
+  EXPECT_TRUE(cache.find(2) != cache.end());
+  EXPECT_TRUE(cache.find(1) != cache.end());
+  this_thread::sleep_for(chrono::milliseconds(20));
+  // Both are referenced, but 1 expired.
+  cache.insert(make_pair(3, 3));
+  EXPECT_TRUE(cache.find(2) != cache.end());
+  EXPECT_TRUE(cache.find(3) != cache.end());
+}
+
+TEST(ShardedLRUCache, Shards) {
+  ShardedLRUCache<int, int> cache(1000);
+  EXPECT_EQ(16, cache.num_shards());
+  EXPECT_EQ(1000, cache.max_size());
+  for (int i = 0; i < 10000; ++i) cache.insert(make_pair(i, i));
+  // Every shard is full.
+  EXPECT_EQ(1000, cache.size());
+  cache.clear();
+  EXPECT_TRUE(cache.empty());
+  for (int i = 0; i < 100; ++i) cache.insert(make_pair(i, i));
+  for (int i = 0; i < 100; ++i) {
+    auto it = cache.find(i);
+    ASSERT_TRUE(it != cache.end());
+    EXPECT_EQ(i, it->second);
+  }
+
+  // Fewer shards than entries.
+  EXPECT_EQ(4, (ShardedLRUCache<int, int>(5).num_shards()));
+  ShardedLRUCache<int, int> empty(0);
+  empty.insert(make_pair(1, 1));
+  EXPECT_TRUE(empty.empty());
+}
+
+TEST(ShardedLRUCache, Concurrent) {
+  ShardedLRUCache<int, int> cache(256);
+  vector<thread> threads;
+  for (int t = 0; t < 8; ++t) {
+    threads.push_back(thread([&cache, t]() {
+      for (int i = 0; i < 20000; ++i) {
+        int k = (i * 7 + t) % 1000;
+        auto it = cache.find(k);
+        if (it == cache.end()) cache.insert(make_pair(k, k));
+        else ASSERT_EQ(k, it->second);
+        if (i % 10 == 0) cache.erase(k + 1);
+      }
+    }));
+  }
+  for (thread& t : threads) t.join();
+  EXPECT_GE(256, cache.size());
+}
+
+}  // namespace test
+}  // namespace util
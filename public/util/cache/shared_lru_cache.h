@@ -9,6 +9,20 @@
 // reference counted. Even though an entry may be evicted from the cache, the
 // actual data may not be deallocated if there is an iterator or delegate to it.
 // Most interesting operations take O(1) assuming a good hash function.
+//
+// The eviction policy is a template parameter (see eviction_policy.h). It is
+// LRU by default; WTinyLFUPolicy keeps the frequently accessed entries
+// through scans of keys that are seen once:
+//   SharedLRUCache<string, int, hash<string>, equal_to<string>, WTinyLFUPolicy>
+//
+// The capacity is a number of entries, and optionally a number of bytes: with
+// set_max_bytes(), a weigher weighs each entry once when it is inserted, and
+// the policy evicts entries until both limits hold. With the serialization
+// library, the weigher defaults to the serialized size of the entries (see
+// weigher.h). The policies size their segments by
+// number of entries, so the entry limit should still be about right. The
+// entries and bytes are exported as gauges (see cache_gauges.h), named with
+// set_name().
 
 #ifndef _PUBLIC_UTIL_CACHE_SHARED_LRU_CACHE_H_
 #define _PUBLIC_UTIL_CACHE_SHARED_LRU_CACHE_H_
@@ -16,17 +30,22 @@
 #include <iostream>
 #include <algorithm>
 #include <chrono>
+#include <functional>
 #include <thread>
 #include <mutex>
 #include <memory>
-#include <list>
 #include <unordered_map>
+#include <vector>
 
+#include "util/cache/cache_gauges.h"
+#include "util/cache/eviction_policy.h"
 #ifdef R77_USE_SERIALIZER
+#include "util/cache/weigher.h"
 #include "util/serial/serializer.h"
 #endif
 
-template<class K, class V, class H = std::hash<K>, class EQ = std::equal_to<K>>
+template<class K, class V, class H = std::hash<K>, class EQ = std::equal_to<K>,
+         template<class, class> class P = LRUPolicy>
 class SharedLRUCache {
   // Convenience typedefs and structs.
   typedef std::shared_ptr<std::pair<K, V>> data_t;
@@ -36,8 +55,13 @@ class SharedLRUCache {
   struct data_eq {
     size_t operator()(const data_t& d1, const data_t& d2) const { return EQ()(d1->first, d2->first); }
   };
-  typedef std::list<std::pair<data_t, std::chrono::steady_clock::time_point>> list_t;
-  typedef std::unordered_map<data_t, typename list_t::iterator, data_hash, data_eq> map_t;
+  typedef P<data_t, data_hash> policy_t;
+  struct entry_t {
+    std::chrono::steady_clock::time_point expiration;
+    typename policy_t::handle_t handle;
+    size_t weight;
+  };
+  typedef std::unordered_map<data_t, entry_t, data_hash, data_eq> map_t;
   typedef std::lock_guard<std::recursive_mutex> lock_t;
 
  public:
@@ -45,6 +69,7 @@ class SharedLRUCache {
   typedef typename map_t::size_type         size_type;
   typedef typename data_t::element_type     value_type;
   typedef std::chrono::steady_clock         clock_type;
+  typedef std::function<size_t(const K&, const V&)> weigher_t;
 
   // Minimal iterator definition. We only support checking against end().
   struct iterator {
@@ -70,39 +95,78 @@ class SharedLRUCache {
     SharedLRUCache* cache_;
   };
 
-  SharedLRUCache(size_type limit) : max_size_(limit), expire_(false) {}
+  SharedLRUCache(size_type limit)
+    : max_size_(limit), policy_(limit), expire_(false) {}
   SharedLRUCache(size_type limit, clock_type::duration lifetime)
-    : max_size_(limit), lifetime_(lifetime), expire_(true) {}
+    : max_size_(limit), policy_(limit), lifetime_(lifetime), expire_(true) {}
   virtual ~SharedLRUCache() {}
 
-  // Copy constructor locks both mutexes and copies the remaining data.
-  SharedLRUCache(const SharedLRUCache& c) {
+  // Copy constructor locks both mutexes and copies the remaining data. The
+  // entries are inserted from the next victim of c to the entry c is most
+  // likely to keep: the copy keeps the LRU order, but not the frequencies of
+  // other policies.
+  SharedLRUCache(const SharedLRUCache& c)
+    : max_size_(c.max_size()), policy_(max_size_) {
     lock_t l(mutex_);
     lock_t cl(c.mutex_);
-    max_size_ = c.max_size_;
-    map_ = c.map_;
-    list_ = c.list_;
     expire_ = c.expire_;
     lifetime_ = c.lifetime_;
+    max_bytes_ = c.max_bytes_;
+    weigher_ = c.weigher_;
+    gauges_.set_max_bytes(max_bytes_);
+    std::vector<data_t> entries;
+    c.policy_.ForEach([&entries](const data_t& d) { entries.push_back(d); });
+    for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+      const entry_t& from = c.map_.find(*it)->second;
+      entry_t entry = {from.expiration, policy_.Insert(*it), from.weight};
+      map_.insert(make_pair(*it, entry));
+      bytes_ += entry.weight;
+      gauges_.Add(1, entry.weight);
+    }
+  }
+
+  // Bounds the total weight of the entries to max_bytes, on top of the number
+  // of entries, and weighs them with 'weigher' from now on. Entries already
+  // in the cache are weighed again. max_bytes = 0 weighs the entries without
+  // bounding their weight.
+  void set_max_bytes(size_t max_bytes, weigher_t weigher) {
+    lock_t l(mutex_);
+    max_bytes_ = max_bytes;
+    weigher_ = weigher;
+    gauges_.set_max_bytes(max_bytes_);
+    for (auto& p : map_) {
+      size_t weight = weigher_(p.first->first, p.first->second);
+      bytes_ += weight - p.second.weight;
+      gauges_.Add(0, int64_t(weight) - int64_t(p.second.weight));
+      p.second.weight = weight;
+    }
+    while (!map_.empty() && oversize()) Drop(map_.find(policy_.Evict()));
   }
 
+  #ifdef R77_USE_SERIALIZER
+  // Same, weighing the entries by their serialized size (see weigher.h). K and
+  // V must be serializable.
+  void set_max_bytes(size_t max_bytes) {
+    set_max_bytes(max_bytes, SerializedSize());
+  }
+  #endif
+
+  // Names the gauges of the cache.
+  void set_name(const std::string& name) { gauges_.set_name(name); }
+
   // Unlike unordered_map, insert variants return void for efficiency.
   void insert(const value_type& v, clock_type::time_point tp) {
     data_t data(new value_type(v));
     lock_t l(mutex_);
     auto map_it = map_.find(data);
-    if (map_it != map_.end()) {
-      list_.erase(map_it->second);
-      map_.erase(map_it);
-    }
-    list_.push_front(typename list_t::value_type(data, tp));
-    map_.insert(make_pair(data, list_.begin()));
+    if (map_it != map_.end()) Remove(map_it);
+    entry_t entry = {tp, policy_.Insert(data),
+                     weigher_ ? weigher_(data->first, data->second) : 0};
+    map_.insert(make_pair(data, entry));
+    bytes_ += entry.weight;
+    gauges_.Add(1, entry.weight);
 
-    while (oversize()) {
-      auto it = list_.rbegin();
-      map_.erase(it->first);
-      list_.pop_back();
-    }
+    while (!map_.empty() && oversize()) Drop(map_.find(policy_.Evict()));
   }
   void insert(const value_type& v) {
     insert(v, expire_ ? clock_type::now() + lifetime_ : clock_type::time_point());
@@ -113,8 +177,7 @@ class SharedLRUCache {
     lock_t l(mutex_);
     auto it = map_.find(key);
     if (it == map_.end()) return 0;
-    list_.erase(it->second);
-    map_.erase(it);
+    Remove(it);
     return 1;
   }
   void erase(const_iterator it) { erase(it->first); }
@@ -123,25 +186,33 @@ class SharedLRUCache {
   iterator find(const key_type& k, const V&& v = V()) const {
     data_t key(new value_type(k, v));
     lock_t l(mutex_);
+    policy_.Access(key);
     auto it = map_.find(key);
     if (it == map_.end()) return data_t();
-    if (expire_ && it->second->second < clock_type::now()) {
-      list_.erase(it->second);
-      map_.erase(it);
+    if (expire_ && it->second.expiration < clock_type::now()) {
+      Remove(it);
       return data_t();
     }
-    list_.push_front(*it->second);
-    list_.erase(it->second);
-    it->second = list_.begin();
+    policy_.Touch(it->second.handle);
     return it->first;
   }
 
   iterator  end()      const    { return iterator(data_t()); }
-  void      clear()             { lock_t l(mutex_); map_.clear(); list_.clear(); }
+  void      clear()             {
+    lock_t l(mutex_);
+    map_.clear();
+    policy_.Clear();
+    bytes_ = 0;
+    gauges_.Reset();
+  }
   void      rehash(size_type n) { lock_t l(mutex_); map_.rehash(n); }
   bool      empty()    const    { lock_t l(mutex_); return map_.empty(); }
   size_type size()     const    { lock_t l(mutex_); return map_.size(); }
   size_type max_size() const    { lock_t l(mutex_); return max_size_; }
+  // The total weight of the entries, 0 until set_max_bytes() is called.
+  size_t    bytes()    const    { lock_t l(mutex_); return bytes_; }
+  size_t    max_bytes() const   { lock_t l(mutex_); return max_bytes_; }
+  const CacheGauges& gauges() const { return gauges_; }
 
   delegate operator[](const key_type& k) {
     data_t data = find(k).data_;
@@ -149,34 +220,55 @@ class SharedLRUCache {
     return delegate(data, this);
   }
 
-  // Debug function to dump the contents of the cache.
+  // Debug function to dump the contents of the cache, from the entry most
+  // likely to be kept to the next victim.
   std::ostream& DumpContent(std::ostream& out = std::cout,
       const std::string& delim1 = " --> ", const std::string delim2 = "\n",
       const std::string& pre = "{\n", const std::string& post = "}\n") {
+    lock_t l(mutex_);
     out << pre;
-    for (auto it = list_.begin(); it != list_.end(); ++it) {
+    policy_.ForEach([&](const data_t& d) {
       #ifdef R77_USE_SERIALIZER
       // Requires serialization library.
-      out << serial::Serializer::ToJSON(it->first->first) << delim1
-          << serial::Serializer::ToJSON(it->first->second) << delim2;
+      out << serial::Serializer::ToJSON(d->first) << delim1
+          << serial::Serializer::ToJSON(d->second) << delim2;
       #else
       // Alternate way without serialization. May only work with basic types.
-      out << it->first->first << delim1 << it->first->second << delim2;
+      out << d->first << delim1 << d->second << delim2;
       #endif
-    }
+    });
     out << post;
     return out;
   }
 
  protected:
-  virtual bool oversize() { return size() > max_size_; }
+  virtual bool oversize() {
+    return size() > max_size_ || (max_bytes_ > 0 && bytes_ > max_bytes_);
+  }
+
+  // Mutex needs to be locked for the following methods.
+  void Remove(typename map_t::iterator it) const {
+    policy_.Erase(it->second.handle);
+    Drop(it);
+  }
+
+  // Erases an entry that the policy no longer has.
+  void Drop(typename map_t::iterator it) const {
+    bytes_ -= it->second.weight;
+    gauges_.Add(-1, -int64_t(it->second.weight));
+    map_.erase(it);
+  }
 
   size_type max_size_;
   mutable map_t map_;
-  mutable list_t list_;
+  mutable policy_t policy_;
   mutable std::recursive_mutex mutex_;
   mutable clock_type::duration lifetime_;
   mutable bool expire_;
+  size_t max_bytes_ = 0;
+  weigher_t weigher_;
+  mutable size_t bytes_ = 0;
+  mutable CacheGauges gauges_;
 };
 
 #endif  // _PUBLIC_UTIL_CACHE_SHARED_LRU_CACHE_H_
@@ -85,5 +85,43 @@ int main() {
     ASSERT(cache.find("3") != cache.end());
     ASSERT(cache.find("4") != cache.end());
   }
+
+  // Test the byte budget.
+  {
+    SharedLRUCache<int, string> cache(100);
+    cache.insert(make_pair(1, string(100, 'x')));
+    // Entries are not weighed without a budget.
+    ASSERT(cache.bytes() == 0);
+    // Each entry weighs 2 + 100 (characters) bytes.
+    cache.set_max_bytes(250, [](const int&, const string& s) {
+      return 2 + s.size();
+    });
+    ASSERT(cache.bytes() == 102);
+    cache.insert(make_pair(2, string(100, 'x')));
+    cache.insert(make_pair(3, string(100, 'x')));
+    // 1 was evicted to stay within the budget.
+    ASSERT(cache.size() == 2);
+    ASSERT(cache.bytes() == 204);
+    ASSERT(cache.find(1) == cache.end());
+    ASSERT(cache.gauges().entries() == 2);
+    ASSERT(cache.gauges().bytes() == 204);
+    ASSERT(cache.gauges().max_bytes() == 250);
+    cache.erase(2);
+    ASSERT(cache.bytes() == 102);
+    // An entry heavier than the budget is not kept.
+    cache.insert(make_pair(4, string(1000, 'x')));
+    ASSERT(cache.empty());
+    ASSERT(cache.bytes() == 0);
+    // Custom weigher.
+    cache.set_max_bytes(10, [](const int&, const string& s) { return s.size(); });
+    cache[1] = "12345";
+    cache[2] = "12345";
+    cache[3] = "1";
+    ASSERT(cache.size() == 2);
+    ASSERT(cache.bytes() == 6);
+    cache.clear();
+    ASSERT(cache.bytes() == 0);
+    ASSERT(cache.gauges().entries() == 0);
+  }
   return 0;
 }
@@ -0,0 +1,71 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Weighers of cache entries, for caches with a byte budget (see
+// SharedLRUCache::set_max_bytes(), GroupCache::Policy::max_bytes and
+// store::SimpleCacher::set_max_bytes()).
+//
+// SerializedSize weighs an entry as the size of the binary serialization of
+// its key and value. It is the default of GroupCache, and of the other caches
+// when they are built with the serialization library (R77_USE_SERIALIZER);
+// without it, they take an explicit weigher. Integers, floating point numbers
+// and strings are weighed from their serial type size
+// (util/serial/type_handlers/type_size.h) without being serialized; other
+// types are serialized once, when the entry is inserted. Structs that are
+// inserted often should get their own weigher.
+
+#ifndef _PUBLIC_UTIL_CACHE_WEIGHER_H_
+#define _PUBLIC_UTIL_CACHE_WEIGHER_H_
+
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+#include "util/serial/serializer.h"
+#include "util/serial/type_handlers/type_size.h"
+
+struct SerializedSize {
+  template<class K, class V>
+  size_t operator()(const K& k, const V& v) const { return Weigh(k) + Weigh(v); }
+
+  // Numbers: 4 or 8 bytes, or their varint encoding.
+  template<class T>
+  static typename std::enable_if<std::is_arithmetic<T>::value ||
+                                 std::is_enum<T>::value, size_t>::type
+  Weigh(const T& t) {
+    switch (serial::SizeByType<T>::value) {
+      case serial::kSerialTypeSizeFour: return 4;
+      case serial::kSerialTypeSizeEight: return 8;
+      default: return VarIntSize(t);
+    }
+  }
+
+  template<class T>
+  static size_t Weigh(const fixedint<T>&) { return sizeof(T); }
+
+  // Strings: their varint size, then their characters.
+  static size_t Weigh(const std::string& s) {
+    return VarIntSize(s.size()) + s.size();
+  }
+
+  template<class T>
+  static typename std::enable_if<!std::is_arithmetic<T>::value &&
+                                 !std::is_enum<T>::value, size_t>::type
+  Weigh(const T& t) {
+    return serial::Serializer::ToBinary(t).size();
+  }
+
+  // The size of the varint encoding of t: 7 bits per byte, after the zigzag
+  // encoding of signed numbers.
+  template<class T>
+  static size_t VarIntSize(T t) {
+    int64_t v = static_cast<int64_t>(t);
+    uint64_t n = std::is_signed<T>::value ?
+        (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63) :
+        static_cast<uint64_t>(t);
+    size_t size = 1;
+    for (; n >> 7; n >>= 7) ++size;
+    return size;
+  }
+};
+
+#endif  // _PUBLIC_UTIL_CACHE_WEIGHER_H_
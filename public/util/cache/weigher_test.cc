@@ -0,0 +1,64 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/cache/weigher.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/common.h"
+#include "test/cc/test_main.h"
+
+namespace util {
+namespace test {
+
+struct tRecord {
+  string name;
+  vector<int> values;
+  SERIALIZE(name*1 / values*2);
+};
+
+// The weight of t is the size of its binary serialization.
+template<class T>
+void ExpectSerializedSize(const T& t) {
+  EXPECT_EQ(serial::Serializer::ToBinary(t).size(), SerializedSize::Weigh(t));
+}
+
+TEST(SerializedSize, Numbers) {
+  ExpectSerializedSize(0);
+  ExpectSerializedSize(63);
+  ExpectSerializedSize(64);
+  ExpectSerializedSize(-64);
+  ExpectSerializedSize(-65);
+  ExpectSerializedSize(1 << 20);
+  ExpectSerializedSize(numeric_limits<int64_t>::min());
+  ExpectSerializedSize(numeric_limits<uint64_t>::max());
+  ExpectSerializedSize(true);
+  ExpectSerializedSize(1.5f);
+  ExpectSerializedSize(1.5);
+  ExpectSerializedSize(fixedint<uint32_t>(7));
+  ExpectSerializedSize(fixedint<uint64_t>(7));
+}
+
+TEST(SerializedSize, Strings) {
+  ExpectSerializedSize(string());
+  ExpectSerializedSize(string("price"));
+  ExpectSerializedSize(string(1000, 'x'));
+}
+
+TEST(SerializedSize, Serializable) {
+  ExpectSerializedSize(vector<int>{1, 2, 300});
+  ExpectSerializedSize(map<string, int>{{"a", 1}, {"b", 2}});
+  tRecord record;
+  record.name = "record";
+  record.values = {1, 2, 3};
+  ExpectSerializedSize(record);
+}
+
+TEST(SerializedSize, Entries) {
+  EXPECT_EQ(SerializedSize::Weigh(string("key")) + SerializedSize::Weigh(1000),
+            SerializedSize()(string("key"), 1000));
+}
+
+}  // namespace test
+}  // namespace util
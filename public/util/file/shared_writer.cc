@@ -3,15 +3,27 @@
 
 #include "util/file/shared_writer.h"
 
-FLAG_int(shared_writer_sleep_ms, 100, 
-         "the number of milliseconds to sleep while waiting for the next results");
+FLAG_int(shared_writer_sleep_ms, 100,
+         "the number of milliseconds between two flushes of the queued entries");
+FLAG_int(shared_writer_flush_threads, 1,
+         "the number of threads flushing the entries of all the shared writers");
 
 namespace util {
 
 SharedWriter::SharedWriter(const string& fn) : fn_(fn) {
   file_.open(fn, ios::out);
   ASSERT(file_.good()) << "Error unable to open for writing: " << fn;
-  thread(&util::SharedWriter::Flush, this).detach();
+  flush_timer_ = threading::Timer::Instance().RunEvery(
+      gFlag_shared_writer_sleep_ms, [this]() { ScheduleFlush(); });
+}
+
+SharedWriter::~SharedWriter() {
+  threading::Timer::Instance().Cancel(flush_timer_);
+  {
+    unique_lock<mutex> l(flush_mutex_);
+    flush_done_.wait(l, [this]() { return !flush_pending_; });
+  }
+  Flush();
 }
 
 void SharedWriter::Write(const string& entry) {
@@ -32,21 +44,37 @@ void SharedWriter::Reset() {
 // PRIVATE
 //
 
+threading::ThreadPool& SharedWriter::FlushPool() {
+  // Never destroyed, as writers may outlive static destruction.
+  static threading::ThreadPool* pool =
+      new threading::ThreadPool(max(1, gFlag_shared_writer_flush_threads));
+  return *pool;
+}
+
+void SharedWriter::ScheduleFlush() {
+  {
+    lock_guard<mutex> l(flush_mutex_);
+    if (flush_pending_) return;
+    flush_pending_ = true;
+  }
+  FlushPool().Add([this]() {
+    Flush();
+    lock_guard<mutex> l(flush_mutex_);
+    flush_pending_ = false;
+    flush_done_.notify_all();
+  });
+}
+
 void SharedWriter::Flush() {
-  while (true) {
-    vector<string> entries;
-    GetEntries(&entries);
-    if (entries.size() > 0) {
-      for (auto it = entries.begin(); it != entries.end(); ++it) {
-        file_ << *it << endl;
-      }
-      file_.flush();
-      ASSERT(!file_.fail()) << "Error flushing " << entries.size() 
-                            << " entries to file" << fn_;
-    } else {
-      this_thread::sleep_for(chrono::milliseconds(gFlag_shared_writer_sleep_ms));
-    }
+  vector<string> entries;
+  GetEntries(&entries);
+  if (entries.empty()) return;
+  for (auto it = entries.begin(); it != entries.end(); ++it) {
+    file_ << *it << '\n';
   }
+  file_.flush();
+  ASSERT(!file_.fail()) << "Error flushing " << entries.size()
+                        << " entries to file" << fn_;
 }
 
 void SharedWriter::GetEntries(vector<string> *entries) {
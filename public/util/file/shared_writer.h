@@ -3,6 +3,9 @@
 
 //
 // Simple threadsafe file writer that flushes files to disk
+// The entries are flushed every --shared_writer_sleep_ms on a pool of flusher
+// threads shared by all the writers, so writers do not cost a thread each. The
+// shared Timer only schedules the flushes, as it must not block on the disk.
 //
 
 #ifndef _PUBLIC_UTIL_FILE_SHARED_WRITER_H_
@@ -10,9 +13,12 @@
 
 #include "base/common.h"
 
+#include <condition_variable>
 #include <fstream>
 #include <mutex>
-#include <thread>
+
+#include "util/thread/thread_pool.h"
+#include "util/thread/timer.h"
 
 namespace util {
 
@@ -20,16 +26,21 @@ class SharedWriter {
  public:
   // @param fn - the path to the file
   SharedWriter(const string& fn);
-  ~SharedWriter() {}
+  // flushes the entries still queued
+  ~SharedWriter();
   // queues up the entry to be written
   // @threadsafe
   void Write(const string& entry);
   // flushes the queue and restarts the write at the beginning of the file
   void Reset();
  private:
-  // flush the entries to disk. runs the main flushing thread.
+  // the pool shared by all the writers to flush on
+  static threading::ThreadPool& FlushPool();
+  // adds a flush to the pool unless one is already pending. runs periodically
+  // on the timer.
+  void ScheduleFlush();
+  // flush the entries to disk. runs on the flush pool.
   // this is the ONLY place where things are written
-  // flushes after every write
   void Flush();
   // copy the current entries in the vector
   // @threadsafe
@@ -43,6 +54,12 @@ class SharedWriter {
   vector<string> entries_;
   // store the fn
   const string fn_;
+  // the periodic flush
+  threading::Timer::tTimerId flush_timer_ = 0;
+  // whether a flush is waiting or running on the pool
+  std::mutex flush_mutex_;
+  std::condition_variable flush_done_;
+  bool flush_pending_ = false;
 };
 
 } // namespace util
@@ -0,0 +1,45 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/network/admission_controller.h"
+
+FLAG_int(netserver_admission_target_ms, 50,
+         "Reject requests that have waited for a worker for longer than this "
+         "once the queue has not drained below it for an interval. "
+         "0 disables admission control.");
+
+FLAG_int(netserver_admission_interval_ms, 500,
+         "The interval over which the queue must drain below the admission "
+         "target. Requests that have waited longer are always rejected.");
+
+bool AdmissionController::Admit(int64_t sojourn_ms, int64_t now_ms) {
+  if (target_ms_ <= 0) return true;
+
+  // At the end of each interval, decide from its shortest wait whether the
+  // queue is standing. Only the thread that moves the interval on does so.
+  int64_t start = interval_start_ms_.load(memory_order_relaxed);
+  if (now_ms - start >= interval_ms_ &&
+      interval_start_ms_.compare_exchange_strong(start, now_ms,
+                                                 memory_order_relaxed)) {
+    int64_t min_sojourn = min_sojourn_ms_.exchange(
+        numeric_limits<int64_t>::max(), memory_order_relaxed);
+    // The queue drained if an interval went by without requests.
+    bool overloaded = now_ms - start < 2 * interval_ms_ &&
+        min_sojourn != numeric_limits<int64_t>::max() &&
+        min_sojourn > target_ms_;
+    if (overloaded != overloaded_.load(memory_order_relaxed)) {
+      VLOG(2) << (overloaded ? "Queue is standing" : "Queue has drained")
+              << ": shortest wait in the last interval " << min_sojourn
+              << "ms, target " << target_ms_ << "ms";
+      overloaded_.store(overloaded, memory_order_relaxed);
+    }
+  }
+
+  int64_t min_sojourn = min_sojourn_ms_.load(memory_order_relaxed);
+  while (sojourn_ms < min_sojourn &&
+         !min_sojourn_ms_.compare_exchange_weak(min_sojourn, sojourn_ms,
+                                                memory_order_relaxed)) {}
+
+  if (sojourn_ms <= (overloaded() ? target_ms_ : interval_ms_)) return true;
+  num_rejected_.fetch_add(1, memory_order_relaxed);
+  return false;
+}
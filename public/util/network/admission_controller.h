@@ -0,0 +1,58 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Admission control based on how long requests wait for a worker, in the
+// style of CoDel. A queue that empties now and then is absorbing a burst and
+// is left alone; a queue that never drains within an interval is a standing
+// queue, and requests that have waited longer than the target are rejected
+// right away instead of being processed for callers that have likely given up.
+//
+// While the queue drains, only requests that waited longer than a whole
+// interval are rejected.
+
+#ifndef _PUBLIC_UTIL_NETWORK_ADMISSION_CONTROLLER_H_
+#define _PUBLIC_UTIL_NETWORK_ADMISSION_CONTROLLER_H_
+
+#include <atomic>
+#include <limits>
+
+#include "base/common.h"
+
+extern int gFlag_netserver_admission_target_ms;
+extern int gFlag_netserver_admission_interval_ms;
+
+class AdmissionController {
+ public:
+  // 'target_ms' <= 0 admits every request.
+  AdmissionController(int target_ms = gFlag_netserver_admission_target_ms,
+                      int interval_ms = gFlag_netserver_admission_interval_ms)
+      : target_ms_(target_ms), interval_ms_(max(1, interval_ms)) {}
+
+  int target_ms() const { return target_ms_; }
+  int interval_ms() const { return interval_ms_; }
+
+  // Decides whether a request that has waited 'sojourn_ms' for a worker is
+  // processed. 'now_ms' is the current time in ms. Thread-safe.
+  bool Admit(int64_t sojourn_ms, int64_t now_ms);
+
+  // True if the queue has not drained below the target in the last interval.
+  bool overloaded() const { return overloaded_.load(memory_order_relaxed); }
+
+  uint64_t num_rejected() const {
+    return num_rejected_.load(memory_order_relaxed);
+  }
+
+ private:
+  const int target_ms_;
+  const int interval_ms_;
+
+  atomic<int64_t> interval_start_ms_{0};
+  // The shortest wait seen in the current interval.
+  atomic<int64_t> min_sojourn_ms_{numeric_limits<int64_t>::max()};
+  atomic<bool> overloaded_{false};
+  atomic<uint64_t> num_rejected_{0};
+
+  AdmissionController(const AdmissionController&) = delete;
+  AdmissionController& operator=(const AdmissionController&) = delete;
+};
+
+#endif  // _PUBLIC_UTIL_NETWORK_ADMISSION_CONTROLLER_H_
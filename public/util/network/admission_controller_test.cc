@@ -0,0 +1,55 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/network/admission_controller.h"
+
+#include "test/cc/test_main.h"
+
+namespace test {
+
+TEST(AdmissionController, Disabled) {
+  AdmissionController admission(0, 100);
+  EXPECT_TRUE(admission.Admit(1000000, 1000));
+  EXPECT_EQ(0, admission.num_rejected());
+}
+
+TEST(AdmissionController, BurstIsAbsorbed) {
+  AdmissionController admission(10, 100);
+  // The queue drains within every interval, so only waits longer than an
+  // interval are rejected.
+  for (int64_t now = 1000; now < 2000; now += 10) {
+    EXPECT_TRUE(admission.Admit(0, now));
+    EXPECT_TRUE(admission.Admit(50, now));
+  }
+  EXPECT_FALSE(admission.overloaded());
+  EXPECT_FALSE(admission.Admit(150, 2000));
+  EXPECT_EQ(1, admission.num_rejected());
+}
+
+TEST(AdmissionController, StandingQueue) {
+  AdmissionController admission(10, 100);
+  int64_t now = 1000;
+  EXPECT_TRUE(admission.Admit(0, now));
+  // The queue does not drain below the target for a whole interval.
+  for (now += 10; now <= 1200; now += 10) admission.Admit(20, now);
+  EXPECT_TRUE(admission.overloaded());
+  EXPECT_FALSE(admission.Admit(20, now));
+  EXPECT_TRUE(admission.Admit(5, now));
+
+  // Once the queue has drained, longer waits are admitted again.
+  for (int i = 0; i < 2; ++i, now += 100) admission.Admit(0, now);
+  EXPECT_FALSE(admission.overloaded());
+  EXPECT_TRUE(admission.Admit(20, now));
+}
+
+TEST(AdmissionController, IdleIntervalIsNotOverloaded) {
+  AdmissionController admission(10, 100);
+  admission.Admit(0, 1000);
+  for (int64_t now = 1100; now <= 1300; now += 10) admission.Admit(50, now);
+  EXPECT_TRUE(admission.overloaded());
+  // Nothing arrives for an interval.
+  admission.Admit(50, 1500);
+  admission.Admit(50, 1700);
+  EXPECT_FALSE(admission.overloaded());
+}
+
+}  // namespace test
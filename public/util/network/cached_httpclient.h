@@ -10,12 +10,15 @@
 #define _PUBLIC_UTIL_NETWORK_CACHED_HTTPCLIENT_H_
 
 #include <iomanip>
-#include <thread>
 #include "util/network/httpclient.h"
 #include "util/network/netclient.h"
 #include "util/serial/serializer.h"
-#include "util/cache/shared_lru_cache.h"
+#include "util/cache/sharded_lru_cache.h"
+#include "util/thread/counters.h"
 
+// Requests already in flight are not sent again: callers wait for the reply
+// of the first one, and are woken up as soon as it is in. poll_freq_ms is no
+// longer used and only kept for existing instantiations.
 template <class NetBase, int cache_lifetime_sec, int cache_size, int poll_freq_ms>
 class CachedHttpBase : public HttpBase<NetBase> {
   typedef std::lock_guard<std::recursive_mutex> lock_t;
@@ -28,7 +31,9 @@ class CachedHttpBase : public HttpBase<NetBase> {
     string message;
 
     // Let's use the same struct as the "hash functor" as well.
-    size_t operator()(const CacheKey& k) { return std::hash<string>()(ToBinary()); }
+    size_t operator()(const CacheKey& k) const {
+      return std::hash<string>()(k.ToBinary());
+    }
 
     // Operator == for unordered_map.
     bool operator==(const CacheKey& k) const {
@@ -39,8 +44,9 @@ class CachedHttpBase : public HttpBase<NetBase> {
   };
 
   struct CacheEntry {
-    CacheEntry() : ready(false), success(false), status_code(-1) {}
-    bool ready;
+    CacheEntry() : success(false), status_code(-1) {}
+    // Notified once the reply is in.
+    ::util::threading::Notification ready;
     bool success;
     int status_code;
     string reply;
@@ -51,24 +57,21 @@ class CachedHttpBase : public HttpBase<NetBase> {
                int *status_code, string *reply) {
     CacheKey key = { true, host, port, path, "" };
     bool own;
-    auto it = GetIterator(key, &own);
+    CacheValue entry = GetEntry(key, &own);
 
     if (!own) {
-      for(int i = 0; !it->second->ready && i < this->timeout_; i += poll_freq_ms) {
-        this_thread::sleep_for(chrono::milliseconds(poll_freq_ms));
-      }
-      if (!it->second->ready) return false;
-      *status_code = it->second->status_code;
-      *reply = it->second->reply;
+      if (!entry->ready.WaitWithTimeout(this->timeout_)) return false;
+      *status_code = entry->status_code;
+      *reply = entry->reply;
     }
     else {
-      it->second->success = HttpBase<NetBase>::HttpGet(host, port, path, status_code, reply, nullptr);
-      it->second->status_code = *status_code;
-      it->second->reply = *reply;
-      it->second->ready = true;
-      if (!it->second->success) Cache().erase(key);
+      entry->success = HttpBase<NetBase>::HttpGet(host, port, path, status_code, reply, nullptr);
+      entry->status_code = *status_code;
+      entry->reply = *reply;
+      if (!entry->success) EraseEntry(key);
+      entry->ready.Notify();
     }
-    return it->second->success;
+    return entry->success;
   }
 
 
@@ -76,26 +79,21 @@ class CachedHttpBase : public HttpBase<NetBase> {
                 const string& message, int *status_code, string *reply) {
     CacheKey key = { false, host, port, path, message };
     bool own;
-    auto it = GetIterator(key, &own);
+    CacheValue entry = GetEntry(key, &own);
 
     if (!own) {
-      for(int i = 0; !it->second->ready && i < this->timeout_; i += poll_freq_ms) {
-        this_thread::sleep_for(chrono::milliseconds(poll_freq_ms));
-      }
-      if (!it->second->ready) {
-        return false;
-      }
-      *status_code = it->second->status_code;
-      *reply = it->second->reply;
+      if (!entry->ready.WaitWithTimeout(this->timeout_)) return false;
+      *status_code = entry->status_code;
+      *reply = entry->reply;
     }
     else {
-      it->second->success = HttpBase<NetBase>::HttpPost(host, port, path, message, status_code, reply, nullptr);
-      it->second->status_code = *status_code;
-      it->second->reply = *reply;
-      it->second->ready = true;
-      if (!it->second->success) Cache().erase(key);
+      entry->success = HttpBase<NetBase>::HttpPost(host, port, path, message, status_code, reply, nullptr);
+      entry->status_code = *status_code;
+      entry->reply = *reply;
+      if (!entry->success) EraseEntry(key);
+      entry->ready.Notify();
     }
-    return it->second->success;
+    return entry->success;
   }
 
   static void DumpStats(ostream& out = cout) {
@@ -106,25 +104,39 @@ class CachedHttpBase : public HttpBase<NetBase> {
   }
 
  protected:
-   typename SharedLRUCache<CacheKey, CacheValue, CacheKey>::iterator
-      GetIterator(const CacheKey& key, bool* own) {
-    lock_t lock(mutex());
+  // Returns the entry for key. Sets own if the caller must make the request.
+  // The entry is returned by value: it may be evicted or erased while the
+  // caller waits for it.
+  CacheValue GetEntry(const CacheKey& key, bool* own) {
+    ++total();
+    // Hits only take the reader lock of one shard of the cache.
     auto it = Cache().find(key);
+    if (it != Cache().end()) {
+      *own = false;
+      return it->second;
+    }
+    // A miss must be looked up again under the lock, so that only one caller
+    // makes the request.
+    lock_t lock(mutex());
+    it = Cache().find(key);
     *own = it == Cache().end();
-    ++total();
     if (*own) {
       ++live();
       CacheValue value(new CacheEntry());
       Cache().insert(make_pair(key, value));
-      it = Cache().find(key);
-      ASSERT(it != Cache().end());
+      return value;
     }
-    return it;
+    return it->second;
+  }
+
+  void EraseEntry(const CacheKey& key) {
+    lock_t lock(mutex());
+    Cache().erase(key);
   }
 
   // Consider this as cache_. Trick for thread safe initialization of shared cache.
-  static SharedLRUCache<CacheKey, CacheValue, CacheKey>& Cache() {
-    static SharedLRUCache<CacheKey, CacheValue, CacheKey>
+  static ShardedLRUCache<CacheKey, CacheValue, CacheKey>& Cache() {
+    static ShardedLRUCache<CacheKey, CacheValue, CacheKey>
         cache_(cache_size, chrono::seconds(cache_lifetime_sec));
     return cache_;
   }
@@ -134,8 +146,8 @@ class CachedHttpBase : public HttpBase<NetBase> {
     return mutex;
   }
 
-  static long& live() { static long live = 0; return live; }
-  static long& total() { static long total = 0; return total; }
+  static std::atomic<long>& live() { static std::atomic<long> live(0); return live; }
+  static std::atomic<long>& total() { static std::atomic<long> total(0); return total; }
 
 };
 
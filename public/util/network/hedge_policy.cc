@@ -0,0 +1,42 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/network/hedge_policy.h"
+
+FLAG_double(rpc_forward_hedge_percentile, 0,
+            "Forwarded calls that take longer than this percentile of the "
+            "recent latency of the remote method are sent to a second "
+            "replica as well. 0 disables hedging.");
+
+FLAG_int(rpc_hedge_window, 10000,
+         "The number of replies in each of the windows the hedging delay is "
+         "computed from.");
+
+FLAG_int(rpc_hedge_min_replies, 100,
+         "Do not hedge calls to a method before this many replies from it "
+         "have been recorded.");
+
+FLAG_int(rpc_hedge_min_delay_ms, 1,
+         "The shortest time to wait before hedging a call.");
+
+namespace network {
+
+void HedgePolicy::Record(uint64_t latency_us) {
+  int current = current_.load(memory_order_relaxed);
+  windows_[current].Record(latency_us);
+  int64_t count = windows_[current].count();
+  if (count >= gFlag_rpc_hedge_window &&
+      current_.compare_exchange_strong(current, 1 - current))
+    windows_[1 - current].Clear();
+}
+
+int HedgePolicy::DelayMs() const {
+  if (percentile_ <= 0) return -1;
+  stats::LatencyHistogram recent;
+  recent.Merge(windows_[0]);
+  recent.Merge(windows_[1]);
+  if (static_cast<int64_t>(recent.count()) < gFlag_rpc_hedge_min_replies) return -1;
+  int delay_ms = (recent.Percentile(percentile_) + 999) / 1000;
+  return max(delay_ms, gFlag_rpc_hedge_min_delay_ms);
+}
+
+}  // namespace network
@@ -0,0 +1,47 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Hedged requests: if a call is slower than most, the same request is sent to
+// a second replica and the first reply wins. A HedgePolicy tracks the latency
+// of the replies from one remote method and decides when a call counts as
+// slow: after the given percentile of the recent latencies. With the 95th
+// percentile, about 5% of the calls are duplicated.
+
+#ifndef _PUBLIC_UTIL_NETWORK_HEDGE_POLICY_H_
+#define _PUBLIC_UTIL_NETWORK_HEDGE_POLICY_H_
+
+#include <atomic>
+
+#include "base/common.h"
+#include "util/stats/latency_histogram.h"
+
+extern double gFlag_rpc_forward_hedge_percentile;
+
+namespace network {
+
+class HedgePolicy {
+ public:
+  // 'percentile' is between 0 and 100. 0 disables hedging.
+  explicit HedgePolicy(double percentile) : percentile_(percentile) {}
+
+  double percentile() const { return percentile_; }
+
+  // Records the latency of a reply.
+  void Record(uint64_t latency_us);
+
+  // Returns how long to wait for the reply before sending the request to a
+  // second replica, or -1 to not hedge: hedging is disabled or too few
+  // replies have been recorded.
+  int DelayMs() const;
+
+ private:
+  const double percentile_;
+  // Replies are recorded in the current one of two windows, and the delay is
+  // computed from both. Once the current window is full, the older one is
+  // cleared and becomes current, so the delay follows changes in latency.
+  stats::LatencyHistogram windows_[2];
+  atomic<int> current_{0};
+};
+
+}  // namespace network
+
+#endif  // _PUBLIC_UTIL_NETWORK_HEDGE_POLICY_H_
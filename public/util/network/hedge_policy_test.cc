@@ -0,0 +1,42 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/network/hedge_policy.h"
+
+#include "test/cc/test_main.h"
+
+extern int gFlag_rpc_hedge_window;
+extern int gFlag_rpc_hedge_min_replies;
+
+namespace network {
+namespace test {
+
+TEST(HedgePolicyTest, Disabled) {
+  HedgePolicy policy(0);
+  for (int i = 0; i < 1000; ++i) policy.Record(1000);
+  EXPECT_EQ(-1, policy.DelayMs());
+}
+
+TEST(HedgePolicyTest, Percentile) {
+  HedgePolicy policy(90);
+  // Not enough replies yet.
+  for (int i = 1; i < gFlag_rpc_hedge_min_replies; ++i) policy.Record(1000);
+  EXPECT_EQ(-1, policy.DelayMs());
+
+  // 1ms to 100ms.
+  for (int i = 1; i <= 1000; ++i) policy.Record(i * 100);
+  EXPECT_NEAR(90, policy.DelayMs(), 90 / 16 + 1);
+}
+
+TEST(HedgePolicyTest, FollowsLatency) {
+  gFlag_rpc_hedge_window = 100;
+  HedgePolicy policy(50);
+  for (int i = 0; i < 100; ++i) policy.Record(100000);
+  EXPECT_EQ(100, policy.DelayMs());
+  // The old window is dropped once the new one is full.
+  for (int i = 0; i < 200; ++i) policy.Record(10000);
+  EXPECT_EQ(10, policy.DelayMs());
+  gFlag_rpc_hedge_window = 10000;
+}
+
+}  // namespace test
+}  // namespace network
@@ -0,0 +1,148 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/network/http_request_parser.h"
+
+#include <strings.h>
+
+namespace {
+
+inline bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+// Returns true if 'v' equals 's', ignoring case.
+inline bool EqualsIgnoreCase(const RequestView& v, const char* s) {
+  return v.size() == strlen(s) && strncasecmp(v.data(), s, v.size()) == 0;
+}
+
+// Returns true if 'v' contains 's', ignoring case.
+bool ContainsIgnoreCase(const RequestView& v, const char* s) {
+  size_t len = strlen(s);
+  for (size_t i = 0; i + len <= v.size(); ++i)
+    if (strncasecmp(v.data() + i, s, len) == 0) return true;
+  return false;
+}
+
+}  // namespace
+
+void HttpRequestParser::Reset() {
+  state_ = kRequestLine;
+  line_begin_ = 0;
+  scanned_ = 0;
+  is_post_ = false;
+  content_length_ = -1;
+  method_ = url_ = query_ = body_ = tField();
+  headers_.clear();
+}
+
+bool HttpRequestParser::Parse(const RequestView& r) {
+  while (state_ != kComplete) {
+    if (state_ == kBody) {
+      if (r.size() < request_size()) return false;
+      state_ = kComplete;
+      break;
+    }
+
+    size_t eol = r.find('\n', scanned_);
+    if (eol == RequestView::npos) {
+      scanned_ = r.size();
+      return false;
+    }
+    // The line without "\n" or "\r\n".
+    size_t begin = line_begin_;
+    size_t end = eol;
+    if (end > begin && r[end - 1] == '\r') --end;
+    line_begin_ = scanned_ = eol + 1;
+
+    if (state_ == kRequestLine) {
+      // Ignore empty lines before the request line.
+      if (begin == end) continue;
+      ParseRequestLine(r, begin, end);
+      state_ = kHeaders;
+    } else if (begin == end) {
+      // An empty line ends the header. Only POST requests have a body; like
+      // the rest of our servers, we expect at least one byte if the length is
+      // not given.
+      body_.begin = line_begin_;
+      if (is_post_)
+        body_.size = content_length_ >= 0 ? content_length_ : 1;
+      state_ = kBody;
+    } else {
+      ParseHeaderLine(r, begin, end);
+    }
+  }
+  return true;
+}
+
+void HttpRequestParser::ParseRequestLine(const RequestView& r,
+                                         size_t begin, size_t end) {
+  // METHOD SP URL[?QUERY] SP VERSION
+  size_t s = begin;
+  while (s < end && r[s] > ' ') s++;
+  method_.begin = begin;
+  method_.size = s - begin;
+  is_post_ = EqualsIgnoreCase(method_.In(r), "POST");
+
+  if (s < end) s++;
+  url_.begin = s;
+  while (s < end && r[s] > ' ' && r[s] != '?') s++;
+  url_.size = s - url_.begin;
+
+  if (s < end && r[s] == '?') {
+    s++;
+    query_.begin = s;
+    while (s < end && r[s] > ' ') s++;
+    query_.size = s - query_.begin;
+  } else {
+    query_.begin = s;
+    query_.size = 0;
+  }
+}
+
+void HttpRequestParser::ParseHeaderLine(const RequestView& r,
+                                        size_t begin, size_t end) {
+  // Name: value
+  size_t sep = r.substr(0, end).find(':', begin);
+  if (sep == RequestView::npos) return;
+
+  tHeader h;
+  size_t b = begin, e = sep;
+  while (b < e && IsSpace(r[b])) b++;
+  while (e > b && IsSpace(r[e - 1])) e--;
+  h.name.begin = b;
+  h.name.size = e - b;
+
+  b = sep + 1;
+  e = end;
+  while (b < e && IsSpace(r[b])) b++;
+  while (e > b && IsSpace(r[e - 1])) e--;
+  h.value.begin = b;
+  h.value.size = e - b;
+  headers_.push_back(h);
+
+  if (EqualsIgnoreCase(h.name.In(r), "Content-Length")) {
+    // The value is followed by the line terminator, so strtoll() stops within
+    // the data.
+    content_length_ = strtoll(r.data() + h.value.begin, nullptr, 10);
+    if (content_length_ < 0) content_length_ = 0;
+  }
+}
+
+RequestView HttpRequestParser::Header(const RequestView& r,
+                                      const char* name) const {
+  for (auto it = headers_.rbegin(); it != headers_.rend(); ++it)
+    if (EqualsIgnoreCase(it->name.In(r), name)) return it->value.In(r);
+  return RequestView();
+}
+
+bool HttpRequestParser::AcceptsGzip(const RequestView& r) const {
+  return ContainsIgnoreCase(Header(r, "Accept-Encoding"), "gzip");
+}
+
+bool HttpRequestParser::KeepAlive(const RequestView& r) const {
+  return ContainsIgnoreCase(Header(r, "Connection"), "keep-alive");
+}
+
+void HttpRequestParser::GetHeaders(
+    const RequestView& r, unordered_map<string, string>* header) const {
+  for (const tHeader& h : headers_)
+    (*header)[h.name.In(r).ToString()] = h.value.In(r).ToString();
+}
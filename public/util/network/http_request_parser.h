@@ -0,0 +1,109 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Resumable parser for HTTP/1.x requests.
+//
+// The parser is fed the data received on a connection as it grows, and picks
+// up where it stopped on the previous call: every byte of the header is
+// looked at once, however many reads the request takes to arrive. Parsed
+// fields are kept as offsets into the request rather than as strings, so they
+// stay valid when the receive buffer moves its data, and nothing is copied
+// unless the caller asks for a string.
+//
+// After a request is complete, Reset() prepares the parser for the next
+// request on a keep-alive connection. The caller removes the request from the
+// front of its buffer, so pipelined requests are parsed one after another.
+
+#ifndef _PUBLIC_UTIL_NETWORK_HTTP_REQUEST_PARSER_H_
+#define _PUBLIC_UTIL_NETWORK_HTTP_REQUEST_PARSER_H_
+
+#include <unordered_map>
+#include <vector>
+
+#include "base/common.h"
+#include "util/network/request_buffer.h"
+
+class HttpRequestParser : public RequestParserState {
+ public:
+  // A part of the request, as an offset range into the request data.
+  struct tField {
+    size_t begin = 0;
+    size_t size = 0;
+
+    RequestView In(const RequestView& r) const {
+      return r.substr(begin, size);
+    }
+  };
+
+  struct tHeader {
+    tField name, value;
+  };
+
+  HttpRequestParser() {}
+
+  virtual void Reset();
+
+  // Parses the request at the start of 'r' and returns true once it is
+  // complete. 'r' must start with the data passed to the previous calls
+  // since Reset(), usually followed by more.
+  bool Parse(const RequestView& r);
+
+  bool header_complete() const { return state_ >= kBody; }
+  bool complete() const { return state_ == kComplete; }
+
+  //
+  // The following are valid once the header is complete.
+  //
+
+  // Size of the whole request, including the body.
+  size_t request_size() const { return body_.begin + body_.size; }
+
+  bool is_post() const { return is_post_; }
+  const tField& method() const { return method_; }
+  // The path of the URL, without the query string.
+  const tField& url() const { return url_; }
+  // The query string of the URL, without the '?'.
+  const tField& query() const { return query_; }
+  const tField& body() const { return body_; }
+  const vector<tHeader>& headers() const { return headers_; }
+
+  // Returns the value of the header with the given (case-insensitive) name,
+  // or an empty view. If the header is repeated, the last value counts.
+  RequestView Header(const RequestView& r, const char* name) const;
+
+  // Returns the CGI arguments: the body of a POST request, or the query
+  // string of any other request.
+  RequestView CgiArguments(const RequestView& r) const {
+    return (is_post_ ? body_ : query_).In(r);
+  }
+
+  // does the client accept gzip encoding?
+  bool AcceptsGzip(const RequestView& r) const;
+
+  // does the client request a keep-alive connection?
+  bool KeepAlive(const RequestView& r) const;
+
+  // Copies all the headers into 'header'.
+  void GetHeaders(const RequestView& r,
+                  unordered_map<string, string>* header) const;
+
+ private:
+  enum State { kRequestLine, kHeaders, kBody, kComplete };
+
+  // Parse the line [begin, end) of 'r', without the line terminator.
+  void ParseRequestLine(const RequestView& r, size_t begin, size_t end);
+  void ParseHeaderLine(const RequestView& r, size_t begin, size_t end);
+
+  State state_ = kRequestLine;
+  // Start of the line being parsed.
+  size_t line_begin_ = 0;
+  // Where to resume the search for the end of the line.
+  size_t scanned_ = 0;
+
+  bool is_post_ = false;
+  // Content-Length, or -1 if the header is missing.
+  long long content_length_ = -1;
+  tField method_, url_, query_, body_;
+  vector<tHeader> headers_;
+};
+
+#endif  // _PUBLIC_UTIL_NETWORK_HTTP_REQUEST_PARSER_H_
@@ -0,0 +1,87 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/network/http_request_parser.h"
+
+#include "test/cc/test_main.h"
+
+namespace test {
+
+TEST(HttpRequestParserTest, Get) {
+  string r = "GET /search?q=hotels&d=1 HTTP/1.1\r\nHost: localhost\r\n"
+             "Accept-Encoding: deflate, gzip\r\nConnection: Keep-Alive\r\n\r\n";
+  HttpRequestParser parser;
+  EXPECT_TRUE(parser.Parse(r));
+  EXPECT_EQ(r.size(), parser.request_size());
+  EXPECT_FALSE(parser.is_post());
+  EXPECT_EQ("GET", parser.method().In(r).ToString());
+  EXPECT_EQ("/search", parser.url().In(r).ToString());
+  EXPECT_EQ("q=hotels&d=1", parser.CgiArguments(r).ToString());
+  EXPECT_EQ("localhost", parser.Header(r, "host").ToString());
+  EXPECT_EQ("", parser.Header(r, "Cookie").ToString());
+  EXPECT_TRUE(parser.AcceptsGzip(r));
+  EXPECT_TRUE(parser.KeepAlive(r));
+  EXPECT_EQ(3, parser.headers().size());
+
+  unordered_map<string, string> headers;
+  parser.GetHeaders(r, &headers);
+  EXPECT_EQ("localhost", headers["Host"]);
+}
+
+TEST(HttpRequestParserTest, PostByteByByte) {
+  string r = "POST /_rpc HTTP/1.1\nContent-Length: 11\nCookie: a=b\n\n"
+             "TESTCONTENT";
+  HttpRequestParser parser;
+  for (size_t len = 0; len < r.size(); ++len) {
+    EXPECT_FALSE(parser.Parse(RequestView(r.data(), len))) << len;
+    // The header is complete once the empty line is in.
+    EXPECT_EQ(len >= r.find("TEST"), parser.header_complete()) << len;
+  }
+  // The data may have moved between calls.
+  string copy = r;
+  EXPECT_TRUE(parser.Parse(copy));
+  EXPECT_TRUE(parser.is_post());
+  EXPECT_EQ(r.size(), parser.request_size());
+  EXPECT_EQ("TESTCONTENT", parser.CgiArguments(copy).ToString());
+  EXPECT_EQ("a=b", parser.Header(copy, "Cookie").ToString());
+  EXPECT_FALSE(parser.KeepAlive(copy));
+}
+
+TEST(HttpRequestParserTest, PostWithoutContentLength) {
+  // At least one byte of content is expected.
+  string r = "POST /x HTTP/1.0\r\n\r\n";
+  HttpRequestParser parser;
+  EXPECT_FALSE(parser.Parse(r));
+  EXPECT_TRUE(parser.Parse(r + "a"));
+  EXPECT_EQ(r.size() + 1, parser.request_size());
+}
+
+TEST(HttpRequestParserTest, Pipelined) {
+  const string first = "GET /_health HTTP/1.1\r\n\r\n";
+  const string second = "POST /q HTTP/1.1\r\nContent-Length: 3\r\n\r\nq=1";
+  const string third = "GET /x?y HTTP/1.1\n\n";
+  string r = first + second + third;
+
+  HttpRequestParser parser;
+  RequestView v(r);
+  vector<string> urls;
+  while (!v.empty() && parser.Parse(v)) {
+    urls.push_back(parser.url().In(v).ToString());
+    v = v.substr(parser.request_size());
+    parser.Reset();
+  }
+  EXPECT_TRUE(v.empty());
+  EXPECT_EQ((vector<string>{"/_health", "/q", "/x"}), urls);
+}
+
+TEST(HttpRequestParserTest, Malformed) {
+  // Leading empty lines are skipped, lines without ':' ignored.
+  string r = "\r\nGET\r\nbogus header\r\nX: 1\r\n\r\n";
+  HttpRequestParser parser;
+  EXPECT_TRUE(parser.Parse(r));
+  EXPECT_EQ(r.size(), parser.request_size());
+  EXPECT_EQ("", parser.url().In(r).ToString());
+  EXPECT_EQ(1, parser.headers().size());
+  EXPECT_EQ("1", parser.Header(r, "X").ToString());
+}
+
+}  // namespace test
@@ -3,11 +3,23 @@
 
 #include "base/args/args.h"
 #include "util/network/method/server_method.h"
+#include "util/cache/cache_gauges.h"
 #include "util/counter/counter_base.h"
+#include "util/thread/thread_pool_stats.h"
 
 namespace network {
 namespace {
 
+// Counters named "thread_pool.<name>" are the stats of the thread pool <name>
+// (see util/thread/thread_pool_stats.h). They are cumulative: the interval is
+// ignored.
+const char kThreadPoolPrefix[] = "thread_pool.";
+
+// Counters named "cache.<name>" are the gauges of the cache <name> (see
+// util/cache/cache_gauges.h). They are current values: the interval is
+// ignored.
+const char kCachePrefix[] = "cache.";
+
 struct tEventReq {
   string counter_name;
   uint64_t interval = 0;  // how far back (in microseconds)
@@ -31,7 +43,29 @@ class GetCounters : public network::ServerMethod {
 
     for (const tEventReq& event_req : req) {
       tEventReply event_reply;
-      if (find(all_events.begin(), all_events.end(), event_req.counter_name) != all_events.end()) {
+      util::threading::ThreadPoolStats::tSnapshot pool_stats;
+      CacheGauges::tSnapshot cache_gauges;
+      if (event_req.counter_name.compare(0, sizeof(kThreadPoolPrefix) - 1,
+                                         kThreadPoolPrefix) == 0 &&
+          util::threading::ThreadPoolStats::SnapshotByName(
+              event_req.counter_name.substr(sizeof(kThreadPoolPrefix) - 1),
+              &pool_stats)) {
+        for (const string& metric_name : event_req.metrics) {
+          double value = 0;
+          pool_stats.GetMetric(metric_name, &value);
+          event_reply.metric_results.push_back(static_cast<float>(value));
+        }
+      } else if (event_req.counter_name.compare(0, sizeof(kCachePrefix) - 1,
+                                                kCachePrefix) == 0 &&
+                 CacheGauges::SnapshotByName(
+                     event_req.counter_name.substr(sizeof(kCachePrefix) - 1),
+                     &cache_gauges)) {
+        for (const string& metric_name : event_req.metrics) {
+          double value = 0;
+          cache_gauges.GetMetric(metric_name, &value);
+          event_reply.metric_results.push_back(static_cast<float>(value));
+        }
+      } else if (find(all_events.begin(), all_events.end(), event_req.counter_name) != all_events.end()) {
         counter::CounterBase::mutable_shared_proxy counter =
             counter::CounterBase::make_shared(event_req.counter_name);
         counter::CounterBase::MetricsMap m = counter->GetMetricsForInterval(event_req.interval,
@@ -0,0 +1,6 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/network/method/response_cache.h"
+
+FLAG_int(response_cache_shards, 16,
+         "The number of shards of the reply cache of each server method.");
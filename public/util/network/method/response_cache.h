@@ -0,0 +1,154 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// A cache of the replies of a server method, for methods whose output depends
+// only on their input. Replies are kept for a limited time in an LRU cache
+// split into shards, so concurrent calls rarely wait on the same lock.
+//
+// Concurrent calls with the same key are coalesced: the first one computes
+// the reply and the others wait for it, so a popular input that is not in the
+// cache is computed only once.
+
+#ifndef _PUBLIC_UTIL_NETWORK_METHOD_RESPONSE_CACHE_H_
+#define _PUBLIC_UTIL_NETWORK_METHOD_RESPONSE_CACHE_H_
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "base/common.h"
+#include "util/cache/shared_lru_cache.h"
+
+extern int gFlag_response_cache_shards;
+
+namespace network {
+
+struct tResponseCacheStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  // Calls that waited for a concurrent call with the same key.
+  uint64_t coalesced = 0;
+};
+
+template<class tValue>
+class ResponseCache {
+ public:
+  // Computes the value of a key. Returns an error message, or "" on success.
+  // Errors are not cached.
+  typedef function<string(shared_ptr<const tValue>*)> tComputeFunc;
+
+  ResponseCache(int max_entries, int ttl_ms,
+                int num_shards = gFlag_response_cache_shards) {
+    num_shards = max(1, num_shards);
+    for (int i = 0; i < num_shards; ++i) {
+      shards_.push_back(unique_ptr<Shard>(new Shard(
+          max(1, max_entries / num_shards), chrono::milliseconds(ttl_ms))));
+    }
+  }
+
+  // Tells whether a computed value may be cached.
+  typedef function<bool(const tValue&)> tCacheablePredicate;
+
+  // Sets 'value' to the cached value of 'key', or to the value computed by
+  // 'compute' if there is none. Returns the error from 'compute', if any.
+  // Computed values are not cached if 'cacheable' returns false for them, but
+  // concurrent calls with the same key still get them.
+  string Get(const string& key, const tComputeFunc& compute,
+             shared_ptr<const tValue>* value,
+             const tCacheablePredicate& cacheable = nullptr) {
+    Shard& shard = *shards_[std::hash<string>()(key) % shards_.size()];
+    if (Find(shard, key, value)) {
+      ++hits_;
+      return "";
+    }
+
+    shared_ptr<tFlight> flight;
+    bool leader = false;
+    {
+      lock_guard<mutex> l(shard.m);
+      shared_ptr<tFlight>& f = shard.in_flight[key];
+      if (f == nullptr) {
+        f.reset(new tFlight);
+        leader = true;
+      }
+      flight = f;
+    }
+    if (!leader) {
+      ++coalesced_;
+      flight->done.wait();
+      *value = flight->value;
+      return flight->error;
+    }
+
+    // The previous leader may have finished since we looked.
+    if (Find(shard, key, &flight->value)) {
+      ++hits_;
+    } else {
+      ++misses_;
+      flight->error = compute(&flight->value);
+      if (flight->error.empty() &&
+          (cacheable == nullptr || cacheable(*flight->value)))
+        shard.cache.insert(make_pair(key, flight->value));
+    }
+    {
+      lock_guard<mutex> l(shard.m);
+      shard.in_flight.erase(key);
+    }
+    flight->ready.set_value();
+    *value = flight->value;
+    return flight->error;
+  }
+
+  tResponseCacheStats stats() const {
+    tResponseCacheStats stats;
+    stats.hits = hits_.load(memory_order_relaxed);
+    stats.misses = misses_.load(memory_order_relaxed);
+    stats.coalesced = coalesced_.load(memory_order_relaxed);
+    return stats;
+  }
+
+  size_t size() const {
+    size_t size = 0;
+    for (const unique_ptr<Shard>& shard : shards_) size += shard->cache.size();
+    return size;
+  }
+
+ private:
+  // A value being computed.
+  struct tFlight {
+    tFlight() : done(ready.get_future().share()) {}
+    promise<void> ready;
+    shared_future<void> done;
+    string error;
+    shared_ptr<const tValue> value;
+  };
+
+  struct Shard {
+    Shard(int max_entries, chrono::milliseconds ttl)
+        : cache(max_entries, ttl) {}
+    SharedLRUCache<string, shared_ptr<const tValue>> cache;
+    mutex m;  // guards in_flight
+    unordered_map<string, shared_ptr<tFlight>> in_flight;
+  };
+
+  static bool Find(const Shard& shard, const string& key,
+                   shared_ptr<const tValue>* value) {
+    auto it = shard.cache.find(key);
+    if (it == shard.cache.end()) return false;
+    *value = it->second;
+    return true;
+  }
+
+  vector<unique_ptr<Shard>> shards_;
+  atomic<uint64_t> hits_{0};
+  atomic<uint64_t> misses_{0};
+  atomic<uint64_t> coalesced_{0};
+};
+
+}  // namespace network
+
+#endif  // _PUBLIC_UTIL_NETWORK_METHOD_RESPONSE_CACHE_H_
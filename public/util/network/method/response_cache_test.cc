@@ -0,0 +1,118 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/network/method/response_cache.h"
+
+#include <thread>
+
+#include "test/cc/test_main.h"
+
+namespace network {
+namespace test {
+
+class ResponseCacheTest : public testing::Test {
+ protected:
+  // Returns the length of the key, and counts the calls.
+  ResponseCache<int>::tComputeFunc Length(const string& key) {
+    return [this, key](shared_ptr<const int>* value) {
+      ++num_computed_;
+      if (key == "error") return string("failed");
+      value->reset(new int(key.size()));
+      return string();
+    };
+  }
+
+  atomic<int> num_computed_{0};
+};
+
+TEST_F(ResponseCacheTest, Get) {
+  ResponseCache<int> cache(100, 60000, 4);
+  shared_ptr<const int> value;
+  EXPECT_EQ("", cache.Get("abc", Length("abc"), &value));
+  EXPECT_EQ(3, *value);
+  EXPECT_EQ("", cache.Get("abc", Length("abc"), &value));
+  EXPECT_EQ(3, *value);
+  EXPECT_EQ("", cache.Get("abcd", Length("abcd"), &value));
+  EXPECT_EQ(4, *value);
+  EXPECT_EQ(2, num_computed_);
+  EXPECT_EQ(2, cache.size());
+
+  tResponseCacheStats stats = cache.stats();
+  EXPECT_EQ(1, stats.hits);
+  EXPECT_EQ(2, stats.misses);
+  EXPECT_EQ(0, stats.coalesced);
+}
+
+TEST_F(ResponseCacheTest, ErrorsAreNotCached) {
+  ResponseCache<int> cache(100, 60000, 4);
+  shared_ptr<const int> value;
+  EXPECT_EQ("failed", cache.Get("error", Length("error"), &value));
+  EXPECT_EQ("failed", cache.Get("error", Length("error"), &value));
+  EXPECT_EQ(2, num_computed_);
+  EXPECT_EQ(0, cache.size());
+}
+
+TEST_F(ResponseCacheTest, UncacheableValues) {
+  ResponseCache<int> cache(100, 60000, 4);
+  shared_ptr<const int> value;
+  auto short_keys = [](const int& length) { return length < 4; };
+  EXPECT_EQ("", cache.Get("abcd", Length("abcd"), &value, short_keys));
+  EXPECT_EQ(4, *value);
+  EXPECT_EQ("", cache.Get("abcd", Length("abcd"), &value, short_keys));
+  EXPECT_EQ("", cache.Get("abc", Length("abc"), &value, short_keys));
+  EXPECT_EQ("", cache.Get("abc", Length("abc"), &value, short_keys));
+  EXPECT_EQ(3, num_computed_);
+  EXPECT_EQ(1, cache.size());
+}
+
+TEST_F(ResponseCacheTest, Expires) {
+  ResponseCache<int> cache(100, 10, 1);
+  shared_ptr<const int> value;
+  cache.Get("abc", Length("abc"), &value);
+  this_thread::sleep_for(chrono::milliseconds(20));
+  cache.Get("abc", Length("abc"), &value);
+  EXPECT_EQ(2, num_computed_);
+}
+
+TEST_F(ResponseCacheTest, SizeBound) {
+  ResponseCache<int> cache(10, 60000, 2);
+  shared_ptr<const int> value;
+  for (int i = 0; i < 100; ++i) {
+    string key = to_string(i);
+    cache.Get(key, Length(key), &value);
+  }
+  EXPECT_LE(cache.size(), 10);
+}
+
+TEST_F(ResponseCacheTest, CoalescesConcurrentCalls) {
+  ResponseCache<int> cache(100, 60000, 4);
+  promise<void> release;
+  shared_future<void> released = release.get_future().share();
+  auto slow = [this, released](shared_ptr<const int>* value) {
+    ++num_computed_;
+    released.wait();
+    value->reset(new int(42));
+    return string();
+  };
+
+  const int kNumThreads = 8;
+  vector<thread> threads;
+  atomic<int> num_ok(0);
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.push_back(thread([&]() {
+      shared_ptr<const int> value;
+      if (cache.Get("key", slow, &value).empty() && *value == 42) ++num_ok;
+    }));
+  }
+  // Let all the threads reach the cache before the value is computed.
+  while (cache.stats().misses + cache.stats().coalesced < kNumThreads)
+    this_thread::sleep_for(chrono::milliseconds(1));
+  release.set_value();
+  for (thread& t : threads) t.join();
+
+  EXPECT_EQ(kNumThreads, num_ok);
+  EXPECT_EQ(1, num_computed_);
+  EXPECT_EQ(kNumThreads - 1, cache.stats().coalesced);
+}
+
+}  // namespace test
+}  // namespace network
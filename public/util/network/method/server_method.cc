@@ -39,6 +39,7 @@ void ServerMethod::Cascade(const ServerMethod* caller) {
   set_arg_map(caller->arg_map());
   set_http_header(caller->http_header());
   set_internal_call(caller->internal_call());
+  set_deadline_ms(caller->deadline_ms());
 }
 
 void ServerMethod::GetCallerIP(string* s_IPaddr, in_addr_t* l_IPaddr) const {
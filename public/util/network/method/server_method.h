@@ -13,6 +13,7 @@
 
 #include "base/common.h"
 #include "util/network/method/server_method_handler.h"
+#include "util/time/timestamp.h"
 
 struct tConnectionInfo;
 extern string gFlag_session_cookie_name;
@@ -130,10 +131,31 @@ class ServerMethod {
   // Returns true if the method allows empty request. i.e. no 'q' CGI param.
   virtual bool AllowEmptyRequest() const { return false; }
 
+  // Returns how long the replies of the method may be served from a cache,
+  // in ms. Only methods whose output depends on nothing but their input may
+  // be cached. 0 (default) disables caching.
+  virtual int ResponseCacheTtlMs() const { return 0; }
+
+  // Returns the number of replies the cache of the method holds.
+  virtual int ResponseCacheSize() const { return 10000; }
+
   // Check wheter this server method has been called internally or is from
   // an actual user.
   bool internal_call() const { return internal_call_; }
 
+  // The time by which the caller needs the reply, in ms since the epoch (0 if
+  // it has not set a deadline). Calls to other servers are bounded by it.
+  uint64_t deadline_ms() const { return deadline_ms_; }
+  void set_deadline_ms(uint64_t deadline_ms) { deadline_ms_ = deadline_ms; }
+
+  // Returns the ms left until the deadline (0 if it has passed), or -1 if
+  // there is no deadline.
+  int RemainingTimeMs() const {
+    if (deadline_ms_ == 0) return -1;
+    uint64_t now = util::Timestamp::Now<chrono::milliseconds>();
+    return now < deadline_ms_ ? deadline_ms_ - now : 0;
+  }
+
   // ----------------------------------------------------------------
   // methods below are for RPCServer internal use only
   // ----------------------------------------------------------------
@@ -191,6 +213,7 @@ class ServerMethod {
   bool has_validator_ = true;
   // Determines if the call is made internally or is coming from a real user.
   bool internal_call_ = true;
+  uint64_t deadline_ms_ = 0;
 
  private:
   // compute a session cookie for the user
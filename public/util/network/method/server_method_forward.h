@@ -8,6 +8,7 @@
 #define _PUBLIC_UTIL_NETWORK_METHOD_SERVER_METHOD_FORWARD_H_
 
 #include "base/common.h"
+#include "util/network/hedge_policy.h"
 #include "util/network/rpcclient_util.h"
 #include "util/network/method/server_method.h"
 #include "util/network/method/server_method_forward_collection.h"
@@ -16,33 +17,73 @@
 namespace network {
 
 // Template to forward an RPC call to another server.
-// The default timeout is 10 seconds.
+// The default timeout is 10 seconds. The call is bounded by the deadline of the
+// request being served, if it has one, and the remaining time is passed on to
+// the remote server.
+// If hedge_percentile is positive, calls that have not returned after that
+// percentile of the recent latencies of the remote method are sent to a
+// second replica as well; the first reply wins. -1 uses
+// --rpc_forward_hedge_percentile. Only hedge methods that can safely run
+// twice.
 template<class tInput, class tOutput, const char* server_type,
-    const char* remote_method, int timeout = 10>
+    const char* remote_method, int timeout = 10, int hedge_percentile = -1>
 class ServerMethodForward : public ServerMethod {
  public:
   string operator() (const tInput& req, tOutput* result) {
     static_assert(server_type != nullptr, "server_type cannot be null");
     static_assert(remote_method != nullptr, "server_type cannot be null");
+    int timeout_ms = TimeoutMs();
+    if (timeout_ms == 0) return "Deadline exceeded before forwarding";
+
     // forward the request to remote server
+    tServerRequestMessage request(remote_method,
+                                  serial::Serializer::ToBinary(req),
+                                  input_cookie(), referrer());
     string output_cookie;
-    string error_msg = MakeRPCCall(server_type, remote_method,
-                                   req, input_cookie(), referrer(),
-                                   result, &output_cookie, timeout * 1000);
+    string error_msg = MakeHedgedRPCCall(server_type, request, result,
+                                         &output_cookie, timeout_ms,
+                                         &Hedging());
     add_output_cookie(output_cookie);  // pass the output cookie back
     return error_msg;
   }
+
+  // Starts forwarding the request without waiting for the reply, so a caller
+  // can fan out to several servers at once. The caller passes the output
+  // cookie of the result back if it needs to.
+  future<RPCChannel::tResult<tOutput>> CallAsync(const tInput& req) const {
+    return MakeRPCCallAsync<tInput, tOutput>(server_type, remote_method, req,
+                                             input_cookie(), referrer(),
+                                             max(TimeoutMs(), 1));
+  }
+
+  static double HedgePercentile() {
+    return hedge_percentile >= 0 ? hedge_percentile :
+        gFlag_rpc_forward_hedge_percentile;
+  }
+
+ private:
+  // The timeout for the remote call, in ms. 0 if the deadline has passed.
+  int TimeoutMs() const {
+    int remaining = RemainingTimeMs();
+    return remaining < 0 ? timeout * 1000 : min(timeout * 1000, remaining);
+  }
+
+  // Shared by all calls to the remote method.
+  static HedgePolicy& Hedging() {
+    static HedgePolicy policy(HedgePercentile());
+    return policy;
+  }
 };
 
 // Structure to register a new forwarded server method with the server.
 template<class tInput, class tOutput, const char* server_type,
-    const char* remote_method, int timeout = 10>
+    const char* remote_method, int timeout = 10, int hedge_percentile = -1>
 struct ServerMethodForwardRegister {
   ServerMethodForwardRegister(const string& server_name,
                               const string& local_method,
                               const tInput& sample_input) {
     typedef ServerMethodForward<tInput, tOutput, server_type, remote_method,
-        timeout> SMForward;
+        timeout, hedge_percentile> SMForward;
     ServerMethodRegister<tInput, tOutput, SMForward> reg(
         server_name, local_method, sample_input);
 
@@ -50,7 +91,8 @@ struct ServerMethodForwardRegister {
     // the lifetime of the binary.
     ServerMethodForwardCollection::shared_proxy proxy =
         ServerMethodForwardCollection::GetCollectionForServer(server_name);
-    proxy->Register(local_method, {server_type, remote_method, timeout});
+    proxy->Register(local_method, {server_type, remote_method, timeout,
+                                   SMForward::HedgePercentile()});
     // Pin this proxy to ensure it is never destroyed.
     ServerMethodForwardCollection::pin(proxy);
   }
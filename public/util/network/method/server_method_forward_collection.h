@@ -26,6 +26,9 @@ class ServerMethodForwardCollection :
     string server_type;
     string remote_method;
     int timeout;
+    // Calls still waiting for a reply after this percentile of the latency
+    // of the method are sent to a second replica as well. 0: never.
+    double hedge_percentile;
   };
 
   typedef unordered_map<string, Data,
@@ -17,10 +17,12 @@
 #include "base/common.h"
 #include "util/network/netserver.h"
 #include "util/network/rpcclient.h"
+#include "util/network/method/response_cache.h"
 #include "util/factory/factory.h"
 #include "util/hash/hash_util.h"
 #include "util/serial/serializer.h"
 #include "util/templates/sfinae.h"
+#include "util/time/timestamp.h"
 
 extern int gFlag_max_binary_response_size;
 extern int gFlag_max_json_response_size;
@@ -93,6 +95,12 @@ class ServerMethodHandlerBase {
   // Function to check if the method expects empty request. i.e. no 'q' CGI
   // param.
   virtual bool AllowEmptyRequest() const = 0;
+
+  // Function to retrieve the stats of the reply cache of the method. Returns
+  // false if its replies are not cached.
+  virtual bool GetResponseCacheStats(tResponseCacheStats* stats) const {
+    return false;
+  }
 };
 
 // Actual RPC handler with input/output type template.
@@ -123,9 +131,11 @@ class ServerMethodHandler : public ServerMethodHandlerBase {
     }
 
     // Run the server method.
-    shared_ptr<tOutput> output(new tOutput);
+    shared_ptr<tOutput> output;
     tFunc f = GetServerMethod(connection, request);
-    string error_msg = RunServerMethod(f, request.arg_map, input, output, response);
+    string error_msg = RunServerMethodCached(request.message, f,
+                                             request.arg_map, input, &output,
+                                             response);
     if (error_msg.empty()) {
       // return output in serialized string format
       response->message = serial::Serializer::ToBinary(output);
@@ -161,10 +171,11 @@ class ServerMethodHandler : public ServerMethodHandlerBase {
     }
 
     // run the server method
-    shared_ptr<tOutput> output(new tOutput);
+    shared_ptr<tOutput> output;
     tFunc f = GetServerMethod(connection, request);
-    string error_msg_func = RunServerMethod(f, request.arg_map, input, output,
-                                            response);
+    string error_msg_func = RunServerMethodCached(
+        response_cache() != nullptr ? serial::Serializer::ToBinary(input) : "",
+        f, request.arg_map, input, &output, response);
     if (error_msg_func.empty()) {
       // return output in JSON format
       // (if debug_json is true, format JSON output to be human-readable)
@@ -223,7 +234,78 @@ class ServerMethodHandler : public ServerMethodHandlerBase {
     return tFunc().AllowEmptyRequest();
   }
 
+  virtual bool GetResponseCacheStats(
+      tResponseCacheStats* stats) const override {
+    if (response_cache() == nullptr) return false;
+    *stats = response_cache()->stats();
+    return true;
+  }
+
  protected:
+  // The output of a call, as cached. Cookies belong to the caller and are
+  // never cached: a reply that sets cookies is not shared.
+  struct tCachedReply {
+    shared_ptr<tOutput> output;
+    bool sets_cookies = false;
+  };
+
+  // Returns the reply cache of the method, or null if it is not cached. The
+  // cache is created on first use, once the flags have been parsed.
+  ResponseCache<tCachedReply>* response_cache() const {
+    call_once(cache_once_, [this]() {
+      tFunc f;
+      if (f.ResponseCacheTtlMs() > 0) {
+        cache_.reset(new ResponseCache<tCachedReply>(
+            f.ResponseCacheSize(), f.ResponseCacheTtlMs()));
+      }
+    });
+    return cache_.get();
+  }
+
+  // Runs the server method, or takes its reply from the cache if the method
+  // is cached. 'key' is the binary serialized input. Calls with a mock are
+  // never cached, nor are calls in which the method sets cookies. A reply
+  // from the cache has the cookies of the current caller, e.g. its session
+  // cookie.
+  string RunServerMethodCached(const string& key,
+                               tFunc server_method,
+                               const unordered_map<string, string>& arg_map,
+                               const tInput& input,
+                               shared_ptr<tOutput>* output,
+                               tServerReplyMessage* response) const {
+    if (response_cache() == nullptr || !ParseMock(arg_map).empty()) {
+      output->reset(new tOutput);
+      return RunServerMethod(server_method, arg_map, input, *output, response);
+    }
+    vector<string> caller_cookies = server_method.output_cookies();
+    sort(caller_cookies.begin(), caller_cookies.end());
+    bool computed_here = false;
+    shared_ptr<const tCachedReply> reply;
+    string err_msg = response_cache()->Get(
+        key, [&](shared_ptr<const tCachedReply>* computed) {
+      computed_here = true;
+      shared_ptr<tCachedReply> r(new tCachedReply);
+      r->output.reset(new tOutput);
+      string err = RunServerMethod(server_method, arg_map, input, r->output,
+                                   response);
+      vector<string> cookies = response->cookies;
+      sort(cookies.begin(), cookies.end());
+      r->sets_cookies = (cookies != caller_cookies);
+      *computed = r;
+      return err;
+    }, &reply, [](const tCachedReply& r) { return !r.sets_cookies; });
+    if (reply == nullptr) return err_msg;
+    if (!computed_here && reply->sets_cookies) {
+      // Waited for a call that set cookies for its own caller.
+      output->reset(new tOutput);
+      return RunServerMethod(server_method, arg_map, input, *output, response);
+    }
+    // Cached outputs are shared, and never modified.
+    *output = reply->output;
+    if (!computed_here) response->cookies = server_method.output_cookies();
+    return err_msg;
+  }
+
   tFunc GetServerMethod(const tConnectionInfo* connection,
                         const tServerRequestMessage& request) const {
     tFunc f;
@@ -238,6 +320,10 @@ class ServerMethodHandler : public ServerMethodHandlerBase {
     bool internal = (user_agent.empty() || user_agent == gFlag_r77_user_agent) ?
         true : false;
     f.set_internal_call(internal);
+
+    if (request.timeout_ms > 0)
+      f.set_deadline_ms(util::Timestamp::Now<chrono::milliseconds>() +
+                        request.timeout_ms);
     return f;
   }
 
@@ -366,6 +452,8 @@ class ServerMethodHandler : public ServerMethodHandlerBase {
  private:
   const string name_;
   tInput sample_input_;
+  mutable once_flag cache_once_;
+  mutable unique_ptr<ResponseCache<tCachedReply>> cache_;
 };
 
 
@@ -66,5 +66,101 @@ TEST(ServerMethodHandlerCollection, DuplicateOpName) {
   ASSERT_DEATH(SubReg("test_server1", "ADD", {21 , 32}), "");
 }
 
+atomic<int> num_cached_calls(0);
+
+struct CachedAddition : public ServerMethod {
+  string operator()(const tInput& input, int *output) {
+    ++num_cached_calls;
+    *output = input.a + input.b;
+    return "";  // success
+  }
+  virtual int ResponseCacheTtlMs() const { return 60000; }
+};
+
+TEST(ServerMethodHandler, ResponseCache) {
+  ServerMethodHandler<tInput, int, Addition> uncached("ADD", {1, 2});
+  tResponseCacheStats stats;
+  EXPECT_FALSE(uncached.GetResponseCacheStats(&stats));
+
+  ServerMethodHandler<tInput, int, CachedAddition> handler("CADD", {1, 2});
+  tConnectionInfo connection;
+  tServerRequestMessage request("CADD",
+                                serial::Serializer::ToBinary(tInput{1, 2}));
+  for (int i = 0; i < 3; ++i) {
+    tServerReplyMessage reply;
+    handler.ProcessRPC(&connection, request, &reply);
+    ASSERT_TRUE(reply.success);
+    int output = 0;
+    ASSERT_TRUE(serial::Serializer::FromBinary(reply.message, &output));
+    EXPECT_EQ(3, output);
+  }
+  // The JSON interface shares the cache.
+  tServerReplyMessage reply;
+  handler.ProcessJSON(&connection,
+                      tServerRequestMessage("CADD", "{\"a\":1,\"b\":2}"),
+                      false, &reply);
+  EXPECT_EQ("3", reply.message);
+  EXPECT_EQ(1, num_cached_calls);
+
+  ASSERT_TRUE(handler.GetResponseCacheStats(&stats));
+  EXPECT_EQ(3, stats.hits);
+  EXPECT_EQ(1, stats.misses);
+}
+
+TEST(ServerMethodHandler, ResponseCacheSessionCookies) {
+  ServerMethodHandler<tInput, int, CachedAddition> handler("CADD", {1, 2});
+  tConnectionInfo connection;
+  tServerRequestMessage request("CADD",
+                                serial::Serializer::ToBinary(tInput{3, 4}));
+  // Two callers without a session each get a session cookie of their own,
+  // though the second reply comes from the cache.
+  int num_calls = num_cached_calls;
+  tServerReplyMessage first, second;
+  handler.ProcessRPC(&connection, request, &first);
+  handler.ProcessRPC(&connection, request, &second);
+  EXPECT_EQ(num_calls + 1, num_cached_calls);
+  ASSERT_EQ(1, first.cookies.size());
+  ASSERT_EQ(1, second.cookies.size());
+  EXPECT_EQ(0, first.cookies[0].find(gFlag_session_cookie_name + "="));
+  EXPECT_EQ(0, second.cookies[0].find(gFlag_session_cookie_name + "="));
+  EXPECT_NE(first.cookies[0], second.cookies[0]);
+
+  // A caller with a session gets no cookie.
+  request.cookie = gFlag_session_cookie_name + "=1234";
+  tServerReplyMessage third;
+  handler.ProcessRPC(&connection, request, &third);
+  EXPECT_EQ(num_calls + 1, num_cached_calls);
+  EXPECT_TRUE(third.cookies.empty());
+}
+
+atomic<int> num_cookie_calls(0);
+
+struct CookieAddition : public ServerMethod {
+  string operator()(const tInput& input, int *output) {
+    ++num_cookie_calls;
+    SetCookie("sum", to_string(input.a + input.b));
+    *output = input.a + input.b;
+    return "";  // success
+  }
+  virtual int ResponseCacheTtlMs() const { return 60000; }
+};
+
+TEST(ServerMethodHandler, ResponseCacheSkipsCookies) {
+  // Replies that set cookies are not cached.
+  ServerMethodHandler<tInput, int, CookieAddition> handler("KADD", {1, 2});
+  tConnectionInfo connection;
+  tServerRequestMessage request("KADD",
+                                serial::Serializer::ToBinary(tInput{1, 2}));
+  request.cookie = gFlag_session_cookie_name + "=1234";
+  for (int i = 0; i < 2; ++i) {
+    tServerReplyMessage reply;
+    handler.ProcessRPC(&connection, request, &reply);
+    ASSERT_TRUE(reply.success);
+    ASSERT_EQ(1, reply.cookies.size());
+    EXPECT_EQ(0, reply.cookies[0].find("sum=3"));
+  }
+  EXPECT_EQ(2, num_cookie_calls);
+}
+
 }  // namespace test
 }  // namespace network
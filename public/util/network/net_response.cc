@@ -0,0 +1,189 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/network/net_response.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "util/string/strutil.h"
+
+namespace {
+
+// Waits until 'fd' accepts more data. Returns false on timeout or error.
+bool WaitWritable(int fd, int timeout_sec) {
+  struct pollfd pfd;
+  pfd.fd = fd;
+  pfd.events = POLLOUT;
+  int ret;
+  do {
+    ret = poll(&pfd, 1, timeout_sec > 0 ? timeout_sec * 1000 : -1);
+  } while (ret < 0 && errno == EINTR);
+  return ret > 0 && !(pfd.revents & (POLLERR | POLLHUP | POLLNVAL));
+}
+
+// Returns true if a write that failed with 'errno' may be retried.
+bool RetryWrite(int fd, int timeout_sec) {
+  if (errno == EINTR) return true;
+  if (errno == EAGAIN || errno == EWOULDBLOCK)
+    return WaitWritable(fd, timeout_sec);
+  return false;
+}
+
+// Writes all of 'iov'. The iovecs are modified.
+bool WritevFully(int fd, vector<struct iovec>* iov, int timeout_sec) {
+  size_t next = 0;
+  while (next < iov->size()) {
+    int count = min<size_t>(iov->size() - next, IOV_MAX);
+    ssize_t written = writev(fd, &(*iov)[next], count);
+    if (written < 0) {
+      if (RetryWrite(fd, timeout_sec)) continue;
+      VLOG(2) << "writev() failed: " << strutil::LastSystemError();
+      return false;
+    }
+    // Skip what has been written.
+    while (written > 0) {
+      struct iovec& v = (*iov)[next];
+      if (written < v.iov_len) {
+        v.iov_base = static_cast<char*>(v.iov_base) + written;
+        v.iov_len -= written;
+        break;
+      }
+      written -= v.iov_len;
+      ++next;
+    }
+    while (next < iov->size() && (*iov)[next].iov_len == 0) ++next;
+  }
+  iov->clear();
+  return true;
+}
+
+bool SendFileFully(int fd, int file_fd, off_t offset, size_t size,
+                   int timeout_sec) {
+  while (size > 0) {
+    ssize_t sent = sendfile(fd, file_fd, &offset, size);
+    if (sent > 0) {
+      size -= sent;
+      continue;
+    }
+    if (sent < 0 && RetryWrite(fd, timeout_sec)) continue;
+    // sent == 0: the file is shorter than expected.
+    VLOG(2) << "sendfile() failed with " << size << " bytes left: "
+            << strutil::LastSystemError();
+    return false;
+  }
+  return true;
+}
+
+void AddBuffer(const string& s, vector<struct iovec>* iov) {
+  if (s.empty()) return;
+  struct iovec v;
+  v.iov_base = const_cast<char*>(s.data());
+  v.iov_len = s.size();
+  iov->push_back(v);
+}
+
+}  // namespace
+
+NetResponse::NetResponse(NetResponse&& other)
+    : header_(std::move(other.header_)), body_(std::move(other.body_)),
+      file_fd_(other.file_fd_), file_offset_(other.file_offset_),
+      file_size_(other.file_size_) {
+  other.file_fd_ = -1;
+}
+
+NetResponse& NetResponse::operator=(NetResponse&& other) {
+  if (this != &other) {
+    if (file_fd_ >= 0) close(file_fd_);
+    header_ = std::move(other.header_);
+    body_ = std::move(other.body_);
+    file_fd_ = other.file_fd_;
+    file_offset_ = other.file_offset_;
+    file_size_ = other.file_size_;
+    other.file_fd_ = -1;
+  }
+  return *this;
+}
+
+NetResponse::~NetResponse() {
+  if (file_fd_ >= 0) close(file_fd_);
+}
+
+void NetResponse::SetFileBody(int fd, off_t offset, size_t size) {
+  if (file_fd_ >= 0) close(file_fd_);
+  file_fd_ = fd;
+  file_offset_ = offset;
+  file_size_ = size;
+  body_.clear();
+}
+
+string NetResponse::ToString() const {
+  if (!has_file_body()) return header_ + body_;
+
+  string s = header_;
+  s.resize(header_.size() + file_size_);
+  size_t done = 0;
+  while (done < file_size_) {
+    ssize_t n = pread(file_fd_, &s[header_.size() + done], file_size_ - done,
+                      file_offset_ + done);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    done += n;
+  }
+  s.resize(header_.size() + done);
+  return s;
+}
+
+bool NetResponse::WriteTo(int fd, int timeout_sec) const {
+  vector<struct iovec> iov;
+  AddBuffer(header_, &iov);
+  if (has_file_body()) {
+    return WritevFully(fd, &iov, timeout_sec) &&
+        SendFileFully(fd, file_fd_, file_offset_, file_size_, timeout_sec);
+  }
+  AddBuffer(body_, &iov);
+  if (!WritevFully(fd, &iov, timeout_sec)) {
+    VLOG(2) << "Unable to write a response of " << size() << " bytes.";
+    return false;
+  }
+  return true;
+}
+
+bool NetResponse::WriteAll(int fd, const vector<NetResponse>& responses,
+                           int timeout_sec) {
+  vector<struct iovec> iov;
+  for (const NetResponse& r : responses) {
+    AddBuffer(r.header_, &iov);
+    if (!r.has_file_body()) {
+      AddBuffer(r.body_, &iov);
+      continue;
+    }
+    // Everything before the file has to go out first.
+    if (!WritevFully(fd, &iov, timeout_sec) ||
+        !SendFileFully(fd, r.file_fd_, r.file_offset_, r.file_size_,
+                       timeout_sec))
+      return false;
+  }
+  return WritevFully(fd, &iov, timeout_sec);
+}
+
+bool NetResponse::WriteData(int fd, const char* data, size_t size,
+                            int timeout_sec) {
+  size_t remaining = size;
+  while (remaining > 0) {
+    ssize_t written = write(fd, data, remaining);
+    if (written > 0) {
+      data += written;
+      remaining -= written;
+      continue;
+    }
+    if (written < 0 && RetryWrite(fd, timeout_sec)) continue;
+    VLOG(2) << "Only " << size - remaining << " out of " << size
+            << " bytes are written successfully.";
+    return false;
+  }
+  return true;
+}
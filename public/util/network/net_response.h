@@ -0,0 +1,78 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Scatter/gather replies for NetServer.
+//
+// A NetResponse keeps the header and the body of a reply apart. They are
+// written together with writev(), so a large body is never copied into a
+// combined string. The body can also be a range of a file, which is sent with
+// sendfile() without passing through user space at all.
+//
+// Writes handle partial writes and non-blocking sockets: when the socket
+// buffer is full, the writer waits for it to drain, up to a timeout.
+
+#ifndef _PUBLIC_UTIL_NETWORK_NET_RESPONSE_H_
+#define _PUBLIC_UTIL_NETWORK_NET_RESPONSE_H_
+
+#include <sys/types.h>
+
+#include <vector>
+
+#include "base/common.h"
+
+class NetResponse {
+ public:
+  NetResponse() {}
+  explicit NetResponse(string body) : body_(std::move(body)) {}
+  NetResponse(NetResponse&& other);
+  NetResponse& operator=(NetResponse&& other);
+  ~NetResponse();
+
+  const string& header() const { return header_; }
+  const string& body() const { return body_; }
+  string* mutable_header() { return &header_; }
+  string* mutable_body() { return &body_; }
+  void set_header(string header) { header_ = std::move(header); }
+  void set_body(string body) { body_ = std::move(body); }
+
+  // Sends 'size' bytes of the file starting at 'offset' after the header,
+  // instead of body(). Takes ownership of 'fd'.
+  void SetFileBody(int fd, off_t offset, size_t size);
+  bool has_file_body() const { return file_fd_ >= 0; }
+
+  // Total number of bytes to write.
+  size_t size() const {
+    return header_.size() + (has_file_body() ? file_size_ : body_.size());
+  }
+  bool empty() const { return size() == 0; }
+
+  // Returns the whole response as one string, reading the file body if there
+  // is one. For callers that need a string; servers write the response with
+  // WriteTo().
+  string ToString() const;
+
+  // Writes the response to 'fd'. Waits at most 'timeout_sec' seconds (-1: no
+  // limit) whenever the socket does not accept more data. Returns false if
+  // the response could not be written completely.
+  bool WriteTo(int fd, int timeout_sec) const;
+
+  // Writes all the responses in order, batching as many as possible into each
+  // writev().
+  static bool WriteAll(int fd, const vector<NetResponse>& responses,
+                       int timeout_sec);
+
+  // Writes 'size' bytes of 'data' to 'fd', like WriteTo().
+  static bool WriteData(int fd, const char* data, size_t size,
+                        int timeout_sec);
+
+ private:
+  string header_;
+  string body_;
+  int file_fd_ = -1;
+  off_t file_offset_ = 0;
+  size_t file_size_ = 0;
+
+  NetResponse(const NetResponse&) = delete;
+  NetResponse& operator=(const NetResponse&) = delete;
+};
+
+#endif  // _PUBLIC_UTIL_NETWORK_NET_RESPONSE_H_
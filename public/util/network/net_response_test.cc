@@ -0,0 +1,120 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/network/net_response.h"
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <thread>
+
+#include "test/cc/test_main.h"
+
+namespace test {
+
+class NetResponseTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds_));
+    // The writer must cope with a full socket buffer.
+    fcntl(fds_[0], F_SETFL, fcntl(fds_[0], F_GETFL) | O_NONBLOCK);
+  }
+
+  virtual void TearDown() {
+    close(fds_[0]);
+    if (fds_[1] >= 0) close(fds_[1]);
+  }
+
+  // Reads everything from the other end until it is closed.
+  string ReadAll() {
+    string s;
+    char buf[65536];
+    ssize_t n;
+    while ((n = read(fds_[1], buf, sizeof(buf))) > 0) s.append(buf, n);
+    return s;
+  }
+
+  // Writes with 'write', closes the socket and returns what was received.
+  template<typename Func>
+  string WriteAndRead(Func write) {
+    string received;
+    thread reader([&]() { received = ReadAll(); });
+    EXPECT_TRUE(write(fds_[0]));
+    shutdown(fds_[0], SHUT_WR);
+    reader.join();
+    return received;
+  }
+
+  // Returns a temporary file holding 'content'.
+  int TempFile(const string& content) {
+    char name[] = "/tmp/net_response_test.XXXXXX";
+    int fd = mkstemp(name);
+    EXPECT_GE(fd, 0);
+    unlink(name);
+    EXPECT_EQ(content.size(), write(fd, content.data(), content.size()));
+    return fd;
+  }
+
+  int fds_[2];
+};
+
+TEST_F(NetResponseTest, HeaderAndBody) {
+  NetResponse r("body");
+  r.set_header("header\n");
+  EXPECT_EQ(11, r.size());
+  EXPECT_EQ("header\nbody", r.ToString());
+  EXPECT_EQ("header\nbody", WriteAndRead([&](int fd) {
+    return r.WriteTo(fd, 5);
+  }));
+}
+
+TEST_F(NetResponseTest, LargeBody) {
+  // Much larger than the socket buffer.
+  NetResponse r(string(8 << 20, 'x'));
+  r.set_header("header\n");
+  string received = WriteAndRead([&](int fd) { return r.WriteTo(fd, 5); });
+  EXPECT_EQ(r.size(), received.size());
+  EXPECT_EQ(r.ToString(), received);
+}
+
+TEST_F(NetResponseTest, FileBody) {
+  const string content = "0123456789" + string(1 << 20, 'f');
+  NetResponse r;
+  r.set_header("header\n");
+  r.SetFileBody(TempFile(content), 5, content.size() - 5);
+  EXPECT_TRUE(r.has_file_body());
+  EXPECT_EQ("header\n" + content.substr(5), r.ToString());
+  EXPECT_EQ("header\n" + content.substr(5), WriteAndRead([&](int fd) {
+    return r.WriteTo(fd, 5);
+  }));
+}
+
+TEST_F(NetResponseTest, WriteAll) {
+  vector<NetResponse> responses;
+  responses.push_back(NetResponse("one\n"));
+  responses.push_back(NetResponse());
+  responses.back().set_header("two:");
+  responses.back().SetFileBody(TempFile("file\n"), 0, 5);
+  responses.push_back(NetResponse("three\n"));
+  EXPECT_EQ("one\ntwo:file\nthree\n", WriteAndRead([&](int fd) {
+    return NetResponse::WriteAll(fd, responses, 5);
+  }));
+}
+
+TEST_F(NetResponseTest, WriteData) {
+  const string data(1 << 20, 'd');
+  EXPECT_EQ(data, WriteAndRead([&](int fd) {
+    return NetResponse::WriteData(fd, data.data(), data.size(), 5);
+  }));
+}
+
+TEST_F(NetResponseTest, PeerClosed) {
+  close(fds_[1]);
+  fds_[1] = -1;
+  signal(SIGPIPE, SIG_IGN);
+  NetResponse r("body");
+  EXPECT_FALSE(r.WriteTo(fds_[0], 1));
+}
+
+}  // namespace test
@@ -50,6 +50,14 @@ class NetClient {
   // close connection to server
   virtual bool CloseConnection();
 
+  // Gives up ownership of the connected socket and returns it (-1 if there is
+  // no connection). The caller must close it.
+  int ReleaseSocket() {
+    int fd = socket_;
+    socket_ = -1;
+    return fd;
+  }
+
  protected:
   int socket_;       // fd for the listening socket
   string hostname_;  // remote server name
@@ -9,7 +9,9 @@
 #include <thread>
 #include <fstream>
 
+#include "util/network/netserver_reactor.h"
 #include "util/string/strutil.h"
+#include "util/time/timestamp.h"
 
 // Definitions of these functions are hijacked by macros in opt mode, which
 // causes compiler errors with gcc 4.9. Undefine them for now to avoid issues.
@@ -29,6 +31,14 @@ FLAG_int(server_thread_pool_size, 512,
 FLAG_int(netserver_max_connections, 1024,
          "The maximum number of connections allowed by netserver.");
 
+FLAG_bool(netserver_use_epoll, false,
+          "Serve connections from an edge-triggered epoll reactor instead of "
+          "select() and a thread per connection. Requests are processed in the "
+          "server thread pool.");
+
+FLAG_int(netserver_io_threads, 4,
+         "The number of I/O threads used by the epoll reactor.");
+
 
 NetServer::NetServer() :
     portnum_(-1), max_request_size_(100000000), timeout_(60),
@@ -36,6 +46,8 @@ NetServer::NetServer() :
     num_connections_(0), num_pending_requests_(0), prepare_shutdown_(false),
     shutdown_loop_(false), socket_(-1) {}
 
+NetServer::~NetServer() {}
+
 //
 // prepare the server (open a socket, etc.)
 //
@@ -83,13 +95,40 @@ void NetServer::PrepareServer() {
   VLOG(0) << "-----------------------";
 
   // put an ear to the socket, listening for a knock-knock-knocking
-  listen(socket_, 1);                      // 1: only one queue slot
+  // (the reactor accepts in batches, so give it a full backlog)
+  listen(socket_, gFlag_netserver_use_epoll ? SOMAXCONN : 1);
 
   // close(0); close(1); close(2);    // close stdin, stdout and stderr
 
-  if (gFlag_use_thread_pool) {
+  // The reactor always hands complete requests to the thread pool.
+  if (gFlag_use_thread_pool || gFlag_netserver_use_epoll) {
     pool_.reset(new util::threading::ThreadPool(gFlag_server_thread_pool_size));
     ASSERT_NOTNULL(pool_);
+    pool_->set_name("netserver");
+  }
+
+  if (gFlag_netserver_use_epoll)
+    reactor_.reset(new NetServerReactor(this, gFlag_netserver_io_threads));
+}
+
+bool NetServer::AdmitRequest(const RequestView& request,
+                             const tConnectionInfo *connection) {
+  if (connection->dequeued_ms == 0) return true;
+  return admission_.Admit(
+      connection->dequeued_ms - connection->received_ms,
+      connection->dequeued_ms);
+}
+
+void NetServer::HandleRequest(const RequestView& request,
+                              bool *keep_alive,
+                              const tConnectionInfo *connection,
+                              const tRequestScanState *scan_state,
+                              NetResponse *response) {
+  if (AdmitRequest(request, connection)) {
+    ProcessRequestView(request, keep_alive, connection, scan_state, response);
+  } else {
+    VLOG(3) << "Request rejected by admission control";
+    RejectRequest(request, keep_alive, connection, response);
   }
 }
 
@@ -122,6 +161,45 @@ void NetServer::StartServer() {
   if (socket_ < 0)
     PrepareServer();
 
+  if (reactor_ != nullptr)
+    reactor_->Run();
+  else
+    AcceptLoop();
+
+  if (pool_ != nullptr) {
+    // Wait for the thread pool to finish (for at most 30 seconds).
+    pool_->WaitWithTimeout(get_timeout() * 1000);
+    pool_.reset(nullptr);
+  }
+
+  // No worker owns a connection anymore. Close the remaining ones.
+  reactor_.reset(nullptr);
+
+  if (return_on_shutdown_) return;
+
+  LOG(INFO) << "Shutting down server upon request.";
+  // Allow sometime for detached threads to finish.
+  for (int i = get_timeout(); i > 0; --i) {
+    this_thread::sleep_for(chrono::seconds(1));
+    ifstream file("/proc/self/status");
+    string tok;
+    for (file >> tok; file.good() && tok != "Threads:"; file >> tok) ;
+    file >> tok;
+    stringstream ss(tok);
+    int num_threads;
+    ss >> num_threads;
+    int num_pending_req = num_pending_requests_;
+    LOG(INFO) << "Pending requests: " << num_pending_req
+           << ", pending threads: " << num_threads - 2
+           << ", forced shutdown in " << i << "s";
+    if (num_pending_requests_ <= 0 || num_threads <= 2) break;
+  }
+
+  ShutdownSystem(shutdown_loop_ ? 100 : 15);  // shut down server
+}
+
+// accept connections until shutdown
+void NetServer::AcceptLoop() {
   while (1) {
     if (prepare_shutdown_ || socket_ < 0) break;
 
@@ -178,9 +256,11 @@ void NetServer::StartServer() {
         data->ear = ear;
         data->caller_id = caller;
         data->server = this;
-        if (pool_ != nullptr)
+        if (pool_ != nullptr) {
+          // The connection waits for a worker from now on.
+          data->received_ms = util::Timestamp::Now<chrono::milliseconds>();
           pool_->Add(std::bind(&NetServer::NewConnection, data.release()));
-        else
+        } else
           thread(&NetServer::NewConnection, data.release()).detach();
       }
     }
@@ -190,43 +270,24 @@ void NetServer::StartServer() {
     if (num_pending_requests_ <= 0 && prepare_shutdown_) break;
     */
   }
-
-  if (pool_ != nullptr) {
-    // Wait for the thread pool to finish (for at most 30 seconds).
-    pool_->WaitWithTimeout(get_timeout() * 1000);
-    pool_.reset(nullptr);
-  }
-
-  if (return_on_shutdown_) return;
-
-  LOG(INFO) << "Shutting down server upon request.";
-  // Allow sometime for detached threads to finish.
-  for (int i = get_timeout(); i > 0; --i) {
-    this_thread::sleep_for(chrono::seconds(1));
-    ifstream file("/proc/self/status");
-    string tok;
-    for (file >> tok; file.good() && tok != "Threads:"; file >> tok) ;
-    file >> tok;
-    stringstream ss(tok);
-    int num_threads;
-    ss >> num_threads;
-    int num_pending_req = num_pending_requests_;
-    LOG(INFO) << "Pending requests: " << num_pending_req
-           << ", pending threads: " << num_threads - 2
-           << ", forced shutdown in " << i << "s";
-    if (num_pending_requests_ <= 0 || num_threads <= 2) break;
-  }
-
-  ShutdownSystem(shutdown_loop_ ? 100 : 15);  // shut down server
 }
 
 // connection handler -- run as a separate thread
 void NetServer::NewConnection(tConnectionInfo* info) {
   unique_ptr<tConnectionInfo> ad(info);
-  string request;
+  RequestBuffer request;
+  tRequestScanState scan_state;
 
   int ear = info->ear;
   NetServer *server = info->server;
+
+  // A connection queued by AcceptLoop() waited for this worker. Its first
+  // request is admitted or not on how long it waited; later requests do not
+  // wait.
+  bool queued = info->received_ms != 0;
+  if (queued)
+    info->dequeued_ms = util::Timestamp::Now<chrono::milliseconds>();
+
   bool connection_active = true;
   int select_error_count = 0;
 
@@ -256,55 +317,72 @@ void NetServer::NewConnection(tConnectionInfo* info) {
     else if (FD_ISSET(ear, &connections)) {
       // more data has been received
 
-      int ret = strutil::ReadMoreDataFromSocket(ear, 16384,
-                                                server->get_max_request_size(),
-                                                &request);
+      int ret = request.ReadFromSocket(ear, server->get_max_request_size());
+      uint64_t now_ms = util::Timestamp::Now<chrono::milliseconds>();
+      if (queued) {
+        // Only the wait for a worker counts, not the wait for the request.
+        info->received_ms += now_ms - info->dequeued_ms;
+        info->dequeued_ms = now_ms;
+      } else {
+        info->received_ms = now_ms;
+        if (info->dequeued_ms != 0) info->dequeued_ms = now_ms;
+      }
       if (ret < 0) {
         // client closed connection
         VLOG(3) << "Client closed connection!";
         if (!(request.empty())) {
           // process the request first
           bool keep_alive;
+          NetResponse response;
           server->IncrementPendingRequestCounter();
-          WriteMessage(ear,
-                       server->ProcessRequest(request, &keep_alive, info));
+          server->HandleRequest(request.Peek(), &keep_alive, info, nullptr,
+                                &response);
+          queued = false;
+          response.WriteTo(ear, server->get_timeout());
           server->DecrementPendingRequestCounter();
-          request.clear();
+          request.Clear();
         }
 
         connection_active = false;
       }
       else if (ret == 0) {
         // client request message exceeds length limit
-        WriteMessage(ear, "Request message too long\n");
+        WriteMessage(ear, "Request message too long\n", server->get_timeout());
         // terminate the connection
         connection_active = false;
       }
       else {
-        // data has been received normally
+        // data has been received normally.  Process all the complete
+        // requests; the client may have pipelined several.
         unsigned int request_len;
-        if (server->RequestIsComplete(request, &request_len)) {
+        while (connection_active &&
+               request.size() >= scan_state.min_size &&
+               server->RequestViewIsComplete(request.Peek(), &scan_state,
+                                             &request_len)) {
           // A complete request has been received.  Let's process it.
           ASSERT(request_len <= request.size())
             << "Error in RequestIsComplete(): incorrect length ("
             << request_len << ") returned; string size = " << request.size();
           bool keep_alive;
+          NetResponse response;
           server->IncrementPendingRequestCounter();
-          WriteMessage(ear,
-                       server->ProcessRequest(request.substr(0, request_len),
-                                              &keep_alive, info));
+          server->HandleRequest(request.Peek().substr(0, request_len),
+                                &keep_alive, info, &scan_state, &response);
+          queued = false;
+          bool written = response.WriteTo(ear, server->get_timeout());
           server->DecrementPendingRequestCounter();
 
-          // The request has been processed.  Remove it from the string.
-          request = request.substr(request_len);
+          // The request has been processed.  Remove it from the buffer.
+          request.Consume(request_len);
+          scan_state.Clear();
 
           // close the connection if only one request is allowed per connection
           // (either by client request, or by server configuration)
-          if (!keep_alive || server->OneRequestPerConnection())
+          if (!written || !keep_alive || server->OneRequestPerConnection())
             connection_active = false;
-        } else {
-          VLOG(4) << "Incomplete request: " << request.size();
         }
+        if (connection_active && !request.empty())
+          VLOG(4) << "Incomplete request: " << request.size();
       }
     }
     else {
@@ -14,19 +14,30 @@
 #include <unistd.h>
 
 #include "base/common.h"
+#include "util/network/admission_controller.h"
+#include "util/network/net_response.h"
+#include "util/network/request_buffer.h"
 #include "util/thread/thread_pool.h"
 
 class NetServer;
+class NetServerReactor;
 struct tConnectionInfo {
   int ear;
   struct sockaddr_in caller_id;
   NetServer *server;
+  // When the request being processed was received, in ms since the epoch
+  // (0 if unknown). The time since then is how long it waited for a worker.
+  uint64_t received_ms = 0;
+  // When a worker of the thread pool picked up the connection to process the
+  // requests received, in ms since the epoch (0 if they were not queued).
+  // Without epoll, only the first request of a connection waits.
+  uint64_t dequeued_ms = 0;
 };
 
 class NetServer {
  public:
   NetServer();
-  virtual ~NetServer() {}
+  virtual ~NetServer();
 
   inline int get_portnum() const { return portnum_; }
   inline int get_max_request_size() const { return max_request_size_; }
@@ -70,6 +81,19 @@ class NetServer {
     return false;
   }
 
+  // incremental version of RequestIsComplete(), called by the connection
+  // handlers with a view of all the data received and not yet processed.
+  //   'state' is kept per connection and cleared after every request.
+  //   Overrides can use it to skip the data they have already scanned, and
+  //   set state->min_size to the size that the data must reach before it is
+  //   worth calling again.
+  //   default: copies the data and calls RequestIsComplete()
+  virtual bool RequestViewIsComplete(const RequestView& r,
+                                     tRequestScanState *state,
+                                     unsigned int *request_size) const {
+    return RequestIsComplete(r.ToString(), request_size);
+  }
+
   // is there only one request per connection?
   //   default: true.  (connection will be closed after a request is processed)
   //   Override to false if multiple requests are allowed per connection (in
@@ -84,11 +108,51 @@ class NetServer {
   // (default: no message; just close the connection)
   virtual string ServerBusyMessage() const { return ""; };
 
+  // decide whether a request that has been completely received is processed,
+  // or rejected because the server is overloaded.
+  //   default: asks admission_controller(), based on how long the request has
+  //   waited for a worker in the thread pool
+  //   override to decide once more is known about the request, e.g. its
+  //   method
+  virtual bool AdmitRequest(const RequestView& request,
+                            const tConnectionInfo *connection);
+
+  // fill in the response to a request that AdmitRequest() rejected
+  //   default: ServerBusyMessage(), and close the connection
+  virtual void RejectRequest(const RequestView& request,
+                             bool *keep_alive,
+                             const tConnectionInfo *connection,
+                             NetResponse *response) {
+    *keep_alive = false;
+    response->set_body(ServerBusyMessage());
+  }
+
   // process a request after it has been completely received
   virtual string ProcessRequest(const string& request,
                                 bool *keep_alive,
                                 const tConnectionInfo *connection) = 0;
 
+  // process a request given as a view into the connection's receive buffer,
+  // and fill in the response. This is what the connection handlers call.
+  //   'scan_state' is the state in which RequestViewIsComplete() found the
+  //   request complete, so that overrides can use what it has parsed (null
+  //   if the request was not found complete, e.g. the client closed the
+  //   connection)
+  //   default: copies the request and calls ProcessRequest()
+  //   override to avoid the copies, or to send the body of the response
+  //   separately from its header (see NetResponse)
+  virtual void ProcessRequestView(const RequestView& request,
+                                  bool *keep_alive,
+                                  const tConnectionInfo *connection,
+                                  const tRequestScanState *scan_state,
+                                  NetResponse *response) {
+    response->set_body(ProcessRequest(request.ToString(), keep_alive,
+                                      connection));
+  }
+
+  // admission control for the requests of this server
+  AdmissionController* admission_controller() { return &admission_; }
+
   inline void IncrementConnectionCounter() { ++num_connections_; }
   inline void DecrementConnectionCounter() { --num_connections_; }
 
@@ -108,17 +172,30 @@ class NetServer {
   virtual void PrepareServer();
 
  protected:
+  friend class NetServerReactor;
 
-  inline static void WriteMessage(int ear, const string& msg) {
-    int bytes_written = write(ear, msg.c_str(), msg.size());
-    if (bytes_written < msg.size())
-      VLOG(2) << "Only " << bytes_written << " out of " << msg.size()
-             << " bytes are written successfully.";
+  // write the entire message, waiting up to 'timeout' seconds (-1: no limit)
+  // whenever the socket does not accept more data
+  inline static void WriteMessage(int ear, const string& msg,
+                                  int timeout = -1) {
+    NetResponse::WriteData(ear, msg.data(), msg.size(), timeout);
   }
 
+  // accept connections with select() until shutdown, and handle each one
+  // in its own thread (or in the thread pool)
+  void AcceptLoop();
+
   // connection handler -- run as a separate thread
   static void NewConnection(tConnectionInfo* info);
 
+  // process a request with ProcessRequestView(), or reject it if
+  // AdmitRequest() says so. This is what the connection handlers call.
+  void HandleRequest(const RequestView& request,
+                     bool *keep_alive,
+                     const tConnectionInfo *connection,
+                     const tRequestScanState *scan_state,
+                     NetResponse *response);
+
   // log caller IP and additional info
   void LogCaller(const struct sockaddr_in& caller,
                  const string& log_info);
@@ -137,8 +214,13 @@ class NetServer {
   bool return_on_shutdown_ = false;
   int socket_;  // main listening socket
 
+  AdmissionController admission_;
+
   // Thread pool to handle requests.
   unique_ptr<util::threading::ThreadPool> pool_;
+
+  // Event loop that owns all connections in epoll mode (null otherwise).
+  unique_ptr<NetServerReactor> reactor_;
 };
 
 #endif  // _PUBLIC_UTIL_NETWORK_NETSERVER_H_
@@ -0,0 +1,376 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/network/netserver_reactor.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+
+#include "util/network/netserver.h"
+#include "util/string/strutil.h"
+#include "util/time/timestamp.h"
+
+namespace {
+
+// Maximum number of events handled per epoll_wait() call.
+const int kMaxEvents = 256;
+
+// epoll_wait() timeout. The I/O threads check for shutdown and idle
+// connections at least this often.
+const int kPollIntervalMs = 1000;
+
+}  // namespace
+
+FLAG_int(netserver_reply_batch_bytes, 65536,
+         "In epoll mode, replies to pipelined requests are batched into one "
+         "write until they add up to this many bytes.");
+
+struct NetServerReactor::Connection {
+  tConnectionInfo info;
+  IOThread* owner = nullptr;
+  // The data received so far that has not been processed yet.
+  RequestBuffer request;
+  tRequestScanState scan_state;
+  // The last time data was received or a request was processed.
+  time_t last_active = 0;
+  // True while the connection is owned by a worker.
+  bool busy = false;
+  // True once the client has closed its end of the connection.
+  bool closed_by_peer = false;
+};
+
+class NetServerReactor::IOThread {
+ public:
+  IOThread(NetServerReactor* reactor, int id) : reactor_(reactor), id_(id) {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    ASSERT(epoll_fd_ >= 0) << strutil::LastSystemError();
+    thread_.reset(new std::thread(&IOThread::Loop, this));
+  }
+
+  ~IOThread() {
+    Stop();
+    lock_guard<mutex> l(mutex_);
+    while (!connections_.empty())
+      UnlockedClose(connections_.begin()->second.get());
+    close(epoll_fd_);
+  }
+
+  // Stops the event loop. Connections are not closed.
+  void Stop() {
+    stop_ = true;
+    if (thread_ != nullptr) {
+      thread_->join();
+      thread_.reset();
+    }
+  }
+
+  // Takes ownership of the accepted socket.
+  void AddConnection(int ear, const struct sockaddr_in& caller) {
+    unique_ptr<Connection> c(new Connection);
+    c->info.ear = ear;
+    c->info.caller_id = caller;
+    c->info.server = reactor_->server_;
+    c->owner = this;
+    c->last_active = time(NULL);
+
+    lock_guard<mutex> l(mutex_);
+    Connection* conn = c.get();
+    connections_[ear] = std::move(c);
+    if (!Arm(conn, EPOLL_CTL_ADD)) UnlockedClose(conn);
+  }
+
+  // Hands the connection back to the event loop. Called by the worker that
+  // owned the connection.
+  void Rearm(Connection* c) {
+    lock_guard<mutex> l(mutex_);
+    c->busy = false;
+    c->last_active = time(NULL);
+    if (!Arm(c, EPOLL_CTL_MOD)) UnlockedClose(c);
+  }
+
+  void Close(Connection* c) {
+    lock_guard<mutex> l(mutex_);
+    UnlockedClose(c);
+  }
+
+ private:
+  bool Arm(Connection* c, int op) {
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET | EPOLLONESHOT;
+    ev.data.ptr = c;
+    if (epoll_ctl(epoll_fd_, op, c->info.ear, &ev) < 0) {
+      VLOG(2) << "epoll_ctl() failed: " << strutil::LastSystemError();
+      return false;
+    }
+    return true;
+  }
+
+  // The caller must hold 'mutex_'. The connection is deleted.
+  void UnlockedClose(Connection* c) {
+    int ear = c->info.ear;
+    close(ear);
+    NetServer* server = reactor_->server_;
+    server->OnCloseConnection(&c->info);
+    server->DecrementConnectionCounter();
+    connections_.erase(ear);
+  }
+
+  void Loop() {
+    VLOG(3) << "Started reactor I/O thread " << id_;
+    struct epoll_event events[kMaxEvents];
+    time_t last_sweep = time(NULL);
+    while (!stop_) {
+      int num_events = epoll_wait(epoll_fd_, events, kMaxEvents,
+                                  kPollIntervalMs);
+      if (num_events < 0 && errno != EINTR) {
+        VLOG(2) << "Warning: epoll_wait() returns error: "
+                << strutil::LastSystemError();
+      }
+      for (int i = 0; i < num_events; ++i)
+        OnReadable(static_cast<Connection*>(events[i].data.ptr));
+
+      time_t now = time(NULL);
+      if (now != last_sweep) {
+        CloseIdleConnections(now);
+        last_sweep = now;
+      }
+    }
+    VLOG(3) << "Finished reactor I/O thread " << id_;
+  }
+
+  // Drains the socket and dispatches the connection to the worker pool if a
+  // complete request has been received.
+  void OnReadable(Connection* c) {
+    NetServer* server = reactor_->server_;
+    // Edge triggered: we are only notified again once new data arrives, so
+    // read until the socket is empty.
+    while (true) {
+      int ret = c->request.ReadFromSocket(c->info.ear,
+                                          server->get_max_request_size());
+      if (ret > 0) continue;
+      if (ret == 0) {
+        // client request message exceeds length limit
+        NetServer::WriteMessage(c->info.ear, "Request message too long\n",
+                                server->get_timeout());
+        Close(c);
+        return;
+      }
+      if (errno == 0) {
+        VLOG(3) << "Client closed connection!";
+        c->closed_by_peer = true;
+        break;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+      VLOG(3) << "Error reading from client: " << strutil::LastSystemError();
+      Close(c);
+      return;
+    }
+    c->last_active = time(NULL);
+
+    bool has_request = reactor_->HasCompleteRequest(c) ||
+        (c->closed_by_peer && !c->request.empty());
+    if (has_request) {
+      // The connection belongs to the worker until it calls Rearm() or
+      // Close().
+      {
+        lock_guard<mutex> l(mutex_);
+        c->busy = true;
+      }
+      c->info.received_ms = util::Timestamp::Now<chrono::milliseconds>();
+      NetServerReactor* reactor = reactor_;
+      server->thread_pool()->Add([reactor, c]() {
+        reactor->ProcessConnection(c);
+      });
+    } else if (c->closed_by_peer) {
+      Close(c);
+    } else {
+      VLOG(4) << "Incomplete request: " << c->request.size();
+      Rearm(c);
+    }
+  }
+
+  // Closes the connections that have been idle for longer than the server
+  // timeout, or all idle connections if the server is shutting down.
+  void CloseIdleConnections(time_t now) {
+    NetServer* server = reactor_->server_;
+    bool shutdown = server->PreparingShutdown();
+    int timeout = server->get_timeout();
+    if (!shutdown && timeout <= 0) return;
+
+    lock_guard<mutex> l(mutex_);
+    vector<Connection*> idle;
+    for (const auto& p : connections_) {
+      const Connection* c = p.second.get();
+      if (c->busy) continue;
+      if (shutdown || now - c->last_active >= timeout)
+        idle.push_back(p.second.get());
+    }
+    for (Connection* c : idle) {
+      VLOG(3) << "closing client connection after timeout.";
+      UnlockedClose(c);
+    }
+  }
+
+  NetServerReactor* reactor_;
+  const int id_;
+  int epoll_fd_ = -1;
+  std::atomic_bool stop_{false};
+  unique_ptr<std::thread> thread_;
+  // Protects 'connections_' and the busy state of the connections.
+  mutex mutex_;
+  unordered_map<int, unique_ptr<Connection>> connections_;
+};
+
+NetServerReactor::NetServerReactor(NetServer* server, int num_io_threads)
+    : server_(server) {
+  ASSERT_NOTNULL(server_);
+  ASSERT_GT(num_io_threads, 0);
+  io_threads_.reserve(num_io_threads);
+  for (int i = 0; i < num_io_threads; ++i)
+    io_threads_.push_back(unique_ptr<IOThread>(new IOThread(this, i)));
+}
+
+NetServerReactor::~NetServerReactor() {
+  // Destroying the I/O threads closes all the remaining connections.
+  io_threads_.clear();
+}
+
+void NetServerReactor::Run() {
+  int listen_fd = server_->socket_;
+  ASSERT(listen_fd >= 0);
+  fcntl(listen_fd, F_SETFL, fcntl(listen_fd, F_GETFL) | O_NONBLOCK);
+
+  int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  ASSERT(epoll_fd >= 0) << strutil::LastSystemError();
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.fd = listen_fd;
+  ASSERT(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) >= 0)
+      << strutil::LastSystemError();
+
+  LOG(INFO) << "Serving connections with " << io_threads_.size()
+            << " reactor I/O threads.";
+
+  while (!server_->PreparingShutdown() && server_->socket_ >= 0) {
+    // Wake up every second to check for shutdown. The listening socket is
+    // removed from the epoll set automatically once it is closed.
+    int num_active = epoll_wait(epoll_fd, &ev, 1, kPollIntervalMs);
+    if (server_->PreparingShutdown()) break;
+
+    if (num_active < 0 && errno != EINTR) {
+      VLOG(2) << "Warning: epoll_wait() returns error: "
+              << strutil::LastSystemError();
+    } else if (num_active > 0) {
+      AcceptConnections();
+    }
+  }
+  close(epoll_fd);
+
+  for (unique_ptr<IOThread>& t : io_threads_) t->Stop();
+}
+
+void NetServerReactor::AcceptConnections() {
+  while (server_->socket_ >= 0) {
+    struct sockaddr_in caller;     // id of foreign calling process
+    socklen_t fromlen = sizeof(struct sockaddr_in);
+    int ear = accept4(server_->socket_, (struct sockaddr *)&caller, &fromlen,
+                      SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (ear < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) continue;
+      if (errno != EAGAIN && errno != EWOULDBLOCK)
+        VLOG(2) << "Warning: accept() returns error: "
+                << strutil::LastSystemError();
+      return;
+    }
+
+    if (server_->num_connections_ >= server_->max_connections_ ||
+        server_->PreparingShutdown()) {
+      // we have already reached the maximum number of concurrent connections
+      // or we are about to shut down the server
+      if (server_->PreparingShutdown())
+        LOG(INFO) << "Connection declined due to server shutdown";
+      else {
+        LOG(INFO) << "Connection declined due to max_connections. "
+                  << "connections: " << server_->num_connections_.load()
+                  << ", max_connections: " << server_->max_connections_;
+      }
+      NetServer::WriteMessage(ear, server_->ServerBusyMessage(),
+                              server_->get_timeout());
+      close(ear);
+      continue;
+    }
+
+    server_->IncrementConnectionCounter();
+    io_threads_[next_io_thread_]->AddConnection(ear, caller);
+    next_io_thread_ = (next_io_thread_ + 1) % io_threads_.size();
+  }
+}
+
+bool NetServerReactor::HasCompleteRequest(Connection* c,
+                                          unsigned int* request_len) const {
+  unsigned int len;
+  if (request_len == nullptr) request_len = &len;
+  if (c->request.size() < c->scan_state.min_size) return false;
+  if (!server_->RequestViewIsComplete(c->request.Peek(), &c->scan_state,
+                                      request_len))
+    return false;
+  ASSERT(*request_len <= c->request.size())
+    << "Error in RequestIsComplete(): incorrect length ("
+    << *request_len << ") returned; string size = " << c->request.size();
+  return true;
+}
+
+void NetServerReactor::ProcessConnection(Connection* c) {
+  c->info.dequeued_ms = util::Timestamp::Now<chrono::milliseconds>();
+  // Replies to pipelined requests are written together, in as few writev()
+  // calls as possible, once they add up to enough bytes or no other request
+  // is waiting.
+  vector<NetResponse> replies;
+  size_t reply_bytes = 0;
+  bool keep_open = true;
+  while (keep_open) {
+    unsigned int request_len;
+    bool complete = HasCompleteRequest(c, &request_len);
+    if (!complete) {
+      // The client closed the connection. Process whatever we have.
+      if (!c->closed_by_peer || c->request.empty()) break;
+      request_len = c->request.size();
+    }
+
+    bool keep_alive = false;
+    NetResponse response;
+    server_->IncrementPendingRequestCounter();
+    server_->HandleRequest(c->request.Peek().substr(0, request_len),
+                           &keep_alive, &c->info,
+                           complete ? &c->scan_state : nullptr, &response);
+    server_->DecrementPendingRequestCounter();
+    c->request.Consume(request_len);
+    c->scan_state.Clear();
+    reply_bytes += response.size();
+    replies.push_back(std::move(response));
+
+    // close the connection if only one request is allowed per connection
+    // (either by client request, or by server configuration)
+    if (!keep_alive || server_->OneRequestPerConnection())
+      keep_open = false;
+
+    if (!keep_open || reply_bytes >= gFlag_netserver_reply_batch_bytes ||
+        !HasCompleteRequest(c)) {
+      if (!NetResponse::WriteAll(c->info.ear, replies, server_->get_timeout()))
+        keep_open = false;
+      replies.clear();
+      reply_bytes = 0;
+    }
+  }
+  if (!replies.empty())
+    NetResponse::WriteAll(c->info.ear, replies, server_->get_timeout());
+
+  if (keep_open && !c->closed_by_peer && !server_->PreparingShutdown())
+    c->owner->Rearm(c);
+  else
+    c->owner->Close(c);
+}
@@ -0,0 +1,73 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Edge-triggered epoll reactor for NetServer.
+//
+// The reactor accepts connections on the server's listening socket and hands
+// them round robin to a small, fixed set of I/O threads. Every I/O thread owns
+// an epoll set and reads from its sockets without blocking. Only when
+// NetServer::RequestViewIsComplete() reports a complete request is the
+// connection handed to the server's worker pool, which runs
+// ProcessRequestView() and writes the reply. Idle keep-alive connections
+// therefore cost a few hundred bytes instead of a thread, and there is no
+// FD_SETSIZE limit on the number of sockets.
+//
+// A connection is registered with EPOLLONESHOT. At any point in time it is
+// owned by exactly one thread: its I/O thread while it is armed in epoll, or a
+// worker while a request is being processed. The worker re-arms the connection
+// once it is done with it.
+
+#ifndef _PUBLIC_UTIL_NETWORK_NETSERVER_REACTOR_H_
+#define _PUBLIC_UTIL_NETWORK_NETSERVER_REACTOR_H_
+
+#include <netinet/in.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "base/common.h"
+
+class NetServer;
+
+class NetServerReactor {
+ public:
+  NetServerReactor(NetServer* server, int num_io_threads);
+  ~NetServerReactor();
+
+  // Accepts connections until the server prepares to shut down. The I/O
+  // threads are stopped when this returns, but connections that are still
+  // being processed by the worker pool stay open until the reactor is
+  // destroyed.
+  void Run();
+
+  int num_io_threads() const { return io_threads_.size(); }
+
+ private:
+  struct Connection;
+  class IOThread;
+
+  // Accepts all the pending connections on the listening socket.
+  void AcceptConnections();
+
+  // Returns true if a complete request has been buffered for the connection,
+  // and sets 'request_len' (may be null) to its size.
+  bool HasCompleteRequest(Connection* c,
+                          unsigned int* request_len = nullptr) const;
+
+  // Processes all the complete requests buffered for the connection. Runs on
+  // a worker thread.
+  void ProcessConnection(Connection* c);
+
+  NetServer* server_;
+  vector<unique_ptr<IOThread>> io_threads_;
+  // The I/O thread that receives the next accepted connection.
+  int next_io_thread_ = 0;
+
+  NetServerReactor(const NetServerReactor&) = delete;
+  NetServerReactor& operator=(const NetServerReactor&) = delete;
+};
+
+#endif  // _PUBLIC_UTIL_NETWORK_NETSERVER_REACTOR_H_
@@ -0,0 +1,66 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/network/playback_log.h"
+
+#include <fstream>
+
+#include "util/string/strutil.h"
+
+namespace network {
+
+string FlattenPlaybackField(const string& field) {
+  string flat = field;
+  for (char& c : flat)
+    if (c == '\n' || c == '\r' || c == '\t') c = ' ';
+  return flat;
+}
+
+string FormatPlaybackRecord(const tPlaybackRecord& record) {
+  string line = to_string(record.timestamp_ms) + "\t" + record.opname + "\t" +
+      FlattenPlaybackField(record.input);
+  if (record.has_output) line += "\t" + FlattenPlaybackField(record.output);
+  return line;
+}
+
+bool ParsePlaybackRecord(const string& line, tPlaybackRecord* record) {
+  // Keeps empty fields, e.g. the input of methods that take none.
+  vector<string> fields;
+  for (size_t start = 0; ; ) {
+    size_t tab = line.find('\t', start);
+    fields.push_back(line.substr(start, tab - start));
+    if (tab == string::npos) break;
+    start = tab + 1;
+  }
+  if (fields.size() < 3 || fields.size() > 4) return false;
+  char* end = nullptr;
+  // Older recordings may have a fractional part.
+  record->timestamp_ms = strtod(fields[0].c_str(), &end);
+  if (fields[0].empty() || *end != '\0' || fields[1].empty()) return false;
+  record->opname = fields[1];
+  record->input = fields[2];
+  record->has_output = fields.size() == 4;
+  record->output = record->has_output ? fields[3] : "";
+  return true;
+}
+
+bool ReadPlaybackFile(const string& filename,
+                      vector<tPlaybackRecord>* records) {
+  ifstream in(filename);
+  if (!in) {
+    LOG(INFO) << "Cannot open " << filename << ": "
+              << strutil::LastSystemError();
+    return false;
+  }
+  string line;
+  for (int line_number = 1; getline(in, line); ++line_number) {
+    if (line.empty()) continue;
+    tPlaybackRecord record;
+    if (ParsePlaybackRecord(line, &record))
+      records->push_back(std::move(record));
+    else
+      LOG(INFO) << filename << ":" << line_number << ": invalid record";
+  }
+  return true;
+}
+
+}  // namespace network
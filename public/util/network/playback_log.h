@@ -0,0 +1,44 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// The calls RPCServer records while /_startrecord is on, for replay. Each
+// file has one call per line, with tab separated fields:
+//   input files (--playback_input_fn):   <ms since epoch> <opname> <input>
+//   output files (--playback_output_fn): <ms since epoch> <opname> <input>
+//                                        <output>
+// Inputs and outputs are JSON, with line breaks and tabs recorded as spaces.
+
+#ifndef _PUBLIC_UTIL_NETWORK_PLAYBACK_LOG_H_
+#define _PUBLIC_UTIL_NETWORK_PLAYBACK_LOG_H_
+
+#include <vector>
+
+#include "base/common.h"
+
+namespace network {
+
+struct tPlaybackRecord {
+  int64_t timestamp_ms = 0;
+  string opname;
+  string input;
+  // Only in output files.
+  bool has_output = false;
+  string output;
+};
+
+// Replaces the characters that would break up a record with spaces.
+string FlattenPlaybackField(const string& field);
+
+// Returns 'record' as a line, without the line break.
+string FormatPlaybackRecord(const tPlaybackRecord& record);
+
+// Parses a line written by FormatPlaybackRecord().
+bool ParsePlaybackRecord(const string& line, tPlaybackRecord* record);
+
+// Appends the records of 'filename' to 'records'. Malformed lines are logged
+// and skipped. Returns false if the file cannot be read.
+bool ReadPlaybackFile(const string& filename,
+                      vector<tPlaybackRecord>* records);
+
+}  // namespace network
+
+#endif  // _PUBLIC_UTIL_NETWORK_PLAYBACK_LOG_H_
@@ -0,0 +1,169 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/network/request_buffer.h"
+
+#include <errno.h>
+#include <unistd.h>
+
+FLAG_int(request_buffer_chunk_size, 16384,
+         "Size of the chunks that NetServer receives requests into.");
+
+FLAG_int(request_buffer_max_free_chunks, 4096,
+         "The maximum number of request buffer chunks kept for reuse.");
+
+const size_t RequestView::npos;
+
+RequestChunkPool::RequestChunkPool(size_t chunk_size, int max_free_chunks)
+    : chunk_size_(chunk_size), max_free_chunks_(max(max_free_chunks, 0)) {
+  ASSERT_GT(chunk_size_, 0);
+}
+
+RequestChunkPool::~RequestChunkPool() {
+  for (char* chunk : free_chunks_) delete[] chunk;
+}
+
+RequestChunkPool& RequestChunkPool::Default() {
+  static RequestChunkPool* pool = new RequestChunkPool(
+      gFlag_request_buffer_chunk_size, gFlag_request_buffer_max_free_chunks);
+  return *pool;
+}
+
+char* RequestChunkPool::Allocate() {
+  {
+    lock_guard<mutex> l(mutex_);
+    if (!free_chunks_.empty()) {
+      char* chunk = free_chunks_.back();
+      free_chunks_.pop_back();
+      return chunk;
+    }
+  }
+  return new char[chunk_size_];
+}
+
+void RequestChunkPool::Release(char* chunk) {
+  {
+    lock_guard<mutex> l(mutex_);
+    if (free_chunks_.size() < max_free_chunks_) {
+      free_chunks_.push_back(chunk);
+      return;
+    }
+  }
+  delete[] chunk;
+}
+
+int RequestChunkPool::num_free_chunks() {
+  lock_guard<mutex> l(mutex_);
+  return free_chunks_.size();
+}
+
+RequestBuffer::RequestBuffer(RequestChunkPool* pool)
+    : pool_(pool != nullptr ? pool : &RequestChunkPool::Default()) {}
+
+int RequestBuffer::ReadFromSocket(int fd, int size_limit) {
+  size_t max_read = numeric_limits<size_t>::max();
+  if (size_limit >= 0) {
+    if (size_ >= static_cast<size_t>(size_limit)) return 0;
+    max_read = size_limit - size_;
+  }
+
+  Chunk& c = WritableChunk();
+  ssize_t read_count;
+  do {
+    read_count = read(fd, c.data + c.end, min(c.capacity - c.end, max_read));
+  } while (read_count < 0 && errno == EINTR);
+
+  if (read_count <= 0) {
+    if (read_count == 0) errno = 0;
+    // Do not hold on to an unused chunk while the connection is idle.
+    if (c.begin == c.end) {
+      ReleaseChunk(c);
+      chunks_.pop_back();
+    }
+    return -1;
+  }
+  c.end += read_count;
+  size_ += read_count;
+  return read_count;
+}
+
+void RequestBuffer::Append(const char* data, size_t len) {
+  while (len > 0) {
+    Chunk& c = WritableChunk();
+    size_t n = min(c.capacity - c.end, len);
+    memcpy(c.data + c.end, data, n);
+    c.end += n;
+    size_ += n;
+    data += n;
+    len -= n;
+  }
+}
+
+RequestView RequestBuffer::Peek() {
+  if (chunks_.empty()) return RequestView();
+  if (chunks_.size() > 1) {
+    // Merge all the chunks into one. Leave room to grow so that a large
+    // request that is still being received is not merged over and over.
+    Chunk merged;
+    merged.capacity = max(pool_->chunk_size(), 2 * size_);
+    merged.data = new char[merged.capacity];
+    merged.begin = 0;
+    merged.end = 0;
+    merged.pooled = false;
+    for (const Chunk& c : chunks_) {
+      memcpy(merged.data + merged.end, c.data + c.begin, c.end - c.begin);
+      merged.end += c.end - c.begin;
+      ReleaseChunk(c);
+    }
+    chunks_.clear();
+    chunks_.push_back(merged);
+  }
+  const Chunk& c = chunks_.front();
+  return RequestView(c.data + c.begin, c.end - c.begin);
+}
+
+void RequestBuffer::Consume(size_t n) {
+  ASSERT_LE(n, size_);
+  size_ -= n;
+  while (n > 0) {
+    Chunk& c = chunks_.front();
+    size_t used = c.end - c.begin;
+    if (n < used) {
+      c.begin += n;
+      return;
+    }
+    n -= used;
+    ReleaseChunk(c);
+    chunks_.pop_front();
+  }
+  // Return the remaining empty chunk, if any.
+  if (size_ == 0) Clear();
+}
+
+void RequestBuffer::Clear() {
+  for (const Chunk& c : chunks_) ReleaseChunk(c);
+  chunks_.clear();
+  size_ = 0;
+}
+
+RequestBuffer::Chunk& RequestBuffer::WritableChunk() {
+  if (!chunks_.empty()) {
+    Chunk& c = chunks_.back();
+    if (c.begin == c.end) c.begin = c.end = 0;
+    if (c.end < c.capacity) return c;
+  }
+  Chunk c;
+  c.data = pool_->Allocate();
+  c.capacity = pool_->chunk_size();
+  c.begin = 0;
+  c.end = 0;
+  c.pooled = true;
+  chunks_.push_back(c);
+  return chunks_.back();
+}
+
+void RequestBuffer::ReleaseChunk(const Chunk& c) {
+  if (c.pooled)
+    pool_->Release(c.data);
+  else
+    delete[] c.data;
+}
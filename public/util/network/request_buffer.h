@@ -0,0 +1,189 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Receive buffers for NetServer.
+//
+// A RequestBuffer accumulates the data received on a connection in fixed-size
+// chunks taken from a shared RequestChunkPool. Data is read from the socket
+// directly into the chunks, so it is not copied on the way in, and chunks are
+// recycled between connections instead of being reallocated. A contiguous
+// RequestView of the buffered data is handed to the server; chunks are only
+// merged when a request spans more than one of them.
+
+#ifndef _PUBLIC_UTIL_NETWORK_REQUEST_BUFFER_H_
+#define _PUBLIC_UTIL_NETWORK_REQUEST_BUFFER_H_
+
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "base/common.h"
+
+// A read-only, non-owning view of (part of) a request, in the spirit of
+// string_view. A view obtained from a RequestBuffer is only valid until the
+// buffer is modified.
+class RequestView {
+ public:
+  static const size_t npos = string::npos;
+
+  RequestView() {}
+  RequestView(const char* data, size_t size) : data_(data), size_(size) {}
+  // Implicit, so that a string can be passed wherever a view is expected.
+  RequestView(const string& s) : data_(s.data()), size_(s.size()) {}
+
+  const char* data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  const char* begin() const { return data_; }
+  const char* end() const { return data_ + size_; }
+  char operator[](size_t i) const { return data_[i]; }
+
+  // Returns the view of at most 'n' characters starting at 'pos'.
+  RequestView substr(size_t pos, size_t n = npos) const {
+    if (pos > size_) pos = size_;
+    return RequestView(data_ + pos, min(n, size_ - pos));
+  }
+
+  // Returns the position of the first occurrence of 'c' or 's' at or after
+  // 'pos', or npos.
+  size_t find(char c, size_t pos = 0) const {
+    if (pos >= size_) return npos;
+    const void* p = memchr(data_ + pos, c, size_ - pos);
+    return p == nullptr ? npos : static_cast<const char*>(p) - data_;
+  }
+  size_t find(const char* s, size_t pos = 0) const {
+    size_t len = strlen(s);
+    if (pos > size_ || len > size_ - pos) return npos;
+    const void* p = memmem(data_ + pos, size_ - pos, s, len);
+    return p == nullptr ? npos : static_cast<const char*>(p) - data_;
+  }
+
+  bool starts_with(const char* prefix) const {
+    size_t len = strlen(prefix);
+    return len <= size_ && memcmp(data_, prefix, len) == 0;
+  }
+
+  bool operator==(const RequestView& other) const {
+    return size_ == other.size_ && memcmp(data_, other.data_, size_) == 0;
+  }
+  bool operator!=(const RequestView& other) const { return !(*this == other); }
+
+  string ToString() const { return string(data_, size_); }
+
+ private:
+  const char* data_ = "";
+  size_t size_ = 0;
+};
+
+inline ostream& operator<<(ostream& out, const RequestView& v) {
+  return out.write(v.data(), v.size());
+}
+
+// Base class for protocol-specific parser state that a server keeps in
+// tRequestScanState between reads.
+class RequestParserState {
+ public:
+  virtual ~RequestParserState() {}
+
+  // Prepares the parser for the next request on the connection.
+  virtual void Reset() = 0;
+};
+
+// Scan state kept for every connection by NetServer and passed to
+// NetServer::RequestViewIsComplete(). It is cleared after each request.
+struct tRequestScanState {
+  // Prepares for the next request. The parser is kept for reuse.
+  void Clear() {
+    min_size = 0;
+    if (parser != nullptr) parser->Reset();
+  }
+
+  // The buffered data must reach this size before the request can possibly be
+  // complete. NetServer does not call RequestViewIsComplete() before then.
+  size_t min_size = 0;
+  // Parser that resumes where it stopped on the previous read (may be null).
+  unique_ptr<RequestParserState> parser;
+};
+
+// Thread-safe free list of equally sized chunks.
+class RequestChunkPool {
+ public:
+  // At most 'max_free_chunks' released chunks are kept for reuse.
+  RequestChunkPool(size_t chunk_size, int max_free_chunks);
+  ~RequestChunkPool();
+
+  // The pool shared by all servers, configured by flags.
+  static RequestChunkPool& Default();
+
+  size_t chunk_size() const { return chunk_size_; }
+
+  char* Allocate();
+  void Release(char* chunk);
+
+  // Number of chunks currently kept for reuse.
+  int num_free_chunks();
+
+ private:
+  const size_t chunk_size_;
+  const size_t max_free_chunks_;
+  mutex mutex_;
+  vector<char*> free_chunks_;
+
+  RequestChunkPool(const RequestChunkPool&) = delete;
+  RequestChunkPool& operator=(const RequestChunkPool&) = delete;
+};
+
+// Chunked receive buffer for a single connection. Not thread-safe.
+class RequestBuffer {
+ public:
+  // Uses RequestChunkPool::Default() if 'pool' is null.
+  explicit RequestBuffer(RequestChunkPool* pool = nullptr);
+  ~RequestBuffer() { Clear(); }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  // Reads the data available on the socket directly into the buffer, with the
+  // same return values as strutil::ReadMoreDataFromSocket():
+  //   -1 if no data could be read. errno is EAGAIN or EWOULDBLOCK if a
+  //      non-blocking socket has no data, and 0 if the peer closed the
+  //      connection.
+  //    0 if the buffer already holds 'size_limit' bytes (-1: no limit).
+  //   otherwise the number of bytes read.
+  int ReadFromSocket(int fd, int size_limit);
+
+  void Append(const char* data, size_t len);
+
+  // Returns a contiguous view of all the buffered data. This copies only if
+  // the data spans several chunks, in which case they are merged into one.
+  RequestView Peek();
+
+  // Removes the first 'n' bytes.
+  void Consume(size_t n);
+
+  // Removes all data and returns the chunks to the pool.
+  void Clear();
+
+ private:
+  struct Chunk {
+    char* data;
+    size_t capacity;
+    size_t begin, end;  // the used range [begin, end)
+    bool pooled;        // false if allocated by Peek()
+  };
+
+  // Returns the last chunk, adding one if it is full.
+  Chunk& WritableChunk();
+  void ReleaseChunk(const Chunk& c);
+
+  RequestChunkPool* pool_;
+  deque<Chunk> chunks_;
+  size_t size_ = 0;
+
+  RequestBuffer(const RequestBuffer&) = delete;
+  RequestBuffer& operator=(const RequestBuffer&) = delete;
+};
+
+#endif  // _PUBLIC_UTIL_NETWORK_REQUEST_BUFFER_H_
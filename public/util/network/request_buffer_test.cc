@@ -0,0 +1,95 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "util/network/request_buffer.h"
+#include "test/cc/test_main.h"
+
+namespace test {
+
+TEST(RequestViewTest, Sanity) {
+  string s = "GET /foo HTTP/1.1\r\n\r\n";
+  RequestView v(s);
+  EXPECT_EQ(s.size(), v.size());
+  EXPECT_TRUE(v.starts_with("GET"));
+  EXPECT_FALSE(v.starts_with("POST"));
+  EXPECT_EQ(s.find('/'), v.find('/'));
+  EXPECT_EQ(s.find("\r\n\r\n"), v.find("\r\n\r\n"));
+  EXPECT_EQ(RequestView::npos, v.find("xyz"));
+  EXPECT_EQ(RequestView::npos, v.find('z', 3));
+  EXPECT_EQ("/foo", v.substr(4, 4).ToString());
+  EXPECT_EQ("", v.substr(100).ToString());
+  EXPECT_TRUE(v.substr(0, 3) == RequestView("GET"));
+}
+
+TEST(RequestBufferTest, AppendAndConsume) {
+  RequestChunkPool pool(8, 10);
+  RequestBuffer buffer(&pool);
+  EXPECT_TRUE(buffer.empty());
+  EXPECT_EQ("", buffer.Peek().ToString());
+
+  // Spans several chunks.
+  buffer.Append("hello world, ", 13);
+  buffer.Append("hello again", 11);
+  EXPECT_EQ(24, buffer.size());
+  EXPECT_EQ("hello world, hello again", buffer.Peek().ToString());
+
+  buffer.Consume(13);
+  EXPECT_EQ("hello again", buffer.Peek().ToString());
+  buffer.Append("!", 1);
+  EXPECT_EQ("hello again!", buffer.Peek().ToString());
+
+  buffer.Consume(12);
+  EXPECT_TRUE(buffer.empty());
+  EXPECT_EQ("", buffer.Peek().ToString());
+}
+
+TEST(RequestBufferTest, ChunksAreReused) {
+  RequestChunkPool pool(8, 2);
+  {
+    RequestBuffer buffer(&pool);
+    buffer.Append("0123456789abcdef0123", 20);
+    EXPECT_EQ(0, pool.num_free_chunks());
+    // Only two of the three chunks are kept.
+    buffer.Clear();
+    EXPECT_EQ(2, pool.num_free_chunks());
+
+    buffer.Append("0123", 4);
+    EXPECT_EQ(1, pool.num_free_chunks());
+  }
+  EXPECT_EQ(2, pool.num_free_chunks());
+}
+
+TEST(RequestBufferTest, ReadFromSocket) {
+  int fds[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+
+  RequestChunkPool pool(4, 10);
+  RequestBuffer buffer(&pool);
+  const string msg = "0123456789";
+  ASSERT_EQ(msg.size(), write(fds[1], msg.data(), msg.size()));
+  int total = 0;
+  while (total < msg.size()) {
+    int ret = buffer.ReadFromSocket(fds[0], -1);
+    ASSERT_GT(ret, 0);
+    total += ret;
+  }
+  EXPECT_EQ(msg, buffer.Peek().ToString());
+
+  // The size limit is reached.
+  ASSERT_EQ(msg.size(), write(fds[1], msg.data(), msg.size()));
+  EXPECT_EQ(2, buffer.ReadFromSocket(fds[0], 12));
+  EXPECT_EQ(0, buffer.ReadFromSocket(fds[0], 12));
+  EXPECT_EQ(msg + "01", buffer.Peek().ToString());
+
+  // The peer closes the connection.
+  buffer.Clear();
+  close(fds[1]);
+  while (buffer.ReadFromSocket(fds[0], -1) > 0) {}
+  EXPECT_EQ(-1, buffer.ReadFromSocket(fds[0], -1));
+  EXPECT_EQ(0, errno);
+  close(fds[0]);
+}
+
+}  // namespace test
@@ -0,0 +1,328 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/network/rpc_channel.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <set>
+#include <thread>
+
+#include "util/network/net_response.h"
+#include "util/network/netclient.h"
+#include "util/network/request_buffer.h"
+#include "util/string/strutil.h"
+
+// Off until servers process the calls pipelined on a connection concurrently
+// (see rpc_channel.h).
+FLAG_bool(rpc_use_channels, false,
+          "Send forwarded RPC calls over pooled, multiplexed connections "
+          "instead of one connection per call.");
+
+FLAG_int(rpc_channel_connections, 2,
+         "The number of connections an RPC channel keeps to each server.");
+
+FLAG_int(rpc_channel_max_expired_calls, 1000,
+         "An RPC channel connection is closed once this many calls on it have "
+         "timed out without a reply.");
+
+extern int gFlag_netclient_max_reply_size;
+
+namespace network {
+
+namespace {
+
+int64_t NowMs() {
+  return chrono::duration_cast<chrono::milliseconds>(
+      chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}  // namespace
+
+// One connection with any number of calls in flight. The reader thread holds a
+// reference, so the connection lives until the thread is done with it.
+class RPCChannel::Connection :
+    public enable_shared_from_this<RPCChannel::Connection> {
+ public:
+  explicit Connection(int fd) : fd_(fd), wake_fd_(eventfd(0, EFD_NONBLOCK)) {
+    fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) | O_NONBLOCK);
+    // Requests are small and many of them may be in flight.
+    int one = 1;
+    setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  }
+
+  ~Connection() {
+    close(fd_);
+    if (wake_fd_ >= 0) close(wake_fd_);
+  }
+
+  // Starts the reader thread.
+  void Start() {
+    thread(&Connection::ReadLoop, shared_from_this()).detach();
+  }
+
+  // Registers 'done' and sends 'request'. Returns false, without calling
+  // 'done', if the connection has already failed.
+  bool Send(tServerRequestMessage* request, int timeout_ms,
+            const tReplyCallback& done) {
+    lock_guard<mutex> write_lock(write_mutex_);
+    request->request_id = ++next_id_;
+    bool wake = false;
+    {
+      lock_guard<mutex> l(mutex_);
+      if (closed_) return false;
+      int64_t deadline = NowMs() + timeout_ms;
+      // The reader only needs to wake up early for the first deadline.
+      wake = deadlines_.empty() || deadline < deadlines_.begin()->first;
+      pending_[request->request_id] = {deadline, done};
+      deadlines_.insert(make_pair(deadline, request->request_id));
+    }
+    if (wake) Wake();
+
+    string msg = serial::Serializer::ToBinaryPrependSize(*request);
+    VLOG(4) << "Request " << request->request_id << ": size = " << msg.size();
+    // On failure, the reader fails all the calls including this one.
+    if (!NetResponse::WriteData(fd_, msg.data(), msg.size(),
+                                (timeout_ms + 999) / 1000))
+      Close();
+    return true;
+  }
+
+  // Fails all calls and stops the reader.
+  void Close() { shutdown(fd_, SHUT_RDWR); }
+
+  bool closed() const { return closed_; }
+
+ private:
+  struct tPending {
+    int64_t deadline;
+    tReplyCallback done;
+  };
+
+  void ReadLoop() {
+    string error;
+    while (error.empty()) {
+      struct pollfd fds[2];
+      fds[0].fd = fd_;
+      fds[0].events = POLLIN;
+      fds[1].fd = wake_fd_;
+      fds[1].events = POLLIN;
+      int ret = poll(fds, 2, PollTimeoutMs());
+      if (ret < 0 && errno != EINTR) {
+        error = "poll() failed: " + strutil::LastSystemError();
+        break;
+      }
+      if (ret > 0 && (fds[1].revents & POLLIN)) {
+        uint64_t count;
+        if (read(wake_fd_, &count, sizeof(count)) < 0) {}
+      }
+      if (ret > 0 && fds[0].revents) error = ReadReplies();
+      if (error.empty()) error = ExpireCalls();
+    }
+    FailAll(error);
+  }
+
+  // Reads what is available and completes the calls whose replies are in.
+  // Returns an error if the connection can no longer be used.
+  string ReadReplies() {
+    while (true) {
+      int n = buffer_.ReadFromSocket(fd_, gFlag_netclient_max_reply_size);
+      if (n > 0) {
+        string error = DispatchReplies();
+        if (!error.empty()) return error;
+        continue;
+      }
+      if (n == 0) return "Reply exceeds netclient_max_reply_size";
+      if (errno == EAGAIN || errno == EWOULDBLOCK) return "";
+      if (errno == 0) return "Connection closed by server";
+      return "Read error: " + strutil::LastSystemError();
+    }
+  }
+
+  string DispatchReplies() {
+    while (!buffer_.empty() && buffer_.size() >= min_size_) {
+      RequestView v = buffer_.Peek();
+      size_t len = serial::Serializer::PrependedSizeMessageLength<unsigned int>(
+          v.data(), v.size());
+      if (len == 0 || len > v.size()) {
+        min_size_ = len > 0 ? len : v.size() + 1;
+        break;
+      }
+      tServerReplyMessage reply;
+      bool parsed = serial::Serializer::FromBinaryPrependedSize(v.data(), len,
+                                                                &reply);
+      buffer_.Consume(len);
+      min_size_ = 0;
+      if (!parsed) return "Server error -- invalid server response.";
+      Complete(&reply);
+    }
+    return "";
+  }
+
+  void Complete(tServerReplyMessage* reply) {
+    tReplyCallback done;
+    {
+      lock_guard<mutex> l(mutex_);
+      // Servers that do not echo the id reply in order, so the reply belongs
+      // to the oldest call.
+      auto it = reply->request_id != 0 ? pending_.find(reply->request_id)
+                                       : pending_.begin();
+      if (it == pending_.end()) {
+        LOG(INFO) << "Unexpected reply to request " << reply->request_id;
+        return;
+      }
+      done = std::move(it->second.done);
+      if (done == nullptr) {
+        --num_expired_;
+      } else {
+        deadlines_.erase(make_pair(it->second.deadline, it->first));
+      }
+      pending_.erase(it);
+    }
+    if (done == nullptr) {
+      VLOG(2) << "Dropping the reply to expired request " << reply->request_id;
+      return;
+    }
+    done("", reply);
+  }
+
+  // Fails the calls that are past their deadline. They stay in pending_,
+  // without a callback, until their reply arrives so that it is not taken
+  // for the reply to a later call.
+  string ExpireCalls() {
+    vector<tReplyCallback> expired;
+    int64_t now = NowMs();
+    bool too_many;
+    {
+      lock_guard<mutex> l(mutex_);
+      while (!deadlines_.empty() && deadlines_.begin()->first <= now) {
+        tPending& p = pending_[deadlines_.begin()->second];
+        expired.push_back(std::move(p.done));
+        p.done = nullptr;
+        deadlines_.erase(deadlines_.begin());
+        ++num_expired_;
+      }
+      too_many = num_expired_ > gFlag_rpc_channel_max_expired_calls;
+    }
+    for (const tReplyCallback& done : expired)
+      done("Server timeout or error", nullptr);
+    return too_many ? "Too many calls timed out" : "";
+  }
+
+  int PollTimeoutMs() {
+    lock_guard<mutex> l(mutex_);
+    if (deadlines_.empty()) return -1;
+    return max<int64_t>(0, deadlines_.begin()->first - NowMs() + 1);
+  }
+
+  void Wake() {
+    uint64_t one = 1;
+    if (write(wake_fd_, &one, sizeof(one)) < 0) {}
+  }
+
+  void FailAll(const string& error) {
+    map<unsigned long, tPending> failed;
+    {
+      lock_guard<mutex> l(mutex_);
+      closed_ = true;
+      failed.swap(pending_);
+      deadlines_.clear();
+      num_expired_ = 0;
+    }
+    VLOG(2) << "RPC connection closed with " << failed.size()
+            << " calls in flight: " << error;
+    for (auto& p : failed)
+      if (p.second.done != nullptr) p.second.done(error, nullptr);
+  }
+
+  const int fd_;
+  const int wake_fd_;  // eventfd to wake the reader when a deadline is added
+
+  mutex write_mutex_;  // serializes requests on the socket
+  unsigned long next_id_ = 0;
+
+  mutex mutex_;  // guards the members below
+  atomic<bool> closed_{false};
+  map<unsigned long, tPending> pending_;  // by request id
+  set<pair<int64_t, unsigned long>> deadlines_;  // of the calls not expired
+  int num_expired_ = 0;  // expired calls still waiting for their reply
+
+  // Used by the reader thread only.
+  RequestBuffer buffer_;
+  size_t min_size_ = 0;  // do not look for a reply before this much is in
+};
+
+RPCChannel::RPCChannel(const string& host, int port, int num_connections)
+    : host_(host), port_(port), connections_(max(1, num_connections)) {}
+
+RPCChannel::~RPCChannel() {
+  for (const shared_ptr<Connection>& c : connections_)
+    if (c != nullptr) c->Close();
+}
+
+shared_ptr<RPCChannel> RPCChannel::Get(const string& host, int port) {
+  static mutex channels_mutex;
+  static unordered_map<string, shared_ptr<RPCChannel>> channels;
+
+  const string key = host + ":" + to_string(port);
+  lock_guard<mutex> l(channels_mutex);
+  shared_ptr<RPCChannel>& channel = channels[key];
+  if (channel == nullptr)
+    channel.reset(new RPCChannel(host, port, gFlag_rpc_channel_connections));
+  return channel;
+}
+
+shared_ptr<RPCChannel::Connection> RPCChannel::PickConnection(string* error) {
+  unsigned int slot;
+  {
+    lock_guard<mutex> l(mutex_);
+    slot = next_++ % connections_.size();
+    const shared_ptr<Connection>& c = connections_[slot];
+    if (c != nullptr && !c->closed()) return c;
+  }
+
+  // (Re)connect without holding up calls on the other connections.
+  NetClient client;
+  if (!client.EstablishConnection(host_, port_)) {
+    *error = "Cannot establish connection to " + host_ + ":" +
+        to_string(port_);
+    return nullptr;
+  }
+  shared_ptr<Connection> c(new Connection(client.ReleaseSocket()));
+  {
+    lock_guard<mutex> l(mutex_);
+    shared_ptr<Connection>& current = connections_[slot];
+    // Another caller got there first.
+    if (current != nullptr && !current->closed()) return current;
+    current = c;
+  }
+  c->Start();
+  return c;
+}
+
+void RPCChannel::Send(tServerRequestMessage request, int timeout_ms,
+                      tReplyCallback done) {
+  if (timeout_ms <= 0) timeout_ms = gFlag_netclient_default_timeout;
+  // Let the server know how long we are going to wait.
+  if (request.timeout_ms <= 0 || request.timeout_ms > timeout_ms)
+    request.timeout_ms = timeout_ms;
+  string error;
+  shared_ptr<Connection> c = PickConnection(&error);
+  if (c != nullptr) {
+    if (c->Send(&request, timeout_ms, done)) return;
+    error = "Connection to " + host_ + ":" + to_string(port_) + " closed";
+  }
+  LOG(INFO) << "Error calling " << request.opname << ": " << error;
+  done(error, nullptr);
+}
+
+}  // namespace network
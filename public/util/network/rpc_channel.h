@@ -0,0 +1,134 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Pooled, multiplexed RPC connections to one server.
+//
+// An RPCClient owns its socket and blocks on it for the whole call. An
+// RPCChannel keeps a few persistent connections to a (host, port) and sends
+// any number of calls over each of them without waiting for earlier replies.
+// Every request is tagged with a request_id that the server echoes in its
+// reply; a reader thread per connection hands each reply to its caller.
+//
+//   shared_ptr<RPCChannel> channel = RPCChannel::Get(host, port);
+//   future<RPCChannel::tResult<tOutput>> f =
+//       channel->CallAsync<tOutput>(request);
+//   ...
+//   RPCChannel::tResult<tOutput> result = f.get();
+//   if (!result.error.empty()) ...
+//
+// Callbacks run on the reader thread of the connection. They must be quick and
+// must not wait for other calls on the same channel.
+//
+// MakeRPCCall() and the method forwards use channels with --rpc_use_channels.
+// The server processes the calls of a connection in order, so the calls to a
+// server are only as concurrent as the connections of its channel.
+
+#ifndef _PUBLIC_UTIL_NETWORK_RPC_CHANNEL_H_
+#define _PUBLIC_UTIL_NETWORK_RPC_CHANNEL_H_
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "base/common.h"
+#include "util/network/rpc_datatypes.h"
+#include "util/network/rpcclient.h"
+
+extern bool gFlag_rpc_use_channels;
+
+namespace network {
+
+class RPCChannel {
+ public:
+  // The outcome of a call.
+  template<class tOutput>
+  struct tResult {
+    string error;  // empty on success
+    tOutput output;
+    string output_cookie;
+  };
+
+  // Called once per request with an error message ("" on success) and the
+  // decoded reply (null on error).
+  typedef function<void(const string& error, tServerReplyMessage* reply)>
+      tReplyCallback;
+
+  // Keeps up to 'num_connections' connections to host:port.
+  RPCChannel(const string& host, int port, int num_connections);
+  // Fails all calls still in flight.
+  ~RPCChannel();
+
+  // Returns the process-wide channel to host:port, creating it on first use.
+  static shared_ptr<RPCChannel> Get(const string& host, int port);
+
+  const string& host() const { return host_; }
+  int port() const { return port_; }
+
+  // Sends 'request' and calls 'done' when the reply arrives, when the call has
+  // not completed within 'timeout_ms' (-1: netclient_default_timeout), or when
+  // the connection fails. The request_id of 'request' is overwritten.
+  void Send(tServerRequestMessage request, int timeout_ms,
+            tReplyCallback done);
+
+  // Makes a call and passes the decoded result to 'done'.
+  template<class tOutput>
+  void CallAsync(const tServerRequestMessage& request, int timeout_ms,
+                 function<void(tResult<tOutput>*)> done) {
+    Send(request, timeout_ms,
+         [done](const string& error, tServerReplyMessage* reply) {
+      tResult<tOutput> result;
+      if (error.empty())
+        result.error = RPCClient::ParseRPCReply(*reply, &result.output,
+                                                &result.output_cookie);
+      else
+        result.error = error;
+      done(&result);
+    });
+  }
+
+  // Makes a call and returns a future for its result.
+  template<class tOutput>
+  future<tResult<tOutput>> CallAsync(const tServerRequestMessage& request,
+                                     int timeout_ms = -1) {
+    shared_ptr<promise<tResult<tOutput>>> p(new promise<tResult<tOutput>>);
+    CallAsync<tOutput>(request, timeout_ms, [p](tResult<tOutput>* result) {
+      p->set_value(std::move(*result));
+    });
+    return p->get_future();
+  }
+
+  // Makes a call and waits for it, like RPCClient::Call().
+  template<class tOutput>
+  string Call(const tServerRequestMessage& request, tOutput* output,
+              string* output_cookie_full_spec, int timeout_ms = -1) {
+    if (output_cookie_full_spec) output_cookie_full_spec->clear();
+    tResult<tOutput> result = CallAsync<tOutput>(request, timeout_ms).get();
+    if (result.error.empty()) {
+      *output = std::move(result.output);
+      if (output_cookie_full_spec)
+        *output_cookie_full_spec = std::move(result.output_cookie);
+    }
+    return result.error;
+  }
+
+ private:
+  class Connection;
+
+  // Returns an open connection for the next call, or null with 'error' set.
+  shared_ptr<Connection> PickConnection(string* error);
+
+  const string host_;
+  const int port_;
+
+  mutex mutex_;  // guards connections_ and next_
+  vector<shared_ptr<Connection>> connections_;
+  unsigned int next_ = 0;
+
+  RPCChannel(const RPCChannel&) = delete;
+  RPCChannel& operator=(const RPCChannel&) = delete;
+};
+
+}  // namespace network
+
+#endif  // _PUBLIC_UTIL_NETWORK_RPC_CHANNEL_H_
@@ -25,6 +25,8 @@ struct tServerRequestMessage {
     referrer.clear();
     http_header.clear();
     arg_map.clear();
+    request_id = 0;
+    timeout_ms = 0;
   }
 
   void MergeMetaData(const tServerRequestMessage& right) {
@@ -53,8 +55,18 @@ struct tServerRequestMessage {
   unordered_map<string, string> http_header;
   unordered_map<string, string> arg_map;
 
+  // Set by clients that send several requests on one connection without
+  // waiting for the replies (see RPCChannel). The server echoes it back in
+  // tServerReplyMessage. 0 means not set.
+  unsigned long request_id = 0;
+
+  // How much longer, in ms, the caller is willing to wait for the reply when
+  // it sends the request. Servers skip requests that have waited longer than
+  // this and pass what is left on to the calls they make. 0 means no limit.
+  int timeout_ms = 0;
+
   SERIALIZE(opname*1 / message*2 / referrer*3 /cookie*4 / http_header*5 /
-            arg_map*6);
+            arg_map*6 / request_id*7 / timeout_ms*8);
 };
 
 // RPC reply format.
@@ -63,6 +75,7 @@ struct tServerReplyMessage {
     message.clear();
     cookies.clear();
     success = false;
+    request_id = 0;
   }
 
   bool success = false;
@@ -70,8 +83,10 @@ struct tServerReplyMessage {
   string message;
   // The output cookies strings.
   vector<string> cookies;
+  // The request_id of the request this replies to.
+  unsigned long request_id = 0;
 
-  SERIALIZE(success*1 / message*2 / cookies*3);
+  SERIALIZE(success*1 / message*2 / cookies*3 / request_id*4);
 };
 
 // Returns true if the RPC message has been completely received.
@@ -0,0 +1,90 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Replays the calls recorded by an RPCServer (/_startrecord) against a server
+// through its JSON interface, and reports the throughput and latencies of
+// each method. See rpc_replayer.h.
+//
+// e.g. replay the recording of a suggest server at 500 calls per second, and
+// check the outputs against the ones recorded:
+//   rpc_replay --replay_input=/data/output/output_playback_10010 \
+//       --replay_port=10010 --replay_open_loop --replay_qps=500
+
+#include <iostream>
+
+#include "util/init/main.h"
+#include "util/network/httpclient.h"
+#include "util/network/playback_log.h"
+#include "util/network/rpc_replayer.h"
+#include "util/string/strutil.h"
+
+FLAG_string(replay_input, "",
+            "The recording to replay: an input or an output playback file.");
+
+FLAG_string(replay_expected, "",
+            "An output playback file to check the outputs against. Defaults "
+            "to --replay_input if it has outputs.");
+
+FLAG_string(replay_host, "localhost", "The host of the server to replay to.");
+
+FLAG_int(replay_port, -1, "The port of the server to replay to.");
+
+FLAG_bool(replay_open_loop, false,
+          "Send the calls on a schedule rather than one after another.");
+
+FLAG_int(replay_concurrency, 16, "The number of concurrent calls.");
+
+FLAG_double(replay_qps, 0,
+            "Open loop: the calls per second, or 0 to keep the recorded "
+            "spacing between calls.");
+
+FLAG_double(replay_speed, 1,
+            "Open loop with --replay_qps=0: how many times faster than "
+            "recorded to send the calls.");
+
+FLAG_int(replay_repeat, 1, "The number of times the recording is replayed.");
+
+FLAG_int(replay_timeout_ms, 10000, "The timeout of each call.");
+
+namespace {
+
+bool CallServer(const network::tPlaybackRecord& call, string* output) {
+  string path = "/" + call.opname + "?" + (call.input.empty() ?
+      string("no_input=1") : "q=" + strutil::EscapeString_CGI(call.input));
+  HttpClient client;
+  client.set_timeout_ms(gFlag_replay_timeout_ms);
+  int status_code;
+  return client.HttpGet(gFlag_replay_host, gFlag_replay_port, path,
+                        &status_code, output) && status_code == 200;
+}
+
+}  // namespace
+
+int init_main() {
+  ASSERT(!gFlag_replay_input.empty()) << "--replay_input is required";
+  ASSERT_GT(gFlag_replay_port, 0) << "--replay_port is required";
+
+  vector<network::tPlaybackRecord> calls;
+  ASSERT(network::ReadPlaybackFile(gFlag_replay_input, &calls));
+  LOG(INFO) << "Replaying " << calls.size() << " calls from "
+            << gFlag_replay_input;
+
+  network::RPCReplayer::tOptions options;
+  options.open_loop = gFlag_replay_open_loop;
+  options.concurrency = gFlag_replay_concurrency;
+  options.qps = gFlag_replay_qps;
+  options.speed = gFlag_replay_speed;
+  options.repeat = gFlag_replay_repeat;
+  network::RPCReplayer replayer(options, &CallServer);
+
+  if (!gFlag_replay_expected.empty()) {
+    vector<network::tPlaybackRecord> expected;
+    ASSERT(network::ReadPlaybackFile(gFlag_replay_expected, &expected));
+    replayer.SetExpectedOutputs(expected);
+  } else {
+    replayer.SetExpectedOutputs(calls);
+  }
+
+  replayer.Run(calls);
+  cout << replayer.Report();
+  return 0;
+}
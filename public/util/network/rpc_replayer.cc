@@ -0,0 +1,138 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/network/rpc_replayer.h"
+
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+#include "util/thread/thread_pool.h"
+#include "util/time/timestamp.h"
+
+FLAG_int(replay_log_mismatches, 10,
+         "The number of output mismatches logged by the replayer.");
+
+namespace network {
+
+namespace {
+
+string CallKey(const tPlaybackRecord& record) {
+  return record.opname + "\t" + FlattenPlaybackField(record.input);
+}
+
+}  // namespace
+
+void RPCReplayer::SetExpectedOutputs(const vector<tPlaybackRecord>& records) {
+  for (const tPlaybackRecord& record : records)
+    if (record.has_output) expected_[CallKey(record)] = record.output;
+}
+
+const RPCReplayer::tMethodStats* RPCReplayer::method_stats(
+    const string& opname) const {
+  const auto i = stats_.find(opname);
+  return i != stats_.end() ? i->second.get() : nullptr;
+}
+
+void RPCReplayer::Run(const vector<tPlaybackRecord>& calls) {
+  stats_.clear();
+  for (const tPlaybackRecord& call : calls)
+    if (stats_.find(call.opname) == stats_.end())
+      stats_[call.opname].reset(new tMethodStats);
+
+  uint64_t start = util::Timestamp::Now();
+  if (options_.open_loop)
+    RunOpenLoop(calls);
+  else
+    RunClosedLoop(calls);
+  elapsed_sec_ = (util::Timestamp::Now() - start) / 1e6;
+}
+
+void RPCReplayer::Call(const tPlaybackRecord& call, int64_t start_us) {
+  tMethodStats& stats = *stats_.at(call.opname);
+  string output;
+  bool success = call_(call, &output);
+  stats.latency_us.Record(max<int64_t>(0, util::Timestamp::Now() - start_us));
+  if (!success) {
+    ++stats.errors;
+    return;
+  }
+  if (expected_.empty()) return;
+  const auto i = expected_.find(CallKey(call));
+  if (i == expected_.end() || i->second == FlattenPlaybackField(output))
+    return;
+  ++stats.mismatches;
+  if (num_mismatches_logged_++ < gFlag_replay_log_mismatches) {
+    LOG(INFO) << "Output mismatch for " << call.opname << " " << call.input
+              << "\nexpected: " << i->second << "\nactual:   " << output;
+  }
+}
+
+void RPCReplayer::RunClosedLoop(const vector<tPlaybackRecord>& calls) {
+  const int total = calls.size() * options_.repeat;
+  atomic<int> next(0);
+  vector<thread> callers;
+  for (int i = 0; i < options_.concurrency; ++i) {
+    callers.push_back(thread([this, &calls, &next, total]() {
+      for (int n = next++; n < total; n = next++)
+        Call(calls[n % calls.size()], util::Timestamp::Now());
+    }));
+  }
+  for (thread& t : callers) t.join();
+}
+
+void RPCReplayer::RunOpenLoop(const vector<tPlaybackRecord>& calls) {
+  if (calls.empty()) return;
+  // The time of each call from the start of its pass, in us.
+  vector<int64_t> offsets(calls.size());
+  for (int i = 0; i < calls.size(); ++i) {
+    offsets[i] = options_.qps > 0 ? i * 1e6 / options_.qps :
+        max<int64_t>(0, calls[i].timestamp_ms - calls[0].timestamp_ms) *
+            1000 / options_.speed;
+  }
+  const int64_t pass_us = options_.qps > 0 ? calls.size() * 1e6 / options_.qps
+                                           : offsets.back() + 1;
+
+  util::threading::ThreadPool callers(options_.concurrency);
+  const int64_t start = util::Timestamp::Now();
+  for (int pass = 0; pass < options_.repeat; ++pass) {
+    for (int i = 0; i < calls.size(); ++i) {
+      int64_t scheduled = start + pass * pass_us + offsets[i];
+      int64_t wait = scheduled - util::Timestamp::Now();
+      if (wait > 0) this_thread::sleep_for(chrono::microseconds(wait));
+      const tPlaybackRecord* call = &calls[i];
+      callers.Add([this, call, scheduled]() { Call(*call, scheduled); });
+    }
+  }
+  callers.Wait();
+}
+
+string RPCReplayer::Report() const {
+  stringstream report;
+  report << left << setw(32) << "method" << right
+         << setw(10) << "calls" << setw(8) << "errors" << setw(11) << "mismatch"
+         << setw(10) << "qps" << setw(10) << "mean ms" << setw(10) << "p50"
+         << setw(10) << "p90" << setw(10) << "p99" << setw(10) << "p99.9"
+         << setw(10) << "max" << "\n";
+  report << fixed << setprecision(2);
+  uint64_t total = 0;
+  for (const auto& p : stats_) {
+    const tMethodStats& s = *p.second;
+    const stats::LatencyHistogram& h = s.latency_us;
+    total += h.count();
+    report << left << setw(32) << p.first << right
+           << setw(10) << h.count() << setw(8) << s.errors.load()
+           << setw(11) << s.mismatches.load()
+           << setw(10) << (elapsed_sec_ > 0 ? h.count() / elapsed_sec_ : 0)
+           << setw(10) << h.mean() / 1000
+           << setw(10) << h.Percentile(50) / 1000.0
+           << setw(10) << h.Percentile(90) / 1000.0
+           << setw(10) << h.Percentile(99) / 1000.0
+           << setw(10) << h.Percentile(99.9) / 1000.0
+           << setw(10) << h.max() / 1000.0 << "\n";
+  }
+  report << total << " calls in " << elapsed_sec_ << "s: "
+         << (elapsed_sec_ > 0 ? total / elapsed_sec_ : 0) << " calls/s\n";
+  return report.str();
+}
+
+}  // namespace network
@@ -0,0 +1,91 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Replays calls recorded by RPCServer (see playback_log.h) to benchmark a
+// server with real traffic, and reports the throughput and the latency of
+// each method. Calls recorded with their output can be checked against it.
+//
+// Closed loop: a fixed number of callers each send the next call as soon as
+// their previous one is done. This measures the throughput of the server.
+// Open loop: calls are sent on a schedule, at a fixed rate or as they were
+// recorded, whether or not the earlier ones are done. Latencies are measured
+// from the scheduled time, so they include the time a call waited for a free
+// caller when the server falls behind.
+
+#ifndef _PUBLIC_UTIL_NETWORK_RPC_REPLAYER_H_
+#define _PUBLIC_UTIL_NETWORK_RPC_REPLAYER_H_
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "base/common.h"
+#include "util/network/playback_log.h"
+#include "util/stats/latency_histogram.h"
+
+namespace network {
+
+class RPCReplayer {
+ public:
+  // Makes a call and sets its output. Returns false on error. Called from
+  // several threads at once.
+  typedef function<bool(const tPlaybackRecord& call, string* output)>
+      tCallFunc;
+
+  struct tOptions {
+    bool open_loop = false;
+    // The number of concurrent callers.
+    int concurrency = 16;
+    // Open loop: calls per second, or 0 to keep the recorded spacing sped up
+    // 'speed' times.
+    double qps = 0;
+    double speed = 1;
+    // The number of times the calls are replayed.
+    int repeat = 1;
+  };
+
+  struct tMethodStats {
+    stats::LatencyHistogram latency_us;
+    atomic<uint64_t> errors{0};
+    atomic<uint64_t> mismatches{0};  // outputs that differ from the expected
+  };
+
+  RPCReplayer(const tOptions& options, const tCallFunc& call)
+      : options_(options), call_(call) {}
+
+  // Calls with the opname and input of a record that has an output are
+  // expected to return the same output.
+  void SetExpectedOutputs(const vector<tPlaybackRecord>& records);
+
+  // Replays 'calls' and returns when all of them are done.
+  void Run(const vector<tPlaybackRecord>& calls);
+
+  // Returns the stats of 'opname' from the last Run(), or null.
+  const tMethodStats* method_stats(const string& opname) const;
+
+  // The time the last Run() took.
+  double elapsed_sec() const { return elapsed_sec_; }
+
+  // A table of the throughput and latencies of each method.
+  string Report() const;
+
+ private:
+  void Call(const tPlaybackRecord& call, int64_t start_us);
+  void RunClosedLoop(const vector<tPlaybackRecord>& calls);
+  void RunOpenLoop(const vector<tPlaybackRecord>& calls);
+
+  const tOptions options_;
+  const tCallFunc call_;
+  // By opname and input.
+  unordered_map<string, string> expected_;
+  // Filled in before the calls start, so it is not modified while they run.
+  map<string, unique_ptr<tMethodStats>> stats_;
+  atomic<int> num_mismatches_logged_{0};
+  double elapsed_sec_ = 0;
+};
+
+}  // namespace network
+
+#endif  // _PUBLIC_UTIL_NETWORK_RPC_REPLAYER_H_
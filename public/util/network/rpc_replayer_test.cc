@@ -0,0 +1,143 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/network/rpc_replayer.h"
+
+#include <chrono>
+#include <thread>
+
+#include "test/cc/test_main.h"
+
+namespace network {
+namespace test {
+
+tPlaybackRecord Record(int64_t timestamp_ms, const string& opname,
+                       const string& input) {
+  tPlaybackRecord record;
+  record.timestamp_ms = timestamp_ms;
+  record.opname = opname;
+  record.input = input;
+  return record;
+}
+
+TEST(PlaybackLog, FormatAndParse) {
+  tPlaybackRecord record = Record(1234, "foo", "{\"a\":\n1}");
+  EXPECT_EQ("1234\tfoo\t{\"a\": 1}", FormatPlaybackRecord(record));
+
+  tPlaybackRecord parsed;
+  ASSERT_TRUE(ParsePlaybackRecord(FormatPlaybackRecord(record), &parsed));
+  EXPECT_EQ(1234, parsed.timestamp_ms);
+  EXPECT_EQ("foo", parsed.opname);
+  EXPECT_EQ("{\"a\": 1}", parsed.input);
+  EXPECT_FALSE(parsed.has_output);
+
+  record.input = "";
+  record.has_output = true;
+  record.output = "out\tput";
+  ASSERT_TRUE(ParsePlaybackRecord(FormatPlaybackRecord(record), &parsed));
+  EXPECT_EQ("", parsed.input);
+  EXPECT_TRUE(parsed.has_output);
+  EXPECT_EQ("out put", parsed.output);
+
+  // As recorded by older servers.
+  ASSERT_TRUE(ParsePlaybackRecord("1234.0\tfoo\t{}", &parsed));
+  EXPECT_EQ(1234, parsed.timestamp_ms);
+
+  EXPECT_FALSE(ParsePlaybackRecord("", &parsed));
+  EXPECT_FALSE(ParsePlaybackRecord("1234\tfoo", &parsed));
+  EXPECT_FALSE(ParsePlaybackRecord("x\tfoo\t{}", &parsed));
+  EXPECT_FALSE(ParsePlaybackRecord("1\t\t{}", &parsed));
+}
+
+class RPCReplayerTest : public testing::Test {
+ protected:
+  // Echoes the input, and fails the calls to "fail".
+  static bool Echo(const tPlaybackRecord& call, string* output) {
+    *output = call.input;
+    return call.opname != "fail";
+  }
+
+  vector<tPlaybackRecord> calls_ = {
+    Record(1000, "foo", "1"), Record(1001, "bar", "2"),
+    Record(1002, "foo", "3"), Record(1003, "fail", "4"),
+  };
+};
+
+TEST_F(RPCReplayerTest, ClosedLoop) {
+  RPCReplayer::tOptions options;
+  options.concurrency = 3;
+  options.repeat = 5;
+  RPCReplayer replayer(options, &Echo);
+  replayer.Run(calls_);
+
+  ASSERT_TRUE(replayer.method_stats("foo") != nullptr);
+  EXPECT_EQ(10, replayer.method_stats("foo")->latency_us.count());
+  EXPECT_EQ(0, replayer.method_stats("foo")->errors);
+  EXPECT_EQ(5, replayer.method_stats("bar")->latency_us.count());
+  EXPECT_EQ(5, replayer.method_stats("fail")->errors);
+  EXPECT_TRUE(replayer.method_stats("baz") == nullptr);
+  EXPECT_NE(string::npos, replayer.Report().find("20 calls"));
+}
+
+TEST_F(RPCReplayerTest, OpenLoop) {
+  RPCReplayer::tOptions options;
+  options.open_loop = true;
+  options.qps = 400;
+  options.repeat = 10;
+  RPCReplayer replayer(options, &Echo);
+  replayer.Run(calls_);
+
+  EXPECT_EQ(20, replayer.method_stats("foo")->latency_us.count());
+  EXPECT_EQ(10, replayer.method_stats("fail")->errors);
+  // 40 calls at 400 qps.
+  EXPECT_GE(replayer.elapsed_sec(), 0.09);
+}
+
+TEST_F(RPCReplayerTest, OpenLoopRecordedSpacing) {
+  RPCReplayer::tOptions options;
+  options.open_loop = true;
+  options.speed = 0.02;  // 1ms apart becomes 50ms
+  RPCReplayer replayer(options, &Echo);
+  replayer.Run(calls_);
+  EXPECT_EQ(2, replayer.method_stats("foo")->latency_us.count());
+  EXPECT_GE(replayer.elapsed_sec(), 0.15);
+}
+
+TEST_F(RPCReplayerTest, OpenLoopMeasuresFromSchedule) {
+  RPCReplayer::tOptions options;
+  options.open_loop = true;
+  options.concurrency = 1;
+  options.qps = 1000;
+  // Each call takes 10ms, so the calls fall further and further behind.
+  RPCReplayer replayer(options, [](const tPlaybackRecord&, string*) {
+    this_thread::sleep_for(chrono::milliseconds(10));
+    return true;
+  });
+  replayer.Run({Record(0, "slow", ""), Record(0, "slow", ""),
+                Record(0, "slow", ""), Record(0, "slow", "")});
+  EXPECT_GE(replayer.method_stats("slow")->latency_us.max(), 30000);
+}
+
+TEST_F(RPCReplayerTest, ExpectedOutputs) {
+  vector<tPlaybackRecord> expected = calls_;
+  for (tPlaybackRecord& record : expected) {
+    record.has_output = true;
+    record.output = record.input;
+  }
+  expected[0].output = "different";
+  // Without an output: not checked.
+  expected[1].has_output = false;
+  expected[1].output = "different";
+
+  RPCReplayer::tOptions options;
+  options.concurrency = 2;
+  RPCReplayer replayer(options, &Echo);
+  replayer.SetExpectedOutputs(expected);
+  replayer.Run(calls_);
+  EXPECT_EQ(1, replayer.method_stats("foo")->mismatches);
+  EXPECT_EQ(0, replayer.method_stats("bar")->mismatches);
+  // Errors are not compared.
+  EXPECT_EQ(0, replayer.method_stats("fail")->mismatches);
+}
+
+}  // namespace test
+}  // namespace network
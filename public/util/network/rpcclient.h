@@ -10,7 +10,8 @@
 #include "util/serial/encoding/encoding.h"
 #include "util/serial/serializer.h"
 
-// An RPC client cannot be reused for multiple calls in parallel.
+// An RPC client cannot be reused for multiple calls in parallel. Use
+// RPCChannel (util/network/rpc_channel.h) for that.
 class RPCClient : public NetClient {
  public:
   virtual ~RPCClient() {};
@@ -25,7 +26,14 @@ class RPCClient : public NetClient {
         !serial::Serializer::FromBinaryPrependedSize(reply, &reply_msg))
       return "Server error -- Server does not support RPC, "
           "or invalid server response.";
+    return ParseRPCReply(reply_msg, output, output_cookie_full_spec);
+  }
 
+  // Same as above for a reply that has already been decoded.
+  template<class tOutput>
+    static string ParseRPCReply(const tServerReplyMessage& reply_msg,
+                                tOutput* output,
+                                string* output_cookie_full_spec) {
     if (reply_msg.success) {
       if (reply_msg.message.empty())
         return "Server error -- RPC reply is empty";
@@ -4,37 +4,72 @@
 #ifndef _PUBLIC_UTIL_NETWORK_RPCCLIENT_UTIL_H_
 #define _PUBLIC_UTIL_NETWORK_RPCCLIENT_UTIL_H_
 
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
 #include "base/lite.h"
 #include "util/codetranslator/server_config.h"
+#include "util/network/hedge_policy.h"
+#include "util/network/rpc_channel.h"
 #include "util/network/rpc_datatypes.h"
 #include "util/network/rpcclient.h"
 #include "util/serial/serializer.h"
+#include "util/time/timestamp.h"
 
 namespace network {
 
 // Convenience functions for making RPC calls
 
-// Standard template for a simple RPC call.
+// Makes an RPC call on a connection of its own.
 template<class tOutput>
-string MakeRPCCall(const string& server_name,
-                   const tServerRequestMessage& request, tOutput* output,
-                   string* output_cookie = nullptr, int timeout_ms = -1) {
+string MakeSingleRPCCall(const string& server_name,
+                         const tServerRequestMessage& request, tOutput* output,
+                         string* output_cookie, int timeout_ms) {
   RPCClient client;
-  // TODO(edelman, pramodg, vkasera): Use clientpool to avoid frequent
-  // connect/disconnect actions?
-  // vkasera already has this somewhere in a local file.
-  string err;
   static CodeTranslator::ServerConfig& server_config =
     CodeTranslator::ServerConfig::Instance();
   auto server = server_config.FindOneServer(server_name, 0);
   if (timeout_ms > 0) client.set_timeout_ms(timeout_ms);
-  if (!client.EstablishConnection(server->host, server->tcp_port)) {
-    err = "Cannot establish connection to " + server_name + "::" +
-          request.opname;
-    return err;
-  }
+  if (!client.EstablishConnection(server->host, server->tcp_port))
+    return "Cannot establish connection to " + server_name + "::" +
+        request.opname;
+  return client.Call(request, output, output_cookie);
+}
 
-  err = client.Call(request, output, output_cookie);
+// Starts an RPC call over the shared channel to the server and returns a
+// future for its result. Any number of calls may be in flight at once.
+template<class tOutput>
+future<RPCChannel::tResult<tOutput>> MakeRPCCallAsync(
+    const string& server_name, const tServerRequestMessage& request,
+    int timeout_ms = -1) {
+  static CodeTranslator::ServerConfig& server_config =
+    CodeTranslator::ServerConfig::Instance();
+  auto server = server_config.FindOneServer(server_name, 0);
+  return RPCChannel::Get(server->host, server->tcp_port)->CallAsync<tOutput>(
+      request, timeout_ms);
+}
+
+// Standard template for a simple RPC call.
+template<class tOutput>
+string MakeRPCCall(const string& server_name,
+                   const tServerRequestMessage& request, tOutput* output,
+                   string* output_cookie = nullptr, int timeout_ms = -1) {
+  string err;
+  if (gFlag_rpc_use_channels) {
+    if (output_cookie) output_cookie->clear();
+    RPCChannel::tResult<tOutput> result =
+        MakeRPCCallAsync<tOutput>(server_name, request, timeout_ms).get();
+    err = result.error;
+    if (err.empty()) {
+      *output = std::move(result.output);
+      if (output_cookie) *output_cookie = std::move(result.output_cookie);
+    }
+  } else {
+    err = MakeSingleRPCCall(server_name, request, output, output_cookie,
+                            timeout_ms);
+  }
 
   if (!err.empty()) {
     LOG(INFO) << "Error msg from " << server_name << " request "
@@ -56,6 +91,91 @@ string MakeRPCCall(const string& server_name, const string& method,
   return MakeRPCCall(server_name, request, output, output_cookie, timeout_ms);
 }
 
+// Like MakeRPCCall(), but if there is no reply within policy->DelayMs(), the
+// request is sent to a second replica of the server as well. Returns the first
+// successful reply, or an error once all the requests sent have failed. Only
+// use it for methods that can safely run twice.
+template<class tOutput>
+string MakeHedgedRPCCall(const string& server_name,
+                         const tServerRequestMessage& request, tOutput* output,
+                         string* output_cookie, int timeout_ms,
+                         HedgePolicy* policy) {
+  if (!gFlag_rpc_use_channels)
+    return MakeRPCCall(server_name, request, output, output_cookie,
+                       timeout_ms);
+  if (timeout_ms <= 0) timeout_ms = gFlag_netclient_default_timeout;
+
+  static CodeTranslator::ServerConfig& server_config =
+    CodeTranslator::ServerConfig::Instance();
+  vector<const CodeTranslator::tServerConfig*> servers;
+  server_config.FindServers(server_name, 0, &servers);
+  if (servers.empty()) return "No server found for " + server_name;
+
+  struct tState {
+    mutex m;
+    condition_variable cond_var;
+    int in_flight = 0;
+    bool done = false;
+    RPCChannel::tResult<tOutput> result;
+  };
+  shared_ptr<tState> state(new tState);
+  auto send = [&](const CodeTranslator::tServerConfig* server, int timeout) {
+    {
+      lock_guard<mutex> l(state->m);
+      ++state->in_flight;
+    }
+    uint64_t start = util::Timestamp::Now();
+    RPCChannel::Get(server->host, server->tcp_port)->CallAsync<tOutput>(
+        request, timeout,
+        [state, policy, start](RPCChannel::tResult<tOutput>* r) {
+      if (r->error.empty()) policy->Record(util::Timestamp::Now() - start);
+      lock_guard<mutex> l(state->m);
+      --state->in_flight;
+      if (state->done || (!r->error.empty() && state->in_flight > 0)) return;
+      state->result = std::move(*r);
+      state->done = true;
+      state->cond_var.notify_all();
+    });
+  };
+
+  int first = rand() % servers.size();
+  send(servers[first], timeout_ms);
+  int delay_ms = policy->DelayMs();
+  unique_lock<mutex> l(state->m);
+  if (servers.size() > 1 && delay_ms >= 0 && delay_ms < timeout_ms &&
+      !state->cond_var.wait_for(l, chrono::milliseconds(delay_ms),
+                                [&state] { return state->done; })) {
+    // Any replica but the first one.
+    int second = (first + 1 + rand() % (servers.size() - 1)) % servers.size();
+    VLOG(3) << "Hedging " << request.opname << " to " << server_name
+            << " after " << delay_ms << " ms";
+    l.unlock();
+    send(servers[second], timeout_ms - delay_ms);
+    l.lock();
+  }
+  state->cond_var.wait(l, [&state] { return state->done; });
+
+  if (output_cookie) output_cookie->clear();
+  if (state->result.error.empty()) {
+    *output = std::move(state->result.output);
+    if (output_cookie) *output_cookie = std::move(state->result.output_cookie);
+  } else {
+    LOG(INFO) << "Error msg from " << server_name << " request "
+              << request.opname << ": " << state->result.error;
+  }
+  return state->result.error;
+}
+
+// Same as above with the request built from its parts.
+template<class tInput, class tOutput>
+future<RPCChannel::tResult<tOutput>> MakeRPCCallAsync(
+    const string& server_name, const string& method, const tInput& input,
+    const string& input_cookie, const string& referrer, int timeout_ms = -1) {
+  tServerRequestMessage request(method, serial::Serializer::ToBinary(input),
+                                input_cookie, referrer);
+  return MakeRPCCallAsync<tOutput>(server_name, request, timeout_ms);
+}
+
 } // namespace network
 
 #endif  // _PUBLIC_UTIL_NETWORK_RPCCLIENT_UTIL_H_
@@ -3,19 +3,21 @@
 #include <random>
 #include <signal.h>
 #include <sstream>
-#include <sys/time.h>
 
 #include "util/network/rpcserver.h"
 
 #include "base/args/args.h"
 #include "base/signal_handler.h"
-#include "util/file/file.h"
+#include "util/network/http_request_parser.h"
 #include "util/network/method/common_methods/params/param_editor.h"
+#include "util/network/playback_log.h"
 #include "util/network/webserver.h"
 #include "util/serial/encoding/encoding.h"
 #include "util/serial/serializer.h"
 #include "util/string/strutil.h"
 #include "util/time/simple_timer.h"
+#include "util/time/timestamp.h"
+#include "util/thread/thread_pool_stats.h"
 #include "util/thread/thread_stack.h"
 
 FLAG_string(webroot, ".", "public web directory");
@@ -37,6 +39,14 @@ FLAG_int(max_recording_sec, 3600, "the maximum seconds a recording is allowed to
 FLAG_bool(validate_server, false,
           "Validates the server and exits if set.");
 
+FLAG_bool(rpc_shed_late_requests, true,
+          "Skip RPC requests that have waited for a worker for longer than "
+          "the caller is willing to wait for the reply.");
+
+FLAG_string(rpc_admission_targets, "",
+            "Comma separated list of opname=target_ms pairs that override "
+            "--netserver_admission_target_ms for the given methods.");
+
 
 namespace network {
 
@@ -52,6 +62,22 @@ int& RecordingStart() {
   return recording_start_ts;
 }
 
+// Deducts the time 'request' has waited for a worker from its timeout, so
+// calls made on its behalf do not outlive the caller. Returns false if the
+// caller has given up on it already.
+bool DeductQueueTime(const tConnectionInfo* connection,
+                     tServerRequestMessage* request) {
+  if (request->timeout_ms <= 0 || connection->received_ms == 0) return true;
+  int64_t waited = util::Timestamp::Now<chrono::milliseconds>() -
+      connection->received_ms;
+  if (waited < request->timeout_ms) {
+    request->timeout_ms -= waited;
+    return true;
+  }
+  request->timeout_ms = 1;
+  return !gFlag_rpc_shed_late_requests;
+}
+
 // return a random integer between 0 and (max - 1)
 inline int RandomInteger(int max) {
   int r = static_cast<int>(1.0 * rand() / (RAND_MAX + 1.0) * max);
@@ -106,6 +132,15 @@ void RPCServer::Initialize(const string& names) {
     ASSERT_NOTNULL(fwd_methods);
     forward_method_collection_->AddCollection(*fwd_methods);
   }
+  vector<string> targets;
+  strutil::SplitString(gFlag_rpc_admission_targets, ",", &targets);
+  for (const string& target : targets) {
+    vector<string> opname_target;
+    ASSERT(strutil::SplitString(target, "=", &opname_target) == 2)
+        << "Invalid --rpc_admission_targets: " << target;
+    SetAdmissionTarget(opname_target[0], atoi(opname_target[1].c_str()));
+  }
+
   // register the signal handle so will call shutdown
   if (!::base::SignalHandler::Instance().IsHandlerRegistered(SIGTERM)) {
     ASSERT(::base::SignalHandler::Instance().Register(
@@ -122,6 +157,22 @@ void RPCServer::Initialize(const string& names) {
   }
 }
 
+void RPCServer::SetAdmissionTarget(const string& opname, int target_ms,
+                                   int interval_ms) {
+  admission_by_opname_[opname].reset(
+      new AdmissionController(target_ms, interval_ms));
+}
+
+bool RPCServer::AdmitCall(const string& opname,
+                          const tConnectionInfo *connection) {
+  if (connection->dequeued_ms == 0) return true;
+  const auto i = admission_by_opname_.find(opname);
+  AdmissionController* admission = i != admission_by_opname_.end() ?
+      i->second.get() : admission_controller();
+  return admission->Admit(connection->dequeued_ms - connection->received_ms,
+                          connection->dequeued_ms);
+}
+
 util::SharedWriter& RPCServer::InputWriter() {
   stringstream ss;
   ss << gFlag_playback_input_fn << "_" << portnum_;
@@ -129,6 +180,13 @@ util::SharedWriter& RPCServer::InputWriter() {
   return input_writer;
 }
 
+util::SharedWriter& RPCServer::OutputWriter() {
+  stringstream ss;
+  ss << gFlag_playback_output_fn << "_" << portnum_;
+  static util::SharedWriter output_writer(ss.str());
+  return output_writer;
+}
+
 void RPCServer::StartServer() {
   if (gFlag_validate_server) {
     tConnectionInfo connection;
@@ -140,22 +198,39 @@ void RPCServer::StartServer() {
   NetServer::StartServer();
 }
 
+namespace {
+
+// Returns true if the request is an HTTP request (as opposed to one in our
+// internal RPC serialized format).
+inline bool IsHttpRequest(const RequestView& r) {
+  return r.starts_with("POST") || r.starts_with("GET");
+}
+
+}  // namespace
+
 // check if all bytes have been received
 bool RPCServer::RequestIsComplete(const string& r,
                                   unsigned int *request_size) const {
-  const char *s = r.c_str();
+  tRequestScanState state;
+  return RequestViewIsComplete(r, &state, request_size);
+}
 
-  if (!strncmp(s, "POST", 4) || !strncmp(s, "GET", 3)) {
+bool RPCServer::RequestViewIsComplete(const RequestView& r,
+                                      tRequestScanState *state,
+                                      unsigned int *request_size) const {
+  if (IsHttpRequest(r)) {
     // input is in JSON format via http
-    return WebServer::HttpRequestIsComplete(r, request_size, NULL, NULL, NULL,
-                                            NULL, NULL, NULL, NULL, NULL);
+    return WebServer::HttpRequestIsComplete(r, state, request_size);
   } else {
-    // Input is in our internal RPC serialized format.
-    if(RPCMessageIsComplete(r)) {
-      *request_size = r.size();
-      return true;
-    }
-    return false;
+    // Input is in our internal RPC serialized format. The size prefix tells
+    // us how much to wait for.
+    size_t total_size = serial::Serializer::PrependedSizeMessageLength(
+        r.data(), r.size());
+    if (total_size == 0) return false;
+    state->min_size = total_size;
+    if (r.size() < total_size) return false;
+    *request_size = total_size;
+    return true;
   }
 }
 
@@ -163,11 +238,25 @@ bool RPCServer::RequestIsComplete(const string& r,
 string RPCServer::ProcessRequest(const string& request,
                                  bool *keep_alive,
                                  const tConnectionInfo *connection) {
-  unsigned int request_len;
-  if (RequestIsComplete(request, &request_len)) {
-    const char *s = request.c_str();
+  NetResponse response;
+  ProcessRequestView(request, keep_alive, connection, nullptr, &response);
+  return response.ToString();
+}
 
-    if (!strncmp(s, "POST", 4) || !strncmp(s, "GET", 3)) {
+void RPCServer::ProcessRequestView(const RequestView& request,
+                                   bool *keep_alive,
+                                   const tConnectionInfo *connection,
+                                   const tRequestScanState *scan_state,
+                                   NetResponse *response) {
+  // The connection handlers pass the state in which RequestViewIsComplete()
+  // has parsed the request. Other requests are parsed here.
+  unsigned int request_len;
+  tRequestScanState parsed_state;
+  if (scan_state == nullptr &&
+      RequestViewIsComplete(request, &parsed_state, &request_len))
+    scan_state = &parsed_state;
+  if (scan_state != nullptr) {
+    if (IsHttpRequest(request)) {
       VLOG(4) << "processwebrequest:" << request;
       // input is in JSON format via http
       ::util::time::SimpleTimer timer;
@@ -179,26 +268,28 @@ string RPCServer::ProcessRequest(const string& request,
 
       string return_content_type = "text/plain";
 
-      unsigned int request_size;
-      string url, cgi_arguments, input_cookie, referrer;
-      bool accept_gzip, is_post;
+      // Fields are only copied out of the request where they are needed.
+      const HttpRequestParser& parser =
+          *static_cast<const HttpRequestParser *>(scan_state->parser.get());
+      const string url = parser.url().In(request).ToString();
+      const RequestView cgi_arguments = parser.CgiArguments(request);
+      const string input_cookie = parser.Header(request, "Cookie").ToString();
+      const string referrer = parser.Header(request, "Referer").ToString();
+      const bool accept_gzip = parser.AcceptsGzip(request);
+      const bool is_post = parser.is_post();
+      if (keep_alive != NULL)
+        *keep_alive = parser.KeepAlive(request);
 
       string output_cookie;
       string callback_hack;
 
-      unordered_map<string, string> http_header;
-
       vector<string> empty_cookies;
 
-      if (WebServer::HttpRequestIsComplete(request, &request_size,
-                                           &url, &cgi_arguments,
-                                           &input_cookie, &referrer,
-                                           &accept_gzip, keep_alive,
-                                           &is_post, &http_header)) {
+      {
         // log some info. Usage is called by HAProxy constantly to see server
         // status. This pollutes our logs too much. Suppressing logging for it
         // for now.
-        if (url != "/_usage")
+        if (url != "/_usage" && url != "/_usage_json")
           LogCaller(connection->caller_id,
                     WebServer::HttpRequestSummary(url, cgi_arguments, is_post));
 
@@ -210,22 +301,29 @@ string RPCServer::ProcessRequest(const string& request,
           // request the root page
           return_content_type = "text/html";
           unordered_map<string, string> arg_map;
-          if (!NetworkUtil::ParseCGIArguments(cgi_arguments, &arg_map))
+          if (!NetworkUtil::ParseCGIArguments(cgi_arguments.ToString(),
+                                              &arg_map))
             arg_map.clear();
           reply.message = ConstructRootForm(arg_map);
         } else if (!strcmp(opname, "URL")) {
           // request URL redirect
-          string target_url = strutil::GetTrimmedString(cgi_arguments);
-          if (target_url.empty())
-            return WebServer::ConstructHttpResponse
-                     (WebServer::gHttpResponse_NotFound, "", "",
-                      accept_gzip, empty_cookies, 0);
+          string target_url =
+              strutil::GetTrimmedString(cgi_arguments.ToString());
+          if (target_url.empty()) {
+            WebServer::ConstructHttpResponse(
+                WebServer::gHttpResponse_NotFound, "", "", accept_gzip,
+                empty_cookies, 0, response);
+            return;
+          }
           return_content_type = "text/html";
           reply.message = RedirectPage(target_url);
         } else if (!strcmp(opname, "_usage")) {
           // request usage page
           return_content_type = "text/html";
           reply.message = ReportUsage();
+        } else if (!strcmp(opname, "_usage_json")) {
+          return_content_type = "application/json";
+          reply.message = ReportUsageJSON();
         } else if (!strcmp(opname, "_status")) {
           // request status page
           return_content_type = "text/plain";
@@ -237,6 +335,7 @@ string RPCServer::ProcessRequest(const string& request,
           IsRecording() = true;
           // starts writing again at the beginning of the file
           InputWriter().Reset();
+          OutputWriter().Reset();
           // refreshes the recording timestamp
           RecordingStart() = time(NULL);
           reply.message = "Recording started";
@@ -266,22 +365,25 @@ string RPCServer::ProcessRequest(const string& request,
           // special RPC request wrapped in HTTP format
           // (client counterpart is HttpClient::RPCWrappedInHttpPost())
           // We assume the arg_map is set in the request directly.
+          unordered_map<string, string> http_header;
+          parser.GetHeaders(request, &http_header);
           tServerRequestMessage request_params("", "", input_cookie,
                                                referrer, http_header);
 
-          string rpc_reply = ProcessRPCRequest(cgi_arguments, connection,
-                                               request_params);
-          return WebServer::ConstructHttpResponse(WebServer::gHttpResponse_OK,
-                                                  rpc_reply,
-                                                  "application/octet-stream",
-                                                  accept_gzip,
-                                                  empty_cookies, 0);
+          WebServer::ConstructHttpResponse(
+              WebServer::gHttpResponse_OK,
+              ProcessRPCRequest(cgi_arguments, connection, request_params),
+              "application/octet-stream", accept_gzip, empty_cookies, 0,
+              response);
+          return;
         } else if (!strcmp(opname, "_validate")) {
           return_content_type = "text/plain";
-          tServerRequestMessage query("", request, input_cookie, referrer);
+          tServerRequestMessage query("", request.ToString(), input_cookie,
+                                      referrer);
           ostringstream out;
           unordered_map<string, string> arg_map;
-          if (!NetworkUtil::ParseCGIArguments(cgi_arguments, &arg_map))
+          if (!NetworkUtil::ParseCGIArguments(cgi_arguments.ToString(),
+                                              &arg_map))
             arg_map.clear();
 
           if (arg_map.find("method") != arg_map.end())
@@ -294,12 +396,16 @@ string RPCServer::ProcessRequest(const string& request,
           return_content_type = "text/plain";
           reply.message = "OK";
           bool status = CheckHealth();
-          if (!status)
-            return WebServer::ConstructHttpResponse(
-              WebServer::gHttpResponse_ServerError, "", "", accept_gzip, empty_cookies, 0);
+          if (!status) {
+            WebServer::ConstructHttpResponse(
+              WebServer::gHttpResponse_ServerError, "", "", accept_gzip,
+              empty_cookies, 0, response);
+            return;
+          }
         } else if (!strcmp(opname, "_threads")) {  // Threads of the server.
           return_content_type = "text/plain";
           reply.message =
+              util::threading::ThreadPoolStats::Report() + "\n" +
               util::threading::ThreadStack::Instance().GetTraceForAllThreads();
         }
         /*
@@ -324,19 +430,20 @@ string RPCServer::ProcessRequest(const string& request,
                 filename += '/';
             filename += opname;
 
-            string content;
-            if (file::ReadFileToString(filename, &content)) {
-              const int max_cache_seconds = 3600;  // todo: allow other values
-              return WebServer::ConstructHttpResponse
-                       (WebServer::gHttpResponse_OK,
-                        content,
-                        WebServer::GuessContentType(opname),
-                        accept_gzip, empty_cookies, max_cache_seconds);
-            } else {
-              return WebServer::ConstructHttpResponse
-                (WebServer::gHttpResponse_NotFound, "", "",
-                 accept_gzip, empty_cookies, 0);
-            }
+            const int max_cache_seconds = 3600;  // todo: allow other values
+            if (!WebServer::ConstructHttpFileResponse(
+                    filename, accept_gzip, max_cache_seconds, response))
+              WebServer::ConstructHttpResponse(
+                  WebServer::gHttpResponse_NotFound, "", "", accept_gzip,
+                  empty_cookies, 0, response);
+            return;
+          } else if (!AdmitCall(p.first, connection)) {
+            LogCaller(connection->caller_id,
+                      "server busy, request rejected -- " + p.first);
+            WebServer::ConstructHttpResponse(
+                WebServer::gHttpResponse_ServerBusy, "", "", accept_gzip,
+                empty_cookies, 0, response);
+            return;
           } else {
             // extract JSON input message from cgi argument
             //   variable q: JSON message
@@ -345,7 +452,8 @@ string RPCServer::ProcessRequest(const string& request,
             return_content_type = "text/plain";
 
             unordered_map<string, string> arg_map;
-            if (!NetworkUtil::ParseCGIArguments(cgi_arguments, &arg_map)) {
+            if (!NetworkUtil::ParseCGIArguments(cgi_arguments.ToString(),
+                                              &arg_map)) {
               // error parsing CGI arguments
               tErrorMessage_JSON err;
               err.error_msg = "Unable to parse CGI arguments.";
@@ -409,30 +517,33 @@ string RPCServer::ProcessRequest(const string& request,
                 // keep track of server usage
                 const string& opname = p.first;
                 int id = TrackUsage_Begin(opname.c_str(), true, json_input);
+                unordered_map<string, string> http_header;
+                parser.GetHeaders(request, &http_header);
                 tServerRequestMessage query("", json_input, input_cookie,
                                             referrer, http_header, arg_map);
 
-                if (IsRecording() && p.second->CanRecord() &&
-                    (time(NULL) - RecordingStart()) <= gFlag_max_recording_sec) {
-                  struct timeval current_time;
-                  gettimeofday(&current_time, NULL);
-                  stringstream ss;
-
-                  // \n \r may be sent via manual user input (typically for
-                  // debugging). Convert them to spaces to preserve one entry
-                  // per line property.
-                  string msg = query.message;
-                  for (int i = 0; i < msg.size(); ++i)
-                    if (msg[i] == '\n' || msg[i] == '\r') msg[i] = ' ';
-                  ss << fixed << setprecision(0)
-                     << current_time.tv_sec*1000.0 + current_time.tv_usec/1000.0
-                     << "\t" << opname
-                     << "\t" << msg;
-                  InputWriter().Write(ss.str());
+                // \n \r may be sent via manual user input (typically for
+                // debugging). They are recorded as spaces to preserve one
+                // entry per line property.
+                bool record = IsRecording() && p.second->CanRecord() &&
+                    (time(NULL) - RecordingStart()) <= gFlag_max_recording_sec;
+                tPlaybackRecord playback;
+                if (record) {
+                  playback.timestamp_ms =
+                      util::Timestamp::Now<chrono::milliseconds>();
+                  playback.opname = opname;
+                  playback.input = query.message;
+                  InputWriter().Write(FormatPlaybackRecord(playback));
                 }
                 p.second->ProcessJSON(connection, query, debug_json, &reply);
 
-                // @TODO(recording/playback): record timestamp and reply.message
+                // The outputs are recorded with their inputs, so a replay can
+                // be checked against them.
+                if (record && reply.success) {
+                  playback.has_output = true;
+                  playback.output = reply.message;
+                  OutputWriter().Write(FormatPlaybackRecord(playback));
+                }
 
                 TrackUsage_End(id);
               }
@@ -453,33 +564,37 @@ string RPCServer::ProcessRequest(const string& request,
       if (reply_http_response) {
         // return message as http response
         const int max_cache_seconds = 0;  // todo: allow other values
-        return WebServer::ConstructHttpResponse(WebServer::gHttpResponse_OK,
-                                                reply.message,
-                                                return_content_type,
-                                                accept_gzip,
-                                                reply.cookies,
-                                                max_cache_seconds);
+        WebServer::ConstructHttpResponse(WebServer::gHttpResponse_OK,
+                                         std::move(reply.message),
+                                         return_content_type,
+                                         accept_gzip,
+                                         reply.cookies,
+                                         max_cache_seconds,
+                                         response);
       } else {
-        return reply.message;
+        response->set_body(std::move(reply.message));
       }
+      return;
     } else {
       // input is in our internal RPC serialized format
 
       if (keep_alive != NULL)
         *keep_alive = true;  // allow multiple calls per connection
 
-      return ProcessRPCRequest(request, connection);
+      response->set_body(ProcessRPCRequest(request, connection));
+      return;
     }
   }
 
-  VLOG(3) << "Incomlete Request:" << serial::encoding::EscapeString(request);
-  return "";
+  VLOG(3) << "Incomlete Request:"
+          << serial::encoding::EscapeString(request.ToString());
 }
 
-string RPCServer::ProcessRPCRequest(const string& request,
+string RPCServer::ProcessRPCRequest(const RequestView& request,
                                     const tConnectionInfo *connection,
                                     const tServerRequestMessage& request_params) {
-  VLOG(4) << "processrpcrequest:" << serial::encoding::EscapeString(request);
+  VLOG(4) << "processrpcrequest:"
+          << serial::encoding::EscapeString(request.ToString());
   // strutil::PrintRaw(request);
 
   // attempt to parse request as "opname followed by message"
@@ -487,32 +602,39 @@ string RPCServer::ProcessRPCRequest(const string& request,
   tServerReplyMessage rpc_reply;
 
   // parse message as a simple RPC-serialized string
-  if (serial::Serializer::FromBinaryPrependedSize(request, &rpc_incoming)) {
+  if (serial::Serializer::FromBinaryPrependedSize(request.data(), request.size(),
+                                                 &rpc_incoming)) {
     LogCaller(connection->caller_id,
               string("rpc request -- ") + rpc_incoming.opname);
 
     // look up the appropriate handler
     pair<string, ServerMethodHandlerBase*> p =
         method_collection_->GetHandlerAndName(rpc_incoming.opname);
-    if (p.second == nullptr)
+    if (!DeductQueueTime(connection, &rpc_incoming)) {
+      // The caller has given up on the reply already.
+      LogCaller(connection->caller_id,
+                string("late rpc request -- ") + rpc_incoming.opname);
+      rpc_reply.message = "Deadline exceeded before the request was processed";
+    } else if (p.second != nullptr && !AdmitCall(p.first, connection)) {
+      LogCaller(connection->caller_id,
+                "server busy, rpc request rejected -- " + p.first);
+      rpc_reply.message = "Server busy";
+    } else if (p.second == nullptr)
       LOG(INFO) << "Undefined op-name received: " << rpc_incoming.opname;
     else {
       ServerMethodHandlerBase *h = p.second;
 
       // keep track of server usage
       const string& opname = p.first;
-      int id = TrackUsage_Begin(opname.c_str(), false,
-                                h->RPCToJSON(rpc_incoming.message));
+      // The input is converted to JSON only if it is shown on the usage page.
+      int id = TrackUsage_Begin(opname.c_str(), false, rpc_incoming.message);
       if (IsRecording() && h->CanRecord() &&
           (time(NULL) - RecordingStart()) <= gFlag_max_recording_sec) {
-        struct timeval current_time;
-        gettimeofday(&current_time, NULL);
-        stringstream ss;
-        ss << fixed << setprecision(0)
-           << current_time.tv_sec*1000.0 + current_time.tv_usec/1000.0
-           << "\t" << opname
-           << "\t" << h->RPCToJSON(rpc_incoming.message, -1);
-        InputWriter().Write(ss.str());
+        tPlaybackRecord playback;
+        playback.timestamp_ms = util::Timestamp::Now<chrono::milliseconds>();
+        playback.opname = opname;
+        playback.input = h->RPCToJSON(rpc_incoming.message, -1);
+        InputWriter().Write(FormatPlaybackRecord(playback));
       }
       // Merge metadata for the request if present.
       rpc_incoming.MergeMetaData(request_params);
@@ -521,6 +643,9 @@ string RPCServer::ProcessRPCRequest(const string& request,
     }
   } else LogCaller(connection->caller_id, "Invalid rpc request");
 
+  // Lets clients with several requests in flight match up the reply.
+  rpc_reply.request_id = rpc_incoming.request_id;
+
   // return string is the raw string further encoded in RPC format
   return serial::Serializer::ToBinaryPrependSize(rpc_reply);
 }
@@ -605,48 +730,11 @@ ServerMethodStatus RPCServer::ValidateMethod(const string& method,
 // server usage tracking
 int RPCServer::TrackUsage_Begin(const char *opname, bool is_json,
                                 const string& input) {
-  lock_guard<mutex> l(mutex_stat_);
-
-  // keep track of this pending method call
-  tPendingMethod *p = new tPendingMethod;
-  p->id = ++max_id_;
-  p->timestamp = time(NULL);
-  p->opname = opname;
-  p->is_json = is_json;
-  p->input_string = input;
-  in_progress_[p->id] = p;
-
-  return p->id;
+  return usage_.Begin(opname, is_json, input);
 }
 
 void RPCServer::TrackUsage_End(int id) {
-  lock_guard<mutex> l(mutex_stat_);
-
-  // remove internal record of this method call
-  unordered_map<int, tPendingMethod *>::iterator i = in_progress_.find(id);
-  ASSERT(i != in_progress_.end()) << "internal error -- invalid id provided";
-  tPendingMethod *p = i->second;
-  in_progress_.erase(i);
-
-  // keep track of method running time
-  int time_elapsed = time(NULL) - p->timestamp;
-  tMethodStat& method_stat = access_count_[p->opname];
-  if (method_stat.count == 0) {
-    method_stat.count = 1;
-    method_stat.time_min = time_elapsed;
-    method_stat.time_max = time_elapsed;
-    method_stat.time_total = time_elapsed;
-  }
-  else {
-    ++(method_stat.count);
-    if (time_elapsed < method_stat.time_min)
-      method_stat.time_min = time_elapsed;
-    if (time_elapsed > method_stat.time_max)
-      method_stat.time_max = time_elapsed;
-    method_stat.time_total += time_elapsed;
-  }
-
-  delete p;
+  usage_.End(id);
 }
 
 string RPCServer::RedirectPage(const string& url) const {
@@ -658,17 +746,11 @@ string RPCServer::RedirectPage(const string& url) const {
 }
 
 string RPCServer::ReportUsage() {
-  lock_guard<mutex> l(mutex_stat_);
-
   Time curr_time;
-  vector<int> id_list;
-  id_list.reserve(in_progress_.size());
-  for (unordered_map<int, tPendingMethod *>::const_iterator
-         i = in_progress_.begin();
-       i != in_progress_.end();
-       ++i)
-    id_list.push_back(i->first);
-  sort(id_list.begin(), id_list.end());
+  vector<UsageTracker::tCall> pending = usage_.PendingCalls();
+  uint64_t num_rejected = admission_controller()->num_rejected();
+  for (const auto& p : admission_by_opname_)
+    num_rejected += p.second->num_rejected();
 
   // dump all pending methods
   stringstream html;
@@ -695,63 +777,58 @@ string RPCServer::ReportUsage() {
        << "Server started: " << Time::PrintDuration(curr_time - init_time_)
        << " ago ("
        << init_time_.ToLocalTime(Timezone::PST()).Print() << " PST)<p>\n"
-       << "Total number of calls: " << max_id_ << "<p>\n"
+       << "Total number of calls: " << usage_.num_calls() << "<p>\n"
+       << "Calls rejected by admission control: " << num_rejected
+       << (admission_controller()->overloaded() ? " (overloaded)" : "")
+       << "<p>\n"
        << ("<table border=1><tr align=center><td><i>method</i></td>"
-           "<td><i>calls</i></td><td><i>min. time</i></td><td><i>max. time</i>"
-           "</td><td><i>avg. time</i></td></tr>\n");
-
-  // sort methods by access count (in descending order)
-  multimap<int, unordered_map<string, tMethodStat>::const_iterator> ops_sorted;
-  for (unordered_map<string, tMethodStat>::const_iterator i = access_count_.begin();
-       i != access_count_.end();
-       ++i) {
-    ops_sorted.insert(make_pair(-(i->second.count), i));
-  }
-  // print method access statistics in a table
-  for (multimap<int, unordered_map<string, tMethodStat>::const_iterator>
-         ::const_iterator j = ops_sorted.begin();
-       j != ops_sorted.end();
-       ++j) {
-    unordered_map<string, tMethodStat>::const_iterator i = j->second;
-    int count = i->second.count;
-    html << "<tr align=center><td>" << i->first
-         << "</td><td>" << count
-         << "</td><td>";
-    if (count > 0)
-      html << i->second.time_min << "s";
-    html << "</td><td>";
-    if (count > 0)
-      html << i->second.time_max << "s";
-    html << "</td><td>";
-    if (count > 0)
-      html << i->second.time_total / count << "s";
-    html << "</td></tr>\n";
+           "<td><i>calls</i></td><td><i>avg. time</i></td>"
+           "<td><i>p50</i></td><td><i>p90</i></td><td><i>p99</i></td>"
+           "<td><i>p99.9</i></td><td><i>max. time</i></td>"
+           "<td><i>cache hits</i></td><td><i>cache misses</i></td></tr>\n");
+
+  // print method access statistics in a table, most called first
+  html << fixed << setprecision(2);
+  for (const tMethodUsage& u : GetMethodUsage()) {
+    html << "<tr align=center><td>" << u.method
+         << "</td><td>" << u.calls
+         << "</td><td>" << u.mean_ms << "ms"
+         << "</td><td>" << u.p50_ms << "ms"
+         << "</td><td>" << u.p90_ms << "ms"
+         << "</td><td>" << u.p99_ms << "ms"
+         << "</td><td>" << u.p999_ms << "ms"
+         << "</td><td>" << u.max_ms << "ms"
+         << "</td><td>" << u.cache_hits
+         << "</td><td>" << u.cache_misses
+         << "</td></tr>\n";
   }
 
   html << "</table><p>\n"
-       << "Number of pending calls: " << id_list.size() << "<p>\n";
+       << "Number of pending calls: " << pending.size() << "<p>\n";
 
-  if (!id_list.empty()) {
+  if (!pending.empty()) {
     html << ("List of pending calls:<p>\n"
              "<table border=1>\n"
              "<tr><td><i>seq. #</i></td><td><i>time elapsed</i></td>"
              "<td><i>method</i></td><td><i>protocol</i></td>"
              "<td><i>input</i></td>\n");
 
-    for (int i = 0; i < id_list.size(); i++) {
-      unordered_map<int, tPendingMethod *>::const_iterator itr =
-        in_progress_.find(id_list[i]);
-      ASSERT(itr != in_progress_.end());
-      const tPendingMethod *p = itr->second;
-      html << "<tr align=center><td>" << p->id
-           << "</td>\n<td>" << (curr_time.t() - p->timestamp)
-           << "s</td>\n<td>" << p->opname
-           << "</td>\n<td>" << (p->is_json ? "json" : "rpc")
+    for (int i = 0; i < pending.size(); i++) {
+      const UsageTracker::tCall& p = pending[i];
+      string input = p.input;
+      if (!p.is_json) {
+        ServerMethodHandlerBase *h = method_collection_->GetHandler(p.opname);
+        if (h != nullptr) input = h->RPCToJSON(p.input);
+      }
+      html << "<tr align=center><td>" << p.id
+           << "</td>\n<td>" << (curr_time.t() - p.timestamp)
+           << "s</td>\n<td>" << p.opname
+           << "</td>\n<td>" << (p.is_json ? "json" : "rpc")
            << ("</td>\n<td align=left>"
                "<a href=\"javascript:toggleinput(")
            << i << ")\"><div id=\"toggle" << i
            << "\">show</div></a><div id=\"inputstr" << i
-           << "\" style=\"display:none;\"><pre>\n" << p->input_string
+           << "\" style=\"display:none;\"><pre>\n" << input
            << "\n</pre></div></td></tr>\n";
     }
     html << "</table>\n";
@@ -762,6 +839,23 @@ string RPCServer::ReportUsage() {
   return html.str();
 }
 
+string RPCServer::ReportUsageJSON() const {
+  return serial::Serializer::ToJSON(GetMethodUsage());
+}
+
+vector<tMethodUsage> RPCServer::GetMethodUsage() const {
+  vector<tMethodUsage> usage = usage_.GetMethodUsage();
+  for (tMethodUsage& u : usage) {
+    ServerMethodHandlerBase *h = method_collection_->GetHandler(u.method);
+    tResponseCacheStats cache;
+    if (h != nullptr && h->GetResponseCacheStats(&cache)) {
+      u.cache_hits = cache.hits + cache.coalesced;
+      u.cache_misses = cache.misses;
+    }
+  }
+  return usage;
+}
+
 void RPCServer::PrintProxyConfig() const {
   // sort the list of opcodes
   set<string> opnames = method_collection_->MethodNames<set<string> >();
@@ -10,6 +10,7 @@
 
 #include "util/network/netserver.h"
 #include "util/network/rpc_datatypes.h"
+#include "util/network/usage_tracker.h"
 #include "util/network/method/server_method_handler.h"
 #include "util/network/method/server_method_forward_collection.h"
 #include "util/network/util.h"
@@ -31,34 +32,21 @@ namespace network {
 
 class ServerMethodForwardCollection;
 
-struct tPendingMethod {
-  int id;
-  time_t timestamp;
-  string opname;
-  bool is_json;
-  string input_string;
-};
-
-// Stats for each server method.
-struct tMethodStat {
-  int count;
-  int time_min, time_max;  // min/max running time
-  long long time_total;  // in order to calculate average running time
-  tMethodStat() : count(0), time_min(0), time_max(0), time_total(0) {}
-};
-
 // Class to implement RPC server.
 class RPCServer : public NetServer {
  public:
   // Comma separated list of names for which the server methods are allowed for
   // this server. The first name is assumed to be the name of the server.
-  RPCServer(const string& names = "server") : NetServer(), max_id_(0) {
+  RPCServer(const string& names = "server") : NetServer() {
     Initialize(names);
   }
 
   virtual ~RPCServer();
 
+  // The files the calls are recorded to while /_startrecord is on (see
+  // playback_log.h).
   util::SharedWriter& InputWriter();
+  util::SharedWriter& OutputWriter();
 
   virtual void StartServer();
 
@@ -77,6 +65,15 @@ class RPCServer : public NetServer {
     method_collection_->Register(opname, method);
   }
 
+  // Sets the admission control of method 'opname': once the queue of
+  // requests waiting for a worker is standing, its calls that have waited
+  // longer than 'target_ms' are rejected (see AdmissionController).
+  // 'target_ms' <= 0 admits all its calls. Methods without a setting of their
+  // own share the server's. Must be called before StartServer().
+  void SetAdmissionTarget(
+      const string& opname, int target_ms,
+      int interval_ms = gFlag_netserver_admission_interval_ms);
+
   // print sample proxy configuration lines for Apache 2.0 (launch preparation)
   void PrintProxyConfig() const;
 
@@ -98,16 +95,31 @@ class RPCServer : public NetServer {
   // check if all bytes have been received
   virtual bool RequestIsComplete(const string& r,
                                  unsigned int *request_size) const;
+  virtual bool RequestViewIsComplete(const RequestView& r,
+                                     tRequestScanState *state,
+                                     unsigned int *request_size) const;
 
   // allow multiple requests per connection
   virtual bool OneRequestPerConnection() const { return false; }
 
+  // Requests are admitted per method, once their opname is known.
+  virtual bool AdmitRequest(const RequestView& request,
+                            const tConnectionInfo *connection) {
+    return true;
+  }
+  bool AdmitCall(const string& opname, const tConnectionInfo *connection);
+
   // process a request
   virtual string ProcessRequest(const string& request,
                                 bool *keep_alive,
                                 const tConnectionInfo *connection);
+  virtual void ProcessRequestView(const RequestView& request,
+                                  bool *keep_alive,
+                                  const tConnectionInfo *connection,
+                                  const tRequestScanState *scan_state,
+                                  NetResponse *response);
 
-  string ProcessRPCRequest(const string& request,
+  string ProcessRPCRequest(const RequestView& request,
                            const tConnectionInfo *connection,
                            const tServerRequestMessage& request_params = {});
 
@@ -118,17 +130,18 @@ class RPCServer : public NetServer {
   int TrackUsage_Begin(const char *opname, bool is_json, const string& input);
   void TrackUsage_End(int id);
   string RedirectPage(const string& url) const;
+  // The usage of each method, with the stats of its reply cache.
+  vector<tMethodUsage> GetMethodUsage() const;
   string ReportUsage();
+  string ReportUsageJSON() const;
   virtual bool CheckHealth() const;
 
   Time init_time_;
-  int max_id_;
   string name_;
   shared_ptr<ServerMethodHandlerCollection> method_collection_;
   shared_ptr<ServerMethodForwardCollection> forward_method_collection_;
-  unordered_map<int, tPendingMethod *> in_progress_;
-  unordered_map<string, tMethodStat> access_count_;
-  mutex mutex_stat_;
+  UsageTracker usage_;
+  unordered_map<string, unique_ptr<AdmissionController>> admission_by_opname_;
 };
 
 }  // namespace network
@@ -1,6 +1,7 @@
 //
 // Copyright 2007 OpTrip, Inc.
 //
+#include <algorithm>
 #include <condition_variable>
 #include <functional>
 #include <memory>
@@ -48,11 +49,17 @@ class EchoClient : public NetClient {
  public:
   EchoClient() {};
   virtual ~EchoClient() {};
+
+  // Expect this many lines in the reply.
+  void set_expected_lines(int n) { expected_lines_ = n; }
+
  private:
-  // incoming reply data is complete if it contains newline character
+  // incoming reply data is complete if it contains enough newline characters
   virtual bool ReplyIsComplete() const {
-    return (strchr(reply_.c_str(), '\n') != NULL);
+    return count(reply_.begin(), reply_.end(), '\n') >= expected_lines_;
   }
+
+  int expected_lines_ = 1;
 };
 
 class EchoClientServerTest : public testing::Test {
@@ -111,4 +118,13 @@ TEST_F(EchoClientServerTest, Sanity) {
 
 }
 
+TEST_F(EchoClientServerTest, Pipelined) {
+  // All the requests arrive together and must all be answered.
+  const string str = "one\ntwo\nthree\n";
+  client_->set_expected_lines(3);
+  EXPECT_TRUE(client_->SendMessage(str));
+  EXPECT_TRUE(client_->WaitForReply());
+  EXPECT_EQ(str, client_->get_reply());
+}
+
 }  // namespace test
@@ -0,0 +1,153 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Tests for the admission control of NetServer without epoll: connections
+// wait for a worker of the thread pool, and those that waited too long are
+// rejected.
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "util/network/netclient.h"
+#include "util/network/netserver.h"
+#include "test/cc/test_main.h"
+
+extern int gFlag_use_thread_pool;
+extern int gFlag_server_thread_pool_size;
+extern int gFlag_netserver_admission_target_ms;
+extern int gFlag_netserver_admission_interval_ms;
+
+FLAG_int(admission_test_port, 11113, "admission test server port number");
+
+namespace test {
+
+const int kSleepMs = 300;
+
+// Echoes lines, one per connection. "sleep" takes kSleepMs to process.
+class SlowEchoServer : public NetServer {
+ public:
+  // The longest wait for a worker of the requests admitted or rejected.
+  uint64_t max_sojourn_ms() {
+    lock_guard<mutex> l(mutex_);
+    return max_sojourn_ms_;
+  }
+
+ private:
+  virtual bool RequestIsComplete(const string& r,
+                                 unsigned int *request_size) const {
+    size_t loc = r.find('\n');
+    if (loc == string::npos) return false;
+    *request_size = loc + 1;
+    return true;
+  }
+
+  virtual bool AdmitRequest(const RequestView& request,
+                            const tConnectionInfo *connection) {
+    EXPECT_NE(0, connection->dequeued_ms);
+    {
+      lock_guard<mutex> l(mutex_);
+      max_sojourn_ms_ = max(max_sojourn_ms_,
+                            connection->dequeued_ms - connection->received_ms);
+    }
+    return NetServer::AdmitRequest(request, connection);
+  }
+
+  virtual string ProcessRequest(const string& request,
+                                bool *keep_alive,
+                                const tConnectionInfo *connection) {
+    if (request == "sleep\n")
+      this_thread::sleep_for(chrono::milliseconds(kSleepMs));
+    return request;
+  }
+
+  mutex mutex_;
+  uint64_t max_sojourn_ms_ = 0;
+};
+
+class LineClient : public NetClient {
+ private:
+  virtual bool ReplyIsComplete() const {
+    return reply_.find('\n') != string::npos;
+  }
+};
+
+class NetServerAdmissionTest : public testing::Test {
+ public:
+  static void SetUpTestCase() {
+    // A single worker, and requests that wait for longer than an interval
+    // are rejected.
+    gFlag_use_thread_pool = 1;
+    gFlag_server_thread_pool_size = 1;
+    gFlag_netserver_admission_target_ms = 10;
+    gFlag_netserver_admission_interval_ms = 100;
+    mutex m;
+    unique_lock<mutex> lock(m);
+    condition_variable cond_var;
+    server_thread_.reset(new thread(bind(
+        &NetServerAdmissionTest::AsyncStartServer, &m, &cond_var)));
+    cond_var.wait(lock);
+  }
+
+  static void TearDownTestCase() {
+    server_->set_prepare_shutdown(true);
+    server_thread_->join();
+  }
+
+  static void AsyncStartServer(mutex* m, condition_variable* cond_var) {
+    server_.reset(new SlowEchoServer());
+    server_->set_portnum(gFlag_admission_test_port);
+    server_->set_return_on_shutdown(true);
+    server_->PrepareServer();
+    {
+      unique_lock<mutex> lock(*m);
+      cond_var->notify_one();
+    }
+    server_->StartServer();
+  }
+
+ protected:
+  unique_ptr<LineClient> Connect() {
+    unique_ptr<LineClient> client(new LineClient());
+    EXPECT_TRUE(client->EstablishConnection("localhost",
+                                            gFlag_admission_test_port))
+        << "Unable to establish connection.";
+    return client;
+  }
+
+  static unique_ptr<SlowEchoServer> server_;
+  static unique_ptr<thread> server_thread_;
+};
+
+unique_ptr<SlowEchoServer> NetServerAdmissionTest::server_;
+unique_ptr<thread> NetServerAdmissionTest::server_thread_;
+
+TEST_F(NetServerAdmissionTest, RejectsQueuedConnections) {
+  // Keep the only worker busy.
+  unique_ptr<LineClient> slow = Connect();
+  EXPECT_TRUE(slow->SendMessage("sleep\n"));
+  this_thread::sleep_for(chrono::milliseconds(50));
+
+  // Waits for the worker for longer than an interval.
+  unique_ptr<LineClient> queued = Connect();
+  EXPECT_TRUE(queued->SendMessage("hello\n"));
+
+  EXPECT_TRUE(slow->WaitForReply());
+  EXPECT_EQ("sleep\n", slow->get_reply());
+  queued->WaitForReply();
+  EXPECT_EQ("", queued->get_reply());
+  EXPECT_EQ(1, server_->admission_controller()->num_rejected());
+  EXPECT_GE(server_->max_sojourn_ms(), kSleepMs - 100);
+
+  // Connections that do not wait are admitted.
+  unique_ptr<LineClient> next = Connect();
+  EXPECT_TRUE(next->SendMessage("hello\n"));
+  EXPECT_TRUE(next->WaitForReply());
+  EXPECT_EQ("hello\n", next->get_reply());
+  EXPECT_EQ(1, server_->admission_controller()->num_rejected());
+}
+
+}  // namespace test
@@ -0,0 +1,169 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Tests for the epoll reactor mode of NetServer.
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "util/network/netclient.h"
+#include "util/network/netserver.h"
+#include "test/cc/test_main.h"
+
+extern bool gFlag_netserver_use_epoll;
+extern int gFlag_netserver_io_threads;
+
+FLAG_int(reactor_test_port, 11112, "reactor test server port number");
+
+namespace test {
+
+class LineEchoServer : public NetServer {
+ private:
+  // Incoming request is complete if it contains a newline character.
+  virtual bool RequestIsComplete(const string& r,
+                                 unsigned int *request_size) const {
+    size_t loc = r.find('\n');
+    if (loc == string::npos) return false;
+    *request_size = loc + 1;
+    return true;
+  }
+
+  // Allow multiple requests per connection.
+  virtual bool OneRequestPerConnection() const { return false; }
+
+  // Process a request by echoing it. "close" closes the connection.
+  virtual string ProcessRequest(const string& request,
+                                bool *keep_alive,
+                                const tConnectionInfo *connection) {
+    *keep_alive = (request != "close\n");
+    return request;
+  }
+};
+
+class LineEchoClient : public NetClient {
+ public:
+  // Expect this many lines in the reply.
+  void set_expected_lines(int n) { expected_lines_ = n; }
+
+ private:
+  virtual bool ReplyIsComplete() const {
+    int lines = 0;
+    for (size_t pos = reply_.find('\n'); pos != string::npos;
+         pos = reply_.find('\n', pos + 1))
+      ++lines;
+    return lines >= expected_lines_;
+  }
+
+  int expected_lines_ = 1;
+};
+
+class NetServerReactorTest : public testing::Test {
+ public:
+  static void SetUpTestCase() {
+    gFlag_netserver_use_epoll = true;
+    gFlag_netserver_io_threads = 2;
+    mutex m;
+    unique_lock<mutex> lock(m);
+    condition_variable cond_var;
+    server_thread_.reset(new thread(bind(
+        &NetServerReactorTest::AsyncStartServer, &m, &cond_var)));
+    cond_var.wait(lock);
+  }
+
+  static void TearDownTestCase() {
+    server_->set_prepare_shutdown(true);
+    server_thread_->join();
+    gFlag_netserver_use_epoll = false;
+  }
+
+  static void AsyncStartServer(mutex* m, condition_variable* cond_var) {
+    server_.reset(new LineEchoServer());
+    server_->set_portnum(gFlag_reactor_test_port);
+    server_->set_return_on_shutdown(true);
+    server_->PrepareServer();
+    {
+      unique_lock<mutex> lock(*m);
+      cond_var->notify_one();
+    }
+    server_->StartServer();
+  }
+
+ protected:
+  unique_ptr<LineEchoClient> Connect() {
+    unique_ptr<LineEchoClient> client(new LineEchoClient());
+    EXPECT_TRUE(client->EstablishConnection("localhost",
+                                            gFlag_reactor_test_port))
+        << "Unable to establish connection.";
+    return client;
+  }
+
+  static unique_ptr<LineEchoServer> server_;
+  static unique_ptr<thread> server_thread_;
+};
+
+unique_ptr<LineEchoServer> NetServerReactorTest::server_;
+unique_ptr<thread> NetServerReactorTest::server_thread_;
+
+TEST_F(NetServerReactorTest, Sanity) {
+  unique_ptr<LineEchoClient> client = Connect();
+  const string str = "hello world\n";
+  EXPECT_TRUE(client->SendMessage(str));
+  EXPECT_TRUE(client->WaitForReply());
+  EXPECT_EQ(str, client->get_reply());
+}
+
+TEST_F(NetServerReactorTest, KeepAlive) {
+  unique_ptr<LineEchoClient> client = Connect();
+  for (int i = 0; i < 10; ++i) {
+    const string str = "request " + to_string(i) + "\n";
+    EXPECT_TRUE(client->SendMessage(str));
+    EXPECT_TRUE(client->WaitForReply());
+    EXPECT_EQ(str, client->get_reply());
+  }
+}
+
+TEST_F(NetServerReactorTest, Pipelined) {
+  unique_ptr<LineEchoClient> client = Connect();
+  const string str = "one\ntwo\nthree\n";
+  client->set_expected_lines(3);
+  EXPECT_TRUE(client->SendMessage(str));
+  EXPECT_TRUE(client->WaitForReply());
+  EXPECT_EQ(str, client->get_reply());
+}
+
+TEST_F(NetServerReactorTest, ServerClosesConnection) {
+  unique_ptr<LineEchoClient> client = Connect();
+  // The reply is followed by the server closing the connection.
+  client->set_expected_lines(2);
+  EXPECT_TRUE(client->SendMessage("close\n"));
+  EXPECT_TRUE(client->WaitForReply());
+  EXPECT_EQ("close\n", client->get_reply());
+}
+
+TEST_F(NetServerReactorTest, LargeReply) {
+  unique_ptr<LineEchoClient> client = Connect();
+  // Larger than the default socket buffers to exercise partial writes.
+  const string str = string(4 << 20, 'x') + "\n";
+  EXPECT_TRUE(client->SendMessage(str));
+  EXPECT_TRUE(client->WaitForReply());
+  EXPECT_EQ(str.size(), client->get_reply().size());
+}
+
+TEST_F(NetServerReactorTest, ManyConnections) {
+  const int kNumClients = 200;
+  vector<unique_ptr<LineEchoClient>> clients;
+  for (int i = 0; i < kNumClients; ++i) clients.push_back(Connect());
+
+  for (int i = 0; i < kNumClients; ++i)
+    EXPECT_TRUE(clients[i]->SendMessage("client " + to_string(i) + "\n"));
+
+  for (int i = 0; i < kNumClients; ++i) {
+    EXPECT_TRUE(clients[i]->WaitForReply());
+    EXPECT_EQ("client " + to_string(i) + "\n", clients[i]->get_reply());
+  }
+}
+
+}  // namespace test
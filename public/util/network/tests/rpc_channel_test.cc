@@ -0,0 +1,226 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Tests for RPCChannel against a minimal RPC server.
+
+#include <signal.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "util/network/netserver.h"
+#include "util/network/rpc_channel.h"
+#include "test/cc/test_main.h"
+
+FLAG_int(rpc_channel_test_port, 11113, "rpc channel test server port number");
+
+namespace test {
+
+// Serves "echo", "sleep" (input: milliseconds), "timeout" (returns the
+// timeout of the request) and "fail".
+class TestRPCServer : public NetServer {
+ public:
+  void set_echo_ids(bool echo) { echo_ids_ = echo; }
+
+ private:
+  virtual bool RequestIsComplete(const string& r,
+                                 unsigned int *request_size) const {
+    size_t len = serial::Serializer::PrependedSizeMessageLength<unsigned int>(
+        r.data(), r.size());
+    if (len == 0 || len > r.size()) return false;
+    *request_size = len;
+    return true;
+  }
+
+  virtual bool OneRequestPerConnection() const { return false; }
+
+  virtual string ProcessRequest(const string& request,
+                                bool *keep_alive,
+                                const tConnectionInfo *connection) {
+    *keep_alive = true;
+    tServerRequestMessage in;
+    tServerReplyMessage out;
+    if (!serial::Serializer::FromBinaryPrependedSize(request, &in))
+      return "";
+    out.success = true;
+    if (in.opname == "echo") {
+      out.message = in.message;
+    } else if (in.opname == "sleep") {
+      int ms = 0;
+      serial::Serializer::FromBinary(in.message, &ms);
+      this_thread::sleep_for(chrono::milliseconds(ms));
+      out.message = in.message;
+      out.cookies.push_back("slept=1");
+    } else if (in.opname == "timeout") {
+      out.message = serial::Serializer::ToBinary(in.timeout_ms);
+    } else {
+      out.success = false;
+      out.message = "failed";
+    }
+    if (echo_ids_) out.request_id = in.request_id;
+    return serial::Serializer::ToBinaryPrependSize(out);
+  }
+
+  atomic<bool> echo_ids_{true};
+};
+
+class RPCChannelTest : public testing::Test {
+ public:
+  static void SetUpTestCase() {
+    signal(SIGPIPE, SIG_IGN);
+    mutex m;
+    unique_lock<mutex> lock(m);
+    condition_variable cond_var;
+    server_thread_.reset(new thread(bind(
+        &RPCChannelTest::AsyncStartServer, &m, &cond_var)));
+    cond_var.wait(lock);
+  }
+
+  static void TearDownTestCase() {
+    server_->set_prepare_shutdown(true);
+    server_thread_->join();
+  }
+
+  static void AsyncStartServer(mutex* m, condition_variable* cond_var) {
+    server_.reset(new TestRPCServer());
+    server_->set_portnum(gFlag_rpc_channel_test_port);
+    server_->set_return_on_shutdown(true);
+    server_->PrepareServer();
+    {
+      unique_lock<mutex> lock(*m);
+      cond_var->notify_one();
+    }
+    server_->StartServer();
+  }
+
+ protected:
+  virtual void TearDown() { server_->set_echo_ids(true); }
+
+  unique_ptr<network::RPCChannel> NewChannel(int num_connections = 2) {
+    return unique_ptr<network::RPCChannel>(new network::RPCChannel(
+        "localhost", gFlag_rpc_channel_test_port, num_connections));
+  }
+
+  template<class T>
+  static tServerRequestMessage Request(const string& opname, const T& input) {
+    return tServerRequestMessage(opname, serial::Serializer::ToBinary(input));
+  }
+
+  static unique_ptr<TestRPCServer> server_;
+  static unique_ptr<thread> server_thread_;
+};
+
+unique_ptr<TestRPCServer> RPCChannelTest::server_;
+unique_ptr<thread> RPCChannelTest::server_thread_;
+
+TEST_F(RPCChannelTest, Call) {
+  auto channel = NewChannel();
+  string output, cookie;
+  EXPECT_EQ("", channel->Call(Request("echo", string("hello")), &output,
+                              &cookie));
+  EXPECT_EQ("hello", output);
+  EXPECT_EQ("", cookie);
+
+  int slept = 0;
+  EXPECT_EQ("", channel->Call(Request("sleep", 1), &slept, &cookie));
+  EXPECT_EQ(1, slept);
+  EXPECT_EQ("slept=1", cookie);
+}
+
+TEST_F(RPCChannelTest, PassesTimeout) {
+  auto channel = NewChannel();
+  int timeout_ms = 0;
+  EXPECT_EQ("", channel->Call(Request("timeout", 0), &timeout_ms, nullptr,
+                              1234));
+  EXPECT_EQ(1234, timeout_ms);
+
+  // A shorter timeout set by the caller is kept.
+  tServerRequestMessage request = Request("timeout", 0);
+  request.timeout_ms = 100;
+  EXPECT_EQ("", channel->Call(request, &timeout_ms, nullptr, 1234));
+  EXPECT_EQ(100, timeout_ms);
+}
+
+TEST_F(RPCChannelTest, ServerError) {
+  auto channel = NewChannel();
+  string output;
+  EXPECT_EQ("failed", channel->Call(Request("fail", 0), &output, nullptr));
+}
+
+TEST_F(RPCChannelTest, ManyInFlight) {
+  auto channel = NewChannel();
+  const int kNumThreads = 4, kCallsPerThread = 250;
+  vector<thread> threads;
+  atomic<int> num_ok(0);
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.push_back(thread([&, t]() {
+      vector<future<network::RPCChannel::tResult<string>>> results;
+      for (int i = 0; i < kCallsPerThread; ++i) {
+        results.push_back(channel->CallAsync<string>(
+            Request("echo", to_string(t) + ":" + to_string(i))));
+      }
+      for (int i = 0; i < kCallsPerThread; ++i) {
+        network::RPCChannel::tResult<string> r = results[i].get();
+        EXPECT_EQ("", r.error);
+        EXPECT_EQ(to_string(t) + ":" + to_string(i), r.output);
+        if (r.error.empty()) ++num_ok;
+      }
+    }));
+  }
+  for (thread& t : threads) t.join();
+  EXPECT_EQ(kNumThreads * kCallsPerThread, num_ok);
+}
+
+TEST_F(RPCChannelTest, Callback) {
+  auto channel = NewChannel();
+  promise<string> p;
+  channel->CallAsync<string>(Request("echo", string("callback")), -1,
+      [&p](network::RPCChannel::tResult<string>* r) {
+    p.set_value(r->error.empty() ? r->output : r->error);
+  });
+  EXPECT_EQ("callback", p.get_future().get());
+}
+
+TEST_F(RPCChannelTest, Timeout) {
+  auto channel = NewChannel(1);
+  auto slow = channel->CallAsync<int>(Request("sleep", 500), 100);
+  // Queued behind the slow call on the same connection.
+  auto next = channel->CallAsync<string>(Request("echo", string("next")));
+  EXPECT_EQ("Server timeout or error", slow.get().error);
+
+  // The late reply to the slow call is dropped.
+  network::RPCChannel::tResult<string> r = next.get();
+  EXPECT_EQ("", r.error);
+  EXPECT_EQ("next", r.output);
+}
+
+TEST_F(RPCChannelTest, ServerWithoutRequestIds) {
+  server_->set_echo_ids(false);
+  auto channel = NewChannel(1);
+  vector<future<network::RPCChannel::tResult<string>>> results;
+  for (int i = 0; i < 10; ++i)
+    results.push_back(channel->CallAsync<string>(Request("echo", to_string(i))));
+  // Replies are matched in order.
+  for (int i = 0; i < 10; ++i) EXPECT_EQ(to_string(i), results[i].get().output);
+}
+
+TEST_F(RPCChannelTest, NoServer) {
+  network::RPCChannel channel("localhost", gFlag_rpc_channel_test_port + 1, 1);
+  string output;
+  EXPECT_NE("", channel.Call(Request("echo", string("x")), &output, nullptr));
+}
+
+TEST_F(RPCChannelTest, Shared) {
+  EXPECT_EQ(network::RPCChannel::Get("localhost", 1).get(),
+            network::RPCChannel::Get("localhost", 1).get());
+  EXPECT_NE(network::RPCChannel::Get("localhost", 1).get(),
+            network::RPCChannel::Get("localhost", 2).get());
+}
+
+}  // namespace test
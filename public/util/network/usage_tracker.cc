@@ -0,0 +1,105 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/network/usage_tracker.h"
+
+#include <algorithm>
+
+#include "util/time/timestamp.h"
+
+FLAG_int(rpc_usage_shards, 16,
+         "The number of shards server usage statistics are recorded in.");
+
+namespace network {
+
+UsageTracker::UsageTracker(int num_shards) {
+  if (num_shards <= 0) num_shards = max(1, gFlag_rpc_usage_shards);
+  for (int i = 0; i < num_shards; ++i)
+    shards_.push_back(unique_ptr<Shard>(new Shard));
+}
+
+UsageTracker::Shard& UsageTracker::ThisShard() {
+  static atomic<unsigned int> next_thread(0);
+  static thread_local unsigned int thread_index = next_thread++;
+  return *shards_[thread_index % shards_.size()];
+}
+
+int UsageTracker::Begin(const string& opname, bool is_json,
+                        const string& input) {
+  tCall call;
+  call.id = ++max_id_;
+  call.timestamp = time(NULL);
+  call.opname = opname;
+  call.is_json = is_json;
+  call.input = input;
+  call.start_us = util::Timestamp::Now();
+
+  Shard& shard = ThisShard();
+  lock_guard<mutex> l(shard.m);
+  int id = call.id;
+  shard.pending.insert(make_pair(id, std::move(call)));
+  return id;
+}
+
+void UsageTracker::End(int id) {
+  uint64_t now = util::Timestamp::Now();
+  Shard& shard = ThisShard();
+  lock_guard<mutex> l(shard.m);
+  auto i = shard.pending.find(id);
+  ASSERT(i != shard.pending.end()) << "internal error -- invalid id provided";
+  unique_ptr<stats::LatencyHistogram>& latency =
+      shard.latencies[i->second.opname];
+  if (latency == nullptr) latency.reset(new stats::LatencyHistogram);
+  latency->Record(now - i->second.start_us);
+  shard.pending.erase(i);
+}
+
+vector<UsageTracker::tCall> UsageTracker::PendingCalls() const {
+  vector<tCall> calls;
+  for (const unique_ptr<Shard>& shard : shards_) {
+    lock_guard<mutex> l(shard->m);
+    for (const auto& p : shard->pending) calls.push_back(p.second);
+  }
+  sort(calls.begin(), calls.end(), [](const tCall& a, const tCall& b) {
+    return a.id < b.id;
+  });
+  return calls;
+}
+
+void UsageTracker::GetLatencies(tMethodLatencies* latencies) const {
+  latencies->clear();
+  for (const unique_ptr<Shard>& shard : shards_) {
+    lock_guard<mutex> l(shard->m);
+    for (const auto& p : shard->latencies) {
+      unique_ptr<stats::LatencyHistogram>& merged = (*latencies)[p.first];
+      if (merged == nullptr) merged.reset(new stats::LatencyHistogram);
+      merged->Merge(*p.second);
+    }
+  }
+}
+
+vector<tMethodUsage> UsageTracker::GetMethodUsage() const {
+  tMethodLatencies latencies;
+  GetLatencies(&latencies);
+
+  vector<tMethodUsage> usage;
+  for (const auto& p : latencies) {
+    const stats::LatencyHistogram& h = *p.second;
+    tMethodUsage u;
+    u.method = p.first;
+    u.calls = h.count();
+    u.mean_ms = h.mean() / 1000;
+    u.max_ms = h.max() / 1000.0;
+    u.p50_ms = h.Percentile(50) / 1000.0;
+    u.p90_ms = h.Percentile(90) / 1000.0;
+    u.p99_ms = h.Percentile(99) / 1000.0;
+    u.p999_ms = h.Percentile(99.9) / 1000.0;
+    usage.push_back(u);
+  }
+  stable_sort(usage.begin(), usage.end(),
+              [](const tMethodUsage& a, const tMethodUsage& b) {
+    return a.calls > b.calls;
+  });
+  return usage;
+}
+
+}  // namespace network
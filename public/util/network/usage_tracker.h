@@ -0,0 +1,103 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Usage statistics of the methods of a server: the calls in progress, and the
+// number and latency distribution of the completed calls of each method.
+//
+// Calls are recorded in one of several shards picked by thread, so concurrent
+// calls rarely share a lock or a cache line. The shards are merged only when
+// the statistics are read, e.g. for the /_usage page.
+
+#ifndef _PUBLIC_UTIL_NETWORK_USAGE_TRACKER_H_
+#define _PUBLIC_UTIL_NETWORK_USAGE_TRACKER_H_
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "base/common.h"
+#include "util/serial/serializer.h"
+#include "util/stats/latency_histogram.h"
+
+namespace network {
+
+// Summary of the calls to one method, as reported in JSON.
+struct tMethodUsage {
+  string method;
+  uint64_t calls = 0;
+  // Latencies in ms.
+  double mean_ms = 0;
+  double max_ms = 0;
+  double p50_ms = 0;
+  double p90_ms = 0;
+  double p99_ms = 0;
+  double p999_ms = 0;
+  // Replies served from the cache of the method, including calls that waited
+  // for a concurrent identical call, and replies computed for it. Filled in
+  // by the server; 0 if the method is not cached.
+  uint64_t cache_hits = 0;
+  uint64_t cache_misses = 0;
+
+  SERIALIZE(method*1 / calls*2 / mean_ms*3 / max_ms*4 / p50_ms*5 / p90_ms*6 /
+            p99_ms*7 / p999_ms*8 / cache_hits*9 / cache_misses*10);
+};
+
+class UsageTracker {
+ public:
+  // A call in progress.
+  struct tCall {
+    int id;
+    time_t timestamp;
+    string opname;
+    bool is_json;
+    // The input as given to Begin(): JSON, or binary RPC if !is_json.
+    string input;
+    uint64_t start_us;
+  };
+
+  // The latency histogram of each method, in microseconds.
+  typedef map<string, unique_ptr<stats::LatencyHistogram>> tMethodLatencies;
+
+  // 'num_shards' <= 0 uses --rpc_usage_shards.
+  explicit UsageTracker(int num_shards = 0);
+
+  // Records the start of a call and returns its id for End(), which must be
+  // called on the same thread.
+  int Begin(const string& opname, bool is_json, const string& input);
+  void End(int id);
+
+  // The number of calls started so far.
+  int num_calls() const { return max_id_.load(memory_order_relaxed); }
+
+  // Returns the calls in progress, ordered by id.
+  vector<tCall> PendingCalls() const;
+
+  // Merges the latencies of the completed calls from all shards.
+  void GetLatencies(tMethodLatencies* latencies) const;
+
+  // Returns the summary of each method, the most called first.
+  vector<tMethodUsage> GetMethodUsage() const;
+
+ private:
+  // Padded so that shards do not share cache lines. Shards are allocated
+  // with new, which ignores alignas before C++17.
+  struct Shard {
+    char pad_front[64];
+    mutable mutex m;
+    unordered_map<int, tCall> pending;
+    unordered_map<string, unique_ptr<stats::LatencyHistogram>> latencies;
+    char pad_back[64];
+  };
+
+  // The shard of the calling thread.
+  Shard& ThisShard();
+
+  atomic<int> max_id_{0};
+  vector<unique_ptr<Shard>> shards_;
+};
+
+}  // namespace network
+
+#endif  // _PUBLIC_UTIL_NETWORK_USAGE_TRACKER_H_
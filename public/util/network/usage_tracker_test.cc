@@ -0,0 +1,73 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/network/usage_tracker.h"
+
+#include <thread>
+
+#include "test/cc/test_main.h"
+
+namespace network {
+namespace test {
+
+TEST(UsageTracker, PendingCalls) {
+  UsageTracker tracker(4);
+  int a = tracker.Begin("foo", true, "{}");
+  int b = tracker.Begin("bar", false, "binary");
+  EXPECT_EQ(2, tracker.num_calls());
+
+  vector<UsageTracker::tCall> pending = tracker.PendingCalls();
+  ASSERT_EQ(2, pending.size());
+  EXPECT_EQ(a, pending[0].id);
+  EXPECT_EQ("foo", pending[0].opname);
+  EXPECT_TRUE(pending[0].is_json);
+  EXPECT_EQ(b, pending[1].id);
+  EXPECT_EQ("binary", pending[1].input);
+
+  tracker.End(a);
+  pending = tracker.PendingCalls();
+  ASSERT_EQ(1, pending.size());
+  EXPECT_EQ(b, pending[0].id);
+  tracker.End(b);
+  EXPECT_TRUE(tracker.PendingCalls().empty());
+  EXPECT_EQ(2, tracker.num_calls());
+}
+
+TEST(UsageTracker, MethodUsage) {
+  UsageTracker tracker(4);
+  for (int i = 0; i < 3; ++i) tracker.End(tracker.Begin("foo", true, ""));
+  tracker.End(tracker.Begin("bar", true, ""));
+
+  vector<tMethodUsage> usage = tracker.GetMethodUsage();
+  ASSERT_EQ(2, usage.size());
+  EXPECT_EQ("foo", usage[0].method);
+  EXPECT_EQ(3, usage[0].calls);
+  EXPECT_EQ("bar", usage[1].method);
+  EXPECT_EQ(1, usage[1].calls);
+  EXPECT_LE(usage[0].p50_ms, usage[0].p999_ms);
+  EXPECT_LE(usage[0].p999_ms, usage[0].max_ms);
+}
+
+TEST(UsageTracker, Concurrent) {
+  UsageTracker tracker(4);
+  const int kNumThreads = 8, kCallsPerThread = 1000;
+  vector<thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.push_back(thread([&tracker, t]() {
+      string opname = t % 2 ? "odd" : "even";
+      for (int i = 0; i < kCallsPerThread; ++i)
+        tracker.End(tracker.Begin(opname, true, ""));
+    }));
+  }
+  for (thread& t : threads) t.join();
+
+  EXPECT_EQ(kNumThreads * kCallsPerThread, tracker.num_calls());
+  EXPECT_TRUE(tracker.PendingCalls().empty());
+  UsageTracker::tMethodLatencies latencies;
+  tracker.GetLatencies(&latencies);
+  ASSERT_EQ(2, latencies.size());
+  EXPECT_EQ(kNumThreads / 2 * kCallsPerThread, latencies["odd"]->count());
+  EXPECT_EQ(kNumThreads / 2 * kCallsPerThread, latencies["even"]->count());
+}
+
+}  // namespace test
+}  // namespace network
@@ -1,11 +1,16 @@
 #include "util/network/webserver.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "util/network/http_request_parser.h"
 #include "util/network/httputil.h"
 
 FLAG_bool(log_full_post_requests, false, "dump full POST requests to log");
 
 // check if all bytes have been received
 // optional return values: request size, url, CGI arguments
-bool WebServer::HttpRequestIsComplete(const string& r,
+bool WebServer::HttpRequestIsComplete(const RequestView& r,
                                       unsigned int *request_size,
                                       string *url, string *cgi_arguments,
                                       string *input_cookie, string *referrer,
@@ -15,191 +20,109 @@ bool WebServer::HttpRequestIsComplete(const string& r,
   // Consider a request complete if it contains two consecutive newlines,
   // except for a "POST" request, which requires additional content
   // after two consecutive newlines.
-  const char *start = r.c_str();
-
-  const char *s;
-
-  const char *nn_newlines = strstr(start, "\n\n");
-  const char *rnrn_newlines = strstr(start, "\r\n\r\n");
-
-  if (nn_newlines == NULL) {
-    s = rnrn_newlines;
-  } else if (rnrn_newlines == NULL) {
-    s = nn_newlines;
-  } else {
-    // if both newline types are found, choose the one that occurs first
-    // to represent the end of the header
-    s = (nn_newlines < rnrn_newlines) ? nn_newlines : rnrn_newlines;
-  }
-
-  if (s == NULL)
+  HttpRequestParser parser;
+  bool request_is_complete = parser.Parse(r);
+  if (!parser.header_complete())
     return false;
 
-  const char *after_two_newlines = (((*s) == '\n') ? (s + 2) : (s + 4));
-  unsigned int header_len = after_two_newlines - start;
-
-  bool request_is_post = (strncasecmp(start, "POST", 4) == 0);
-  bool request_is_complete = false;
-  int content_length = 1;
-
-  unordered_map<string, string> http_header_local;
-  // in case caller didn't supply http_header parameter
-  if (http_header == NULL)
-    http_header = &http_header_local;
-
-  vector<string> lines;
-  strutil::BreakUpString(r.substr(0, header_len), '\n', &lines);
-  for (int i = 1; i < lines.size(); i++) {
-    const char *s = lines[i].c_str();
-    const char *sep = strchr(s, ':');  // find the first ':'
-    if (sep != NULL) {
-      string key = strutil::GetTrimmedString(string(s, sep - s));
-      string value = strutil::GetTrimmedString(string(sep + 1));
-      (*http_header)[key] = value;
-    }
-  }
-
-  if (input_cookie != NULL) {
-    // get Cookie from header
-    unordered_map<string, string>::const_iterator itr = http_header->find("Cookie");
-    *input_cookie = (itr == http_header->end() ? "" : itr->second);
-  }
-  if (referrer != NULL) {
-    // get Referer from header
-    unordered_map<string, string>::const_iterator itr = http_header->find("Referer");
-    *referrer = (itr == http_header->end() ? "" : itr->second);
-  }
-  if (accept_gzip != NULL) {
-    // check if client accepts gzip encoding
-    unordered_map<string, string>::const_iterator itr =
-      http_header->find("Accept-Encoding");
-    *accept_gzip = (itr != http_header->end() &&
-                    strstr(itr->second.c_str(), "gzip") != NULL);
-  }
-
-  if (keep_alive != NULL) {
-    // check if client requests keep-alive connection
-    unordered_map<string, string>::const_iterator itr =
-      http_header->find("Connection");
-    *keep_alive = (itr != http_header->end() &&
-                   strstr(itr->second.c_str(), "keep-alive") != NULL);
-  }
-
-  /*
-  if (input_cookie != NULL) {
-    // retrieve HTTP cookie, if available
-    input_cookie->clear();
-    const char *ck = strstr(start, "Cookie: ");
-    if (ck != NULL && ck < after_two_newlines) {
-      const char *cookie_begin = ck + 8;
-      const char *cookie_end = cookie_begin;
-      while ((*cookie_end) >= ' ')
-        cookie_end++;
-      *input_cookie = string(cookie_begin, cookie_end - cookie_begin);
-    }
-  }
-  */
-
-  if (request_is_post) {
-    // a post request requires additional content
-    const char *cl = strstr(start, "Content-Length: ");
-    if (cl != NULL && cl < after_two_newlines)
-      content_length = atoi(cl + 16);
-    else
-      content_length = 1;
-
-    unsigned int total_size = header_len + content_length;
-    if (request_size != NULL)
-      *request_size = total_size;
-
-    request_is_complete = (r.size() >= total_size);
-  }
-  else {
-    if (request_size != NULL)
-      *request_size = header_len;
-    request_is_complete = true;
-  }
+  if (request_size != NULL)
+    *request_size = parser.request_size();
+  if (http_header != NULL)
+    parser.GetHeaders(r, http_header);
+  if (input_cookie != NULL)
+    *input_cookie = parser.Header(r, "Cookie").ToString();
+  if (referrer != NULL)
+    *referrer = parser.Header(r, "Referer").ToString();
+  if (accept_gzip != NULL)
+    *accept_gzip = parser.AcceptsGzip(r);
+  if (keep_alive != NULL)
+    *keep_alive = parser.KeepAlive(r);
 
   if (request_is_complete) {
     // fill in other optional return values
     if (is_post)
-      *is_post = request_is_post;
-
-    const char *s = start;
-    while ((*s) > ' ') s++;  // scan until the first space character
-    if ((*s) != '\0') s++;
-    // now s points to the beginning of URL
-    const char *url_begin = s;
-
-    while ((*s) > ' ' && (*s) != '?') s++;  // scan until the first space or ?
-
-    // now s points to the character just after URL
+      *is_post = parser.is_post();
     if (url)
-      *url = string(url_begin, s - url_begin);
-
-    if (request_is_post) {
-      // POST command
-      // cgi arguments can be found just after two consecutive newlines
-      if (cgi_arguments)
-        *cgi_arguments = string(after_two_newlines, content_length);
-    }
-    else {
-      // GET command
-      // cgi arguments can be found after '?' in URL
-      if ((*s) == '?') {
-        s++;
-        const char *cgi_begin = s;
-        while ((*s) > ' ') s++;
-        // now s points to the character just after CGI arguments
-        if (cgi_arguments)
-          *cgi_arguments = string(cgi_begin, s - cgi_begin);
-      }
-      else {
-        // no GET arguments
-        if (cgi_arguments)
-          *cgi_arguments = "";
-      }
-    }
+      *url = parser.url().In(r).ToString();
+    if (cgi_arguments)
+      *cgi_arguments = parser.CgiArguments(r).ToString();
   }
 
   return request_is_complete;
 }
 
+// incremental check for a complete request: the parser kept in 'state'
+// resumes where the previous call stopped
+bool WebServer::HttpRequestIsComplete(const RequestView& r,
+                                      tRequestScanState *state,
+                                      unsigned int *request_size) {
+  if (state->parser == nullptr)
+    state->parser.reset(new HttpRequestParser);
+  // Servers derived from WebServer only keep HTTP parsers in the state.
+  HttpRequestParser *parser =
+      static_cast<HttpRequestParser *>(state->parser.get());
+
+  if (!parser->Parse(r)) {
+    // once the header is in, there is no need to look before the body is
+    if (parser->header_complete())
+      state->min_size = parser->request_size();
+    return false;
+  }
+  *request_size = parser->request_size();
+  return true;
+}
 
 // process a request
 string WebServer::ProcessRequest(const string& request,
                                  bool *keep_alive,
                                  const tConnectionInfo *connection) {
-  unsigned int request_len;
-  string url, cgi_arguments, input_cookie, referrer;
-  unordered_map<string, string> http_header;
-  bool accept_gzip, is_post;
-
-  if (HttpRequestIsComplete(request, &request_len,
-                            &url, &cgi_arguments, &input_cookie, &referrer,
-                            &accept_gzip, keep_alive, &is_post, &http_header)) {
-    VLOG(4) << "processrequest:" << request;
-    LogCaller(connection->caller_id,
-              HttpRequestSummary(url, cgi_arguments, is_post));
-
-    string result_content, content_type;
-    int max_cache_seconds = 0;
-    vector<string> empty_cookies;
-
-    int response_code = gHttpResponse_ServerError;
+  NetResponse response;
+  ProcessRequestView(request, keep_alive, connection, nullptr, &response);
+  return response.ToString();
+}
 
-    if (!(url.empty()))
-      response_code = ProcessHttpRequest(url, is_post, cgi_arguments,
-                                         input_cookie, referrer,
-                                         &result_content, &content_type,
-                                         &max_cache_seconds);
-    return ConstructHttpResponse(response_code, result_content, content_type,
-                                 accept_gzip, empty_cookies, max_cache_seconds);
-  }
-  else {
-    // request is incomplete (this shouldn't happen)
-    return "";
+void WebServer::ProcessRequestView(const RequestView& request,
+                                   bool *keep_alive,
+                                   const tConnectionInfo *connection,
+                                   const tRequestScanState *scan_state,
+                                   NetResponse *response) {
+  // The connection handlers pass the parser that found the request complete.
+  // Other requests are parsed here.
+  HttpRequestParser request_parser;
+  const HttpRequestParser *parser = nullptr;
+  if (scan_state != nullptr)
+    parser = static_cast<const HttpRequestParser *>(scan_state->parser.get());
+  if (parser == nullptr) {
+    if (!request_parser.Parse(request)) {
+      // request is incomplete (this shouldn't happen)
+      return;
+    }
+    parser = &request_parser;
   }
+
+  VLOG(4) << "processrequest:" << request;
+  if (keep_alive != NULL)
+    *keep_alive = parser->KeepAlive(request);
+  string url = parser->url().In(request).ToString();
+  string cgi_arguments = parser->CgiArguments(request).ToString();
+  LogCaller(connection->caller_id,
+            HttpRequestSummary(url, cgi_arguments, parser->is_post()));
+
+  string result_content, content_type;
+  int max_cache_seconds = 0;
+  vector<string> empty_cookies;
+
+  int response_code = gHttpResponse_ServerError;
+
+  if (!(url.empty()))
+    response_code = ProcessHttpRequest(
+        url, parser->is_post(), cgi_arguments,
+        parser->Header(request, "Cookie").ToString(),
+        parser->Header(request, "Referer").ToString(),
+        &result_content, &content_type, &max_cache_seconds);
+  ConstructHttpResponse(response_code, std::move(result_content), content_type,
+                        parser->AcceptsGzip(request), empty_cookies,
+                        max_cache_seconds, response);
 }
 
 // assemble http response from components
@@ -211,12 +134,26 @@ string WebServer::ConstructHttpResponse(int response_code,
                                         bool client_accepts_gzip,
                                         const vector<string>& full_cookie_specs,
                                         int max_cache_seconds) {
+  NetResponse response;
+  ConstructHttpResponse(response_code, result_content, content_type,
+                        client_accepts_gzip, full_cookie_specs,
+                        max_cache_seconds, &response);
+  return response.ToString();
+}
+
+void WebServer::ConstructHttpResponse(int response_code,
+                                      string result_content,
+                                      const string& content_type,
+                                      bool client_accepts_gzip,
+                                      const vector<string>& full_cookie_specs,
+                                      int max_cache_seconds,
+                                      NetResponse *response) {
   stringstream header;
   string content;
 
   switch (response_code) {
   case gHttpResponse_OK: {
-    content = result_content;
+    content = std::move(result_content);
     header << "HTTP/1.1 200 Document follows\n"
            << "Content-type: " << content_type << "; charset=utf-8\n"
            << "Cache-Control: private, max-age=" << max_cache_seconds << "\n";
@@ -275,26 +212,70 @@ string WebServer::ConstructHttpResponse(int response_code,
 
   header << "Content-length: " << content.size() << "\n";
 
+  header << "\n";
   VLOG(5) << "Response header:\n" << header.str();
-  return header.str() + "\n" + content;
+  response->set_header(header.str());
+  response->set_body(std::move(content));
+}
+
+// assemble the http response for a file; the file is sent with sendfile()
+// unless it is compressed
+bool WebServer::ConstructHttpFileResponse(const string& filename,
+                                          bool client_accepts_gzip,
+                                          int max_cache_seconds,
+                                          NetResponse *response) {
+  int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+    close(fd);
+    return false;
+  }
+
+  string content_type = GuessContentType(filename);
+  bool compressible = (content_type.compare(0, 5, "text/") == 0 ||
+                       content_type == "application/x-javascript");
+  if (client_accepts_gzip && compressible && st.st_size > 1024) {
+    NetResponse file;
+    file.SetFileBody(fd, 0, st.st_size);
+    vector<string> empty_cookies;
+    ConstructHttpResponse(gHttpResponse_OK, file.ToString(), content_type,
+                          true, empty_cookies, max_cache_seconds, response);
+    return true;
+  }
+
+  stringstream header;
+  header << "HTTP/1.1 200 Document follows\n"
+         << "Content-type: " << content_type << "; charset=utf-8\n"
+         << "Cache-Control: private, max-age=" << max_cache_seconds << "\n"
+         << "Content-length: " << st.st_size << "\n\n";
+  response->set_header(header.str());
+  response->SetFileBody(fd, 0, st.st_size);
+  return true;
 }
 
 
+
+
 // return a summary string for logging purposes
 string WebServer::HttpRequestSummary(const string& url,
-                                     const string& cgi_arguments,
+                                     const RequestView& cgi_arguments,
                                      bool is_post) {
   stringstream ss;
   if (is_post) {
     ss << "POST " << url;
     if (!cgi_arguments.empty()) {
-      string unescaped = strutil::UnescapeString_CGI(cgi_arguments);
-      if (gFlag_log_full_post_requests)
-        ss << " ... " << unescaped;
-      else {
+      if (gFlag_log_full_post_requests) {
+        ss << " ... " << strutil::UnescapeString_CGI(cgi_arguments.ToString());
+      } else {
+        // only unescape what gets logged: 300 characters take at most 900
+        // escaped ones
+        string unescaped =
+            strutil::UnescapeString_CGI(cgi_arguments.substr(0, 900).ToString());
         ss << " ... " << unescaped.substr(0, 300);
-        if (unescaped.size() > 300)
-          ss << " ... (total " << unescaped.size() << " bytes)";
+        if (unescaped.size() > 300 || cgi_arguments.size() > 900)
+          ss << " ... (total " << cgi_arguments.size() << " bytes)";
       }
     }
   }
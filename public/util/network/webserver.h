@@ -36,7 +36,7 @@ class WebServer : public NetServer {
                                  int *max_cache_seconds);
 
   // check if all bytes have been received in an http request
-  static bool HttpRequestIsComplete(const string& r,
+  static bool HttpRequestIsComplete(const RequestView& r,
                                     unsigned int *request_size,
                                     string *url,  // may be NULL
                                     string *cgi_arguments,  // may be NULL
@@ -47,6 +47,13 @@ class WebServer : public NetServer {
                                     bool *is_post,      // may be NULL
                                     unordered_map<string, string> *http_header);
 
+  // incremental version of the above for a request that is still being
+  // received: does not rescan data that was scanned by earlier calls with the
+  // same 'state'
+  static bool HttpRequestIsComplete(const RequestView& r,
+                                    tRequestScanState *state,
+                                    unsigned int *request_size);
+
   // assemble http response from components
   // (note: in case response_code is not gHttpResponse_OK, all other arguments
   //        are ignored)
@@ -57,9 +64,27 @@ class WebServer : public NetServer {
                                       const vector<string>& full_cookie_specs,
                                       int max_cache_seconds);
 
+  // same as above, but the header and the content are kept apart in
+  // 'response' so that the content is never copied
+  static void ConstructHttpResponse(int response_code,
+                                    string result_content,
+                                    const string& content_type,
+                                    bool client_accepts_gzip,
+                                    const vector<string>& full_cookie_specs,
+                                    int max_cache_seconds,
+                                    NetResponse *response);
+
+  // assemble http response for the given file, which is sent straight from
+  // the file system unless it gets compressed
+  // (returns false if the file cannot be read)
+  static bool ConstructHttpFileResponse(const string& filename,
+                                        bool client_accepts_gzip,
+                                        int max_cache_seconds,
+                                        NetResponse *response);
+
   // return a summary string for logging purposes
   static string HttpRequestSummary(const string& url,
-                                   const string& cgi_arguments,
+                                   const RequestView& cgi_arguments,
                                    bool is_post);
 
   // guess content type from file name suffix
@@ -73,6 +98,11 @@ class WebServer : public NetServer {
                                  NULL, NULL, NULL, NULL,
                                  NULL, NULL, NULL, NULL);
   }
+  virtual bool RequestViewIsComplete(const RequestView& r,
+                                     tRequestScanState *state,
+                                     unsigned int *request_size) const {
+    return HttpRequestIsComplete(r, state, request_size);
+  }
 
   // allow multiple requests per connection
   virtual bool OneRequestPerConnection() const { return false; }
@@ -81,6 +111,11 @@ class WebServer : public NetServer {
   virtual string ProcessRequest(const string& request,
                                 bool *keep_alive,
                                 const tConnectionInfo *connection);
+  virtual void ProcessRequestView(const RequestView& request,
+                                  bool *keep_alive,
+                                  const tConnectionInfo *connection,
+                                  const tRequestScanState *scan_state,
+                                  NetResponse *response);
 };
 
 #endif  // _PUBLIC_UTIL_NETWORK_WEBSERVER_H_
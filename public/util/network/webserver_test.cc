@@ -5,6 +5,8 @@ Copyright 2014, Room 77, Inc.
 Test for webserver
 */
 
+#include <fstream>
+
 #include "test/cc/test_main.h"
 #include "util/network/webserver.h"
 
@@ -46,3 +48,85 @@ TEST(WebserverTest, TestHttpRequestIsComplete_ConsecutiveNewlines) {
   EXPECT_TRUE(WebServer::HttpRequestIsComplete(
       request, &request_size, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL));
 }
+
+// The request is received in small pieces.
+TEST(WebserverTest, TestHttpRequestIsComplete_Incremental) {
+  string request =
+      "POST /_rpc HTTP/1.1\r\nContent-Length: 11\r\n"
+      "Host: localhost\r\n\r\nTESTCONTENTGET / HTTP/1.1\r\n\r\n";
+  const unsigned int first_size = request.find("GET");
+  tRequestScanState state;
+  unsigned int request_size = 0;
+  for (int len = 0; len < first_size; ++len) {
+    EXPECT_FALSE(WebServer::HttpRequestIsComplete(
+        RequestView(request.data(), len), &state, &request_size)) << len;
+  }
+  EXPECT_TRUE(WebServer::HttpRequestIsComplete(request, &state,
+                                                &request_size));
+  EXPECT_EQ(first_size, request_size);
+
+  // The next request in the pipeline.
+  RequestView next = RequestView(request).substr(first_size);
+  state.Clear();
+  EXPECT_TRUE(WebServer::HttpRequestIsComplete(next, &state, &request_size));
+  EXPECT_EQ(next.size(), request_size);
+}
+
+TEST(WebserverTest, TestHttpRequestIsComplete_Fields) {
+  string request =
+      "GET /search?q=hotels HTTP/1.1\r\nCookie: id=7\r\n"
+      "Connection: keep-alive\r\n\r\n";
+  unsigned int request_size;
+  string url, cgi_arguments, cookie, referrer;
+  bool accept_gzip, keep_alive, is_post;
+  unordered_map<string, string> header;
+  // Parse from a buffer that is not NUL-terminated.
+  string buffer = request + "xxxx";
+  EXPECT_TRUE(WebServer::HttpRequestIsComplete(
+      RequestView(buffer.data(), request.size()), &request_size, &url,
+      &cgi_arguments, &cookie, &referrer, &accept_gzip, &keep_alive, &is_post,
+      &header));
+  EXPECT_EQ(request.size(), request_size);
+  EXPECT_EQ("/search", url);
+  EXPECT_EQ("q=hotels", cgi_arguments);
+  EXPECT_EQ("id=7", cookie);
+  EXPECT_TRUE(keep_alive);
+  EXPECT_FALSE(is_post);
+}
+
+TEST(WebserverTest, TestConstructHttpResponse) {
+  vector<string> cookies = {"a=b"};
+  NetResponse response;
+  WebServer::ConstructHttpResponse(WebServer::gHttpResponse_OK, "content",
+                                   "text/plain", false, cookies, 5, &response);
+  EXPECT_EQ("content", response.body());
+  EXPECT_EQ(WebServer::ConstructHttpResponse(WebServer::gHttpResponse_OK,
+                                             "content", "text/plain", false,
+                                             cookies, 5),
+            response.ToString());
+}
+
+TEST(WebserverTest, TestConstructHttpFileResponse) {
+  NetResponse response;
+  EXPECT_FALSE(WebServer::ConstructHttpFileResponse(
+      "/nonexistent/file.png", false, 60, &response));
+  EXPECT_FALSE(WebServer::ConstructHttpFileResponse("/tmp", false, 60,
+                                                    &response));
+
+  const string filename = "/tmp/webserver_test_file.png";
+  const string content(5000, 'p');
+  {
+    ofstream out(filename);
+    out << content;
+  }
+  // Images are sent as they are.
+  EXPECT_TRUE(WebServer::ConstructHttpFileResponse(filename, true, 60,
+                                                   &response));
+  EXPECT_TRUE(response.has_file_body());
+  vector<string> empty_cookies;
+  EXPECT_EQ(WebServer::ConstructHttpResponse(WebServer::gHttpResponse_OK,
+                                             content, "image/png", false,
+                                             empty_cookies, 60),
+            response.ToString());
+  remove(filename.c_str());
+}
@@ -78,7 +78,10 @@ class Serializer {
   template<typename T>
   static bool FromBinary(const char* s, size_t len, T* v,
       const BinaryDeSerializationParams& params = BinaryDeSerializationParams()) {
-    return FromBinary(string(s, len), v, params);
+    // Parse in place instead of copying the data into an istringstream.
+    util::ArrayStreamBuf buf(s, len);
+    istream in(&buf);
+    return FromBinary(in, v, params);
   }
 
   // Utility function to deserialize a struct where size had been prepended.
@@ -100,28 +103,40 @@ class Serializer {
   template<typename SizeT = unsigned int, typename T>
   static bool FromBinaryPrependedSize(const char* s, size_t len, T* v,
       const BinaryDeSerializationParams& params = BinaryDeSerializationParams()) {
-    return FromBinaryPrependedSize<SizeT>(string(s, len), v, params);
+    util::ArrayStreamBuf buf(s, len);
+    istream in(&buf);
+    return FromBinaryPrependedSize<SizeT>(in, v, params);
   }
 
   // Returns true if the binary stream has enough data for FromBinaryPrependedSize to succeed.
   // TODO(pramodg): Write similar functions for streams.
   template<typename SizeT = unsigned int>
   static bool BinaryStreamHasEnoughDataToParsePrependedSize(const string& str) {
-    if (str.size() < sizeof(SizeT)) return false;
-
-    // Get the size in the prefix.
-    fixedint<SizeT> size = 0;
-    if (!FromBinary(str.substr(0, sizeof(SizeT)), &size)) return false;
+    size_t total_size = PrependedSizeMessageLength<SizeT>(str.data(), str.size());
+    if (total_size == 0) return false;
 
     // Check if the stream size is large enough.
-    if (str.size() < size + sizeof(SizeT)) {
+    if (str.size() < total_size) {
       VLOG(5) << "Stream size too short. Expected: "
-              << size + sizeof(unsigned int) << ", Actual: " << str.size();
+              << total_size << ", Actual: " << str.size();
       return false;
     }
     return true;
   }
 
+  // Returns the total size, including the size prefix, of the message at the
+  // start of 's' that was serialized with ToBinaryPrependSize, or 0 if the
+  // prefix itself has not been received yet.
+  template<typename SizeT = unsigned int>
+  static size_t PrependedSizeMessageLength(const char* s, size_t len) {
+    if (len < sizeof(SizeT)) return 0;
+
+    // Get the size in the prefix.
+    fixedint<SizeT> size = 0;
+    if (!FromBinary(s, sizeof(SizeT), &size)) return 0;
+    return static_cast<size_t>(size) + sizeof(SizeT);
+  }
+
   //-------------------------------------------------
   // Raw Binary serialization interface.
   //-------------------------------------------------
@@ -6,6 +6,7 @@
 #include "util/serial/serializer_macros.h"
 
 #include "test/cc/test_main.h"
+#include "util/serial/serializer.h"
 #include "util/serial/type_handlers/test_util.h"
 #include "util/serial/utils/test_util.h"
 
@@ -484,5 +485,28 @@ TEST(SerializerBinaryTest, TestVirtual) {
   EXPECT_FLOAT_EQ(b.test_float, a.test_float);
 }
 
+TEST(SerializerBinaryTest, TestFromBuffer) {
+  TestData<vector<string>> a(vector<string>{"first", "second"});
+  ostringstream out;
+  Serializer::ToBinaryPrependSize(out, a);
+  const string msg = out.str();
+
+  // The buffer holds more than the message and is not NUL-terminated.
+  string buffer = msg + "trailing data";
+  EXPECT_EQ(msg.size(), Serializer::PrependedSizeMessageLength(
+      buffer.data(), buffer.size()));
+  EXPECT_EQ(0, Serializer::PrependedSizeMessageLength(buffer.data(), 3));
+
+  TestData<vector<string>> b;
+  EXPECT_TRUE(Serializer::FromBinaryPrependedSize(buffer.data(), msg.size(),
+                                                  &b));
+  EXPECT_EQ(a, b);
+
+  // Truncated data.
+  TestData<vector<string>> c;
+  EXPECT_FALSE(Serializer::FromBinaryPrependedSize(buffer.data(),
+                                                   msg.size() - 2, &c));
+}
+
 }  // namespace test
 }  // namespace serial
@@ -200,6 +200,34 @@ inline char ExpectNext(istream& in, const string& expected,
   return 0;
 }
 
+// Read-only stream buffer over an existing character array. Unlike
+// istringstream, the data is not copied, so the array must outlive the buffer.
+// Supports seeking, which the parsers use for error reporting.
+class ArrayStreamBuf : public std::streambuf {
+ public:
+  ArrayStreamBuf(const char* data, size_t len) {
+    char* begin = const_cast<char*>(data);
+    setg(begin, begin, begin + len);
+  }
+
+ protected:
+  pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                   std::ios_base::openmode which) override {
+    if (!(which & std::ios_base::in)) return pos_type(off_type(-1));
+    off_type base = 0;
+    if (dir == std::ios_base::cur) base = gptr() - eback();
+    else if (dir == std::ios_base::end) base = egptr() - eback();
+    off_type pos = base + off;
+    if (pos < 0 || pos > egptr() - eback()) return pos_type(off_type(-1));
+    setg(eback(), eback() + pos, egptr());
+    return pos_type(pos);
+  }
+
+  pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+  }
+};
+
 }  // namespace util
 }  // namespace serial
 
@@ -0,0 +1,67 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/stats/latency_histogram.h"
+
+#include <cmath>
+
+namespace stats {
+
+const int LatencyHistogram::kSubBucketBits;
+const int LatencyHistogram::kSubBuckets;
+const int LatencyHistogram::kMaxValueBits;
+const int LatencyHistogram::kNumBuckets;
+
+int LatencyHistogram::BucketIndex(uint64_t value) {
+  // Values below kSubBuckets have a bucket each.
+  if (value < kSubBuckets) return value;
+  int msb = 63 - __builtin_clzll(value);
+  if (msb >= kMaxValueBits) return kNumBuckets - 1;
+  int shift = msb - kSubBucketBits;
+  // The bits below the most significant one select the sub-bucket.
+  return (shift + 1) * kSubBuckets + ((value >> shift) - kSubBuckets);
+}
+
+uint64_t LatencyHistogram::BucketUpperBound(int index) {
+  if (index < kSubBuckets) return index;
+  if (index >= kNumBuckets - 1) return numeric_limits<uint64_t>::max();
+  int shift = index / kSubBuckets - 1;
+  uint64_t sub = index % kSubBuckets + kSubBuckets;
+  return ((sub + 1) << shift) - 1;
+}
+
+uint64_t LatencyHistogram::Percentile(double percentile) const {
+  uint64_t total = count();
+  if (total == 0) return 0;
+  // The rank of the value we are looking for, starting at 1.
+  uint64_t rank = std::max<uint64_t>(1, ceil(total * percentile / 100));
+  uint64_t seen = 0;
+  for (int i = 0; i < kNumBuckets; ++i) {
+    seen += buckets_[i].load(memory_order_relaxed);
+    if (seen >= rank) return min(BucketUpperBound(i), max());
+  }
+  // count_ got ahead of the buckets in a concurrent Record().
+  return max();
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other) {
+  for (int i = 0; i < kNumBuckets; ++i) {
+    uint64_t n = other.buckets_[i].load(memory_order_relaxed);
+    if (n) buckets_[i].fetch_add(n, memory_order_relaxed);
+  }
+  count_.fetch_add(other.count(), memory_order_relaxed);
+  sum_.fetch_add(other.sum(), memory_order_relaxed);
+  uint64_t value = other.max();
+  uint64_t max = max_.load(memory_order_relaxed);
+  while (value > max &&
+         !max_.compare_exchange_weak(max, value, memory_order_relaxed)) {}
+}
+
+void LatencyHistogram::Clear() {
+  for (int i = 0; i < kNumBuckets; ++i)
+    buckets_[i].store(0, memory_order_relaxed);
+  count_.store(0, memory_order_relaxed);
+  sum_.store(0, memory_order_relaxed);
+  max_.store(0, memory_order_relaxed);
+}
+
+}  // namespace stats
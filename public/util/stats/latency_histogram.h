@@ -0,0 +1,71 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// A lock-free, log-bucketed histogram for latencies.
+//
+// Values are counted in buckets whose width grows with the value, in the style
+// of HDR histograms: every power of two is split into 2^kSubBucketBits equal
+// buckets, so any value is known within 1/16 of itself. Recording is a couple
+// of relaxed atomic increments and can be done from any number of threads.
+
+#ifndef _PUBLIC_UTIL_STATS_LATENCY_HISTOGRAM_H_
+#define _PUBLIC_UTIL_STATS_LATENCY_HISTOGRAM_H_
+
+#include <atomic>
+
+#include "base/common.h"
+
+namespace stats {
+
+class LatencyHistogram {
+ public:
+  static const int kSubBucketBits = 4;
+  static const int kSubBuckets = 1 << kSubBucketBits;
+  // Larger values are counted in the last bucket.
+  static const int kMaxValueBits = 40;
+  static const int kNumBuckets =
+      (kMaxValueBits - kSubBucketBits + 1) * kSubBuckets;
+
+  LatencyHistogram() { Clear(); }
+
+  void Record(uint64_t value) {
+    buckets_[BucketIndex(value)].fetch_add(1, memory_order_relaxed);
+    count_.fetch_add(1, memory_order_relaxed);
+    sum_.fetch_add(value, memory_order_relaxed);
+    uint64_t max = max_.load(memory_order_relaxed);
+    while (value > max &&
+           !max_.compare_exchange_weak(max, value, memory_order_relaxed)) {}
+  }
+
+  uint64_t count() const { return count_.load(memory_order_relaxed); }
+  uint64_t sum() const { return sum_.load(memory_order_relaxed); }
+  uint64_t max() const { return max_.load(memory_order_relaxed); }
+  double mean() const { return count() ? double(sum()) / count() : 0; }
+
+  // Returns the smallest value that at least 'percentile' percent of the
+  // recorded values do not exceed, rounded up to the end of its bucket.
+  // Returns 0 if nothing has been recorded.
+  uint64_t Percentile(double percentile) const;
+
+  // Adds the counts of 'other' to this histogram.
+  void Merge(const LatencyHistogram& other);
+
+  // Not atomic with respect to concurrent Record() calls, which may be lost.
+  void Clear();
+
+  // The bucket of 'value', and the largest value in bucket 'index'.
+  static int BucketIndex(uint64_t value);
+  static uint64_t BucketUpperBound(int index);
+
+ private:
+  atomic<uint64_t> buckets_[kNumBuckets];
+  atomic<uint64_t> count_;
+  atomic<uint64_t> sum_;
+  atomic<uint64_t> max_;
+
+  LatencyHistogram(const LatencyHistogram&) = delete;
+  LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+};
+
+}  // namespace stats
+
+#endif  // _PUBLIC_UTIL_STATS_LATENCY_HISTOGRAM_H_
@@ -0,0 +1,77 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/stats/latency_histogram.h"
+
+#include <thread>
+#include <vector>
+
+#include "test/cc/test_main.h"
+
+namespace stats {
+namespace test {
+
+TEST(LatencyHistogramTest, Buckets) {
+  // Every value falls in a bucket that contains it, and buckets are ordered.
+  uint64_t last_upper = 0;
+  for (int i = 0; i < LatencyHistogram::kNumBuckets - 1; ++i) {
+    uint64_t upper = LatencyHistogram::BucketUpperBound(i);
+    EXPECT_EQ(i, LatencyHistogram::BucketIndex(upper));
+    EXPECT_EQ(i + 1, LatencyHistogram::BucketIndex(upper + 1));
+    if (i > 0) EXPECT_LT(last_upper, upper);
+    last_upper = upper;
+  }
+  EXPECT_EQ(LatencyHistogram::kNumBuckets - 1,
+            LatencyHistogram::BucketIndex(numeric_limits<uint64_t>::max()));
+}
+
+TEST(LatencyHistogramTest, Precision) {
+  for (uint64_t v = 1; v < (1ULL << 40); v = v * 3 + 1) {
+    uint64_t upper = LatencyHistogram::BucketUpperBound(
+        LatencyHistogram::BucketIndex(v));
+    EXPECT_GE(upper, v);
+    EXPECT_LE(upper - v, v / LatencyHistogram::kSubBuckets) << v;
+  }
+}
+
+TEST(LatencyHistogramTest, Percentile) {
+  LatencyHistogram h;
+  EXPECT_EQ(0, h.Percentile(50));
+  for (int i = 1; i <= 1000; ++i) h.Record(i);
+  EXPECT_EQ(1000, h.count());
+  EXPECT_EQ(500500, h.sum());
+  EXPECT_EQ(1000, h.max());
+  EXPECT_NEAR(500, h.Percentile(50), 500 / 16);
+  EXPECT_NEAR(990, h.Percentile(99), 990 / 16);
+  EXPECT_EQ(1000, h.Percentile(100));
+  EXPECT_EQ(1, h.Percentile(0));
+}
+
+TEST(LatencyHistogramTest, MergeAndClear) {
+  LatencyHistogram a, b;
+  a.Record(10);
+  b.Record(20);
+  b.Record(30000);
+  a.Merge(b);
+  EXPECT_EQ(3, a.count());
+  EXPECT_EQ(30030, a.sum());
+  EXPECT_EQ(30000, a.max());
+  EXPECT_EQ(20, a.Percentile(50));
+  a.Clear();
+  EXPECT_EQ(0, a.count());
+  EXPECT_EQ(0, a.Percentile(99));
+}
+
+TEST(LatencyHistogramTest, Concurrent) {
+  LatencyHistogram h;
+  vector<thread> threads;
+  for (int t = 0; t < 4; ++t)
+    threads.push_back(thread([&h]() {
+      for (int i = 0; i < 100000; ++i) h.Record(i % 100);
+    }));
+  for (thread& t : threads) t.join();
+  EXPECT_EQ(400000, h.count());
+  EXPECT_EQ(99, h.max());
+}
+
+}  // namespace test
+}  // namespace stats
@@ -4,14 +4,20 @@
 #define _PUBLIC_UTIL_STORE_CACHE_SIMPLE_CACHER_H_
 
 #include <cassert>
+#include <functional>
 #include <memory>
 #include <thread>
 #include <limits>
 #include <string>
-#include <list>
 #include <unordered_map>
 #include <iostream>
 #include "../store.h"
+#include "util/cache/cache_gauges.h"
+#include "util/cache/eviction_policy.h"
+
+#ifdef R77_USE_SERIALIZER
+#include "util/cache/weigher.h"
+#endif
 
 ///////////////////////////////////////////////////////////////////////////////
 //
@@ -26,7 +32,16 @@
 //    loaded on demand. We have a fixed cache size that caches successful as
 //    well as unsuccessful lookups. Hence, you should allocate enough cache
 //    size (in number of elements) to account for unsuccessful lookups as well.
-//    Cache implementation is LRU. There is no timeout.
+//    Cache implementation is LRU by default, the Policy template parameter
+//    picks another eviction policy (see util/cache/eviction_policy.h), e.g.
+//    WTinyLFUPolicy for stores that get scans. There is no timeout.
+//    set_max_bytes() also bounds the weight of the cached entries, as
+//    computed by a weigher: by default their serialized size (see
+//    util/cache/weigher.h) when built with the serialization library.
+//
+// The cached entries and their weight are exported as gauges (see
+// util/cache/cache_gauges.h), named with set_name(). In cache all mode, the
+// entries are only weighed, once set_max_bytes() is called.
 //
 // This class can be used to have a store that loads everything in memory in
 // production and can load stuff on demand on dev if store registration detects
@@ -38,7 +53,8 @@
 
 namespace store {
 
-template<class Key = std::string, class Data = std::string>
+template<class Key = std::string, class Data = std::string,
+         template<class, class> class Policy = LRUPolicy>
 class SimpleCacher : public Store<Key, Data> {
  public:
   using Parent       = Store<Key, Data>;
@@ -49,19 +65,21 @@ class SimpleCacher : public Store<Key, Data> {
   using value_type   = typename Parent::value_type;
   using iterator     = typename Parent::iterator;
   template<class R> using result = result::Result<R>;
+  using weigher_t    = std::function<size_t(const Key&, const Data&)>;
 
  protected:
   // Cache related definitions.
   using data_t = std::shared_ptr<const value_type>;
-  using list_t = std::list<data_t>;
-  struct meta_data_t {
-    typename list_t::iterator list_iter;
-    bool end = true;
-  };
   struct data_hash_eq {
     size_t operator()(const data_t& d) const { return std::hash<key_type>()(d->first); }
     bool operator()(const data_t& d1, const data_t& d2) const { return d1->first == d2->first; }
   };
+  using policy_t = Policy<data_t, data_hash_eq>;
+  struct meta_data_t {
+    typename policy_t::handle_t handle;
+    bool end = true;
+    size_t weight = 0;
+  };
   using cache_t = std::unordered_map<data_t, meta_data_t, data_hash_eq, data_hash_eq>;
   using lock_t = std::lock_guard<std::recursive_mutex>;
 
@@ -80,15 +98,49 @@ class SimpleCacher : public Store<Key, Data> {
 
   // Construct using a mutable shared proxy of the underlying store.
   SimpleCacher(typename Child::shared_proxy store, bool preload_all = false, int cache_size = std::numeric_limits<int>::max())
-     : store_(store), preload_all_(preload_all), cache_size_(cache_size) {
+     : store_(store), preload_all_(preload_all), cache_size_(cache_size),
+       policy_(preload_all ? 0 : cache_size) {
     if (fail()) return;
     if (preload_all_) {
       for (auto it = store_->begin(); it != store_->end(); ++it) {
         cache_.insert(std::make_pair(it.shared_ptr(), meta_data_t()));
       }
+      gauges_.Add(cache_.size(), 0);
     }
   }
 
+  // Bounds the total weight of the cached entries to max_bytes in "cache a
+  // subset" mode, on top of their number, and weighs them with 'weigher' from
+  // now on. max_bytes = 0 weighs the entries without bounding their weight.
+  // Should be called before the cacher is used.
+  void set_max_bytes(size_t max_bytes, weigher_t weigher) {
+    lock_t l(mutex_);
+    max_bytes_ = max_bytes;
+    weigher_ = weigher;
+    gauges_.set_max_bytes(max_bytes);
+    for (auto& p : cache_) {
+      size_t weight = weigher_(p.first->first, p.first->second);
+      bytes_ += weight - p.second.weight;
+      gauges_.Add(0, int64_t(weight) - int64_t(p.second.weight));
+      p.second.weight = weight;
+    }
+    if (!preload_all_) Shrink();
+  }
+
+  #ifdef R77_USE_SERIALIZER
+  // Same, weighing the entries by their serialized size. Key and Data must be
+  // serializable.
+  void set_max_bytes(size_t max_bytes) {
+    set_max_bytes(max_bytes, SerializedSize());
+  }
+  #endif
+
+  // Names the gauges of the cacher.
+  void set_name(const std::string& name) { gauges_.set_name(name); }
+  const CacheGauges& gauges() const { return gauges_; }
+  // The weight of the cached entries, 0 until set_max_bytes() is called.
+  size_t bytes() const { lock_t l(mutex_); return bytes_; }
+
   virtual iterator          end()   const { return iterator(new SimpleCacherIterator()); }
   virtual result<bool>      empty() const { return store_->empty(); }
   virtual result<size_type> size()  const { return store_->size(); }
@@ -104,12 +156,11 @@ class SimpleCacher : public Store<Key, Data> {
     } else {
       // We are in "cache a subset" mode, need to lock mutex.
       lock_t l(mutex_);
+      policy_.Access(key);
       auto it = cache_.find(key);
       if (it != cache_.end()) {
-        // If it is in the cache, move the item to the front of the queue.
-        list_.push_front(*it->second.list_iter);
-        list_.erase(it->second.list_iter);
-        it->second.list_iter = list_.begin();
+        // If it is in the cache, let the policy know of the hit.
+        policy_.Touch(it->second.handle);
         return it->second.end ? end() : iterator(new SimpleCacherIterator(it->first));
       } else {
         // We don't have it in cache, find it from the store.
@@ -124,15 +175,19 @@ class SimpleCacher : public Store<Key, Data> {
         // Remaining operations need to be guarded. Lock the mutex again.
         mutex_.lock();
 
-        list_.push_front(data);
-        meta_data.list_iter = list_.begin();
+        // Another thread may have cached it in the meantime.
+        it = cache_.find(key);
+        if (it != cache_.end()) {
+          return it->second.end ? end() : iterator(new SimpleCacherIterator(it->first));
+        }
+        meta_data.handle = policy_.Insert(data);
+        if (weigher_) meta_data.weight = weigher_(data->first, data->second);
         cache_.insert(make_pair(data, meta_data));
+        bytes_ += meta_data.weight;
+        gauges_.Add(1, meta_data.weight);
 
-        // If we hit the limit, remove old entries.
-        if (cache_.size() > cache_size_ ) {
-          cache_.erase(*list_.rbegin());
-          list_.pop_back();
-        }
+        // If we hit the limit, let the policy pick the entries to remove.
+        Shrink();
         return meta_data.end ? end() : iterator(new SimpleCacherIterator(data));
       }
     }
@@ -141,12 +196,27 @@ class SimpleCacher : public Store<Key, Data> {
   bool fail() const { return store_.get() == nullptr; }
 
  private:
+  // Mutex needs to be locked.
+  void Shrink() const {
+    while (!cache_.empty() &&
+           (cache_.size() > cache_size_ || (max_bytes_ > 0 && bytes_ > max_bytes_))) {
+      auto it = cache_.find(policy_.Evict());
+      bytes_ -= it->second.weight;
+      gauges_.Add(-1, -int64_t(it->second.weight));
+      cache_.erase(it);
+    }
+  }
+
   typename Child::shared_proxy store_;
   bool preload_all_;
   int cache_size_;
-  mutable list_t list_;
+  mutable policy_t policy_;
   mutable cache_t cache_;
   mutable std::recursive_mutex mutex_;
+  size_t max_bytes_ = 0;
+  weigher_t weigher_;
+  mutable size_t bytes_ = 0;
+  mutable CacheGauges gauges_;
 };
 
 }
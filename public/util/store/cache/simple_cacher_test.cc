@@ -38,6 +38,21 @@ auto reg_cache_1_2 = Store<>::bind("cache_1/2", [](){
   return new SimpleCacher<>(LowLevelStore(), false, Tester<Store<>>::size() / 2);
 });
 
+auto reg_tiny_lfu_1_4 = Store<>::bind("tiny_lfu_1/4", [](){
+  return new SimpleCacher<std::string, std::string, WTinyLFUPolicy>(
+      LowLevelStore(), false, Tester<Store<>>::size() / 4);
+});
+
+auto reg_cache_bytes = Store<>::bind("cache_bytes", [](){
+  auto cacher = new SimpleCacher<>(LowLevelStore(), false);
+  cacher->set_max_bytes(1000, [](const std::string& key,
+                                 const std::string& data) {
+    return key.size() + data.size();
+  });
+  return cacher;
+});
+
 int main(int argc, char** argv) {
-  return Tester<Store<>>::Test({"preload_all", "cache_inf", "cache_1/2", "cache_1/4"});
+  return Tester<Store<>>::Test({"preload_all", "cache_inf", "cache_1/2", "cache_1/4",
+                                "tiny_lfu_1/4", "cache_bytes"});
 }
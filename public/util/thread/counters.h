@@ -7,8 +7,10 @@
 #include <algorithm>
 #include <chrono>
 #include <condition_variable>
+#include <functional>
 #include <mutex>
 #include <thread>
+#include <vector>
 
 #include "base/common.h"
 
@@ -80,13 +82,19 @@ class Counter {
   ~Counter() { Reset(); }
 
   void ChangeBy(int val) {
-    lock_guard<mutex> l(mutex_);
-    count_ += val;
-    if (count_ == 0) {
-      VLOG(5) << name_ << ":"  <<  std::this_thread::get_id() << " notifying.";
-
-      cond_.notify_all();
+    vector<function<void()>> on_zero;
+    {
+      lock_guard<mutex> l(mutex_);
+      count_ += val;
+      if (count_ == 0) {
+        VLOG(5) << name_ << ":"  <<  std::this_thread::get_id()
+                << " notifying.";
+
+        cond_.notify_all();
+        on_zero.swap(on_zero_);
+      }
     }
+    for (function<void()>& f : on_zero) f();
   }
 
   void Increment() { ChangeBy(1); }
@@ -94,9 +102,28 @@ class Counter {
   void Notify() { Decrement(); }
 
   void Reset() {
-    lock_guard<mutex> l(mutex_);
-    count_ = 0;
-    cond_.notify_all();
+    vector<function<void()>> on_zero;
+    {
+      lock_guard<mutex> l(mutex_);
+      count_ = 0;
+      cond_.notify_all();
+      on_zero.swap(on_zero_);
+    }
+    for (function<void()>& f : on_zero) f();
+  }
+
+  // Calls f once the counter becomes 0, on the thread that brings it to 0, or
+  // right away if it is 0. Lets callers react to the counter without blocking
+  // a thread in Wait().
+  void OnZero(function<void()> f) {
+    {
+      lock_guard<mutex> l(mutex_);
+      if (count_ != 0) {
+        on_zero_.push_back(std::move(f));
+        return;
+      }
+    }
+    f();
   }
 
   void Wait() {
@@ -141,6 +168,8 @@ class Counter {
   mutex mutex_;
   // The condition variable to wait for the notification.
   condition_variable cond_;
+  // The functions to call once the counter becomes 0.
+  vector<function<void()>> on_zero_;
 
   Counter(const Counter&) = delete;
   Counter & operator=(const Counter&) = delete;
@@ -127,6 +127,28 @@ TEST(Counters, WaitWithTimeout) {
   t.join();
 }
 
+TEST(Counters, OnZero) {
+  Counter c(2);
+  int calls = 0;
+  c.OnZero([&calls]() { ++calls; });
+  c.Notify();
+  EXPECT_EQ(0, calls);
+  c.Notify();
+  EXPECT_EQ(1, calls);
+
+  // Called right away once at 0, and only once per registration.
+  c.OnZero([&calls]() { ++calls; });
+  EXPECT_EQ(2, calls);
+  c.Increment();
+  c.Decrement();
+  EXPECT_EQ(2, calls);
+
+  c.Increment();
+  c.OnZero([&calls]() { ++calls; });
+  c.Reset();
+  EXPECT_EQ(3, calls);
+}
+
 }  // namepace test
 }  // namespace threading
 }  // namespace util
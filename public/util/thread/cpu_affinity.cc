@@ -0,0 +1,100 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/thread/cpu_affinity.h"
+
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+namespace util {
+namespace threading {
+
+bool ParseCpuList(const string& list, CpuSet* cpus) {
+  cpus->clear();
+  stringstream ss(list);
+  string range;
+  while (getline(ss, range, ',')) {
+    range.erase(remove_if(range.begin(), range.end(), ::isspace), range.end());
+    if (range.empty()) continue;
+    char* end = nullptr;
+    long first = strtol(range.c_str(), &end, 10);
+    long last = first;
+    if (*end == '-') last = strtol(end + 1, &end, 10);
+    if (end == range.c_str() || *end != '\0' || first < 0 || last < first)
+      return false;
+    for (long cpu = first; cpu <= last; ++cpu) cpus->push_back(cpu);
+  }
+  sort(cpus->begin(), cpus->end());
+  cpus->erase(unique(cpus->begin(), cpus->end()), cpus->end());
+  return true;
+}
+
+bool SetCurrentThreadAffinity(const CpuSet& cpus) {
+  if (cpus.empty()) return true;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus)
+    if (cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+  int res = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  if (res != 0) {
+    VLOG(2) << "Could not set the affinity of the thread: " << res;
+    return false;
+  }
+  return true;
+}
+
+int CurrentCpu() {
+  return sched_getcpu();
+}
+
+CpuTopology::CpuTopology(const string& node_dir) {
+  DIR* dir = opendir(node_dir.c_str());
+  if (dir != nullptr) {
+    while (dirent* entry = readdir(dir)) {
+      string name = entry->d_name;
+      if (name.compare(0, 4, "node") != 0 || name.size() == 4 ||
+          name.find_first_not_of("0123456789", 4) != string::npos)
+        continue;
+      ifstream in(node_dir + "/" + name + "/cpulist");
+      string list;
+      tNode node;
+      node.id = atoi(name.c_str() + 4);
+      // Memory-only nodes have no cpus.
+      if (getline(in, list) && ParseCpuList(list, &node.cpus) &&
+          !node.cpus.empty())
+        nodes_.push_back(node);
+    }
+    closedir(dir);
+  }
+  if (nodes_.empty()) {
+    tNode node;
+    node.id = 0;
+    for (unsigned cpu = 0; cpu < max(thread::hardware_concurrency(), 1u); ++cpu)
+      node.cpus.push_back(cpu);
+    nodes_.push_back(node);
+  }
+  sort(nodes_.begin(), nodes_.end(),
+       [](const tNode& a, const tNode& b) { return a.id < b.id; });
+
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    int max_cpu = nodes_[i].cpus.back();
+    if (max_cpu >= static_cast<int>(node_of_cpu_.size()))
+      node_of_cpu_.resize(max_cpu + 1, 0);
+    for (int cpu : nodes_[i].cpus) node_of_cpu_[cpu] = i;
+  }
+  VLOG(2) << "Found " << nodes_.size() << " NUMA nodes in " << node_dir;
+}
+
+const CpuTopology& CpuTopology::Get() {
+  static CpuTopology topology("/sys/devices/system/node");
+  return topology;
+}
+
+}  // namespace threading
+}  // namespace util
@@ -0,0 +1,76 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// CPU topology and thread placement.
+//
+// CpuTopology::Get() lists the NUMA nodes of the machine and their cpus, as
+// found in /sys/devices/system/node. Machines without that directory (or
+// without NUMA) are one node with all the cpus.
+//
+// SetCurrentThreadAffinity() pins the calling thread to a set of cpus. The
+// pools use it to keep their workers on one socket (see the 'cpus' argument of
+// ThreadPool and numa_thread_pool.h).
+
+#ifndef _PUBLIC_UTIL_THREAD_CPU_AFFINITY_H_
+#define _PUBLIC_UTIL_THREAD_CPU_AFFINITY_H_
+
+#include <string>
+#include <vector>
+
+#include "base/common.h"
+
+namespace util {
+namespace threading {
+
+// A set of cpu ids, sorted. Empty means no placement constraint.
+typedef vector<int> CpuSet;
+
+// Parses a kernel cpu list, e.g. "0-3,8,10-11". Returns false if it is
+// malformed.
+bool ParseCpuList(const string& list, CpuSet* cpus);
+
+// Pins the calling thread to 'cpus'. Returns false if the kernel refused, e.g.
+// for cpus outside of the cpuset of the process. Empty 'cpus' is a no-op.
+bool SetCurrentThreadAffinity(const CpuSet& cpus);
+
+// The cpu the calling thread is running on, or -1 if unknown.
+int CurrentCpu();
+
+class CpuTopology {
+ public:
+  struct tNode {
+    // The node id of the kernel, e.g. 1 for node1.
+    int id;
+    CpuSet cpus;
+  };
+
+  // Reads the nodes from 'node_dir', e.g. /sys/devices/system/node.
+  explicit CpuTopology(const string& node_dir);
+
+  // The topology of this machine, detected once.
+  static const CpuTopology& Get();
+
+  // The nodes with cpus, by increasing id. Never empty.
+  const vector<tNode>& nodes() const { return nodes_; }
+  int num_nodes() const { return nodes_.size(); }
+
+  // The index in nodes() of the node of 'cpu', 0 if unknown.
+  int NodeIndexOfCpu(int cpu) const {
+    return cpu >= 0 && cpu < static_cast<int>(node_of_cpu_.size()) ?
+        node_of_cpu_[cpu] : 0;
+  }
+
+  // The index in nodes() of the node the calling thread is running on.
+  int CurrentNodeIndex() const {
+    return nodes_.size() == 1 ? 0 : NodeIndexOfCpu(CurrentCpu());
+  }
+
+ private:
+  vector<tNode> nodes_;
+  // Node index by cpu id.
+  vector<int> node_of_cpu_;
+};
+
+}  // namespace threading
+}  // namespace util
+
+#endif  // _PUBLIC_UTIL_THREAD_CPU_AFFINITY_H_
@@ -0,0 +1,77 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/thread/cpu_affinity.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <thread>
+
+#include "test/cc/test_main.h"
+
+namespace util {
+namespace threading {
+namespace test {
+
+TEST(CpuAffinity, ParseCpuList) {
+  CpuSet cpus;
+  EXPECT_TRUE(ParseCpuList("0-3,8,10-11\n", &cpus));
+  EXPECT_EQ(CpuSet({0, 1, 2, 3, 8, 10, 11}), cpus);
+  EXPECT_TRUE(ParseCpuList("5, 1", &cpus));
+  EXPECT_EQ(CpuSet({1, 5}), cpus);
+  EXPECT_TRUE(ParseCpuList("", &cpus));
+  EXPECT_TRUE(cpus.empty());
+  EXPECT_FALSE(ParseCpuList("1-", &cpus));
+  EXPECT_FALSE(ParseCpuList("3-1", &cpus));
+  EXPECT_FALSE(ParseCpuList("a", &cpus));
+}
+
+TEST(CpuAffinity, Topology) {
+  char dir[] = "/tmp/cpu_affinity_test.XXXXXX";
+  ASSERT_TRUE(mkdtemp(dir) != nullptr);
+  string root = dir;
+  auto add_node = [&root](const string& name, const string& cpulist) {
+    mkdir((root + "/" + name).c_str(), 0755);
+    ofstream(root + "/" + name + "/cpulist") << cpulist << endl;
+  };
+  add_node("node1", "4-7");
+  add_node("node0", "0-3");
+  // A node with memory only.
+  add_node("node2", "");
+  mkdir((root + "/power").c_str(), 0755);
+
+  CpuTopology topology(root);
+  ASSERT_EQ(2, topology.num_nodes());
+  EXPECT_EQ(0, topology.nodes()[0].id);
+  EXPECT_EQ(CpuSet({0, 1, 2, 3}), topology.nodes()[0].cpus);
+  EXPECT_EQ(1, topology.nodes()[1].id);
+  EXPECT_EQ(1, topology.NodeIndexOfCpu(5));
+  EXPECT_EQ(0, topology.NodeIndexOfCpu(2));
+  EXPECT_EQ(0, topology.NodeIndexOfCpu(100));
+  system(("rm -rf " + root).c_str());
+
+  // Without sysfs, all the cpus are one node.
+  CpuTopology none("/nonexistent");
+  ASSERT_EQ(1, none.num_nodes());
+  EXPECT_EQ(max(thread::hardware_concurrency(), 1u),
+            none.nodes()[0].cpus.size());
+  EXPECT_EQ(0, none.CurrentNodeIndex());
+
+  EXPECT_LE(1, CpuTopology::Get().num_nodes());
+}
+
+TEST(CpuAffinity, SetCurrentThreadAffinity) {
+  thread([]() {
+    int cpu = CurrentCpu();
+    ASSERT_LE(0, cpu);
+    EXPECT_TRUE(SetCurrentThreadAffinity({cpu}));
+    EXPECT_EQ(cpu, CurrentCpu());
+    EXPECT_TRUE(SetCurrentThreadAffinity(CpuSet()));
+  }).join();
+}
+
+}  // namespace test
+}  // namespace threading
+}  // namespace util
@@ -0,0 +1,271 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Lock-free alternative to SharedQueue, for queues shared by many producers
+// and consumers. Pushing and popping go through a bounded ring buffer
+// (Vyukov's MPMC queue) without taking any lock; the mutex is only used to
+// park consumers that wait for a batch.
+//
+// Unlike SharedQueue the queue is bounded: the ring holds min(capacity,
+// kMaxRingSize) elements rounded up to a power of 2, and push() yields until
+// there is room.
+
+#ifndef _PUBLIC_UTIL_THREAD_LOCK_FREE_SHARED_QUEUE_H_
+#define _PUBLIC_UTIL_THREAD_LOCK_FREE_SHARED_QUEUE_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "base/common.h"
+#include "util/thread/shared_queue.h"
+
+namespace util {
+namespace threading {
+
+// Bounded multi-producer multi-consumer ring buffer. Each cell carries a
+// sequence number telling whether it is ready to be written or read for a
+// given position, so producers and consumers only contend on their own
+// position counter.
+template<typename T>
+class MPMCRingBuffer {
+ public:
+  // 'size' is rounded up to a power of 2.
+  explicit MPMCRingBuffer(size_t size) {
+    size_t capacity = 1;
+    while (capacity < size) capacity <<= 1;
+    mask_ = capacity - 1;
+    cells_.reset(new Cell[capacity]);
+    for (size_t i = 0; i < capacity; ++i)
+      cells_[i].sequence.store(i, memory_order_relaxed);
+  }
+
+  size_t capacity() const { return mask_ + 1; }
+
+  // Approximate while other threads push or pop.
+  size_t size() const {
+    size_t dequeue = dequeue_pos_.load(memory_order_relaxed);
+    size_t enqueue = enqueue_pos_.load(memory_order_relaxed);
+    return enqueue > dequeue ? enqueue - dequeue : 0;
+  }
+
+  // Returns false if the ring is full, in which case t is left untouched.
+  template<class U>
+  bool TryPush(U&& t) {
+    size_t pos = enqueue_pos_.load(memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+      cell = &cells_[pos & mask_];
+      size_t sequence = cell->sequence.load(memory_order_acquire);
+      intptr_t diff = intptr_t(sequence) - intptr_t(pos);
+      if (diff == 0) {
+        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1,
+                                               memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = enqueue_pos_.load(memory_order_relaxed);
+      }
+    }
+    cell->data = std::forward<U>(t);
+    cell->sequence.store(pos + 1, memory_order_release);
+    return true;
+  }
+
+  // Returns false if the ring is empty.
+  bool TryPop(T* t) {
+    size_t pos = dequeue_pos_.load(memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+      cell = &cells_[pos & mask_];
+      size_t sequence = cell->sequence.load(memory_order_acquire);
+      intptr_t diff = intptr_t(sequence) - intptr_t(pos + 1);
+      if (diff == 0) {
+        if (dequeue_pos_.compare_exchange_weak(pos, pos + 1,
+                                               memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = dequeue_pos_.load(memory_order_relaxed);
+      }
+    }
+    *t = std::move(cell->data);
+    // Do not hold on to the resources of the element until the cell is reused.
+    cell->data = T();
+    cell->sequence.store(pos + mask_ + 1, memory_order_release);
+    return true;
+  }
+
+ private:
+  struct Cell {
+    atomic<size_t> sequence;
+    T data;
+  };
+
+  static const size_t kCacheLineSize = 64;
+
+  unique_ptr<Cell[]> cells_;
+  size_t mask_;
+  // Padded onto separate cache lines: producers write enqueue_pos_, consumers
+  // dequeue_pos_. Padding rather than alignas, as new ignores extended
+  // alignment before C++17 and the queues are allocated with it.
+  char cells_pad_[kCacheLineSize];
+  atomic<size_t> enqueue_pos_{0};
+  char enqueue_pad_[kCacheLineSize - sizeof(atomic<size_t>)];
+  atomic<size_t> dequeue_pos_{0};
+  char dequeue_pad_[kCacheLineSize - sizeof(atomic<size_t>)];
+
+  MPMCRingBuffer(const MPMCRingBuffer&) = delete;
+  MPMCRingBuffer& operator=(const MPMCRingBuffer&) = delete;
+};
+
+template<typename T>
+class LockFreeSharedQueue : public SharedQueue<T> {
+  typedef SharedQueue<T> super;
+  typedef std::chrono::steady_clock Clock;
+
+ public:
+  // The largest ring allocated, for queues of unlimited capacity.
+  static const int kMaxRingSize = 1 << 16;
+
+  // Same parameters as SharedQueue. The notify timeout needs no thread here:
+  // waiting consumers wake up by themselves once it has expired.
+  LockFreeSharedQueue(int batch_size = 1,
+                      int capacity = numeric_limits<int>::max(),
+                      int notify_timeout_sec = -1)
+      : super(batch_size, capacity, -1),
+        notify_timeout_(notify_timeout_sec),
+        ring_(std::min(capacity, kMaxRingSize)),
+        last_flush_(Clock::now().time_since_epoch().count()) {}
+
+  virtual ~LockFreeSharedQueue() { notify_producers_finished(); }
+
+  virtual bool empty() { return ring_.size() == 0; }
+  virtual size_t size() { return ring_.size(); }
+
+  virtual bool producers_finished() { return producers_finished_; }
+
+  using super::try_push;
+
+  // Adds t regardless of the capacity, waiting for room if the ring is full.
+  virtual void push(T t) {
+    while (!ring_.TryPush(std::move(t))) this_thread::yield();
+    NotifyConsumer();
+  }
+
+  virtual bool try_push(T&& t) {
+    if (ring_.size() >= size_t(super::capacity()) ||
+        !ring_.TryPush(std::move(t)))
+      return false;
+    NotifyConsumer();
+    return true;
+  }
+
+  // The ring has a single lane.
+  virtual void push(T t, int lane) { push(std::move(t)); }
+  virtual bool try_push(T&& t, int lane) { return try_push(std::move(t)); }
+
+  // Waits for an element if the queue is empty.
+  virtual T pop() {
+    T t;
+    while (!ring_.TryPop(&t)) this_thread::yield();
+    return t;
+  }
+
+  // Waits until a batch is available, the producers are finished or the
+  // notify timeout expired, and returns up to a batch.
+  virtual vector<T> consume_batch() {
+    // Spin briefly before parking: waking a consumer up costs the producer a
+    // lock.
+    for (int i = 0; i < kSpinCount && !BatchReady(); ++i) this_thread::yield();
+    if (!BatchReady()) WaitForBatch();
+    return Pop(super::batch_size());
+  }
+
+  virtual vector<T> flush() {
+    return Pop(numeric_limits<int>::max());
+  }
+
+  virtual void notify_producers_finished() {
+    lock_guard<mutex> l(wait_mutex_);
+    producers_finished_ = true;
+    wait_cond_.notify_all();
+  }
+
+ private:
+  vector<T> Pop(int max_size) {
+    vector<T> batch;
+    batch.reserve(std::min<size_t>(max_size, ring_.size()));
+    T t;
+    while (int(batch.size()) < max_size && ring_.TryPop(&t))
+      batch.push_back(std::move(t));
+    last_flush_ = Clock::now().time_since_epoch().count();
+    return batch;
+  }
+
+  bool BatchReady() const {
+    return ring_.size() >= size_t(super::batch_size()) || producers_finished_;
+  }
+
+  // Wakes up a waiting consumer if there is a batch for it.
+  void NotifyConsumer() {
+    // Pairs with the fence in WaitForBatch(): either the consumer sees the new
+    // element, or this sees the consumer waiting.
+    atomic_thread_fence(memory_order_seq_cst);
+    if (num_waiting_.load(memory_order_relaxed) > 0 && BatchReady()) {
+      lock_guard<mutex> l(wait_mutex_);
+      wait_cond_.notify_one();
+    }
+  }
+
+  void WaitForBatch() {
+    unique_lock<mutex> l(wait_mutex_);
+    num_waiting_.fetch_add(1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (notify_timeout_ <= 0) {
+      wait_cond_.wait(l, [this]() { return BatchReady(); });
+    } else {
+      const chrono::seconds timeout(notify_timeout_);
+      Clock::time_point deadline =
+          Clock::time_point(Clock::duration(last_flush_.load())) + timeout;
+      while (!BatchReady()) {
+        if (Clock::now() >= deadline) {
+          // Consume a partial batch, as the timeout thread of SharedQueue
+          // would.
+          if (ring_.size() > 0) break;
+          deadline = Clock::now() + timeout;
+        }
+        wait_cond_.wait_until(l, deadline);
+      }
+    }
+    num_waiting_.fetch_sub(1, memory_order_relaxed);
+  }
+
+  // The number of times consume_batch() checks for a batch before parking.
+  static const int kSpinCount = 16;
+
+  const int notify_timeout_;
+  MPMCRingBuffer<T> ring_;
+  atomic<bool> producers_finished_{false};
+  // The time of the last consumption, in Clock ticks.
+  atomic<Clock::rep> last_flush_;
+
+  // Consumers waiting for a batch.
+  mutex wait_mutex_;
+  condition_variable wait_cond_;
+  atomic<int> num_waiting_{0};
+};
+
+template<typename T>
+const int LockFreeSharedQueue<T>::kMaxRingSize;
+
+}  // namespace threading
+}  // namespace util
+
+#endif  // _PUBLIC_UTIL_THREAD_LOCK_FREE_SHARED_QUEUE_H_
@@ -0,0 +1,159 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Tests for LockFreeSharedQueue and LockFreeThreadPool.
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "test/cc/test_main.h"
+#include "util/string/strutil.h"
+#include "util/thread/lock_free_shared_queue.h"
+#include "util/thread/lock_free_thread_pool.h"
+#include "util/thread/rate_limited_shared_queue.h"
+#include "util/thread/shared_queue_consumers.h"
+#include "util/thread/test_util.h"
+
+namespace util {
+namespace threading {
+namespace test {
+
+TEST(MPMCRingBuffer, Bounded) {
+  MPMCRingBuffer<int> ring(3);
+  EXPECT_EQ(4, ring.capacity());
+  for (int i = 0; i < 4; ++i) EXPECT_TRUE(ring.TryPush(i));
+  EXPECT_FALSE(ring.TryPush(4));
+  EXPECT_EQ(4, ring.size());
+
+  int val = -1;
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(ring.TryPop(&val));
+    EXPECT_EQ(i, val);
+  }
+  EXPECT_FALSE(ring.TryPop(&val));
+  // Wraps around.
+  EXPECT_TRUE(ring.TryPush(5));
+  EXPECT_TRUE(ring.TryPop(&val));
+  EXPECT_EQ(5, val);
+}
+
+TEST(LockFreeSharedQueue, Sanity) {
+  LockFreeSharedQueue<string> q;
+  EXPECT_TRUE(q.empty());
+  q.push("a");
+  EXPECT_EQ(1, q.size());
+  EXPECT_EQ("a", q.pop());
+  EXPECT_TRUE(q.empty());
+}
+
+TEST(LockFreeSharedQueue, TryPushAtCapacity) {
+  LockFreeSharedQueue<int> q(1, 3);
+  for (int i = 0; i < 3; ++i) EXPECT_TRUE(q.try_push(i));
+  EXPECT_FALSE(q.try_push(3));
+  EXPECT_EQ(3, q.flush().size());
+  EXPECT_TRUE(q.try_push(3));
+}
+
+TEST(LockFreeSharedQueue, ConsumeBatch) {
+  LockFreeSharedQueue<int> q(2);
+  vector<int> batch;
+  thread consumer([&q, &batch]() { batch = q.consume_batch(); });
+  q.push(1);
+  q.push(2);
+  q.push(3);
+  consumer.join();
+  EXPECT_EQ(2, batch.size());
+  EXPECT_EQ(1, q.size());
+
+  // A partial batch is returned once the producers are finished.
+  q.notify_producers_finished();
+  EXPECT_TRUE(q.producers_finished());
+  batch = q.consume_batch();
+  ASSERT_EQ(1, batch.size());
+  EXPECT_EQ(3, batch[0]);
+  EXPECT_TRUE(q.consume_batch().empty());
+}
+
+TEST(LockFreeSharedQueue, NotifyTimeout) {
+  LockFreeSharedQueue<int> q(10, numeric_limits<int>::max(), 1);
+  q.push(1);
+  auto start = chrono::steady_clock::now();
+  vector<int> batch = q.consume_batch();
+  EXPECT_EQ(1, batch.size());
+  EXPECT_GT(chrono::steady_clock::now() - start, chrono::milliseconds(500));
+}
+
+TEST(LockFreeSharedQueue, MultipleProducerConsumer) {
+  LockFreeSharedQueue<int> q(4);
+
+  vector<shared_ptr<SharedQProducer<int>>> producers;
+  vector<shared_ptr<AsyncConsumer<vector<int>>>> consumers;
+  for (int i = 0; i < 8; ++i) {
+    consumers.push_back(shared_ptr<AsyncConsumer<vector<int>>>(
+        new AsyncConsumer<vector<int>>(i, &q)));
+    producers.push_back(shared_ptr<SharedQProducer<int>>(
+        new SharedQProducer<int>(i, &q, true)));
+  }
+
+  this_thread::sleep_for(chrono::milliseconds(100));
+
+  for (int i = 0; i < producers.size(); ++i)
+    producers[i]->Finish();
+
+  q.notify_producers_finished();
+
+  int num_produced = 0;
+  for (int i = 0; i < producers.size(); ++i)
+    num_produced += producers[i]->produced().size();
+
+  for (int i = 0; i < consumers.size(); ++i)
+    consumers[i]->Wait();
+
+  int num_consumed = 0;
+  set<int> consumed;
+  for (int i = 0; i < consumers.size(); ++i) {
+    num_consumed += consumers[i]->Consumed().size();
+    consumed.insert(consumers[i]->Consumed().begin(),
+                    consumers[i]->Consumed().end());
+  }
+
+  EXPECT_EQ(0, q.size());
+  EXPECT_EQ(num_produced, num_consumed);
+  EXPECT_EQ(num_produced, consumed.size());
+}
+
+TEST(LockFreeSharedQueue, Factory) {
+  auto proxy = SharedQueueFactory<int>::Queue<LockFreeSharedQueue<int>>(
+      "lock_free_shared_queue_test");
+  ASSERT_NOTNULL(proxy);
+  EXPECT_TRUE(dynamic_cast<const LockFreeSharedQueue<int>*>(proxy.get()) != nullptr);
+}
+
+TEST(LockFreeSharedQueue, RateLimited) {
+  RateLimitedSharedQueue<int, LockFreeSharedQueue<int>> q(1000, 1);
+  q.push(1);
+  vector<int> batch = q.consume_batch();
+  ASSERT_EQ(1, batch.size());
+  EXPECT_EQ(1, batch[0]);
+}
+
+TEST(LockFreeThreadPool, MultipleProducers) {
+  LockFreeThreadPool pool(8);
+  atomic<int> count(0);
+  vector<thread> producers;
+  for (int i = 0; i < 8; ++i) {
+    producers.push_back(thread([&pool, &count]() {
+      for (int j = 0; j < 10000; ++j) pool.Add([&count]() { ++count; });
+    }));
+  }
+  for (thread& t : producers) t.join();
+  pool.Wait();
+  EXPECT_EQ(80000, count);
+}
+
+}  // namespace test
+}  // namespace threading
+}  // namespace util
@@ -0,0 +1,27 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Thread pool whose workers share a LockFreeSharedQueue. Adding functions
+// takes no lock, which helps when many threads add small functions. Add
+// waits while kMaxRingSize functions are queued.
+
+#ifndef _PUBLIC_UTIL_THREAD_LOCK_FREE_THREAD_POOL_H_
+#define _PUBLIC_UTIL_THREAD_LOCK_FREE_THREAD_POOL_H_
+
+#include "base/common.h"
+#include "util/thread/lock_free_shared_queue.h"
+#include "util/thread/thread_pool.h"
+
+namespace util {
+namespace threading {
+
+class LockFreeThreadPool : public ThreadPool {
+ public:
+  LockFreeThreadPool(int num_workers, int capacity = numeric_limits<int>::max())
+      : ThreadPool(SQ(new LockFreeSharedQueue<ThreadPoolTask>(1, capacity)),
+                   num_workers, capacity) {}
+};
+
+}  // namespace threading
+}  // namespace util
+
+#endif  // _PUBLIC_UTIL_THREAD_LOCK_FREE_THREAD_POOL_H_
@@ -0,0 +1,118 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Thread pool with one sub-pool per NUMA node and the same interface as
+// ThreadPool.
+//
+// The workers are split evenly between the nodes of CpuTopology::Get() and
+// pinned to the cpus of their node, each node with its own queue. Add() queues
+// the function on the node of the calling thread, so that it runs where the
+// data the caller just touched is likely to be in the cache and in local
+// memory. A node with more functions waiting than workers spills to the node
+// with the shortest queue, so one busy socket does not leave the others idle.
+//
+// On machines with a single node it behaves like a ThreadPool. It can also be
+// created through ThreadPoolFactory::Pool<NumaThreadPool>(id, ...).
+
+#ifndef _PUBLIC_UTIL_THREAD_NUMA_THREAD_POOL_H_
+#define _PUBLIC_UTIL_THREAD_NUMA_THREAD_POOL_H_
+
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "base/common.h"
+#include "util/thread/cpu_affinity.h"
+#include "util/thread/shared_queue.h"
+#include "util/thread/thread_pool.h"
+
+namespace util {
+namespace threading {
+
+class NumaThreadPool : public ThreadPool {
+ public:
+  // Each node gets at least one worker. The capacity bounds the functions
+  // waiting on each node, and is only checked by TryAdd. The topology must
+  // outlive the pool.
+  NumaThreadPool(int num_workers, int capacity = numeric_limits<int>::max(),
+                 const CpuTopology& topology = CpuTopology::Get())
+      : ThreadPool(SQ(), 0, capacity), topology_(topology) {
+    int num_nodes = topology_.num_nodes();
+    nodes_.reserve(num_nodes);
+    for (int i = 0; i < num_nodes; ++i) {
+      unique_ptr<tNode> node(new tNode);
+      node->q.reset(new SharedQueue<ThreadPoolTask>(1, capacity));
+      int n = max(1, num_workers / num_nodes + (i < num_workers % num_nodes));
+      for (int w = 0; w < n; ++w)
+        node->workers.push_back(unique_ptr<internal::ThreadPoolWorker>(
+            new internal::ThreadPoolWorker(num_workers_ + w, node->q.get(),
+                                           topology_.nodes()[i].cpus)));
+      num_workers_ += n;
+      nodes_.push_back(std::move(node));
+    }
+    stats_.set_num_workers(num_workers_);
+  }
+
+  // Runs the functions still waiting and stops the workers.
+  virtual ~NumaThreadPool() {
+    for (unique_ptr<tNode>& node : nodes_) node->q->notify_producers_finished();
+    for (unique_ptr<tNode>& node : nodes_)
+      for (unique_ptr<internal::ThreadPoolWorker>& w : node->workers) w->Wait();
+  }
+
+  virtual int num_workers() const { return num_workers_; }
+
+  virtual int queue_size() const {
+    int size = 0;
+    for (const unique_ptr<tNode>& node : nodes_) size += node->q->size();
+    return size;
+  }
+
+  int num_nodes() const { return nodes_.size(); }
+
+  // The functions waiting on the node with index 'i' in the topology.
+  int node_queue_size(int i) const { return nodes_[i]->q->size(); }
+
+ protected:
+  virtual void PushTask(ThreadPoolTask task, ThreadPoolPriority priority) {
+    nodes_[PickNode()]->q->push(std::move(task), static_cast<int>(priority));
+  }
+
+  virtual bool TryPushTask(ThreadPoolTask&& task, ThreadPoolPriority priority) {
+    return nodes_[PickNode()]->q->try_push(std::move(task),
+                                           static_cast<int>(priority));
+  }
+
+ private:
+  struct tNode {
+    shared_ptr<SharedQueue<ThreadPoolTask>> q;
+    vector<unique_ptr<internal::ThreadPoolWorker>> workers;
+  };
+
+  // The node of the caller, unless it has a backlog and another node has a
+  // shorter one.
+  int PickNode() const {
+    int local = topology_.CurrentNodeIndex();
+    if (nodes_.size() == 1) return 0;
+    int best = local;
+    int best_size = nodes_[local]->q->size();
+    if (best_size < static_cast<int>(nodes_[local]->workers.size()))
+      return local;
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+      int size = nodes_[i]->q->size();
+      if (size < best_size) {
+        best = i;
+        best_size = size;
+      }
+    }
+    return best;
+  }
+
+  const CpuTopology& topology_;
+  vector<unique_ptr<tNode>> nodes_;
+  int num_workers_ = 0;
+};
+
+}  // namespace threading
+}  // namespace util
+
+#endif  // _PUBLIC_UTIL_THREAD_NUMA_THREAD_POOL_H_
@@ -0,0 +1,109 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/thread/numa_thread_pool.h"
+
+#include <sys/stat.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <thread>
+
+#include "test/cc/test_main.h"
+#include "util/thread/counters.h"
+
+namespace util {
+namespace threading {
+namespace test {
+
+namespace {
+
+// Two nodes with all the cpus of the machine each: every thread is on the
+// last node, and the workers of both nodes can run anywhere.
+class TwoNodes {
+ public:
+  TwoNodes() {
+    char dir[] = "/tmp/numa_thread_pool_test.XXXXXX";
+    ASSERT(mkdtemp(dir) != nullptr);
+    dir_ = dir;
+    string cpulist =
+        "0-" + to_string(max(thread::hardware_concurrency(), 1u) - 1);
+    for (const string& node : {"node0", "node1"}) {
+      mkdir((dir_ + "/" + node).c_str(), 0755);
+      ofstream(dir_ + "/" + node + "/cpulist") << cpulist << endl;
+    }
+    topology_.reset(new CpuTopology(dir_));
+  }
+
+  ~TwoNodes() { system(("rm -rf " + dir_).c_str()); }
+
+  const CpuTopology& topology() const { return *topology_; }
+
+ private:
+  string dir_;
+  unique_ptr<CpuTopology> topology_;
+};
+
+}  // namespace
+
+TEST(NumaThreadPool, RunsAllFunctions) {
+  TwoNodes nodes;
+  ASSERT_EQ(2, nodes.topology().num_nodes());
+  NumaThreadPool pool(3, numeric_limits<int>::max(), nodes.topology());
+  EXPECT_EQ(2, pool.num_nodes());
+  EXPECT_EQ(3, pool.num_workers());
+
+  atomic_int count(0);
+  for (int i = 0; i < 1000; ++i) pool.Add([&count]() { ++count; });
+  pool.Wait();
+  EXPECT_EQ(1000, count);
+  EXPECT_EQ(0, pool.size());
+  EXPECT_EQ(0, pool.queue_size());
+}
+
+TEST(NumaThreadPool, PrefersTheCallersNode) {
+  TwoNodes nodes;
+  NumaThreadPool pool(2, numeric_limits<int>::max(), nodes.topology());
+  // Block the worker of the local node with one function, then queue one more
+  // behind it: the local node is busy but has no backlog yet.
+  Notification started, release;
+  pool.Add([&]() {
+    started.Notify();
+    release.Wait();
+  });
+  started.Wait();
+  pool.Add([]() {});
+  EXPECT_EQ(1, pool.node_queue_size(1));
+
+  // With a backlog, functions spill to the idle node and run.
+  Counter spilled(1);
+  pool.Add([&spilled]() { spilled.Notify(); });
+  EXPECT_TRUE(spilled.WaitWithTimeout(1000));
+  EXPECT_EQ(1, pool.node_queue_size(1));
+
+  release.Notify();
+  pool.Wait();
+}
+
+TEST(NumaThreadPool, Factory) {
+  auto pool = ThreadPoolFactory::Pool<NumaThreadPool>("numa_pool_test", 2);
+  Counter done(10);
+  for (int i = 0; i < 10; ++i) pool->Add([&done]() { done.Notify(); });
+  EXPECT_TRUE(done.WaitWithTimeout(1000));
+  pool->Wait();
+}
+
+TEST(ThreadPool, PinnedWorkers) {
+  CpuSet cpus = {CurrentCpu()};
+  ASSERT_LE(0, cpus[0]);
+  auto pool = ThreadPoolFactory::PinnedPool("pinned_pool_test", cpus, 2);
+  atomic_int on_cpu(0);
+  for (int i = 0; i < 10; ++i)
+    pool->Add([&on_cpu, &cpus]() { on_cpu += CurrentCpu() == cpus[0]; });
+  pool->Wait();
+  EXPECT_EQ(10, on_cpu);
+}
+
+}  // namespace test
+}  // namespace threading
+}  // namespace util
@@ -0,0 +1,115 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/thread/parallel.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <thread>
+
+#include "util/thread/work_stealing_thread_pool.h"
+
+FLAG_int(parallel_num_workers, 0,
+         "Number of threads of the pool shared by the parallel algorithms. "
+         "0 uses one per core.");
+
+namespace util {
+namespace threading {
+
+ThreadPool* ParallelPool() {
+  static ThreadPoolFactory::mutable_shared_proxy proxy =
+      ThreadPoolFactory::Pool<WorkStealingThreadPool>("parallel",
+          gFlag_parallel_num_workers > 0
+              ? gFlag_parallel_num_workers
+              : std::max<int>(1, std::thread::hardware_concurrency()));
+  return proxy.get();
+}
+
+namespace internal {
+
+namespace {
+
+// A range being worked on. Shared with the helpers added to the pool, which
+// may only start after the range is done.
+class ParallelJob {
+ public:
+  ParallelJob(size_t n, size_t grain, size_t num_threads,
+              const function<void(size_t, size_t)>* body)
+      : n_(n), grain_(std::max<size_t>(grain, 1)), num_threads_(num_threads),
+        body_(body) {}
+
+  // Runs chunks until none is left. Called by the caller and the helpers.
+  void Work() {
+    // Count this thread as active before claiming, so that Wait() cannot miss
+    // a chunk between its claim and its run.
+    ++active_;
+    size_t begin, end;
+    while (Claim(&begin, &end)) (*body_)(begin, end);
+    if (--active_ == 0 && next_ >= n_) {
+      lock_guard<mutex> l(mutex_);
+      done_.notify_all();
+    }
+  }
+
+  // Waits until the chunks claimed by other threads are done. Only called by
+  // the caller, after Work().
+  void Wait() {
+    unique_lock<mutex> l(mutex_);
+    done_.wait(l, [this]() { return active_ == 0; });
+  }
+
+ private:
+  // Claims the next chunk: a share of what is left, at least grain_.
+  bool Claim(size_t* begin, size_t* end) {
+    size_t next = next_.load();
+    while (next < n_) {
+      size_t size = std::max(grain_, (n_ - next) / (2 * num_threads_));
+      size_t chunk_end = std::min(n_, next + size);
+      if (next_.compare_exchange_weak(next, chunk_end)) {
+        *begin = next;
+        *end = chunk_end;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  const size_t n_;
+  const size_t grain_;
+  const size_t num_threads_;
+  // Owned by the caller; only used while a chunk is left.
+  const function<void(size_t, size_t)>* body_;
+
+  atomic<size_t> next_{0};
+  // The threads in Work().
+  atomic<int> active_{0};
+  mutex mutex_;
+  condition_variable done_;
+};
+
+}  // namespace
+
+void ParallelRun(size_t n, const tParallelOptions& options,
+                 const function<void(size_t, size_t)>& body) {
+  if (n == 0) return;
+  ThreadPool* pool = options.pool != nullptr ? options.pool : ParallelPool();
+  size_t num_threads = options.max_threads > 0 ? options.max_threads
+                                               : pool->num_workers() + 1;
+  size_t grain = std::max<size_t>(options.grain, 1);
+  size_t max_chunks = (n + grain - 1) / grain;
+  num_threads = std::min(num_threads, max_chunks);
+  if (num_threads <= 1) {
+    body(0, n);
+    return;
+  }
+
+  shared_ptr<ParallelJob> job(new ParallelJob(n, grain, num_threads, &body));
+  for (size_t i = 1; i < num_threads; ++i) pool->Add([job]() { job->Work(); });
+  job->Work();
+  job->Wait();
+}
+
+}  // namespace internal
+
+}  // namespace threading
+}  // namespace util
@@ -0,0 +1,164 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Fork/join parallel algorithms on a thread pool:
+//   ParallelFor(0, n, [&](size_t i) { out[i] = f(in[i]); });
+//   vector<int> lengths = ParallelMap(words, [](const string& w) {
+//     return int(w.size()); });
+//   int total = ParallelReduce(0, n, 0, [&](size_t i) { return v[i]; },
+//                              plus<int>());
+//   ParallelSort(v.begin(), v.end());
+//
+// The range is split into chunks that the calling thread and helper functions
+// added to the pool claim one at a time. Chunks shrink as the range runs out
+// (guided scheduling), so the load balances without many tiny chunks.
+//
+// The calling thread works on the range too and only waits for chunks other
+// threads are already running, never for functions still queued. The
+// algorithms can therefore be nested, or called from a worker of the pool
+// they run on, without deadlocking even when every worker is busy.
+//
+// By default the algorithms run on a shared WorkStealingThreadPool of
+// --parallel_num_workers threads.
+
+#ifndef _PUBLIC_UTIL_THREAD_PARALLEL_H_
+#define _PUBLIC_UTIL_THREAD_PARALLEL_H_
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "base/common.h"
+#include "util/thread/thread_pool.h"
+
+extern int gFlag_parallel_num_workers;
+
+namespace util {
+namespace threading {
+
+struct tParallelOptions {
+  // The pool to run on. Null uses ParallelPool().
+  ThreadPool* pool = nullptr;
+  // The smallest number of elements in a chunk. Raise it when the work per
+  // element is tiny.
+  size_t grain = 1;
+  // The most threads working on the range, including the caller. 0 uses all
+  // the workers of the pool.
+  int max_threads = 0;
+};
+
+// The shared pool of the parallel algorithms.
+ThreadPool* ParallelPool();
+
+namespace internal {
+
+// Calls body(begin, end) on chunks covering [0, n), from the calling thread
+// and the pool, and returns once all the chunks are done.
+void ParallelRun(size_t n, const tParallelOptions& options,
+                 const function<void(size_t, size_t)>& body);
+
+}  // namespace internal
+
+// Calls f(i) for each i in [begin, end).
+template<class F>
+void ParallelFor(size_t begin, size_t end, const F& f,
+                 const tParallelOptions& options = tParallelOptions()) {
+  if (end <= begin) return;
+  internal::ParallelRun(end - begin, options,
+                        [begin, &f](size_t chunk_begin, size_t chunk_end) {
+    for (size_t i = begin + chunk_begin; i < begin + chunk_end; ++i) f(i);
+  });
+}
+
+// Returns {f(x) for x in input}, in order.
+template<class T, class F>
+auto ParallelMap(const vector<T>& input, const F& f,
+                 const tParallelOptions& options = tParallelOptions())
+    -> vector<typename decay<decltype(f(input[0]))>::type> {
+  vector<typename decay<decltype(f(input[0]))>::type> output(input.size());
+  ParallelFor(0, input.size(), [&](size_t i) { output[i] = f(input[i]); },
+              options);
+  return output;
+}
+
+// Returns identity combined with f(i) for each i in [begin, end), in order:
+// reduce(...reduce(reduce(identity, f(begin)), f(begin + 1))..., f(end - 1)).
+// reduce must be associative; it need not be commutative.
+template<class T, class F, class R>
+T ParallelReduce(size_t begin, size_t end, const T& identity, const F& f,
+                 const R& reduce,
+                 const tParallelOptions& options = tParallelOptions()) {
+  if (end <= begin) return identity;
+  // The result of each chunk, by the start of the chunk.
+  vector<pair<size_t, T>> partial;
+  mutex m;
+  internal::ParallelRun(end - begin, options,
+                        [&](size_t chunk_begin, size_t chunk_end) {
+    T result = f(begin + chunk_begin);
+    for (size_t i = begin + chunk_begin + 1; i < begin + chunk_end; ++i)
+      result = reduce(result, f(i));
+    lock_guard<mutex> l(m);
+    partial.emplace_back(chunk_begin, std::move(result));
+  });
+  sort(partial.begin(), partial.end(),
+       [](const pair<size_t, T>& a, const pair<size_t, T>& b) {
+    return a.first < b.first;
+  });
+  T result = identity;
+  for (pair<size_t, T>& p : partial) result = reduce(result, p.second);
+  return result;
+}
+
+// Sorts [first, last) with comp: the range is cut into about twice as many
+// parts as threads, which are sorted in parallel and then merged pairwise.
+// Not stable.
+template<class RandomIt, class Compare>
+void ParallelSort(RandomIt first, RandomIt last, const Compare& comp,
+                  const tParallelOptions& options = tParallelOptions()) {
+  // Below this many elements std::sort is faster.
+  const size_t kMinParallelSize = 1 << 13;
+  size_t n = last - first;
+  ThreadPool* pool = options.pool != nullptr ? options.pool : ParallelPool();
+  size_t num_threads = options.max_threads > 0 ? options.max_threads
+                                               : pool->num_workers() + 1;
+  size_t num_parts = std::min(2 * num_threads, n / kMinParallelSize);
+  if (num_parts <= 1) {
+    sort(first, last, comp);
+    return;
+  }
+
+  vector<size_t> bounds(num_parts + 1);
+  for (size_t i = 0; i <= num_parts; ++i) bounds[i] = n * i / num_parts;
+  ParallelFor(0, num_parts, [&](size_t i) {
+    sort(first + bounds[i], first + bounds[i + 1], comp);
+  }, options);
+
+  // Merge neighbouring parts until one is left.
+  for (size_t width = 1; width < num_parts; width *= 2) {
+    size_t num_merges = (num_parts + 2 * width - 1) / (2 * width);
+    ParallelFor(0, num_merges, [&](size_t i) {
+      size_t lo = 2 * width * i;
+      size_t mid = std::min(lo + width, num_parts);
+      size_t hi = std::min(lo + 2 * width, num_parts);
+      if (mid < hi) {
+        inplace_merge(first + bounds[lo], first + bounds[mid],
+                      first + bounds[hi], comp);
+      }
+    }, options);
+  }
+}
+
+template<class RandomIt>
+void ParallelSort(RandomIt first, RandomIt last,
+                  const tParallelOptions& options = tParallelOptions()) {
+  ParallelSort(first, last,
+               std::less<typename iterator_traits<RandomIt>::value_type>(),
+               options);
+}
+
+}  // namespace threading
+}  // namespace util
+
+#endif  // _PUBLIC_UTIL_THREAD_PARALLEL_H_
@@ -0,0 +1,128 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Tests for the parallel algorithms.
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "test/cc/test_main.h"
+#include "util/thread/parallel.h"
+#include "util/thread/work_stealing_thread_pool.h"
+
+namespace util {
+namespace threading {
+namespace test {
+
+class ParallelTest : public testing::Test {
+ protected:
+  ParallelTest() : pool_(4) { options_.pool = &pool_; }
+
+  WorkStealingThreadPool pool_;
+  tParallelOptions options_;
+};
+
+TEST_F(ParallelTest, ForVisitsEachIndexOnce) {
+  for (size_t grain : {1, 7, 1000, 100000}) {
+    options_.grain = grain;
+    vector<atomic<int>> visits(10000);
+    for (atomic<int>& v : visits) v = 0;
+    ParallelFor(100, 10100, [&](size_t i) { ++visits[i - 100]; }, options_);
+    int num_wrong = 0;
+    for (atomic<int>& v : visits) num_wrong += v != 1;
+    EXPECT_EQ(0, num_wrong) << "grain " << grain;
+  }
+}
+
+TEST_F(ParallelTest, ForEmptyRange) {
+  int calls = 0;
+  ParallelFor(5, 5, [&](size_t i) { ++calls; }, options_);
+  ParallelFor(5, 3, [&](size_t i) { ++calls; }, options_);
+  EXPECT_EQ(0, calls);
+}
+
+TEST_F(ParallelTest, ForOnPlainThreadPool) {
+  ThreadPool pool(3);
+  options_.pool = &pool;
+  atomic<int> sum(0);
+  ParallelFor(0, 1000, [&](size_t i) { sum += i; }, options_);
+  EXPECT_EQ(999 * 1000 / 2, sum);
+}
+
+TEST_F(ParallelTest, ForOnSharedPool) {
+  atomic<int> sum(0);
+  ParallelFor(0, 1000, [&](size_t i) { sum += i; });
+  EXPECT_EQ(999 * 1000 / 2, sum);
+}
+
+// Every worker of a small pool waits for nested loops, which must still
+// finish.
+TEST_F(ParallelTest, Nested) {
+  WorkStealingThreadPool pool(2);
+  options_.pool = &pool;
+  atomic<int> count(0);
+  ParallelFor(0, 8, [&](size_t i) {
+    ParallelFor(0, 8, [&](size_t j) {
+      ParallelFor(0, 8, [&](size_t k) { ++count; }, options_);
+    }, options_);
+  }, options_);
+  EXPECT_EQ(512, count);
+
+  // Also from a function added to the pool directly.
+  count = 0;
+  for (int i = 0; i < 4; ++i) {
+    pool.Add([&]() {
+      ParallelFor(0, 100, [&](size_t j) { ++count; }, options_);
+    });
+  }
+  pool.Wait();
+  EXPECT_EQ(400, count);
+}
+
+TEST_F(ParallelTest, Map) {
+  vector<string> words = {"a", "bb", "", "dddd"};
+  vector<int> lengths = ParallelMap(words, [](const string& w) {
+    return int(w.size());
+  }, options_);
+  EXPECT_EQ(vector<int>({1, 2, 0, 4}), lengths);
+  EXPECT_TRUE(ParallelMap(vector<int>(), [](int x) { return x; },
+                          options_).empty());
+}
+
+TEST_F(ParallelTest, ReduceKeepsOrder) {
+  // Concatenation is associative but not commutative.
+  string expected;
+  for (int i = 0; i < 1000; ++i) expected += char('a' + i % 26);
+  for (size_t grain : {1, 10, 5000}) {
+    options_.grain = grain;
+    string result = ParallelReduce(0, 1000, string(), [](size_t i) {
+      return string(1, char('a' + i % 26));
+    }, [](const string& a, const string& b) { return a + b; }, options_);
+    EXPECT_EQ(expected, result) << "grain " << grain;
+  }
+  EXPECT_EQ(7, ParallelReduce(3, 3, 7, [](size_t i) { return 1; },
+                              plus<int>(), options_));
+}
+
+TEST_F(ParallelTest, Sort) {
+  mt19937 random(77);
+  for (size_t n : {0, 1, 100, 50000, 100003}) {
+    vector<int> v(n);
+    for (int& x : v) x = random() % 1000;
+    vector<int> expected = v;
+    sort(expected.begin(), expected.end());
+    ParallelSort(v.begin(), v.end(), options_);
+    EXPECT_EQ(expected, v) << "n " << n;
+
+    ParallelSort(v.begin(), v.end(), greater<int>(), options_);
+    reverse(expected.begin(), expected.end());
+    EXPECT_EQ(expected, v) << "n " << n;
+  }
+}
+
+}  // namespace test
+}  // namespace threading
+}  // namespace util
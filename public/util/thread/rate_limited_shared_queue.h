@@ -12,52 +12,61 @@
 #define _PUBLIC_UTIL_THREAD_RATE_LIMITED_SHARED_QUEUE_H_
 
 #include <chrono>
-#include <thread>
 #include <queue>
 
 #include "base/common.h"
 #include "util/thread/shared_queue.h"
+#include "util/thread/timer.h"
 
 namespace util {
 namespace threading {
 
-template <typename T>
-class RateLimitedSharedQueue : public SharedQueue<T> {
+// The tasks are released into a queue of type tQueue, e.g.
+// LockFreeSharedQueue<T>.
+template <typename T, class tQueue = SharedQueue<T>>
+class RateLimitedSharedQueue : public tQueue {
  public:
   RateLimitedSharedQueue(double qps, int batch_size = 1,
                          int capacity = numeric_limits<int>::max(),
                          int notify_timeout = -1)
-    : SharedQueue<T>(batch_size, capacity, notify_timeout),
+    : tQueue(batch_size, capacity, notify_timeout),
       min_ms_between_tasks_(1000.0 / qps),
       // set to -2*min_ms_between_tasks in the past, so the new task can be added immediately
       last_task_add_timestamp_ms_(chrono::duration_cast<chrono::milliseconds>(
-        chrono::high_resolution_clock::now().time_since_epoch()).count() - 2*min_ms_between_tasks_),
-      run_qps_thread_(true) {
-      consume_qps_thread_.reset(
-          new thread(&RateLimitedSharedQueue<T>::ConsumeQueryRate, this));
-    }
+        chrono::high_resolution_clock::now().time_since_epoch()).count() - 2*min_ms_between_tasks_) {}
 
   virtual ~RateLimitedSharedQueue() {
-    if (consume_qps_thread_) {
-      run_qps_thread_ = false;
-      consume_qps_thread_->join();
+    Timer::tTimerId release_timer;
+    {
+      lock_guard<mutex> l(m_);
+      release_timer = release_timer_;
     }
+    if (release_timer != 0) Timer::Instance().Cancel(release_timer);
   }
 
-  virtual void push(const T& t) override {
+  virtual void push(T t) override {
     T task;
     bool add_task = false;
     {
       lock_guard<mutex> l(m_);
       // add the new task
-      tasks_.push(t);
+      tasks_.push(std::move(t));
       // if past the time threshold, execute immediately
       // and reset the timestamp
       add_task = MaybeGetTask(&task);
+      // otherwise release it from the timer once it is
+      if (!add_task && !release_armed_) {
+        release_armed_ = true;
+        release_timer_ = Timer::Instance().RunAfter(MsUntilNextTask(),
+                                                    [this]() { ReleaseTask(); });
+      }
     }
-    if (add_task) AddTask(task);
+    if (add_task) AddTask(std::move(task));
   }
 
+  // the tasks are released in order, whatever their lane
+  virtual void push(T t, int lane) override { push(std::move(t)); }
+
   // return the number of tasks that have not been moved as
   //   a result of rate limiting
   virtual int NumPendingTasks() {
@@ -66,44 +75,39 @@ class RateLimitedSharedQueue : public SharedQueue<T> {
   }
 
  private:
-  // wake up every min_ms_between_tasks and process any pending
-  // tasks if they exist
+  // runs on the timer when the next pending task may be released, and
+  // re-arms itself while tasks are pending.
   // this function does a slightly unintuitive thing. it allows
   // AT MOST one request per min_ms_between_tasks_. even if you
   // have not had a request for the last 10 seconds, the rate will
   // NOT increase. the rate will stay at most one request per
   // min_ms_between_tasks_
-  void ConsumeQueryRate() {
-    uint64_t start_ts = 0, end_ts = 0;
-    while (run_qps_thread_) {
-      uint64_t sleep_time = min_ms_between_tasks_ - (end_ts - start_ts);
-      if (sleep_time > 0) {
-        this_thread::sleep_for(chrono::milliseconds());
-      }
-      bool add_task = false;
-      T task;
-      start_ts = TimestampMs();
-      {
-        lock_guard<mutex> l(m_);
-        add_task = MaybeGetTask(&task);
-      }
-      if (add_task) AddTask(task);
-      end_ts = TimestampMs();
+  void ReleaseTask() {
+    bool add_task = false;
+    T task;
+    {
+      lock_guard<mutex> l(m_);
+      add_task = MaybeGetTask(&task, true);
+      if (tasks_.empty())
+        release_armed_ = false;
+      else
+        Timer::Instance().Reschedule(release_timer_, MsUntilNextTask());
     }
+    if (add_task) AddTask(std::move(task));
   }
 
-  void AddTask(const T& task) {
-    SharedQueue<T>::push(task);
+  void AddTask(T task) {
+    tQueue::push(std::move(task));
   }
 
   // checks if it is time to run a new task. fills in the task if
   // a new task is ready to run
   // @warning ASSUMES the mutex is already locked
   // @return true if task is filled with the new task that is ready to run
-  bool MaybeGetTask(T* task) {
-    bool ready = ReadyForNextTask();
+  bool MaybeGetTask(T* task, bool on_schedule = false) {
+    bool ready = ReadyForNextTask(on_schedule);
     if (ready) {
-      *task = tasks_.back();
+      *task = std::move(tasks_.front());
       tasks_.pop();
     }
     return ready;
@@ -114,17 +118,31 @@ class RateLimitedSharedQueue : public SharedQueue<T> {
   // @warning ASSUMES the mutex is already locked
   // @warning ASSUMES the task is pushed to tasks_ per executing
   // @modifies last_task_add_timestamp_ms_
-  bool ReadyForNextTask() {
+  // on_schedule is set when the timer releases a backlog: the next task is
+  // then due min_ms_between_tasks_ after this one was, not after the timer
+  // fired, so the latency of the timer does not lower the rate.
+  bool ReadyForNextTask(bool on_schedule) {
     uint64_t timestamp = TimestampMs();
-    if (tasks_.size() > 0 &&
-        timestamp - last_task_add_timestamp_ms_ >= min_ms_between_tasks_) {
+    uint64_t elapsed = timestamp - last_task_add_timestamp_ms_;
+    if (tasks_.size() > 0 && elapsed >= min_ms_between_tasks_) {
       // reset the state
-      last_task_add_timestamp_ms_ = timestamp;
+      if (on_schedule && elapsed < 2 * min_ms_between_tasks_)
+        last_task_add_timestamp_ms_ += min_ms_between_tasks_;
+      else
+        last_task_add_timestamp_ms_ = timestamp;
       return true;
     }
     return false;
   }
 
+  // the ms until the next task may be released
+  // @warning ASSUMES the mutex is already locked
+  int MsUntilNextTask() {
+    uint64_t next = last_task_add_timestamp_ms_ + min_ms_between_tasks_;
+    uint64_t timestamp = TimestampMs();
+    return next > timestamp ? next - timestamp : 0;
+  }
+
   uint64_t TimestampMs() {
     return chrono::duration_cast<chrono::milliseconds>(
       chrono::high_resolution_clock::now().time_since_epoch()).count();
@@ -134,14 +152,14 @@ class RateLimitedSharedQueue : public SharedQueue<T> {
   const uint64_t min_ms_between_tasks_;
   // mutex protecting all the mutable data
   mutex m_;
-  // the thread that consumes tasks at the appropriate qps
-  shared_ptr<thread> consume_qps_thread_;
+  // releases the pending tasks at the appropriate qps
+  Timer::tTimerId release_timer_ = 0;
+  // true while release_timer_ is pending
+  bool release_armed_ = false;
   // the set of pending tasks
   queue<T> tasks_;
   // the timestamp of the last add
   uint64_t last_task_add_timestamp_ms_;
-  // true if the qps thread should continue to run
-  bool run_qps_thread_;
 };
 
 } // namespace threading
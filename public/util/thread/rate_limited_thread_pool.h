@@ -24,7 +24,7 @@ class RateLimitedThreadPool : public ThreadPool {
   //   specify qps=2, then at most one task can be executed every 500ms.
   RateLimitedThreadPool(double qps, int num_workers,
                         int capacity = numeric_limits<int>::max())
-      : ThreadPool(SQ(new RateLimitedSharedQueue<ThreadPoolFunc>(qps, 1, capacity)),
+      : ThreadPool(SQ(new RateLimitedSharedQueue<ThreadPoolTask>(qps, 1, capacity)),
                    num_workers, capacity) {}
 };
 
@@ -4,6 +4,10 @@
 //
 // Simple threadsafe queue that protects STL queue methods with a mutex.
 //
+// Elements can be pushed to one of kNumLanes lanes: all the elements of a
+// lane are consumed before those of the next one, e.g. for priorities. push()
+// without a lane uses kDefaultLane.
+//
 
 #ifndef _PUBLIC_UTIL_THREAD_SHARED_QUEUE_H_
 #define _PUBLIC_UTIL_THREAD_SHARED_QUEUE_H_
@@ -18,6 +22,7 @@
 
 #include "base/common.h"
 #include "util/factory/factory.h"
+#include "util/thread/timer.h"
 
 namespace util {
 namespace threading {
@@ -25,6 +30,9 @@ namespace threading {
 template<typename T>
 class SharedQueue {
  public:
+  static const int kNumLanes = 3;
+  static const int kDefaultLane = 1;
+
   // @param batch_size - the number of elements in the queue before
   //        the producer is notified
   // @param capacity - the max number of elements in the queue after which
@@ -40,18 +48,15 @@ class SharedQueue {
       producers_finished_(false),
       last_flush_ts_(std::chrono::high_resolution_clock::now()) {
     if (notify_timeout_ > 0) {
-      run_timeout_thread_ = true;
-      timeout_notify_thread_.reset(
-          new thread(&SharedQueue<T>::timeout_consume, this));
+      lock_guard<mutex> l(mutex_);
+      timeout_timer_ = Timer::Instance().RunAfter(notify_timeout_ * 1000,
+                                                  [this]() { timeout_consume(); });
     }
   }
 
   virtual ~SharedQueue() {
     notify_producers_finished();
-    if (timeout_notify_thread_ != NULL) {
-      run_timeout_thread_ = false;
-      timeout_notify_thread_->join();
-    }
+    if (timeout_timer_ != 0) Timer::Instance().Cancel(timeout_timer_);
   }
 
   int batch_size() const { return batch_size_; }
@@ -59,66 +64,73 @@ class SharedQueue {
 
   // Note that these values are approximate. They may change after the function
   // returns. Any critical code should not depend on these values.
-  bool empty() { lock_guard<mutex> l(mutex_); return q_.empty(); }
-  size_t size() { lock_guard<mutex> l(mutex_); return q_.size(); }
+  virtual bool empty() { lock_guard<mutex> l(mutex_); return size_ == 0; }
+  virtual size_t size() { lock_guard<mutex> l(mutex_); return size_; }
 
-  bool producers_finished() {
+  virtual bool producers_finished() {
     lock_guard<mutex> l(mutex_);
     return producers_finished_;
   }
 
   // This will always add to the queue regardless of the capacity.
-  virtual void push(const T& t) {
+  // T may be move-only.
+  virtual void push(T t) {
     lock_guard<mutex> l(mutex_);
-    unlocked_push(t);
+    unlocked_push(std::move(t), kDefaultLane);
   }
 
-  bool try_push(const T& t) {
+  // Same, to the given lane. Queues that do not support lanes ignore it.
+  virtual void push(T t, int lane) {
     lock_guard<mutex> l(mutex_);
-    if (q_.size() >= capacity()) return false;
+    unlocked_push(std::move(t), lane);
+  }
 
-    unlocked_push(t);
-    return true;
+  // t is only moved from if it is added.
+  virtual bool try_push(T&& t) {
+    lock_guard<mutex> l(mutex_);
+    return unlocked_try_push(std::move(t), kDefaultLane);
   }
 
-  T pop() {
+  virtual bool try_push(T&& t, int lane) {
     lock_guard<mutex> l(mutex_);
-    T data = q_.front();
-    q_.pop();
-    return data;
+    return unlocked_try_push(std::move(t), lane);
+  }
+
+  bool try_push(const T& t) {
+    T copy(t);
+    return try_push(std::move(copy));
+  }
+
+  virtual T pop() {
+    lock_guard<mutex> l(mutex_);
+    return unlocked_pop();
   }
 
   // blocking wait on conditional variable to consume the
   // next batch of results from the queue.
-  vector<T> consume_batch() {
+  virtual vector<T> consume_batch() {
     vector<T> batch;
     // unique lock needed for cond wait
     unique_lock<mutex> l(mutex_);
-    if (q_.size() < batch_size() && !producers_finished_)
+    if (size_ < size_t(batch_size()) && !producers_finished_)
       cond_.wait(l);
 
     // Get the batch from the queue.
-    int size = std::min<int>(batch_size(), q_.size());
+    int size = std::min<int>(batch_size(), size_);
     batch.reserve(size);
-    for (int i = 0; i < size; ++i) {
-      batch.push_back(q_.front());
-      q_.pop();
-    }
+    for (int i = 0; i < size; ++i) batch.push_back(unlocked_pop());
     // update the last flush timestamp
     last_flush_ts_ = std::chrono::high_resolution_clock::now();
     return batch;
   }
 
   // clear out the queue and push into batch.
-  vector<T> flush() {
+  virtual vector<T> flush() {
     vector<T> batch;
     lock_guard<mutex> l(mutex_);
     // flush the queue
-    batch.reserve(q_.size());
-    for (int i = 0; i < q_.size(); ++i) {
-      batch.push_back(q_.front());
-      q_.pop();
-    }
+    batch.reserve(size_);
+    while (size_ > 0) batch.push_back(unlocked_pop());
     // update the last flush timestamp
     last_flush_ts_ = std::chrono::high_resolution_clock::now();
     return batch;
@@ -126,7 +138,7 @@ class SharedQueue {
 
   // This function allows a queue manager to wake up all consumers once all
   // producers are finished.
-  void notify_producers_finished() {
+  virtual void notify_producers_finished() {
     unique_lock<mutex> l(mutex_);
     producers_finished_ = true;
     cond_.notify_all();
@@ -134,50 +146,86 @@ class SharedQueue {
 
  private:
   // Add to the queue. The caller must ensure that 'mutex_' is already held.
-  void unlocked_push(const T& t) {
-    q_.push(t);
-    if (q_.size() >= batch_size())
+  void unlocked_push(T&& t, int lane) {
+    ASSERT(lane >= 0 && lane < kNumLanes) << "Bad lane: " << lane;
+    lanes_[lane].push(std::move(t));
+    ++size_;
+    if (size_ >= size_t(batch_size()))
       cond_.notify_one();
   }
 
+  bool unlocked_try_push(T&& t, int lane) {
+    if (size_ >= size_t(capacity())) return false;
+    unlocked_push(std::move(t), lane);
+    return true;
+  }
+
+  // Remove the first element of the first non empty lane. The queue must not
+  // be empty and 'mutex_' must be held.
+  T unlocked_pop() {
+    int lane = 0;
+    while (lanes_[lane].empty()) ++lane;
+    T data = std::move(lanes_[lane].front());
+    lanes_[lane].pop();
+    --size_;
+    return data;
+  }
+
   // force the batch to be consumed if it is non-empty by
-  // notifying the condition variable
+  // notifying the condition variable. Runs on the timer once the notify
+  // timeout may have expired, and re-arms itself for the next time it may.
   void timeout_consume() {
-    while (run_timeout_thread_) {
-      this_thread::sleep_for(chrono::seconds(notify_timeout_));
-      unique_lock<mutex> l(mutex_);
-      if (producers_finished_) cond_.notify_all();
-      else if (q_.size() > 0 && std::chrono::duration_cast<std::chrono::seconds>(
-          std::chrono::high_resolution_clock::now() - last_flush_ts_).count() >=
-          notify_timeout_) cond_.notify_one();
+    lock_guard<mutex> l(mutex_);
+    if (producers_finished_) {
+      cond_.notify_all();
+      return;
+    }
+    const std::chrono::seconds timeout(notify_timeout_);
+    auto since_flush =
+        std::chrono::high_resolution_clock::now() - last_flush_ts_;
+    int next_check_ms = notify_timeout_ * 1000;
+    if (since_flush >= timeout) {
+      if (size_ > 0) cond_.notify_one();
+    } else {
+      next_check_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+          timeout - since_flush).count() + 1;
     }
+    Timer::Instance().Reschedule(timeout_timer_, next_check_ms);
   }
 
   const int batch_size_;
   const int capacity_;
   const int notify_timeout_;
-  // Thread that notifies a consumer after timeout.
-  unique_ptr<thread> timeout_notify_thread_;
-  volatile bool run_timeout_thread_;
+  // Notifies a consumer after timeout.
+  Timer::tTimerId timeout_timer_ = 0;
   volatile bool producers_finished_;
   // the timestamp of the last flush
   std::chrono::time_point<std::chrono::high_resolution_clock> last_flush_ts_;
-  queue<T> q_;
+  queue<T> lanes_[kNumLanes];
+  // The number of elements in all the lanes.
+  size_t size_ = 0;
   mutex mutex_;
   condition_variable cond_;
 };
 
+template<typename T> const int SharedQueue<T>::kNumLanes;
+template<typename T> const int SharedQueue<T>::kDefaultLane;
+
+// The queue implementation is picked with the template argument, e.g.
+// Queue<LockFreeSharedQueue<T>>("id") (see lock_free_shared_queue.h). It must
+// be constructible from (batch_size, capacity, notify_timeout).
 template<typename T>
 class SharedQueueFactory :
     public LazyFactory<SharedQueue<T>, string, int, int, int> {
   typedef LazyFactory<SharedQueue<T>, string, int, int, int> super;
 
  public:
+  template<class tQueue = SharedQueue<T>>
   static typename super::shared_proxy Queue(const string& id, int batch_size = 1,
       int capacity = numeric_limits<int>::max(), int notify_timeout = -1) {
     return super::make_shared(id, batch_size, capacity, notify_timeout,
         [](int batch_size, int capacity, int notify_timeout) {
-      return new SharedQueue<T>(batch_size, capacity, notify_timeout);
+      return new tQueue(batch_size, capacity, notify_timeout);
     });
   }
 };
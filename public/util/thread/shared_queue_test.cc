@@ -25,6 +25,19 @@ TEST(SharedQueue, Sanity) {
   EXPECT_EQ(1, val);
 }
 
+TEST(SharedQueue, Lanes) {
+  SharedQueue<int> q(2);
+  q.push(1, 2);
+  q.push(2);
+  q.push(3, 0);
+  EXPECT_TRUE(q.try_push(4, 0));
+  EXPECT_EQ(4, q.size());
+  EXPECT_EQ(vector<int>({3, 4}), q.consume_batch());
+  EXPECT_EQ(2, q.pop());
+  EXPECT_EQ(vector<int>({1}), q.flush());
+  EXPECT_TRUE(q.empty());
+}
+
 template<typename T>
 class SharedQueueTest : public testing::Test {
  protected:
@@ -0,0 +1,147 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Move-only replacement for std::function<void()> that stores callables of up
+// to kInlineSize bytes, e.g. lambdas capturing a few pointers and strings or
+// a std::function, in place instead of on the heap. std::function only does
+// that for callables of 16 bytes or less, so most thread pool functions cost
+// one or two allocations each.
+//
+// Larger callables, and callables that may throw when moved, are still
+// allocated on the heap.
+
+#ifndef _PUBLIC_UTIL_THREAD_SMALL_TASK_H_
+#define _PUBLIC_UTIL_THREAD_SMALL_TASK_H_
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "base/common.h"
+
+namespace util {
+namespace threading {
+
+class SmallTask {
+ public:
+  // Callables up to this size are stored inline.
+  static const size_t kInlineSize = 64;
+
+  SmallTask() {}
+  SmallTask(nullptr_t) {}
+
+  template<class F, class = typename enable_if<!is_same<
+      typename decay<F>::type, SmallTask>::value>::type>
+  SmallTask(F&& f) {
+    typedef typename decay<F>::type tFunc;
+    Init<tFunc>(std::forward<F>(f), integral_constant<bool, FitsInline<tFunc>()>());
+  }
+
+  SmallTask(SmallTask&& other) noexcept { MoveFrom(&other); }
+
+  SmallTask& operator=(SmallTask&& other) noexcept {
+    if (this != &other) {
+      Reset();
+      MoveFrom(&other);
+    }
+    return *this;
+  }
+
+  ~SmallTask() { Reset(); }
+
+  explicit operator bool() const { return ops_ != nullptr; }
+
+  // True if the callable is stored in place.
+  bool is_inline() const { return ops_ != nullptr && ops_->is_inline; }
+
+  void operator()() {
+    ASSERT(ops_ != nullptr) << "Calling an empty SmallTask";
+    ops_->invoke(storage_);
+  }
+
+ private:
+  // The functions handling one type of callable.
+  struct Ops {
+    void (*invoke)(void* storage);
+    // Moves the callable from one storage to another, leaving 'from' empty.
+    void (*relocate)(void* from, void* to);
+    void (*destroy)(void* storage);
+    bool is_inline;
+  };
+
+  // Callables stored in place.
+  template<class F>
+  struct InlineOps {
+    static void Invoke(void* s) { (*static_cast<F*>(s))(); }
+    static void Relocate(void* from, void* to) {
+      new (to) F(std::move(*static_cast<F*>(from)));
+      static_cast<F*>(from)->~F();
+    }
+    static void Destroy(void* s) { static_cast<F*>(s)->~F(); }
+    static const Ops ops;
+  };
+
+  // Callables on the heap: the storage holds a pointer to them.
+  template<class F>
+  struct HeapOps {
+    static void Invoke(void* s) { (**static_cast<F**>(s))(); }
+    static void Relocate(void* from, void* to) {
+      *static_cast<F**>(to) = *static_cast<F**>(from);
+    }
+    static void Destroy(void* s) { delete *static_cast<F**>(s); }
+    static const Ops ops;
+  };
+
+  template<class F>
+  static constexpr bool FitsInline() {
+    return sizeof(F) <= kInlineSize &&
+           alignof(F) <= alignof(std::max_align_t) &&
+           is_nothrow_move_constructible<F>::value;
+  }
+
+  template<class F, class Arg>
+  void Init(Arg&& f, true_type /* inline */) {
+    new (storage_) F(std::forward<Arg>(f));
+    ops_ = &InlineOps<F>::ops;
+  }
+
+  template<class F, class Arg>
+  void Init(Arg&& f, false_type /* inline */) {
+    *reinterpret_cast<F**>(storage_) = new F(std::forward<Arg>(f));
+    ops_ = &HeapOps<F>::ops;
+  }
+
+  void MoveFrom(SmallTask* other) {
+    if (other->ops_ == nullptr) return;
+    other->ops_->relocate(other->storage_, storage_);
+    ops_ = other->ops_;
+    other->ops_ = nullptr;
+  }
+
+  void Reset() {
+    if (ops_ == nullptr) return;
+    ops_->destroy(storage_);
+    ops_ = nullptr;
+  }
+
+  alignas(std::max_align_t) unsigned char storage_[kInlineSize];
+  const Ops* ops_ = nullptr;
+
+  SmallTask(const SmallTask&) = delete;
+  SmallTask& operator=(const SmallTask&) = delete;
+};
+
+template<class F>
+const SmallTask::Ops SmallTask::InlineOps<F>::ops = {
+    &SmallTask::InlineOps<F>::Invoke, &SmallTask::InlineOps<F>::Relocate,
+    &SmallTask::InlineOps<F>::Destroy, true};
+
+template<class F>
+const SmallTask::Ops SmallTask::HeapOps<F>::ops = {
+    &SmallTask::HeapOps<F>::Invoke, &SmallTask::HeapOps<F>::Relocate,
+    &SmallTask::HeapOps<F>::Destroy, false};
+
+}  // namespace threading
+}  // namespace util
+
+#endif  // _PUBLIC_UTIL_THREAD_SMALL_TASK_H_
@@ -0,0 +1,106 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Tests for SmallTask.
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <utility>
+
+#include "test/cc/test_main.h"
+#include "util/thread/small_task.h"
+
+namespace util {
+namespace threading {
+namespace test {
+
+namespace {
+
+// Counts the live instances.
+struct Counted {
+  explicit Counted(int* live) : live(live) { ++*live; }
+  Counted(const Counted& other) : live(other.live) { ++*live; }
+  ~Counted() { --*live; }
+  void operator()() {}
+
+  int* live;
+};
+
+}  // namespace
+
+TEST(SmallTask, Empty) {
+  SmallTask task;
+  EXPECT_FALSE(task);
+  EXPECT_FALSE(task.is_inline());
+  SmallTask null_task(nullptr);
+  EXPECT_FALSE(null_task);
+}
+
+TEST(SmallTask, Inline) {
+  int calls = 0;
+  SmallTask task([&calls]() { ++calls; });
+  EXPECT_TRUE(task);
+  EXPECT_TRUE(task.is_inline());
+  task();
+  task();
+  EXPECT_EQ(2, calls);
+
+  // So is a std::function, whatever it wraps.
+  std::function<void()> f = [&calls]() { ++calls; };
+  SmallTask wrapped(f);
+  EXPECT_TRUE(wrapped.is_inline());
+  wrapped();
+  EXPECT_EQ(3, calls);
+}
+
+TEST(SmallTask, Heap) {
+  std::array<char, SmallTask::kInlineSize + 1> big;
+  big.fill('a');
+  char seen = 0;
+  SmallTask task([big, &seen]() { seen = big[SmallTask::kInlineSize]; });
+  EXPECT_FALSE(task.is_inline());
+  task();
+  EXPECT_EQ('a', seen);
+}
+
+TEST(SmallTask, MoveOnly) {
+  unique_ptr<int> p(new int(7));
+  int value = 0;
+  SmallTask task([p = std::move(p), &value]() { value = *p; });
+  SmallTask moved(std::move(task));
+  EXPECT_FALSE(task);
+  moved();
+  EXPECT_EQ(7, value);
+
+  task = std::move(moved);
+  EXPECT_FALSE(moved);
+  value = 0;
+  task();
+  EXPECT_EQ(7, value);
+}
+
+TEST(SmallTask, Destroys) {
+  int live = 0;
+  {
+    SmallTask task{Counted(&live)};
+    EXPECT_EQ(1, live);
+    SmallTask moved(std::move(task));
+    EXPECT_EQ(1, live);
+    moved = SmallTask();
+    EXPECT_EQ(0, live);
+  }
+  {
+    std::array<char, SmallTask::kInlineSize> big;
+    Counted counted(&live);
+    SmallTask task([big, counted]() {});
+    EXPECT_FALSE(task.is_inline());
+    EXPECT_EQ(2, live);
+    SmallTask moved(std::move(task));
+    EXPECT_EQ(2, live);
+  }
+  EXPECT_EQ(0, live);
+}
+
+}  // namespace test
+}  // namespace threading
+}  // namespace util
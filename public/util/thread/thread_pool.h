@@ -18,19 +18,64 @@
 
 #include "base/common.h"
 #include "util/factory/factory.h"
+#include "util/thread/cpu_affinity.h"
 #include "util/thread/shared_queue.h"
+#include "util/thread/small_task.h"
+#include "util/thread/thread_pool_stats.h"
 
 namespace util {
 namespace threading {
 
 typedef std::function<void()> ThreadPoolFunc;
 
+// What the pools queue: the added function together with the bookkeeping of
+// the pool. Small functions are stored without allocating.
+typedef SmallTask ThreadPoolTask;
+
+// The lane of a function added to a pool. Waiting functions of a higher
+// priority run before those of a lower one, so low priority functions only run
+// when nothing else is waiting. Pools without lanes (WorkStealingThreadPool)
+// ignore it.
+enum class ThreadPoolPriority { kHigh = 0, kNormal = 1, kLow = 2 };
+
+static_assert(static_cast<int>(ThreadPoolPriority::kLow) <
+                  SharedQueue<ThreadPoolTask>::kNumLanes &&
+              static_cast<int>(ThreadPoolPriority::kNormal) ==
+                  SharedQueue<ThreadPoolTask>::kDefaultLane,
+              "The priorities must map to the lanes of the queue.");
+
+// How a function added to a pool is run.
+struct ThreadPoolTaskOptions {
+  typedef chrono::steady_clock Clock;
+
+  ThreadPoolTaskOptions(ThreadPoolPriority priority = ThreadPoolPriority::kNormal,
+                        Clock::time_point deadline = Clock::time_point::max())
+      : priority(priority), deadline(deadline) {}
+
+  // A deadline 'msec' milliseconds from now.
+  static ThreadPoolTaskOptions WithTimeout(int msec,
+      ThreadPoolPriority priority = ThreadPoolPriority::kNormal) {
+    return ThreadPoolTaskOptions(
+        priority, Clock::now() + chrono::milliseconds(msec));
+  }
+
+  bool has_deadline() const { return deadline != Clock::time_point::max(); }
+
+  ThreadPoolPriority priority;
+  // A function that has not started by its deadline is dropped without
+  // running. One that finishes after it is counted as late.
+  Clock::time_point deadline;
+};
+
 namespace internal {
 
 // Threadpool worker class. Each worker processes callbacks from the queue.
+// The worker thread runs on 'cpus' if not empty.
 class ThreadPoolWorker {
  public:
-  ThreadPoolWorker(int id, SharedQueue<ThreadPoolFunc>* q): id_(id), q_(q) {
+  ThreadPoolWorker(int id, SharedQueue<ThreadPoolTask>* q,
+                   const CpuSet& cpus = CpuSet())
+      : id_(id), q_(q), cpus_(cpus) {
     thread_.reset(new std::thread(&ThreadPoolWorker::WorkHorse, this));
   }
 
@@ -47,11 +92,11 @@ class ThreadPoolWorker {
 
  private:
   bool Run() {
-    vector<ThreadPoolFunc> batch = q_->consume_batch();
+    vector<ThreadPoolTask> batch = q_->consume_batch();
     if (batch.empty() && q_->producers_finished()) return false;
 
     // Run all the function in the batch.
-    for (ThreadPoolFunc& f : batch) f();
+    for (ThreadPoolTask& f : batch) f();
 
     return true;
   }
@@ -66,6 +111,8 @@ class ThreadPoolWorker {
   }
 
   void WorkHorse() {
+    if (!SetCurrentThreadAffinity(cpus_))
+      LOG(INFO) << "Could not pin thread " << id_ << " to its cpus.";
     // Loop on the queue and run callbacks.
     while(!done_ && Run());
     done_ = true;
@@ -73,7 +120,8 @@ class ThreadPoolWorker {
   }
 
   int id_ = -1;
-  SharedQueue<ThreadPoolFunc>* q_;
+  SharedQueue<ThreadPoolTask>* q_;
+  const CpuSet cpus_;
   unique_ptr<std::thread> thread_;
   volatile bool done_ = false;
 };
@@ -83,27 +131,41 @@ class ThreadPoolWorker {
 // Creates a new threadpool of 'n' threads.
 class ThreadPool {
  public:
-  typedef shared_ptr<SharedQueue<ThreadPoolFunc>> SQ;
+  typedef shared_ptr<SharedQueue<ThreadPoolTask>> SQ;
 
   // Creates a thread pool with num_workers with given capacity for the given
-  // shared queue.
-  ThreadPool(const SQ& q, int num_workers, int capacity = numeric_limits<int>::max())
-      : q_(q), capacity_(capacity), size_(0) {
+  // shared queue. The workers are pinned to 'cpus' if not empty, e.g. to the
+  // cpus of a NUMA node (see cpu_affinity.h).
+  ThreadPool(const SQ& q, int num_workers, int capacity = numeric_limits<int>::max(),
+             const CpuSet& cpus = CpuSet())
+      : capacity_(capacity), size_(0), q_(q) {
+    stats_.set_num_workers(num_workers);
     workers_.reserve(num_workers);
     for (int i = 0; i < num_workers; ++i)
       workers_.push_back(shared_ptr<internal::ThreadPoolWorker>(
-          new internal::ThreadPoolWorker(i, q_.get())));
+          new internal::ThreadPoolWorker(i, q_.get(), cpus)));
   }
 
   // Create a new queue with batch size 1 and given capacity.
-  ThreadPool(int num_workers, int capacity = numeric_limits<int>::max())
-     : ThreadPool(SQ(new SharedQueue<ThreadPoolFunc>(1, capacity)),
-                  num_workers, capacity) {}
+  ThreadPool(int num_workers, int capacity = numeric_limits<int>::max(),
+             const CpuSet& cpus = CpuSet())
+     : ThreadPool(SQ(new SharedQueue<ThreadPoolTask>(1, capacity)),
+                  num_workers, capacity, cpus) {}
 
-  ~ThreadPool() { Finish(); }
+  virtual ~ThreadPool() { Finish(); }
 
   int capacity() const { return capacity_; }
 
+  // The name of the pool in its stats.
+  string name() const { return stats_.name(); }
+  void set_name(const string& name) { stats_.set_name(name); }
+
+  // The telemetry of the pool: queue wait and run times, busy workers, etc.
+  const ThreadPoolStats& stats() const { return stats_; }
+
+  // The number of threads running the functions.
+  virtual int num_workers() const { return workers_.size(); }
+
   // Returns the number of functions still waiting to be executed or being
   // currently executed.
   int size() const {
@@ -113,25 +175,49 @@ class ThreadPool {
 
   // The queue size. This does not include the currently running functions but
   // just the functions waiting in the queue.
-  int queue_size() const { return q_->size(); }
+  virtual int queue_size() const { return q_->size(); }
 
   // Check if the pool is empty.
   int empty() const { return !size(); }
 
+  // The number of functions dropped because their deadline passed before they
+  // started, and of functions that finished after their deadline.
+  int num_dropped() const { return stats_.Snapshot().dropped; }
+  int num_late() const { return stats_.Snapshot().late; }
+
   // Adds a new func to be executed. Capacity constraints are ignored.
-  void Add(ThreadPoolFunc f) {
+  // f can be any callable, including move-only ones. It is stored as is,
+  // without wrapping it in a ThreadPoolFunc first.
+  template<class F>
+  void Add(F&& f) {
     // Always increment size before adding to queue.
     ++size_;
-    q_->push(std::bind(&ThreadPool::FuncHandler, this, f));
+    PushTask(MakeTask(std::forward<F>(f)), ThreadPoolPriority::kNormal);
+  }
+
+  // Same, with a priority and deadline, e.g.
+  //   pool->Add(f, ThreadPoolTaskOptions::WithTimeout(
+  //       30, ThreadPoolPriority::kLow));
+  // A dropped function is destroyed without being called.
+  template<class F>
+  void Add(F&& f, const ThreadPoolTaskOptions& options) {
+    ++size_;
+    PushTask(MakeTask(std::forward<F>(f), options), options.priority);
   }
 
   // Tries to add a new func to be executed. If the threadpool is at capacity
   // the new function is not added. The caller is responsible for calling the
-  // func.
-  bool TryAdd(ThreadPoolFunc f) {
+  // func, which is lost if it was passed as an rvalue.
+  template<class F>
+  bool TryAdd(F&& f,
+              const ThreadPoolTaskOptions& options = ThreadPoolTaskOptions()) {
     ++size_;
-    bool res = q_->try_push(std::bind(&ThreadPool::FuncHandler, this, f));
-    if (!res) --size_;
+    bool res = TryPushTask(MakeTask(std::forward<F>(f), options),
+                           options.priority);
+    if (!res) {
+      --size_;
+      stats_.Rejected();
+    }
     return res;
   }
 
@@ -160,15 +246,56 @@ class ThreadPool {
     return res;
   }
 
+ protected:
+  // Queue the task of a function added to the pool. Pools that schedule the
+  // tasks themselves (constructed with a null queue and no workers) override
+  // these. The tasks update the size of the pool when run.
+  virtual void PushTask(ThreadPoolTask task, ThreadPoolPriority priority) {
+    q_->push(std::move(task), static_cast<int>(priority));
+  }
+  virtual bool TryPushTask(ThreadPoolTask&& task, ThreadPoolPriority priority) {
+    return q_->try_push(std::move(task), static_cast<int>(priority));
+  }
+
+  // Capacity for the queue.
+  const int capacity_;
+  // The size of the threadpool. This includes the number of function currently
+  // running as well.
+  std::atomic_int size_;
+  // Pools that create their own workers set the number of workers.
+  ThreadPoolStats stats_;
+
  private:
-  void Finish() {
-    q_->notify_producers_finished();
-    for (size_t i = 0; i < workers_.size(); ++i)
-      workers_[i]->Wait();
+  template<class F>
+  ThreadPoolTask MakeTask(F&& f) {
+    return ThreadPoolTask([this, f = std::forward<F>(f),
+                           added_at = stats_.Added()]() mutable {
+      int64_t started_at = stats_.Started(added_at);
+      f();
+      stats_.Finished(started_at);
+      FuncDone();
+    });
+  }
+
+  template<class F>
+  ThreadPoolTask MakeTask(F&& f, const ThreadPoolTaskOptions& options) {
+    if (!options.has_deadline()) return MakeTask(std::forward<F>(f));
+    return ThreadPoolTask([this, f = std::forward<F>(f),
+                           added_at = stats_.Added(),
+                           deadline = options.deadline]() mutable {
+      int64_t started_at = stats_.Started(added_at);
+      if (ThreadPoolTaskOptions::Clock::now() > deadline) {
+        stats_.Dropped();
+      } else {
+        f();
+        stats_.Finished(started_at);
+        if (ThreadPoolTaskOptions::Clock::now() > deadline) stats_.Late();
+      }
+      FuncDone();
+    });
   }
 
-  void FuncHandler(ThreadPoolFunc& f) {
-    f();
+  void FuncDone() {
     --size_;
     if (empty()) {
       std::unique_lock<std::mutex> l(mutex_);
@@ -176,16 +303,17 @@ class ThreadPool {
     }
   }
 
+  void Finish() {
+    if (q_ != nullptr) q_->notify_producers_finished();
+    for (size_t i = 0; i < workers_.size(); ++i)
+      workers_[i]->Wait();
+  }
+
   // The shared queue used between threadpool workers.
   SQ q_;
 
-  // Capacity for the queue.
-  const int capacity_;
   // List of thread pool workers that run all the functions.
   vector<shared_ptr<internal::ThreadPoolWorker> > workers_;
-  // The size of the threadpool. This includes the number of function currently
-  // running as well.
-  std::atomic_int size_;
   // Mutex for the condition variable.
   mutex mutex_;
   // The condition variable to wait for all functions to finish executing.
@@ -195,16 +323,39 @@ class ThreadPool {
   ThreadPool & operator=(const ThreadPool&) = delete;
 };
 
-// Thread pool Factory utility class.
+// Thread pool Factory utility class. The pools are named after their id.
+// The pool implementation is picked with the template argument, e.g.
+// Pool<WorkStealingThreadPool>("id") (see work_stealing_thread_pool.h). It
+// must be constructible from (num_workers, capacity). The first call for an
+// id and parameters decides the implementation of that pool.
 class ThreadPoolFactory : public LazyFactory<ThreadPool, string, int, int> {
   typedef LazyFactory<ThreadPool, string, int, int> super;
 
  public:
+  template<class tPool = ThreadPool>
   static typename super::mutable_shared_proxy Pool(const string& id,
       int num_workers = 32, int capacity = numeric_limits<int>::max()) {
     return super::make_shared(id, num_workers, capacity,
-        [](int num_workers, int capacity) {
-            return new ThreadPool(num_workers, capacity);
+        [id](int num_workers, int capacity) {
+            tPool* pool = new tPool(num_workers, capacity);
+            pool->set_name(id);
+            return pool;
+        });
+  }
+
+  // Same for a pool whose workers are pinned to 'cpus', e.g.
+  // PinnedPool("log", CpuTopology::Get().nodes()[1].cpus, 8). tPool must be
+  // constructible from (num_workers, capacity, cpus). As above, the first call
+  // for an id and parameters decides the cpus.
+  template<class tPool = ThreadPool>
+  static typename super::mutable_shared_proxy PinnedPool(const string& id,
+      const CpuSet& cpus, int num_workers = 32,
+      int capacity = numeric_limits<int>::max()) {
+    return super::make_shared(id, num_workers, capacity,
+        [id, cpus](int num_workers, int capacity) {
+            tPool* pool = new tPool(num_workers, capacity, cpus);
+            pool->set_name(id);
+            return pool;
         });
   }
 };
@@ -0,0 +1,202 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/thread/thread_pool_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+namespace util {
+namespace threading {
+
+namespace {
+
+// The live stats, in order of creation.
+mutex& RegistryMutex() {
+  static mutex m;
+  return m;
+}
+
+vector<ThreadPoolStats*>& Registry() {
+  static vector<ThreadPoolStats*> stats;
+  return stats;
+}
+
+}  // namespace
+
+const int CycleHistogram::kNumBuckets;
+
+int64_t CycleHistogram::count() const {
+  int64_t n = 0;
+  for (int64_t c : buckets_) n += c;
+  return n;
+}
+
+double CycleHistogram::mean_usec() const {
+  int64_t n = count();
+  return n == 0 ? 0 : sum_cycles_ / CycleClock::CyclesPerUsec() / n;
+}
+
+double CycleHistogram::PercentileUsec(double p) const {
+  int64_t n = count();
+  if (n == 0) return 0;
+  int64_t rank = max<int64_t>(1, ceil(n * p / 100));
+  int64_t seen = 0;
+  int bucket = 0;
+  for (; bucket < kNumBuckets - 1; ++bucket) {
+    seen += buckets_[bucket];
+    if (seen >= rank) break;
+  }
+  return ldexp(1.0, bucket) / CycleClock::CyclesPerUsec();
+}
+
+double CycleHistogram::max_usec() const {
+  return max_cycles_ / CycleClock::CyclesPerUsec();
+}
+
+string CycleHistogram::ToString() const {
+  stringstream ss;
+  ss << fixed << setprecision(1) << "n=" << count() << " mean="
+     << mean_usec() << "us p50=" << PercentileUsec(50) << "us p90="
+     << PercentileUsec(90) << "us p99=" << PercentileUsec(99) << "us max="
+     << max_usec() << "us";
+  return ss.str();
+}
+
+bool ThreadPoolStats::tSnapshot::GetMetric(const string& metric,
+                                           double* value) const {
+  const pair<const char*, int64_t> counters[] = {
+    {"num_workers", num_workers}, {"added", added}, {"rejected", rejected},
+    {"completed", completed}, {"dropped", dropped}, {"late", late},
+    {"queued", queued}, {"busy", busy},
+  };
+  for (const auto& counter : counters) {
+    if (metric == counter.first) {
+      *value = counter.second;
+      return true;
+    }
+  }
+
+  const CycleHistogram* histogram = nullptr;
+  string stat;
+  if (metric.compare(0, 11, "queue_wait_") == 0) {
+    histogram = &queue_wait;
+    stat = metric.substr(11);
+  } else if (metric.compare(0, 4, "run_") == 0) {
+    histogram = &run;
+    stat = metric.substr(4);
+  } else {
+    return false;
+  }
+  if (stat == "count") *value = histogram->count();
+  else if (stat == "mean_us") *value = histogram->mean_usec();
+  else if (stat == "p50_us") *value = histogram->PercentileUsec(50);
+  else if (stat == "p90_us") *value = histogram->PercentileUsec(90);
+  else if (stat == "p99_us") *value = histogram->PercentileUsec(99);
+  else if (stat == "max_us") *value = histogram->max_usec();
+  else return false;
+  return true;
+}
+
+string ThreadPoolStats::tSnapshot::ToString() const {
+  stringstream ss;
+  ss << (name.empty() ? "<unnamed>" : name) << ": workers=" << num_workers << " busy=" << busy
+     << " queued=" << queued << " added=" << added << " completed="
+     << completed << " rejected=" << rejected << " dropped=" << dropped
+     << " late=" << late << endl
+     << "  queue wait: " << queue_wait.ToString() << endl
+     << "  run:        " << run.ToString() << endl;
+  return ss.str();
+}
+
+ThreadPoolStats::ThreadPoolStats(const string& name) : name_(name) {
+  lock_guard<mutex> l(RegistryMutex());
+  Registry().push_back(this);
+}
+
+ThreadPoolStats::~ThreadPoolStats() {
+  lock_guard<mutex> l(RegistryMutex());
+  vector<ThreadPoolStats*>& registry = Registry();
+  registry.erase(find(registry.begin(), registry.end(), this));
+}
+
+string ThreadPoolStats::name() const {
+  lock_guard<mutex> l(RegistryMutex());
+  return name_;
+}
+
+void ThreadPoolStats::set_name(const string& name) {
+  lock_guard<mutex> l(RegistryMutex());
+  name_ = name;
+}
+
+ThreadPoolStats::tSnapshot ThreadPoolStats::Snapshot() const {
+  lock_guard<mutex> l(RegistryMutex());
+  return SnapshotLocked();
+}
+
+ThreadPoolStats::tSnapshot ThreadPoolStats::SnapshotLocked() const {
+  tSnapshot snapshot;
+  snapshot.name = name_;
+  snapshot.num_workers = num_workers_;
+  int64_t started = 0;
+  for (const tShard& shard : shards_) {
+    // Read the completed functions first, so that busy is never negative.
+    snapshot.completed += shard.completed.load(memory_order_relaxed);
+    snapshot.dropped += shard.dropped.load(memory_order_relaxed);
+    snapshot.late += shard.late.load(memory_order_relaxed);
+    started += shard.started.load(memory_order_relaxed);
+    snapshot.rejected += shard.rejected.load(memory_order_relaxed);
+    snapshot.added += shard.added.load(memory_order_relaxed);
+    for (int i = 0; i < CycleHistogram::kNumBuckets; ++i) {
+      snapshot.queue_wait.Add(i, shard.wait_buckets[i].load(memory_order_relaxed));
+      snapshot.run.Add(i, shard.run_buckets[i].load(memory_order_relaxed));
+    }
+    snapshot.queue_wait.AddSum(shard.wait_sum_cycles.load(memory_order_relaxed));
+    snapshot.run.AddSum(shard.run_sum_cycles.load(memory_order_relaxed));
+    snapshot.queue_wait.AddMax(shard.wait_max_cycles.load(memory_order_relaxed));
+    snapshot.run.AddMax(shard.run_max_cycles.load(memory_order_relaxed));
+  }
+  // The shards are read one after the other: clamp what other threads moved
+  // in the meantime.
+  snapshot.busy = max<int64_t>(0, started - snapshot.completed);
+  snapshot.queued = max<int64_t>(0, snapshot.added - snapshot.rejected - started);
+  return snapshot;
+}
+
+vector<ThreadPoolStats::tSnapshot> ThreadPoolStats::SnapshotAll() {
+  vector<tSnapshot> snapshots;
+  {
+    // The stats cannot be destroyed while they are read.
+    lock_guard<mutex> l(RegistryMutex());
+    for (const ThreadPoolStats* stats : Registry())
+      snapshots.push_back(stats->SnapshotLocked());
+  }
+  stable_sort(snapshots.begin(), snapshots.end(),
+              [](const tSnapshot& a, const tSnapshot& b) {
+    return a.name < b.name;
+  });
+  return snapshots;
+}
+
+bool ThreadPoolStats::SnapshotByName(const string& name, tSnapshot* snapshot) {
+  for (tSnapshot& s : SnapshotAll()) {
+    if (s.name == name) {
+      *snapshot = std::move(s);
+      return true;
+    }
+  }
+  return false;
+}
+
+string ThreadPoolStats::Report() {
+  vector<tSnapshot> snapshots = SnapshotAll();
+  stringstream ss;
+  ss << "Thread pools: " << snapshots.size() << endl;
+  for (const tSnapshot& snapshot : snapshots) ss << snapshot.ToString();
+  return ss.str();
+}
+
+}  // namespace threading
+}  // namespace util
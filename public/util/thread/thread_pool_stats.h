@@ -0,0 +1,196 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Telemetry of the thread pools: how long functions wait in the queue before
+// they start, how long they run, how many workers are busy and how many
+// functions were rejected by TryAdd or dropped at their deadline.
+//
+// Every ThreadPool has a ThreadPoolStats, named after the pool (see
+// ThreadPool::set_name(); pools of ThreadPoolFactory are named after their
+// id). The live pools are listed with ThreadPoolStats::SnapshotAll(), e.g.
+// on the /_threads page of RPCServer, and read by name through the
+// .get_counters method as counter "thread_pool.<name>".
+//
+// Recording is meant to be nearly free: timestamps come from the TSC, and the
+// counters are sharded by thread, so that workers only touch their own cache
+// line. Durations are kept in power of 2 buckets of cycles and converted to
+// microseconds when read.
+
+#ifndef _PUBLIC_UTIL_THREAD_THREAD_POOL_STATS_H_
+#define _PUBLIC_UTIL_THREAD_THREAD_POOL_STATS_H_
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "base/common.h"
+#include "util/time/cycle_clock.h"
+
+namespace util {
+namespace threading {
+
+using ::util::time::CycleClock;
+
+// The durations of a pool read in a snapshot, in power of 2 buckets of
+// cycles: bucket i holds durations in [2^(i-1), 2^i) cycles. Unlike
+// stats::LatencyHistogram, which records, this is a plain copyable value merged
+// from the atomic counters of the shards, and its buckets are coarse enough to
+// keep those small. The exact maximum is tracked alongside the buckets.
+class CycleHistogram {
+ public:
+  static const int kNumBuckets = 64;
+
+  static int BucketOf(int64_t cycles) {
+    return cycles <= 0 ? 0 : 64 - __builtin_clzll(cycles);
+  }
+
+  void Add(int bucket, int64_t count) { buckets_[bucket] += count; }
+  void AddSum(int64_t cycles) { sum_cycles_ += cycles; }
+  void AddMax(int64_t cycles) { max_cycles_ = max(max_cycles_, cycles); }
+
+  int64_t count() const;
+  double mean_usec() const;
+  // The upper bound of the bucket of the p-th percentile (0 < p <= 100).
+  double PercentileUsec(double p) const;
+  // The longest duration recorded.
+  double max_usec() const;
+
+  // "n=1234 mean=5.1us p50=4.3us p90=8.5us p99=34.1us max=60.7us".
+  string ToString() const;
+
+ private:
+  int64_t buckets_[kNumBuckets] = {};
+  int64_t sum_cycles_ = 0;
+  int64_t max_cycles_ = 0;
+};
+
+class ThreadPoolStats {
+ public:
+  // The counters of a pool at one point.
+  struct tSnapshot {
+    string name;
+    int num_workers = 0;
+    // The functions added, including those rejected by TryAdd.
+    int64_t added = 0;
+    int64_t rejected = 0;
+    // The functions done, including those dropped at their deadline.
+    int64_t completed = 0;
+    int64_t dropped = 0;
+    int64_t late = 0;
+    // The functions waiting in the queue, and the busy workers.
+    int64_t queued = 0;
+    int64_t busy = 0;
+    CycleHistogram queue_wait;
+    CycleHistogram run;
+
+    // A metric by name, for .get_counters: any of the counters above, or
+    // queue_wait_* and run_* with * one of count, mean_us, p50_us, p90_us,
+    // p99_us and max_us. Returns false for an unknown name.
+    bool GetMetric(const string& metric, double* value) const;
+
+    string ToString() const;
+  };
+
+  explicit ThreadPoolStats(const string& name = "");
+  ~ThreadPoolStats();
+
+  string name() const;
+  void set_name(const string& name);
+  void set_num_workers(int num_workers) { num_workers_ = num_workers; }
+
+  // Recording, from any thread. Added() returns the timestamp to pass to
+  // Started() when the function starts, and Started() the one to pass to
+  // Finished(). A function dropped at its deadline is started but not
+  // finished.
+  int64_t Added() {
+    Shard().added.fetch_add(1, memory_order_relaxed);
+    return CycleClock::Now();
+  }
+  void Rejected() { Shard().rejected.fetch_add(1, memory_order_relaxed); }
+  int64_t Started(int64_t added_at) {
+    int64_t now = CycleClock::Now();
+    tShard& shard = Shard();
+    shard.started.fetch_add(1, memory_order_relaxed);
+    Record(now - added_at, shard.wait_buckets, &shard.wait_sum_cycles,
+           &shard.wait_max_cycles);
+    return now;
+  }
+  void Finished(int64_t started_at) {
+    tShard& shard = Shard();
+    Record(CycleClock::Now() - started_at, shard.run_buckets,
+           &shard.run_sum_cycles, &shard.run_max_cycles);
+    shard.completed.fetch_add(1, memory_order_relaxed);
+  }
+  void Dropped() {
+    tShard& shard = Shard();
+    shard.dropped.fetch_add(1, memory_order_relaxed);
+    shard.completed.fetch_add(1, memory_order_relaxed);
+  }
+  void Late() { Shard().late.fetch_add(1, memory_order_relaxed); }
+
+  tSnapshot Snapshot() const;
+
+  // The snapshots of all the live pools, by name.
+  static vector<tSnapshot> SnapshotAll();
+  // The snapshot of the first pool named 'name'. Returns false if none is.
+  static bool SnapshotByName(const string& name, tSnapshot* snapshot);
+  // SnapshotAll() as text.
+  static string Report();
+
+ private:
+  static const int kNumShards = 16;
+
+  // The counters written by the threads mapped to a shard. The padding keeps
+  // the counters of neighboring shards on different cache lines.
+  struct tShard {
+    char padding[64];
+    atomic<int64_t> added{0};
+    atomic<int64_t> rejected{0};
+    atomic<int64_t> started{0};
+    atomic<int64_t> completed{0};
+    atomic<int64_t> dropped{0};
+    atomic<int64_t> late{0};
+    atomic<int64_t> wait_sum_cycles{0};
+    atomic<int64_t> run_sum_cycles{0};
+    atomic<int64_t> wait_max_cycles{0};
+    atomic<int64_t> run_max_cycles{0};
+    atomic<int64_t> wait_buckets[CycleHistogram::kNumBuckets] = {};
+    atomic<int64_t> run_buckets[CycleHistogram::kNumBuckets] = {};
+  };
+
+  static int ShardIndex() {
+    static atomic<int> next_index(0);
+    static thread_local int index = next_index++ % kNumShards;
+    return index;
+  }
+
+  tShard& Shard() { return shards_[ShardIndex()]; }
+
+  // Called with the mutex of the registry held.
+  tSnapshot SnapshotLocked() const;
+
+  static void Record(int64_t cycles, atomic<int64_t>* buckets,
+                     atomic<int64_t>* sum, atomic<int64_t>* max_cycles) {
+    buckets[CycleHistogram::BucketOf(cycles)].fetch_add(
+        1, memory_order_relaxed);
+    sum->fetch_add(cycles, memory_order_relaxed);
+    // Only contended by the threads of the shard, and rarely written.
+    int64_t current = max_cycles->load(memory_order_relaxed);
+    while (cycles > current &&
+           !max_cycles->compare_exchange_weak(current, cycles,
+                                              memory_order_relaxed)) {}
+  }
+
+  tShard shards_[kNumShards];
+  atomic<int> num_workers_{0};
+  // Protected by the mutex of the registry.
+  string name_;
+
+  ThreadPoolStats(const ThreadPoolStats&) = delete;
+  ThreadPoolStats& operator=(const ThreadPoolStats&) = delete;
+};
+
+}  // namespace threading
+}  // namespace util
+
+#endif  // _PUBLIC_UTIL_THREAD_THREAD_POOL_STATS_H_
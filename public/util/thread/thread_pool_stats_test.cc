@@ -0,0 +1,132 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/thread/thread_pool_stats.h"
+
+#include <chrono>
+#include <thread>
+
+#include "test/cc/test_main.h"
+#include "util/thread/counters.h"
+#include "util/thread/thread_pool.h"
+
+namespace util {
+namespace threading {
+namespace test {
+
+TEST(CycleHistogram, Buckets) {
+  EXPECT_EQ(0, CycleHistogram::BucketOf(0));
+  EXPECT_EQ(0, CycleHistogram::BucketOf(-5));
+  EXPECT_EQ(1, CycleHistogram::BucketOf(1));
+  EXPECT_EQ(2, CycleHistogram::BucketOf(3));
+  EXPECT_EQ(11, CycleHistogram::BucketOf(1024));
+  EXPECT_EQ(63, CycleHistogram::BucketOf(numeric_limits<int64_t>::max()));
+
+  CycleHistogram histogram;
+  EXPECT_EQ(0, histogram.count());
+  EXPECT_EQ(0, histogram.PercentileUsec(50));
+  histogram.Add(4, 98);
+  histogram.Add(20, 2);
+  EXPECT_EQ(100, histogram.count());
+  EXPECT_DOUBLE_EQ(16 / CycleClock::CyclesPerUsec(),
+                   histogram.PercentileUsec(50));
+  EXPECT_DOUBLE_EQ(16 / CycleClock::CyclesPerUsec(),
+                   histogram.PercentileUsec(98));
+  EXPECT_DOUBLE_EQ((1 << 20) / CycleClock::CyclesPerUsec(),
+                   histogram.PercentileUsec(99));
+  EXPECT_DOUBLE_EQ((1 << 20) / CycleClock::CyclesPerUsec(),
+                   histogram.PercentileUsec(100));
+
+  // The maximum is exact, not the bound of its bucket.
+  EXPECT_EQ(0, histogram.max_usec());
+  histogram.AddMax(600000);
+  histogram.AddMax(5000);
+  EXPECT_DOUBLE_EQ(600000 / CycleClock::CyclesPerUsec(), histogram.max_usec());
+}
+
+TEST(ThreadPoolStats, CountsFunctions) {
+  ThreadPool pool(2);
+  pool.set_name("stats_test_pool");
+  EXPECT_EQ("stats_test_pool", pool.name());
+  for (int i = 0; i < 100; ++i)
+    pool.Add([]() { this_thread::sleep_for(chrono::microseconds(10)); });
+  pool.Wait();
+
+  ThreadPoolStats::tSnapshot snapshot = pool.stats().Snapshot();
+  EXPECT_EQ("stats_test_pool", snapshot.name);
+  EXPECT_EQ(2, snapshot.num_workers);
+  EXPECT_EQ(100, snapshot.added);
+  EXPECT_EQ(100, snapshot.completed);
+  EXPECT_EQ(0, snapshot.rejected);
+  EXPECT_EQ(0, snapshot.queued);
+  EXPECT_EQ(0, snapshot.busy);
+  EXPECT_EQ(100, snapshot.queue_wait.count());
+  EXPECT_EQ(100, snapshot.run.count());
+  // Every function slept for 10us.
+  EXPECT_LE(10, snapshot.run.max_usec());
+  EXPECT_LE(snapshot.run.max_usec(), snapshot.run.PercentileUsec(100));
+  EXPECT_LE(10, snapshot.run.mean_usec());
+
+  double value = 0;
+  EXPECT_TRUE(snapshot.GetMetric("completed", &value));
+  EXPECT_EQ(100, value);
+  EXPECT_TRUE(snapshot.GetMetric("run_count", &value));
+  EXPECT_EQ(100, value);
+  EXPECT_TRUE(snapshot.GetMetric("run_p99_us", &value));
+  EXPECT_LE(10, value);
+  EXPECT_TRUE(snapshot.GetMetric("run_max_us", &value));
+  EXPECT_EQ(snapshot.run.max_usec(), value);
+  EXPECT_FALSE(snapshot.GetMetric("run_p42_us", &value));
+  EXPECT_FALSE(snapshot.GetMetric("unknown", &value));
+}
+
+TEST(ThreadPoolStats, BusyQueuedAndRejected) {
+  ThreadPool pool(1, 1);
+  Notification started, release;
+  pool.Add([&]() {
+    started.Notify();
+    release.Wait();
+  });
+  started.Wait();
+  pool.Add([]() {});
+  // The pool is full.
+  EXPECT_FALSE(pool.TryAdd([]() {}));
+
+  ThreadPoolStats::tSnapshot snapshot = pool.stats().Snapshot();
+  EXPECT_EQ(3, snapshot.added);
+  EXPECT_EQ(1, snapshot.rejected);
+  EXPECT_EQ(1, snapshot.busy);
+  EXPECT_EQ(1, snapshot.queued);
+  EXPECT_EQ(0, snapshot.completed);
+
+  release.Notify();
+  pool.Wait();
+  snapshot = pool.stats().Snapshot();
+  EXPECT_EQ(0, snapshot.busy);
+  EXPECT_EQ(0, snapshot.queued);
+  EXPECT_EQ(2, snapshot.completed);
+}
+
+TEST(ThreadPoolStats, Registry) {
+  ThreadPoolStats::tSnapshot snapshot;
+  {
+    ThreadPool pool(1);
+    pool.set_name("stats_test_registry");
+    pool.Add([]() {});
+    pool.Wait();
+    ASSERT_TRUE(ThreadPoolStats::SnapshotByName("stats_test_registry",
+                                                &snapshot));
+    EXPECT_EQ(1, snapshot.completed);
+    EXPECT_NE(string::npos,
+              ThreadPoolStats::Report().find("stats_test_registry: workers=1"));
+  }
+  EXPECT_FALSE(ThreadPoolStats::SnapshotByName("stats_test_registry",
+                                               &snapshot));
+  EXPECT_EQ(string::npos, ThreadPoolStats::Report().find("stats_test_registry"));
+
+  auto pool = ThreadPoolFactory::Pool("stats_test_factory", 1);
+  EXPECT_EQ("stats_test_factory", pool->name());
+}
+
+}  // namespace test
+}  // namespace threading
+}  // namespace util
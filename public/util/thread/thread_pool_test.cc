@@ -8,6 +8,7 @@
 #include <functional>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <thread>
 #include <vector>
 
@@ -102,6 +103,62 @@ TEST(ThreadPool, WaitWithTimeout) {
   EXPECT_TRUE(pool.WaitWithTimeout(10));
 }
 
+TEST(ThreadPool, MoveOnlyFunction) {
+  ThreadPool pool(2);
+  unique_ptr<int> p(new int(5));
+  std::atomic_int value(0);
+  pool.Add([p = std::move(p), &value]() { value = *p; });
+  pool.Wait();
+  EXPECT_EQ(5, value);
+}
+
+TEST(ThreadPool, Priorities) {
+  ThreadPool pool(1);
+  Notification release;
+  pool.Add([&release]() { release.Wait(); });
+
+  mutex m;
+  vector<string> order;
+  auto record = [&m, &order](const string& name) {
+    return [&m, &order, name]() {
+      lock_guard<mutex> l(m);
+      order.push_back(name);
+    };
+  };
+  pool.Add(record("low"), ThreadPoolTaskOptions(ThreadPoolPriority::kLow));
+  pool.Add(record("normal"));
+  pool.Add(record("high"), ThreadPoolTaskOptions(ThreadPoolPriority::kHigh));
+  EXPECT_TRUE(pool.TryAdd(record("normal2")));
+  release.Notify();
+  pool.Wait();
+  EXPECT_EQ(vector<string>({"high", "normal", "normal2", "low"}), order);
+}
+
+TEST(ThreadPool, Deadlines) {
+  ThreadPool pool(1);
+  Notification release;
+  pool.Add([&release]() { release.Wait(); });
+
+  bool expired_ran = false, ran = false;
+  pool.Add([&expired_ran]() { expired_ran = true; },
+           ThreadPoolTaskOptions::WithTimeout(10));
+  pool.Add([&ran]() { ran = true; },
+           ThreadPoolTaskOptions::WithTimeout(10000));
+  this_thread::sleep_for(chrono::milliseconds(30));
+  release.Notify();
+  pool.Wait();
+  EXPECT_FALSE(expired_ran);
+  EXPECT_TRUE(ran);
+  EXPECT_EQ(1, pool.num_dropped());
+  EXPECT_EQ(0, pool.num_late());
+
+  pool.Add([]() { this_thread::sleep_for(chrono::milliseconds(20)); },
+           ThreadPoolTaskOptions::WithTimeout(5));
+  pool.Wait();
+  EXPECT_EQ(1, pool.num_dropped());
+  EXPECT_EQ(1, pool.num_late());
+}
+
 }  // namepace test
 }  // namespace threading
 }  // namespace util
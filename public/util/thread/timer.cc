@@ -0,0 +1,223 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/thread/timer.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace util {
+namespace threading {
+
+const int Timer::kWheelBits;
+const int Timer::kWheelSize;
+const int Timer::kNumLevels;
+
+Timer::Timer(int tick_ms)
+    : tick_(chrono::milliseconds(std::max(tick_ms, 1))),
+      start_(Clock::now()),
+      thread_([this]() { Run(); }) {}
+
+Timer::~Timer() {
+  {
+    lock_guard<mutex> l(mutex_);
+    stopping_ = true;
+    cond_.notify_all();
+  }
+  thread_.join();
+}
+
+Timer& Timer::Instance() {
+  static Timer* timer = new Timer;
+  return *timer;
+}
+
+Timer::tTimerId Timer::RunAfter(int msec, SmallTask f) {
+  tSlot added(1);
+  tSlot::iterator entry = added.begin();
+  entry->period = 0;
+  entry->f = std::move(f);
+
+  lock_guard<mutex> l(mutex_);
+  entry->id = next_id_++;
+  entry->deadline = DeadlineTick(msec);
+  Insert(&added, entry);
+  return entry->id;
+}
+
+Timer::tTimerId Timer::RunEvery(int period_msec, SmallTask f) {
+  tSlot added(1);
+  tSlot::iterator entry = added.begin();
+  entry->period = std::max<tTick>(MsecToTicks(period_msec), 1);
+  entry->f = std::move(f);
+
+  lock_guard<mutex> l(mutex_);
+  entry->id = next_id_++;
+  entry->deadline = DeadlineTick(period_msec);
+  Insert(&added, entry);
+  return entry->id;
+}
+
+bool Timer::Reschedule(tTimerId id, int msec) {
+  lock_guard<mutex> l(mutex_);
+  auto iter = locations_.find(id);
+  if (iter == locations_.end()) return false;
+  tLocation location = iter->second;
+  if (location.slot == &running_) {
+    location.entry->reschedule_ticks = MsecToTicks(msec);
+  } else {
+    location.entry->deadline = DeadlineTick(msec);
+    Insert(location.slot, location.entry);
+  }
+  return true;
+}
+
+bool Timer::Cancel(tTimerId id) {
+  unique_lock<mutex> l(mutex_);
+  auto iter = locations_.find(id);
+  if (iter == locations_.end()) return false;
+  tLocation location = iter->second;
+  locations_.erase(iter);
+
+  if (location.slot == &running_) {
+    bool has_next_run = location.entry->period > 0 ||
+                        location.entry->reschedule_ticks >= 0;
+    location.entry->cancelled = true;
+    if (this_thread::get_id() != thread_.get_id())
+      done_cond_.wait(l, [this, id]() { return running_id_ != id; });
+    return has_next_run;
+  }
+
+  // Destroy the function outside the lock: its captures may use the timer.
+  SmallTask f = std::move(location.entry->f);
+  location.slot->erase(location.entry);
+  l.unlock();
+  return true;
+}
+
+size_t Timer::size() {
+  lock_guard<mutex> l(mutex_);
+  return locations_.size();
+}
+
+void Timer::Insert(tSlot* from, tSlot::iterator entry) {
+  const tTick kMaxDelta = (tTick(1) << (kWheelBits * kNumLevels)) - 1;
+  if (entry->deadline - current_tick_ > kMaxDelta)
+    entry->deadline = current_tick_ + kMaxDelta;
+  tTick delta = entry->deadline - current_tick_;
+  int level = 0;
+  while (level < kNumLevels - 1 &&
+         delta >= (tTick(1) << (kWheelBits * (level + 1))))
+    ++level;
+  tSlot* slot = &wheels_[level][(entry->deadline >> (kWheelBits * level)) &
+                                (kWheelSize - 1)];
+  slot->splice(slot->end(), *from, entry);
+  locations_[entry->id] = tLocation{slot, entry};
+
+  // Wake the thread up if it sleeps past the new deadline.
+  if (entry->deadline < wakeup_tick_) cond_.notify_one();
+}
+
+void Timer::Cascade(int level) {
+  tSlot* slot = &wheels_[level][(current_tick_ >> (kWheelBits * level)) &
+                                (kWheelSize - 1)];
+  tSlot moving;
+  moving.splice(moving.end(), *slot);
+  while (!moving.empty()) Insert(&moving, moving.begin());
+}
+
+void Timer::RunDue(unique_lock<mutex>* l) {
+  while (!due_.empty() && !stopping_) {
+    tSlot::iterator entry = due_.begin();
+    running_.splice(running_.end(), due_, entry);
+    locations_[entry->id].slot = &running_;
+    running_id_ = entry->id;
+
+    l->unlock();
+    entry->f();
+    l->lock();
+
+    SmallTask done;
+    if (!entry->cancelled &&
+        (entry->reschedule_ticks >= 0 || entry->period > 0)) {
+      tTick ticks = entry->reschedule_ticks >= 0 ? entry->reschedule_ticks
+                                                 : entry->period;
+      entry->deadline = current_tick_ + std::max<tTick>(ticks, 1);
+      entry->reschedule_ticks = -1;
+      Insert(&running_, entry);
+    } else {
+      if (!entry->cancelled) locations_.erase(entry->id);
+      done = std::move(entry->f);
+      running_.erase(entry);
+    }
+    running_id_ = 0;
+    done_cond_.notify_all();
+
+    if (done) {
+      l->unlock();
+      done = nullptr;
+      l->lock();
+    }
+  }
+}
+
+Timer::tTick Timer::NextEventTick() const {
+  tTick end_of_turn = (current_tick_ | (kWheelSize - 1)) + 1;
+  for (tTick t = current_tick_ + 1; t < end_of_turn; ++t)
+    if (!wheels_[0][t & (kWheelSize - 1)].empty()) return t;
+  return end_of_turn;
+}
+
+Timer::tTick Timer::MsecToTicks(int msec) const {
+  Clock::duration delay = chrono::milliseconds(std::max(msec, 0));
+  return (delay + tick_ - Clock::duration(1)) / tick_;
+}
+
+Timer::tTick Timer::DeadlineTick(int msec) const {
+  // The first tick starting after the delay.
+  Clock::duration deadline =
+      Clock::now() - start_ + chrono::milliseconds(std::max(msec, 0));
+  tTick tick = (deadline + tick_ - Clock::duration(1)) / tick_;
+  return std::max(tick, current_tick_ + 1);
+}
+
+Timer::tTick Timer::NowTick() const {
+  return (Clock::now() - start_) / tick_;
+}
+
+void Timer::Run() {
+  unique_lock<mutex> l(mutex_);
+  while (!stopping_) {
+    wakeup_tick_ = 0;
+    // Catch up with the clock, skipping the ticks with nothing to do.
+    tTick now = NowTick();
+    while (current_tick_ < now && !stopping_) {
+      tTick next = locations_.empty() ? now + 1 : NextEventTick();
+      if (next > now) {
+        current_tick_ = now;
+        break;
+      }
+      current_tick_ = next;
+      for (int level = kNumLevels - 1; level > 0; --level) {
+        tTick turn = (tTick(1) << (kWheelBits * level)) - 1;
+        if ((current_tick_ & turn) == 0) Cascade(level);
+      }
+      tSlot* slot = &wheels_[0][current_tick_ & (kWheelSize - 1)];
+      for (tEntry& entry : *slot) locations_[entry.id].slot = &due_;
+      due_.splice(due_.end(), *slot);
+      RunDue(&l);
+      now = NowTick();
+    }
+    if (stopping_) break;
+
+    if (locations_.empty()) {
+      wakeup_tick_ = numeric_limits<tTick>::max();
+      cond_.wait(l);
+    } else {
+      wakeup_tick_ = NextEventTick();
+      cond_.wait_until(l, start_ + tick_ * int64_t(wakeup_tick_));
+    }
+  }
+}
+
+}  // namespace threading
+}  // namespace util
@@ -0,0 +1,139 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Runs functions after a delay on a single background thread:
+//   Timer::Instance().RunAfter(100, []() { ... });
+//
+// The functions run one at a time on the timer thread, so they must be short;
+// longer work should be handed to a thread pool.
+//
+// Pending functions are kept in a hierarchical timing wheel: kNumLevels wheels
+// of kWheelSize slots, each slot of a level covering a full turn of the level
+// below. Scheduling and cancelling are O(1); a function is moved down a level
+// at most kNumLevels - 1 times before it runs. The thread only wakes up for
+// ticks with something to run and once per turn of the lowest wheel, and a
+// function runs within a tick of its deadline.
+
+#ifndef _PUBLIC_UTIL_THREAD_TIMER_H_
+#define _PUBLIC_UTIL_THREAD_TIMER_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "base/common.h"
+#include "util/thread/small_task.h"
+
+namespace util {
+namespace threading {
+
+class Timer {
+ public:
+  typedef int64_t tTimerId;
+
+  // The wheels have kWheelSize slots each and tick every 'tick_ms'.
+  // Deadlines beyond kWheelSize^kNumLevels ticks are clamped.
+  static const int kWheelBits = 8;
+  static const int kWheelSize = 1 << kWheelBits;
+  static const int kNumLevels = 4;
+
+  explicit Timer(int tick_ms = 1);
+  // Drops the functions that have not run yet.
+  ~Timer();
+
+  // The process-wide timer.
+  static Timer& Instance();
+
+  // Runs f in 'msec' milliseconds. Returns an id to cancel it with.
+  tTimerId RunAfter(int msec, SmallTask f);
+
+  // Runs f every 'period_msec' milliseconds, starting in 'period_msec', until
+  // cancelled.
+  tTimerId RunEvery(int period_msec, SmallTask f);
+
+  // Runs the function 'id' in 'msec' milliseconds instead of at its current
+  // deadline, or once more after its current run if it is running, e.g. from
+  // the function itself to re-arm a timeout. Returns false if the function is
+  // done or was cancelled.
+  bool Reschedule(tTimerId id, int msec);
+
+  // Cancels the future runs of a function. If it is running, waits for it to
+  // finish (unless called from the function itself), so the function may be
+  // destroyed right after. Returns false if it had no run left.
+  bool Cancel(tTimerId id);
+
+  // The number of functions waiting to run.
+  size_t size();
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+  typedef uint64_t tTick;
+
+  struct tEntry {
+    tTimerId id;
+    tTick deadline;
+    // 0 for functions that run once.
+    tTick period;
+    SmallTask f;
+    // Set while the function runs if it is cancelled or rescheduled.
+    bool cancelled = false;
+    int64_t reschedule_ticks = -1;
+  };
+  typedef std::list<tEntry> tSlot;
+
+  // Where a function is: in a slot of the wheels, in the list of those due,
+  // or running.
+  struct tLocation {
+    tSlot* slot;
+    tSlot::iterator entry;
+  };
+
+  void Run();
+
+  // Moves 'entry' from 'from' into the slot for its deadline, which must not
+  // be before the current tick.
+  void Insert(tSlot* from, tSlot::iterator entry);
+  // Moves the functions of a slot of an upper level into the lower levels.
+  void Cascade(int level);
+  // Runs the functions due at the current tick. Called with 'l' held.
+  void RunDue(unique_lock<mutex>* l);
+  // The next tick with something to do: a slot of the lowest wheel to run or
+  // the end of its turn.
+  tTick NextEventTick() const;
+
+  tTick MsecToTicks(int msec) const;
+  // The tick of a deadline in 'msec' milliseconds. Called with mutex_ held.
+  tTick DeadlineTick(int msec) const;
+  tTick NowTick() const;
+
+  const Clock::duration tick_;
+  const Clock::time_point start_;
+
+  mutex mutex_;
+  condition_variable cond_;
+  // Signaled when a function is done running.
+  condition_variable done_cond_;
+  tSlot wheels_[kNumLevels][kWheelSize];
+  // The functions due at the current tick, and the one running.
+  tSlot due_;
+  tSlot running_;
+  tTimerId running_id_ = 0;
+  unordered_map<tTimerId, tLocation> locations_;
+  // The last tick processed.
+  tTick current_tick_ = 0;
+  // The tick the thread sleeps until, if it sleeps.
+  tTick wakeup_tick_ = 0;
+  tTimerId next_id_ = 1;
+  bool stopping_ = false;
+  thread thread_;
+
+  Timer(const Timer&) = delete;
+  Timer& operator=(const Timer&) = delete;
+};
+
+}  // namespace threading
+}  // namespace util
+
+#endif  // _PUBLIC_UTIL_THREAD_TIMER_H_
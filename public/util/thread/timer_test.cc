@@ -0,0 +1,154 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/thread/timer.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "test/cc/test_main.h"
+#include "util/thread/counters.h"
+
+namespace util {
+namespace threading {
+namespace test {
+
+TEST(Timer, RunsInDeadlineOrder) {
+  Timer timer;
+  mutex m;
+  vector<int> order;
+  Counter done(3);
+  for (int msec : {60, 20, 40}) {
+    timer.RunAfter(msec, [msec, &m, &order, &done]() {
+      {
+        lock_guard<mutex> l(m);
+        order.push_back(msec);
+      }
+      done.Notify();
+    });
+  }
+  done.Wait();
+  EXPECT_EQ(vector<int>({20, 40, 60}), order);
+  EXPECT_EQ(0, timer.size());
+}
+
+TEST(Timer, WaitsForTheDelay) {
+  Timer timer;
+  Notification done;
+  auto start = chrono::steady_clock::now();
+  timer.RunAfter(30, [&done]() { done.Notify(); });
+  done.Wait();
+  EXPECT_GE(chrono::steady_clock::now() - start, chrono::milliseconds(30));
+}
+
+TEST(Timer, Cancel) {
+  Timer timer;
+  bool ran = false;
+  Timer::tTimerId id = timer.RunAfter(20, [&ran]() { ran = true; });
+  EXPECT_EQ(1, timer.size());
+  EXPECT_TRUE(timer.Cancel(id));
+  EXPECT_FALSE(timer.Cancel(id));
+  EXPECT_EQ(0, timer.size());
+
+  Notification done;
+  id = timer.RunAfter(0, [&done]() { done.Notify(); });
+  done.Wait();
+  EXPECT_FALSE(timer.Cancel(id));
+
+  this_thread::sleep_for(chrono::milliseconds(40));
+  EXPECT_FALSE(ran);
+}
+
+// Delays longer than a turn of the lowest wheel are cascaded down before they
+// run.
+TEST(Timer, RunsOnTimeAcrossLevels) {
+  Timer timer;
+  const int kNumTimers = 200;
+  mutex m;
+  vector<int> late_ms;
+  Counter done(kNumTimers);
+  auto start = chrono::steady_clock::now();
+  for (int i = 0; i < kNumTimers; ++i) {
+    int msec = (i * 7919) % 700;
+    timer.RunAfter(msec, [msec, start, &m, &late_ms, &done]() {
+      int elapsed = chrono::duration_cast<chrono::milliseconds>(
+          chrono::steady_clock::now() - start).count();
+      {
+        lock_guard<mutex> l(m);
+        late_ms.push_back(elapsed - msec);
+      }
+      done.Notify();
+    });
+  }
+  done.Wait();
+  for (int late : late_ms) {
+    EXPECT_LE(0, late);
+    EXPECT_GT(200, late);
+  }
+}
+
+TEST(Timer, RunEvery) {
+  Timer timer;
+  Counter runs(3);
+  Timer::tTimerId id = timer.RunEvery(10, [&runs]() { runs.Notify(); });
+  EXPECT_TRUE(runs.WaitWithTimeout(1000));
+  EXPECT_TRUE(timer.Cancel(id));
+  EXPECT_EQ(0, timer.size());
+}
+
+TEST(Timer, Reschedule) {
+  Timer timer;
+  Notification done;
+  auto start = chrono::steady_clock::now();
+  Timer::tTimerId id = timer.RunAfter(10, [&done]() { done.Notify(); });
+  EXPECT_TRUE(timer.Reschedule(id, 60));
+  done.Wait();
+  EXPECT_GE(chrono::steady_clock::now() - start, chrono::milliseconds(60));
+  EXPECT_FALSE(timer.Reschedule(id, 10));
+
+  // A function re-arms itself until it is done.
+  Counter runs(3);
+  atomic<Timer::tTimerId> self(0);
+  self = timer.RunAfter(20, [&]() {
+    runs.Notify();
+    if (runs.count() > 0) EXPECT_TRUE(timer.Reschedule(self, 5));
+  });
+  runs.Wait();
+  this_thread::sleep_for(chrono::milliseconds(20));
+  EXPECT_EQ(0, runs.count());
+  EXPECT_EQ(0, timer.size());
+}
+
+TEST(Timer, CancelWaitsForRunningFunction) {
+  Timer timer;
+  Notification started, release;
+  bool finished = false;
+  Timer::tTimerId id = timer.RunEvery(1, [&]() {
+    started.Notify();
+    release.Wait();
+    finished = true;
+  });
+  started.Wait();
+  thread t([&release]() {
+    this_thread::sleep_for(chrono::milliseconds(20));
+    release.Notify();
+  });
+  EXPECT_TRUE(timer.Cancel(id));
+  EXPECT_TRUE(finished);
+  t.join();
+}
+
+TEST(Timer, DropsPendingOnDestruction) {
+  bool ran = false;
+  {
+    Timer timer;
+    timer.RunAfter(1000, [&ran]() { ran = true; });
+  }
+  EXPECT_FALSE(ran);
+}
+
+}  // namespace test
+}  // namespace threading
+}  // namespace util
@@ -0,0 +1,135 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Chase-Lev work-stealing deque of pointers, with the memory orderings of
+// "Correct and Efficient Work-Stealing for Weak Memory Models" (Le et al.).
+// The owner thread pushes and pops at the bottom without locking; any other
+// thread may steal from the top.
+//
+// The buffer grows when full. Replaced buffers are kept until the deque is
+// destroyed since a thief may still be reading them.
+
+#ifndef _PUBLIC_UTIL_THREAD_WORK_STEALING_DEQUE_H_
+#define _PUBLIC_UTIL_THREAD_WORK_STEALING_DEQUE_H_
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "base/common.h"
+
+namespace util {
+namespace threading {
+
+template<typename T>
+class WorkStealingDeque {
+ public:
+  // 'log_capacity' is the log2 of the initial capacity.
+  explicit WorkStealingDeque(int log_capacity = 8) {
+    buffers_.push_back(unique_ptr<Buffer>(new Buffer(int64_t(1) << log_capacity)));
+    buffer_.store(buffers_.back().get(), memory_order_relaxed);
+  }
+
+  // The approximate number of elements.
+  int64_t size() const {
+    int64_t b = bottom_.load(memory_order_relaxed);
+    int64_t t = top_.load(memory_order_relaxed);
+    return b > t ? b - t : 0;
+  }
+
+  bool empty() const { return size() == 0; }
+
+  // Owner only: adds x at the bottom.
+  void Push(T* x) {
+    int64_t b = bottom_.load(memory_order_relaxed);
+    int64_t t = top_.load(memory_order_acquire);
+    Buffer* buffer = buffer_.load(memory_order_relaxed);
+    if (b - t > buffer->capacity - 1) buffer = Grow(buffer, t, b);
+    buffer->Put(b, x);
+    atomic_thread_fence(memory_order_release);
+    bottom_.store(b + 1, memory_order_relaxed);
+  }
+
+  // Owner only: removes and returns the element at the bottom, or null if
+  // the deque is empty.
+  T* Pop() {
+    int64_t b = bottom_.load(memory_order_relaxed) - 1;
+    Buffer* buffer = buffer_.load(memory_order_relaxed);
+    bottom_.store(b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t t = top_.load(memory_order_relaxed);
+    if (t > b) {
+      // Empty.
+      bottom_.store(b + 1, memory_order_relaxed);
+      return nullptr;
+    }
+    T* x = buffer->Get(b);
+    if (t == b) {
+      // The last element: race the thieves for it.
+      if (!top_.compare_exchange_strong(t, t + 1, memory_order_seq_cst,
+                                        memory_order_relaxed))
+        x = nullptr;
+      bottom_.store(b + 1, memory_order_relaxed);
+    }
+    return x;
+  }
+
+  // Any thread: removes and returns the element at the top, or null if the
+  // deque is empty or another thread took the element first.
+  T* Steal() {
+    int64_t t = top_.load(memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t b = bottom_.load(memory_order_acquire);
+    if (t >= b) return nullptr;
+    T* x = buffer_.load(memory_order_acquire)->Get(t);
+    if (!top_.compare_exchange_strong(t, t + 1, memory_order_seq_cst,
+                                      memory_order_relaxed))
+      return nullptr;
+    return x;
+  }
+
+ private:
+  struct Buffer {
+    explicit Buffer(int64_t c)
+        : capacity(c), mask(c - 1), elements(new atomic<T*>[c]) {}
+
+    T* Get(int64_t i) const {
+      return elements[i & mask].load(memory_order_relaxed);
+    }
+    void Put(int64_t i, T* x) {
+      elements[i & mask].store(x, memory_order_relaxed);
+    }
+
+    const int64_t capacity;
+    const int64_t mask;
+    unique_ptr<atomic<T*>[]> elements;
+  };
+
+  static const size_t kCacheLineSize = 64;
+
+  // Owner only: replaces the buffer with one twice as large.
+  Buffer* Grow(Buffer* old, int64_t top, int64_t bottom) {
+    Buffer* buffer = new Buffer(old->capacity * 2);
+    for (int64_t i = top; i < bottom; ++i) buffer->Put(i, old->Get(i));
+    buffers_.push_back(unique_ptr<Buffer>(buffer));
+    buffer_.store(buffer, memory_order_release);
+    return buffer;
+  }
+
+  // Padded onto separate cache lines: thieves write top_, the owner bottom_.
+  // Padding rather than alignas, as new ignores extended alignment before
+  // C++17 and deques are allocated with it.
+  atomic<int64_t> top_{0};
+  char top_pad_[kCacheLineSize - sizeof(atomic<int64_t>)];
+  atomic<int64_t> bottom_{0};
+  atomic<Buffer*> buffer_{nullptr};
+  // All the buffers allocated so far, the current one last. Owner only.
+  vector<unique_ptr<Buffer>> buffers_;
+
+  WorkStealingDeque(const WorkStealingDeque&) = delete;
+  WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+};
+
+}  // namespace threading
+}  // namespace util
+
+#endif  // _PUBLIC_UTIL_THREAD_WORK_STEALING_DEQUE_H_
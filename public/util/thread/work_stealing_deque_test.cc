@@ -0,0 +1,74 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Tests for WorkStealingDeque.
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "test/cc/test_main.h"
+#include "util/thread/work_stealing_deque.h"
+
+namespace util {
+namespace threading {
+namespace test {
+
+TEST(WorkStealingDeque, OwnerIsLifoThiefIsFifo) {
+  WorkStealingDeque<int> deque(1);
+  int values[4] = {0, 1, 2, 3};
+  ASSERT_TRUE(deque.Pop() == nullptr);
+  ASSERT_TRUE(deque.Steal() == nullptr);
+
+  // Grows past the initial capacity of 2.
+  for (int& v : values) deque.Push(&v);
+  EXPECT_EQ(4, deque.size());
+  EXPECT_EQ(3, *deque.Pop());
+  EXPECT_EQ(0, *deque.Steal());
+  EXPECT_EQ(2, *deque.Pop());
+  EXPECT_EQ(1, *deque.Steal());
+  EXPECT_TRUE(deque.empty());
+  ASSERT_TRUE(deque.Pop() == nullptr);
+  ASSERT_TRUE(deque.Steal() == nullptr);
+}
+
+TEST(WorkStealingDeque, EachElementTakenOnce) {
+  const int kNumElements = 200000, kNumThieves = 3;
+  WorkStealingDeque<int> deque(2);
+  vector<int> values(kNumElements);
+  vector<atomic<int>> taken(kNumElements);
+  for (int i = 0; i < kNumElements; ++i) {
+    values[i] = i;
+    taken[i] = 0;
+  }
+
+  atomic<bool> done(false);
+  vector<thread> thieves;
+  for (int t = 0; t < kNumThieves; ++t) {
+    thieves.push_back(thread([&]() {
+      while (!done) {
+        int* x = deque.Steal();
+        if (x != nullptr) ++taken[*x];
+      }
+    }));
+  }
+
+  // The owner pops one element for every two it pushes.
+  for (int i = 0; i < kNumElements; ++i) {
+    deque.Push(&values[i]);
+    if (i % 2 == 1) {
+      int* x = deque.Pop();
+      if (x != nullptr) ++taken[*x];
+    }
+  }
+  while (int* x = deque.Pop()) ++taken[*x];
+  done = true;
+  for (thread& t : thieves) t.join();
+
+  int num_wrong = 0;
+  for (int i = 0; i < kNumElements; ++i) num_wrong += taken[i] != 1;
+  EXPECT_EQ(0, num_wrong);
+}
+
+}  // namespace test
+}  // namespace threading
+}  // namespace util
@@ -0,0 +1,220 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Work-stealing thread pool with the same interface as ThreadPool.
+//
+// Each worker has its own deque (see work_stealing_deque.h). Functions added
+// from a worker of the pool go to the deque of that worker, which runs them
+// last in, first out, so that recursive tasks mostly stay on one thread and
+// never touch a shared lock. Functions added from other threads go to a global
+// injection queue. A worker with nothing to do takes a batch from the
+// injection queue, then steals from the top of the deques of the other
+// workers, and parks when there is nothing left anywhere.
+//
+// Prefer it over ThreadPool for many small or recursively spawned functions,
+// where the shared queue of ThreadPool becomes the bottleneck. It can also be
+// created through ThreadPoolFactory::Pool<WorkStealingThreadPool>(id, ...).
+
+#ifndef _PUBLIC_UTIL_THREAD_WORK_STEALING_THREAD_POOL_H_
+#define _PUBLIC_UTIL_THREAD_WORK_STEALING_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "base/common.h"
+#include "util/thread/thread_pool.h"
+#include "util/thread/work_stealing_deque.h"
+
+namespace util {
+namespace threading {
+
+class WorkStealingThreadPool : public ThreadPool {
+ public:
+  // The capacity bounds the number of functions waiting to run, as for
+  // ThreadPool. It is only checked by TryAdd. The workers are pinned to 'cpus'
+  // if not empty.
+  WorkStealingThreadPool(int num_workers,
+                         int capacity = numeric_limits<int>::max(),
+                         const CpuSet& cpus = CpuSet())
+      : ThreadPool(SQ(), 0, capacity), cpus_(cpus) {
+    ASSERT(num_workers > 0);
+    stats_.set_num_workers(num_workers);
+    workers_.reserve(num_workers);
+    for (int i = 0; i < num_workers; ++i)
+      workers_.push_back(unique_ptr<Worker>(new Worker(i)));
+    // Start the threads once all the deques exist, as they steal from each
+    // other.
+    for (int i = 0; i < num_workers; ++i)
+      workers_[i]->thread.reset(
+          new std::thread(&WorkStealingThreadPool::WorkHorse, this, i));
+  }
+
+  // Runs the functions still waiting and stops the workers.
+  virtual ~WorkStealingThreadPool() {
+    {
+      std::unique_lock<std::mutex> l(park_mutex_);
+      done_ = true;
+    }
+    park_cond_.notify_all();
+    for (unique_ptr<Worker>& w : workers_) w->thread->join();
+  }
+
+  virtual int num_workers() const { return workers_.size(); }
+
+  virtual int queue_size() const { return num_queued_; }
+
+ protected:
+  // The deques have no lanes: the priority is ignored.
+  virtual void PushTask(ThreadPoolTask task, ThreadPoolPriority priority) {
+    Push(new ThreadPoolTask(std::move(task)));
+  }
+
+  virtual bool TryPushTask(ThreadPoolTask&& task, ThreadPoolPriority priority) {
+    if (num_queued_ >= capacity_) return false;
+    PushTask(std::move(task), priority);
+    return true;
+  }
+
+ private:
+  struct Worker {
+    explicit Worker(int i) : seed(i + 1) {}
+
+    WorkStealingDeque<ThreadPoolTask> deque;
+    unique_ptr<std::thread> thread;
+    // For picking victims to steal from.
+    unsigned seed;
+  };
+
+  // The pool and worker index of the calling thread, if it is a worker.
+  struct tCurrentWorker {
+    WorkStealingThreadPool* pool = nullptr;
+    int index = -1;
+  };
+
+  static tCurrentWorker& CurrentWorker() {
+    static thread_local tCurrentWorker current;
+    return current;
+  }
+
+  void Push(ThreadPoolTask* f) {
+    // Count the function before it can be taken, so that num_queued_ never
+    // goes negative.
+    ++num_queued_;
+    const tCurrentWorker& current = CurrentWorker();
+    if (current.pool == this) {
+      workers_[current.index]->deque.Push(f);
+    } else {
+      std::lock_guard<std::mutex> l(injection_mutex_);
+      injection_.push_back(f);
+    }
+    // Both num_queued_ and num_parked_ are sequentially consistent: either
+    // this sees a parking worker, or the worker sees the new function.
+    if (num_parked_ > 0) {
+      std::unique_lock<std::mutex> l(park_mutex_);
+      park_cond_.notify_one();
+    }
+  }
+
+  // Moves up to a fair share of the injection queue to the deque of worker
+  // 'index' and returns one of the functions, or null if the queue is empty.
+  ThreadPoolTask* TakeInjected(int index) {
+    std::lock_guard<std::mutex> l(injection_mutex_);
+    if (injection_.empty()) return nullptr;
+    size_t n = (injection_.size() + workers_.size() - 1) / workers_.size();
+    if (n > kMaxInjectedBatch) n = kMaxInjectedBatch;
+    ThreadPoolTask* f = injection_.front();
+    injection_.pop_front();
+    for (size_t i = 1; i < n; ++i) {
+      workers_[index]->deque.Push(injection_.front());
+      injection_.pop_front();
+    }
+    return f;
+  }
+
+  // Steals from the other workers, starting at a random one.
+  ThreadPoolTask* Steal(int index) {
+    Worker& self = *workers_[index];
+    int n = workers_.size();
+    int start = rand_r(&self.seed) % n;
+    for (int i = 0; i < n; ++i) {
+      int victim = (start + i) % n;
+      if (victim == index) continue;
+      ThreadPoolTask* f = workers_[victim]->deque.Steal();
+      if (f != nullptr) return f;
+    }
+    return nullptr;
+  }
+
+  ThreadPoolTask* FindWork(int index) {
+    ThreadPoolTask* f = workers_[index]->deque.Pop();
+    if (f == nullptr) f = TakeInjected(index);
+    if (f == nullptr) f = Steal(index);
+    return f;
+  }
+
+  // Waits until there may be work. Returns false once the pool is destroyed
+  // and no work is left.
+  bool Park() {
+    std::unique_lock<std::mutex> l(park_mutex_);
+    ++num_parked_;
+    park_cond_.wait(l, [this]() { return num_queued_ > 0 || done_; });
+    --num_parked_;
+    return num_queued_ > 0;
+  }
+
+  void WorkHorse(int index) {
+    VLOG(4) << "Started work stealing thread: " << index;
+    if (!SetCurrentThreadAffinity(cpus_))
+      LOG(INFO) << "Could not pin thread " << index << " to its cpus.";
+    CurrentWorker().pool = this;
+    CurrentWorker().index = index;
+    while (true) {
+      ThreadPoolTask* f = FindWork(index);
+      if (f == nullptr) {
+        // Another worker may have counted a function it has not pushed yet,
+        // or be racing for the same one: try again before parking.
+        std::this_thread::yield();
+        f = FindWork(index);
+      }
+      if (f == nullptr) {
+        if (!Park()) break;
+        continue;
+      }
+      --num_queued_;
+      (*f)();
+      delete f;
+    }
+    VLOG(4) << "Finished work stealing thread: " << index;
+  }
+
+  // The most functions a worker moves from the injection queue at once.
+  static constexpr size_t kMaxInjectedBatch = 32;
+
+  const CpuSet cpus_;
+  vector<unique_ptr<Worker>> workers_;
+
+  // Functions added from outside the pool.
+  std::mutex injection_mutex_;
+  std::deque<ThreadPoolTask*> injection_;
+
+  // The number of functions added and not yet taken by a worker.
+  std::atomic_int num_queued_{0};
+
+  // Idle workers wait on park_cond_.
+  std::mutex park_mutex_;
+  condition_variable park_cond_;
+  std::atomic_int num_parked_{0};
+  // Set when the pool is destroyed. Guarded by park_mutex_.
+  bool done_ = false;
+};
+
+}  // namespace threading
+}  // namespace util
+
+#endif  // _PUBLIC_UTIL_THREAD_WORK_STEALING_THREAD_POOL_H_
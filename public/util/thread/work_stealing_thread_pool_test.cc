@@ -0,0 +1,132 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Tests for WorkStealingThreadPool.
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "test/cc/test_main.h"
+#include "util/thread/counters.h"
+#include "util/thread/work_stealing_thread_pool.h"
+
+namespace util {
+namespace threading {
+namespace test {
+
+namespace {
+
+// Adds 2^depth functions to the pool, recursively from its workers.
+void Spawn(ThreadPool* pool, int depth, atomic<int>* count) {
+  if (depth == 0) {
+    ++*count;
+    return;
+  }
+  for (int i = 0; i < 2; ++i)
+    pool->Add([pool, depth, count]() { Spawn(pool, depth - 1, count); });
+}
+
+}  // namespace
+
+TEST(WorkStealingThreadPool, Sanity) {
+  WorkStealingThreadPool pool(4);
+  atomic<int> count(0);
+  pool.Add([&count]() { ++count; });
+  pool.Wait();
+  EXPECT_EQ(1, count);
+  EXPECT_TRUE(pool.empty());
+}
+
+TEST(WorkStealingThreadPool, MultipleProducers) {
+  WorkStealingThreadPool pool(8);
+  atomic<int> count(0);
+  vector<thread> producers;
+  for (int i = 0; i < 8; ++i) {
+    producers.push_back(thread([&pool, &count]() {
+      for (int j = 0; j < 10000; ++j) pool.Add([&count]() { ++count; });
+    }));
+  }
+  for (thread& t : producers) t.join();
+  pool.Wait();
+  EXPECT_EQ(80000, count);
+}
+
+TEST(WorkStealingThreadPool, Recursive) {
+  WorkStealingThreadPool pool(4);
+  atomic<int> count(0);
+  pool.Add([&pool, &count]() { Spawn(&pool, 14, &count); });
+  pool.Wait();
+  EXPECT_EQ(1 << 14, count);
+}
+
+TEST(WorkStealingThreadPool, StealsFromBusyWorker) {
+  WorkStealingThreadPool pool(2);
+  Notification started("started"), release("release");
+  atomic<int> count(0);
+  // The first function blocks its worker after adding more to its deque; the
+  // other worker has to steal them.
+  pool.Add([&]() {
+    for (int i = 0; i < 10; ++i) pool.Add([&count]() { ++count; });
+    started.Notify();
+    release.Wait();
+  });
+  started.Wait();
+  for (int i = 0; i < 1000 && count < 10; ++i)
+    this_thread::sleep_for(chrono::milliseconds(1));
+  EXPECT_EQ(10, count);
+  release.Notify();
+  pool.Wait();
+}
+
+TEST(WorkStealingThreadPool, WaitWithTimeout) {
+  WorkStealingThreadPool pool(2);
+  Notification start("start"), wait("wait"), notify("notify");
+  pool.Add([&start, &wait, &notify](){
+    start.Notify(); wait.Wait(); notify.Notify(); });
+
+  start.Wait();
+  EXPECT_FALSE(pool.WaitWithTimeout(10));
+  wait.Notify();
+  notify.Wait();
+  EXPECT_TRUE(pool.WaitWithTimeout(10));
+}
+
+TEST(WorkStealingThreadPool, TryAddAtCapacity) {
+  WorkStealingThreadPool pool(1, 2);
+  Notification start("start"), release("release");
+  pool.Add([&start, &release]() { start.Notify(); release.Wait(); });
+  start.Wait();
+  EXPECT_TRUE(pool.TryAdd([]() {}));
+  EXPECT_TRUE(pool.TryAdd([]() {}));
+  EXPECT_EQ(2, pool.queue_size());
+  EXPECT_FALSE(pool.TryAdd([]() {}));
+  EXPECT_EQ(3, pool.size());
+  release.Notify();
+  pool.Wait();
+}
+
+TEST(WorkStealingThreadPool, DestructorRunsPendingFunctions) {
+  atomic<int> count(0);
+  {
+    WorkStealingThreadPool pool(2);
+    for (int i = 0; i < 1000; ++i) pool.Add([&count]() { ++count; });
+  }
+  EXPECT_EQ(1000, count);
+}
+
+TEST(WorkStealingThreadPool, Factory) {
+  auto pool = ThreadPoolFactory::Pool<WorkStealingThreadPool>(
+      "work_stealing_thread_pool_test", 4);
+  EXPECT_TRUE(dynamic_cast<WorkStealingThreadPool*>(pool.get()) != nullptr);
+  atomic<int> count(0);
+  pool->Add([&pool, &count]() { Spawn(pool.get(), 8, &count); });
+  pool->Wait();
+  EXPECT_EQ(1 << 8, count);
+}
+
+}  // namespace test
+}  // namespace threading
+}  // namespace util
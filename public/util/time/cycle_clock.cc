@@ -0,0 +1,25 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+#include "util/time/cycle_clock.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace util {
+namespace time {
+
+double CycleClock::CyclesPerUsec() {
+  static double cycles_per_usec = []() {
+    auto start = std::chrono::steady_clock::now();
+    int64_t start_cycles = Now();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    int64_t cycles = Now() - start_cycles;
+    double usec = std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now() - start).count();
+    return std::max(cycles / usec, 1e-3);
+  }();
+  return cycles_per_usec;
+}
+
+}  // namespace time
+}  // namespace util
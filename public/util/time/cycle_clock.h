@@ -0,0 +1,39 @@
+// Copyright 2015 Room77 Inc. All Rights Reserved.
+
+// Timestamps for measuring short durations: the TSC on x86, the steady clock
+// elsewhere. Reading the TSC takes a few nanoseconds and does not serialize
+// the pipeline, so it is only meant for durations of more than a few hundred
+// cycles.
+
+#ifndef _PUBLIC_UTIL_TIME_CYCLE_CLOCK_H_
+#define _PUBLIC_UTIL_TIME_CYCLE_CLOCK_H_
+
+#include <chrono>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "base/common.h"
+
+namespace util {
+namespace time {
+
+class CycleClock {
+ public:
+  static int64_t Now() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+  }
+
+  // The number of cycles per microsecond, measured on the first call.
+  static double CyclesPerUsec();
+};
+
+}  // namespace time
+}  // namespace util
+
+#endif  // _PUBLIC_UTIL_TIME_CYCLE_CLOCK_H_